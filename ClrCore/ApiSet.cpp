@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include "ApiSet.h"
+#include "ImageView.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_API_SET_SCHEMA_VERSION 6
+
+	// The version 6 layout. Offsets are from the start of the namespace, lengths are in bytes.
+	typedef struct _LS_API_SET_NAMESPACE
+	{
+		DWORD Version;
+		DWORD Size;
+		DWORD Flags;
+		DWORD Count;
+		DWORD EntryOffset;
+		DWORD HashOffset;
+		DWORD HashFactor;
+
+	} LS_API_SET_NAMESPACE, *PLS_API_SET_NAMESPACE;
+
+	typedef struct _LS_API_SET_NAMESPACE_ENTRY
+	{
+		DWORD Flags;
+		DWORD NameOffset;
+		DWORD NameLength;
+
+		// The name up to the last hyphen, without it.
+		DWORD HashedLength;
+		DWORD ValueOffset;
+		DWORD ValueCount;
+
+	} LS_API_SET_NAMESPACE_ENTRY, *PLS_API_SET_NAMESPACE_ENTRY;
+
+	typedef struct _LS_API_SET_VALUE_ENTRY
+	{
+		DWORD Flags;
+
+		// The importing module this host is for. Empty for the default.
+		DWORD NameOffset;
+		DWORD NameLength;
+		DWORD ValueOffset;
+		DWORD ValueLength;
+
+	} LS_API_SET_VALUE_ENTRY, *PLS_API_SET_VALUE_ENTRY;
+
+	// Schema strings are not terminated. Lowercase, like every key.
+	static bool GetSchemaString(const BYTE* data, DWORD size, DWORD offset, DWORD length, WWuString& output)
+	{
+		if (offset > size || length > size - offset || length % sizeof(WCHAR) != 0)
+			return false;
+
+		wuvector<WCHAR> buffer((length / sizeof(WCHAR)) + 1, L'\0');
+		RtlCopyMemory(buffer.data(), data + offset, length);
+		output = WWuString(buffer.data()).ToLower();
+
+		return true;
+	}
+
+	// 'api-ms-win-core-file-l1-2-4.dll' is looked up as 'api-ms-win-core-file-l1-2', so any
+	// revision of a contract gets the host of the one in the schema. The extension is optional.
+	static bool GetLookupKey(const WWuString& module_name, WWuString& key)
+	{
+		WWuString name = module_name.ToLower();
+		const WCHAR* buffer = name.GetBuffer();
+		size_t length = name.Length();
+		if (length >= 4 && wcscmp(buffer + length - 4, L".dll") == 0)
+			length -= 4;
+
+		while (length > 0 && buffer[length - 1] != L'-')
+			length--;
+
+		if (length < 2)
+			return false;
+
+		wuvector<WCHAR> key_buffer(buffer, buffer + length - 1);
+		key_buffer.push_back(L'\0');
+		key = WWuString(key_buffer.data());
+
+		return true;
+	}
+
+	ApiSetSchema::ApiSetSchema() { }
+
+	ApiSetSchema::~ApiSetSchema() { }
+
+	const LSRESULT ApiSetSchema::Load(const WWuString& system_directory)
+	{
+		_entries.clear();
+
+		WWuString schema_path = system_directory + L"\\apisetschema.dll";
+		HANDLE h_file = CreateFile(schema_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(h_file, &file_size)) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (h_map == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		LPVOID view = MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0);
+		if (view == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_map);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		// Read as a file, the section is at its raw data offset.
+		ImageView image;
+		LSRESULT result = image.Attach(static_cast<const BYTE*>(view), static_cast<size_t>(file_size.QuadPart));
+		if (result.Result == ERROR_SUCCESS) {
+			DWORD section_size = 0;
+			const BYTE* section = image.GetSection(".apiset", section_size);
+			if (section == NULL)
+				result = LSRESULT(ERROR_NOT_FOUND, L"The API set schema has no '.apiset' section.", __FILEW__, __LINE__);
+			else
+				result = Parse(section, section_size);
+		}
+
+		UnmapViewOfFile(view);
+		CloseHandle(h_map);
+		CloseHandle(h_file);
+
+		if (result.Result != ERROR_SUCCESS)
+			_entries.clear();
+
+		return result;
+	}
+
+	bool ApiSetSchema::IsApiSetName(const WWuString& module_name) noexcept
+	{
+		return _wcsnicmp(module_name.GetBuffer(), L"api-", 4) == 0 || _wcsnicmp(module_name.GetBuffer(), L"ext-", 4) == 0;
+	}
+
+	bool ApiSetSchema::Resolve(const WWuString& module_name, const WWuString& importing_name, WWuString& host_name) const
+	{
+		WWuString key;
+		if (!IsApiSetName(module_name) || !GetLookupKey(module_name, key))
+			return false;
+
+		auto entry = _entries.find(key);
+		if (entry == _entries.end())
+			return false;
+
+		if (!WWuString::IsNullOrEmpty(importing_name)) {
+			auto host = entry->second.Hosts.find(WWuString(PathFindFileName(importing_name.GetBuffer())).ToLower());
+			if (host != entry->second.Hosts.end() && host->second.Length() > 0) {
+				host_name = host->second;
+				return true;
+			}
+		}
+
+		// Contracts without a host are not implemented on this system.
+		if (entry->second.DefaultHost.Length() == 0)
+			return false;
+
+		host_name = entry->second.DefaultHost;
+
+		return true;
+	}
+
+	const LSRESULT ApiSetSchema::Parse(const BYTE* data, DWORD size)
+	{
+		if (size < sizeof(LS_API_SET_NAMESPACE))
+			return LSRESULT(ERROR_BAD_FORMAT, L"The API set schema is truncated.", __FILEW__, __LINE__);
+
+		const LS_API_SET_NAMESPACE* api_namespace = reinterpret_cast<const LS_API_SET_NAMESPACE*>(data);
+		if (api_namespace->Version != LS_API_SET_SCHEMA_VERSION)
+			return LSRESULT(ERROR_NOT_SUPPORTED, L"Unsupported API set schema version.", __FILEW__, __LINE__);
+
+		if (api_namespace->EntryOffset > size || api_namespace->Count > (size - api_namespace->EntryOffset) / sizeof(LS_API_SET_NAMESPACE_ENTRY))
+			return LSRESULT(ERROR_BAD_FORMAT, L"API set schema entries out of bounds.", __FILEW__, __LINE__);
+
+		const LS_API_SET_NAMESPACE_ENTRY* entries = reinterpret_cast<const LS_API_SET_NAMESPACE_ENTRY*>(data + api_namespace->EntryOffset);
+		for (DWORD i = 0; i < api_namespace->Count; i++) {
+			const LS_API_SET_NAMESPACE_ENTRY& entry = entries[i];
+			WWuString name;
+			if (entry.HashedLength > entry.NameLength || !GetSchemaString(data, size, entry.NameOffset, entry.HashedLength, name))
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid API set schema entry name.", __FILEW__, __LINE__);
+
+			if (entry.ValueOffset > size || entry.ValueCount > (size - entry.ValueOffset) / sizeof(LS_API_SET_VALUE_ENTRY))
+				return LSRESULT(ERROR_BAD_FORMAT, L"API set schema values out of bounds.", __FILEW__, __LINE__);
+
+			LS_API_SET_ENTRY& output = _entries[name];
+			const LS_API_SET_VALUE_ENTRY* values = reinterpret_cast<const LS_API_SET_VALUE_ENTRY*>(data + entry.ValueOffset);
+			for (DWORD j = 0; j < entry.ValueCount; j++) {
+				WWuString importing_name;
+				WWuString host_name;
+				if (!GetSchemaString(data, size, values[j].NameOffset, values[j].NameLength, importing_name)
+					|| !GetSchemaString(data, size, values[j].ValueOffset, values[j].ValueLength, host_name))
+				{
+					return LSRESULT(ERROR_BAD_FORMAT, L"Invalid API set schema value.", __FILEW__, __LINE__);
+				}
+
+				if (importing_name.Length() == 0)
+					output.DefaultHost = host_name;
+				else
+					output.Hosts[importing_name] = host_name;
+			}
+		}
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// A contract in the schema. 'Hosts' maps an importing module name to the host it gets
+	// instead of the default, like 'kernel32.dll' getting 'kernel32.dll', not 'kernelbase.dll'.
+	typedef struct _LS_API_SET_ENTRY
+	{
+		WWuString DefaultHost;
+		wumap<WWuString, WWuString> Hosts;
+
+		_LS_API_SET_ENTRY() { }
+		~_LS_API_SET_ENTRY() { }
+
+	} LS_API_SET_ENTRY, *PLS_API_SET_ENTRY;
+
+	// The API set schema, from the '.apiset' section of 'apisetschema.dll'. The loader redirects
+	// 'api-', and 'ext-' names to their host module before looking for a file, so there is no file
+	// to find for them. Only the Windows 10 layout, version 6, is read. With an older schema, or
+	// none, every API set name is left unresolved.
+	class ApiSetSchema
+	{
+	public:
+		ApiSetSchema();
+		~ApiSetSchema();
+
+		// Reads 'apisetschema.dll' from 'system_directory'.
+		const LSRESULT Load(const WWuString& system_directory);
+
+		// Names the loader sends to the schema, whether they are in it or not.
+		_NODISCARD static bool IsApiSetName(const WWuString& module_name) noexcept;
+
+		// The host module name for 'module_name', imported by 'importing_name'. False when the
+		// contract is not in the schema, or has no host on this system.
+		bool Resolve(const WWuString& module_name, const WWuString& importing_name, WWuString& host_name) const;
+
+	private:
+		// Keyed by the lowercase name up to the last hyphen, the part the loader compares.
+		wumap<WWuString, LS_API_SET_ENTRY> _entries;
+
+		const LSRESULT Parse(const BYTE* data, DWORD size);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,518 @@
+#include "pch.h"
+
+#include "Archive.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// Not in every SDK version.
+	#ifndef IMPORT_OBJECT_NAME_EXPORTAS
+	#define IMPORT_OBJECT_NAME_EXPORTAS 4
+	#endif
+
+	typedef struct _LS_INDEX_CONTEXT
+	{
+		const wuvector<WWuString>* Paths;
+		wuvector<LS_LIBRARY_INDEX>* Indexes;
+		volatile LONG Next;
+
+	} LS_INDEX_CONTEXT, *PLS_INDEX_CONTEXT;
+
+	// Byte order, then length. The order of the second linker member.
+	static bool CompareNames(const char* left, DWORD left_length, const char* right, DWORD right_length) noexcept
+	{
+		int result = memcmp(left, right, min(left_length, right_length));
+		if (result != 0)
+			return result < 0;
+
+		return left_length < right_length;
+	}
+
+	static WuString CopyName(const char* name, DWORD length, wuvector<char>& buffer)
+	{
+		buffer.assign(name, name + length);
+		buffer.push_back('\0');
+
+		return WuString(buffer.data());
+	}
+
+	ArchiveReader::ArchiveReader()
+		: _h_file(INVALID_HANDLE_VALUE), _h_map(NULL), _view(NULL), _size(0), _long_names(NULL), _long_names_size(0) { }
+
+	ArchiveReader::~ArchiveReader()
+	{
+		Close();
+	}
+
+	const LSRESULT ArchiveReader::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (_h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		if (file_size.QuadPart < IMAGE_ARCHIVE_START_SIZE || file_size.QuadPart > MAXDWORD)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid archive.", __FILEW__, __LINE__);
+
+		_h_map = CreateFileMapping(_h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_h_map == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view = static_cast<const BYTE*>(MapViewOfFile(_h_map, FILE_MAP_READ, 0, 0, 0));
+		if (_view == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_size = static_cast<size_t>(file_size.QuadPart);
+		if (!IsArchive(_view, _size))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid archive.", __FILEW__, __LINE__);
+
+		if (!ReadMembers())
+			return LSRESULT(ERROR_BAD_FORMAT, L"Archive member header is invalid.", __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+
+	void ArchiveReader::Close() noexcept
+	{
+		if (_view != NULL) {
+			UnmapViewOfFile(_view);
+			_view = NULL;
+		}
+
+		if (_h_map != NULL) {
+			CloseHandle(_h_map);
+			_h_map = NULL;
+		}
+
+		if (_h_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_h_file);
+			_h_file = INVALID_HANDLE_VALUE;
+		}
+
+		_size = 0;
+		_long_names = NULL;
+		_long_names_size = 0;
+		_members.clear();
+		_symbols.clear();
+	}
+
+	bool ArchiveReader::IsArchive(const BYTE* data, size_t size) noexcept
+	{
+		return data != NULL && size >= IMAGE_ARCHIVE_START_SIZE && memcmp(data, IMAGE_ARCHIVE_START, IMAGE_ARCHIVE_START_SIZE) == 0;
+	}
+
+	bool ArchiveReader::FindSymbol(const char* name, DWORD length, DWORD& member) const noexcept
+	{
+		auto iterator = std::lower_bound(_symbols.begin(), _symbols.end(), name, [length](const LS_ARCHIVE_SYMBOL& symbol, const char* value) {
+			return CompareNames(symbol.Name, symbol.NameLength, value, length);
+		});
+
+		if (iterator == _symbols.end() || iterator->NameLength != length || memcmp(iterator->Name, name, length) != 0)
+			return false;
+
+		member = iterator->Member;
+
+		return true;
+	}
+
+	const LSRESULT ArchiveReader::OpenObject(DWORD member, CoffObject& object) const
+	{
+		if (member >= _members.size() || _members[member].Kind != ArchiveMemberObject)
+			return LSRESULT(ERROR_INVALID_PARAMETER, L"Member is not a COFF object.", __FILEW__, __LINE__);
+
+		return object.Attach(_view + _members[member].DataOffset, _members[member].Size);
+	}
+
+	bool ArchiveReader::GetImportEntry(DWORD member, LS_IMPORT_ENTRY& entry) const noexcept
+	{
+		if (member >= _members.size() || _members[member].Kind != ArchiveMemberImport)
+			return false;
+
+		const LS_ARCHIVE_MEMBER& archive_member = _members[member];
+		const IMPORT_OBJECT_HEADER* header = reinterpret_cast<const IMPORT_OBJECT_HEADER*>(_view + archive_member.DataOffset);
+		if (static_cast<ULONGLONG>(sizeof(IMPORT_OBJECT_HEADER)) + header->SizeOfData > archive_member.Size)
+			return false;
+
+		entry.Machine = header->Machine;
+		entry.TimeDateStamp = header->TimeDateStamp;
+		entry.OrdinalOrHint = header->Ordinal;
+		entry.Type = static_cast<BYTE>(header->Type);
+		entry.NameType = static_cast<BYTE>(header->NameType);
+
+		// Symbol, and DLL names. 'EXPORTAS' entries have the name exported after.
+		const char* strings = reinterpret_cast<const char*>(header + 1);
+		const char* end = strings + header->SizeOfData;
+		entry.Symbol = strings;
+		entry.SymbolLength = static_cast<DWORD>(strnlen(entry.Symbol, end - entry.Symbol));
+		entry.Module = entry.Symbol + entry.SymbolLength + 1;
+		if (entry.Module >= end)
+			return false;
+
+		entry.ModuleLength = static_cast<DWORD>(strnlen(entry.Module, end - entry.Module));
+		entry.ImportName = entry.Symbol;
+		entry.ImportNameLength = entry.SymbolLength;
+		switch (entry.NameType) {
+			case IMPORT_OBJECT_ORDINAL:
+				entry.ImportName = NULL;
+				entry.ImportNameLength = 0;
+				break;
+
+			case IMPORT_OBJECT_NAME_NO_PREFIX:
+			case IMPORT_OBJECT_NAME_UNDECORATE:
+			{
+				if (entry.ImportNameLength > 0 && (entry.ImportName[0] == '?' || entry.ImportName[0] == '@' || entry.ImportName[0] == '_')) {
+					entry.ImportName++;
+					entry.ImportNameLength--;
+				}
+
+				// Undecorated names end at the first '@'. '_Function@12' is 'Function'.
+				if (entry.NameType == IMPORT_OBJECT_NAME_UNDECORATE) {
+					const char* at = static_cast<const char*>(memchr(entry.ImportName, '@', entry.ImportNameLength));
+					if (at != NULL)
+						entry.ImportNameLength = static_cast<DWORD>(at - entry.ImportName);
+				}
+			} break;
+
+			case IMPORT_OBJECT_NAME_EXPORTAS:
+			{
+				const char* export_name = entry.Module + entry.ModuleLength + 1;
+				if (export_name < end) {
+					entry.ImportName = export_name;
+					entry.ImportNameLength = static_cast<DWORD>(strnlen(export_name, end - export_name));
+				}
+			} break;
+		}
+
+		return true;
+	}
+
+	void ArchiveReader::IndexBatch(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_LIBRARY_INDEX>& indexes)
+	{
+		indexes.clear();
+		indexes.resize(file_paths.size());
+		if (file_paths.empty())
+			return;
+
+		if (thread_count == 0) {
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			thread_count = system_info.dwNumberOfProcessors;
+		}
+
+		// The calling thread is one of the workers.
+		thread_count = static_cast<DWORD>(min(static_cast<size_t>(thread_count), file_paths.size()));
+		thread_count = min(thread_count, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS));
+
+		LS_INDEX_CONTEXT context{ &file_paths, &indexes, 0 };
+		wuvector<HANDLE> threads;
+		for (DWORD i = 1; i < thread_count; i++) {
+			HANDLE h_thread = CreateThread(NULL, 0, IndexWorker, &context, 0, NULL);
+			if (h_thread == NULL)
+				break;
+
+			threads.push_back(h_thread);
+		}
+
+		IndexWorker(&context);
+
+		if (!threads.empty()) {
+			WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, INFINITE);
+			for (HANDLE h_thread : threads)
+				CloseHandle(h_thread);
+		}
+	}
+
+	bool ArchiveReader::ReadMembers()
+	{
+		bool first_linker_found = false;
+		LS_ARCHIVE_MEMBER first_linker{ };
+		LS_ARCHIVE_MEMBER second_linker{ };
+		bool second_linker_found = false;
+
+		size_t offset = IMAGE_ARCHIVE_START_SIZE;
+		while (offset + IMAGE_SIZEOF_ARCHIVE_MEMBER_HDR <= _size) {
+			const IMAGE_ARCHIVE_MEMBER_HEADER* header = reinterpret_cast<const IMAGE_ARCHIVE_MEMBER_HEADER*>(_view + offset);
+			if (memcmp(header->EndHeader, IMAGE_ARCHIVE_END, 2) != 0)
+				return false;
+
+			// Decimal, padded with spaces.
+			ULONGLONG size = 0;
+			for (DWORD i = 0; i < sizeof(header->Size) && header->Size[i] >= '0' && header->Size[i] <= '9'; i++)
+				size = (size * 10) + (header->Size[i] - '0');
+
+			ULONGLONG data_offset = offset + IMAGE_SIZEOF_ARCHIVE_MEMBER_HDR;
+			if (data_offset + size > _size)
+				return false;
+
+			LS_ARCHIVE_MEMBER member{ };
+			member.HeaderOffset = static_cast<DWORD>(offset);
+			member.DataOffset = static_cast<DWORD>(data_offset);
+			member.Size = static_cast<DWORD>(size);
+
+			const char* name = reinterpret_cast<const char*>(header->Name);
+			if (memcmp(name, IMAGE_ARCHIVE_LINKER_MEMBER, sizeof(header->Name)) == 0) {
+				member.Kind = ArchiveMemberLinker;
+				member.Name = name;
+				member.NameLength = 1;
+				if (!first_linker_found) {
+					first_linker = member;
+					first_linker_found = true;
+				}
+				else if (!second_linker_found) {
+					second_linker = member;
+					second_linker_found = true;
+				}
+			}
+			else if (memcmp(name, IMAGE_ARCHIVE_LONGNAMES_MEMBER, sizeof(header->Name)) == 0) {
+				member.Kind = ArchiveMemberLongNames;
+				member.Name = name;
+				member.NameLength = 2;
+				_long_names = reinterpret_cast<const char*>(_view + data_offset);
+				_long_names_size = member.Size;
+			}
+
+			// '/<ECSYMBOLS>/', and '/<HYBRIDMAP>/', for ARM64EC.
+			else if (name[0] == '/' && name[1] == '<') {
+				member.Kind = ArchiveMemberOther;
+				member.Name = name;
+				member.NameLength = static_cast<DWORD>(strnlen(name, sizeof(header->Name)));
+				while (member.NameLength > 0 && name[member.NameLength - 1] == ' ')
+					member.NameLength--;
+			}
+			else {
+				if (!ResolveName(name, member))
+					return false;
+
+				// Short import entries share the anonymous object header signature.
+				const BYTE* data = _view + data_offset;
+				const IMPORT_OBJECT_HEADER* import_header = reinterpret_cast<const IMPORT_OBJECT_HEADER*>(data);
+				if (size >= sizeof(IMPORT_OBJECT_HEADER) && import_header->Sig1 == IMAGE_FILE_MACHINE_UNKNOWN && import_header->Sig2 == IMPORT_OBJECT_HDR_SIG2 && import_header->Version == 0)
+					member.Kind = ArchiveMemberImport;
+				else if (CoffObject::IsCoffObject(data, static_cast<size_t>(size)))
+					member.Kind = ArchiveMemberObject;
+				else
+					member.Kind = ArchiveMemberOther;
+			}
+
+			_members.push_back(member);
+
+			// Members start on even offsets.
+			offset = static_cast<size_t>(data_offset + size + (size & 1));
+		}
+
+		// The second linker member is sorted, and in file byte order. The first is in big endian.
+		if (second_linker_found)
+			ReadSecondLinkerMember(second_linker);
+		else if (first_linker_found)
+			ReadFirstLinkerMember(first_linker);
+		else
+			IndexMembers();
+
+		if (!std::is_sorted(_symbols.begin(), _symbols.end(), [](const LS_ARCHIVE_SYMBOL& left, const LS_ARCHIVE_SYMBOL& right) {
+			return CompareNames(left.Name, left.NameLength, right.Name, right.NameLength);
+		})) {
+			std::sort(_symbols.begin(), _symbols.end(), [](const LS_ARCHIVE_SYMBOL& left, const LS_ARCHIVE_SYMBOL& right) {
+				return CompareNames(left.Name, left.NameLength, right.Name, right.NameLength);
+			});
+		}
+
+		return true;
+	}
+
+	bool ArchiveReader::ResolveName(const char* header_name, LS_ARCHIVE_MEMBER& member) const noexcept
+	{
+		// '/123' is an offset into the long names member.
+		if (header_name[0] == '/' && header_name[1] >= '0' && header_name[1] <= '9') {
+			DWORD offset = 0;
+			for (DWORD i = 1; i < 16 && header_name[i] >= '0' && header_name[i] <= '9'; i++)
+				offset = (offset * 10) + (header_name[i] - '0');
+
+			if (_long_names == NULL || offset >= _long_names_size)
+				return false;
+
+			// Null terminated by the Microsoft linker, '/\n' terminated by GNU ar.
+			member.Name = _long_names + offset;
+			DWORD length = 0;
+			while (offset + length < _long_names_size && member.Name[length] != '\0' && member.Name[length] != '\n')
+				length++;
+
+			if (length > 0 && member.Name[length - 1] == '/')
+				length--;
+
+			member.NameLength = length;
+
+			return true;
+		}
+
+		// Short names end with '/'.
+		member.Name = header_name;
+		const char* slash = static_cast<const char*>(memchr(header_name, '/', 16));
+		if (slash != NULL)
+			member.NameLength = static_cast<DWORD>(slash - header_name);
+		else {
+			member.NameLength = 16;
+			while (member.NameLength > 0 && header_name[member.NameLength - 1] == ' ')
+				member.NameLength--;
+		}
+
+		return true;
+	}
+
+	void ArchiveReader::ReadFirstLinkerMember(const LS_ARCHIVE_MEMBER& member)
+	{
+		const BYTE* data = _view + member.DataOffset;
+		if (member.Size < sizeof(DWORD))
+			return;
+
+		DWORD symbol_count = _byteswap_ulong(*reinterpret_cast<const DWORD*>(data));
+		ULONGLONG strings_offset = sizeof(DWORD) + (static_cast<ULONGLONG>(symbol_count) * sizeof(DWORD));
+		if (strings_offset > member.Size)
+			return;
+
+		const DWORD* offsets = reinterpret_cast<const DWORD*>(data + sizeof(DWORD));
+		const char* name = reinterpret_cast<const char*>(data + strings_offset);
+		const char* end = reinterpret_cast<const char*>(data + member.Size);
+		_symbols.reserve(symbol_count);
+		for (DWORD i = 0; i < symbol_count && name < end; i++) {
+			DWORD length = static_cast<DWORD>(strnlen(name, end - name));
+
+			DWORD member_index;
+			if (FindMember(_byteswap_ulong(offsets[i]), member_index))
+				_symbols.push_back({ name, length, member_index });
+
+			name += length + 1;
+		}
+	}
+
+	void ArchiveReader::ReadSecondLinkerMember(const LS_ARCHIVE_MEMBER& member)
+	{
+		const BYTE* data = _view + member.DataOffset;
+		if (member.Size < sizeof(DWORD))
+			return;
+
+		// Member offsets, then symbol count, one based member indices, and names.
+		DWORD member_count = *reinterpret_cast<const DWORD*>(data);
+		ULONGLONG position = sizeof(DWORD) + (static_cast<ULONGLONG>(member_count) * sizeof(DWORD));
+		if (position + sizeof(DWORD) > member.Size)
+			return;
+
+		const DWORD* offsets = reinterpret_cast<const DWORD*>(data + sizeof(DWORD));
+		DWORD symbol_count = *reinterpret_cast<const DWORD*>(data + position);
+		position += sizeof(DWORD);
+		if (position + (static_cast<ULONGLONG>(symbol_count) * sizeof(WORD)) > member.Size)
+			return;
+
+		const WORD* indices = reinterpret_cast<const WORD*>(data + position);
+		position += static_cast<ULONGLONG>(symbol_count) * sizeof(WORD);
+
+		const char* name = reinterpret_cast<const char*>(data + position);
+		const char* end = reinterpret_cast<const char*>(data + member.Size);
+		_symbols.reserve(symbol_count);
+		for (DWORD i = 0; i < symbol_count && name < end; i++) {
+			DWORD length = static_cast<DWORD>(strnlen(name, end - name));
+
+			DWORD member_index;
+			if (indices[i] > 0 && indices[i] <= member_count && FindMember(offsets[indices[i] - 1], member_index))
+				_symbols.push_back({ name, length, member_index });
+
+			name += length + 1;
+		}
+	}
+
+	// Archives without a linker member. The external definitions of each object, and the import entry symbols.
+	void ArchiveReader::IndexMembers()
+	{
+		CoffObject object;
+		for (DWORD i = 0; i < _members.size(); i++) {
+			if (_members[i].Kind == ArchiveMemberImport) {
+				LS_IMPORT_ENTRY entry;
+				if (GetImportEntry(i, entry))
+					_symbols.push_back({ entry.Symbol, entry.SymbolLength, i });
+
+				continue;
+			}
+
+			if (_members[i].Kind != ArchiveMemberObject || OpenObject(i, object).Result != ERROR_SUCCESS)
+				continue;
+
+			DWORD index = 0;
+			LS_COFF_SYMBOL symbol;
+			while (object.NextSymbol(index, symbol)) {
+				if (symbol.StorageClass == IMAGE_SYM_CLASS_EXTERNAL && symbol.SectionNumber > 0 && symbol.NameLength > 0)
+					_symbols.push_back({ symbol.Name, symbol.NameLength, i });
+			}
+		}
+	}
+
+	bool ArchiveReader::FindMember(DWORD header_offset, DWORD& member) const noexcept
+	{
+		// Members are read in file order.
+		auto iterator = std::lower_bound(_members.begin(), _members.end(), header_offset, [](const LS_ARCHIVE_MEMBER& archive_member, DWORD value) {
+			return archive_member.HeaderOffset < value;
+		});
+
+		if (iterator == _members.end() || iterator->HeaderOffset != header_offset)
+			return false;
+
+		member = static_cast<DWORD>(iterator - _members.begin());
+
+		return true;
+	}
+
+	DWORD WINAPI ArchiveReader::IndexWorker(LPVOID context)
+	{
+		PLS_INDEX_CONTEXT batch = static_cast<PLS_INDEX_CONTEXT>(context);
+
+		// One reader, and name buffer per thread.
+		ArchiveReader reader;
+		wuvector<char> buffer;
+		LONG count = static_cast<LONG>(batch->Paths->size());
+		for (LONG index = InterlockedIncrement(&batch->Next) - 1; index < count; index = InterlockedIncrement(&batch->Next) - 1) {
+			LS_LIBRARY_INDEX& library = (*batch->Indexes)[index];
+			library.Path = (*batch->Paths)[index];
+
+			LSRESULT result = reader.Open(library.Path);
+			library.Result = result.Result;
+			if (result.Result != ERROR_SUCCESS) {
+				reader.Close();
+				continue;
+			}
+
+			library.MemberCount = reader.MemberCount();
+			for (const LS_ARCHIVE_MEMBER& member : reader._members) {
+				if (member.Kind == ArchiveMemberObject)
+					library.ObjectCount++;
+				else if (member.Kind == ArchiveMemberImport)
+					library.ImportCount++;
+			}
+
+			library.Symbols.resize(reader._symbols.size());
+			for (size_t i = 0; i < reader._symbols.size(); i++) {
+				const LS_ARCHIVE_SYMBOL& symbol = reader._symbols[i];
+				const LS_ARCHIVE_MEMBER& member = reader._members[symbol.Member];
+				LS_LIBRARY_SYMBOL& output = library.Symbols[i];
+				output.Name = CopyName(symbol.Name, symbol.NameLength, buffer);
+				output.Member = CopyName(member.Name, member.NameLength, buffer);
+
+				LS_IMPORT_ENTRY entry;
+				if (reader.GetImportEntry(symbol.Member, entry)) {
+					output.IsImport = true;
+					output.Module = CopyName(entry.Module, entry.ModuleLength, buffer);
+					output.OrdinalOrHint = entry.OrdinalOrHint;
+					if (entry.ImportName != NULL)
+						output.ImportName = CopyName(entry.ImportName, entry.ImportNameLength, buffer);
+				}
+			}
+
+			reader.Close();
+		}
+
+		return 0;
+	}
+}
\ No newline at end of file
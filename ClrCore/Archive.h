@@ -0,0 +1,144 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "CoffObject.h"
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_ARCHIVE_MEMBER_KIND
+	{
+		ArchiveMemberLinker,
+		ArchiveMemberLongNames,
+		ArchiveMemberObject,
+		ArchiveMemberImport,
+		ArchiveMemberOther
+
+	} LS_ARCHIVE_MEMBER_KIND;
+
+	// Names point into the file, and are not null terminated.
+	typedef struct _LS_ARCHIVE_MEMBER
+	{
+		DWORD HeaderOffset;
+		DWORD DataOffset;
+		DWORD Size;
+		const char* Name;
+		DWORD NameLength;
+		LS_ARCHIVE_MEMBER_KIND Kind;
+
+	} LS_ARCHIVE_MEMBER, *PLS_ARCHIVE_MEMBER;
+
+	typedef struct _LS_ARCHIVE_SYMBOL
+	{
+		const char* Name;
+		DWORD NameLength;
+		DWORD Member;
+
+	} LS_ARCHIVE_SYMBOL, *PLS_ARCHIVE_SYMBOL;
+
+	// A short import library entry. The header, the symbol name, the DLL name, and for
+	// 'IMPORT_OBJECT_NAME_EXPORTAS' the name exported. 'ImportName' is what the loader looks up.
+	typedef struct _LS_IMPORT_ENTRY
+	{
+		WORD Machine;
+		DWORD TimeDateStamp;
+		WORD OrdinalOrHint;
+
+		// IMPORT_OBJECT_TYPE, and IMPORT_OBJECT_NAME_TYPE.
+		BYTE Type;
+		BYTE NameType;
+		const char* Symbol;
+		DWORD SymbolLength;
+		const char* Module;
+		DWORD ModuleLength;
+		const char* ImportName;
+		DWORD ImportNameLength;
+
+	} LS_IMPORT_ENTRY, *PLS_IMPORT_ENTRY;
+
+	typedef struct _LS_LIBRARY_SYMBOL
+	{
+		WuString Name;
+		WuString Member;
+
+		// Import entries only. Empty 'ImportName' means by ordinal.
+		bool IsImport;
+		WuString Module;
+		WuString ImportName;
+		WORD OrdinalOrHint;
+
+		_LS_LIBRARY_SYMBOL()
+			: IsImport(false), OrdinalOrHint(0) { }
+
+		~_LS_LIBRARY_SYMBOL() { }
+
+	} LS_LIBRARY_SYMBOL, *PLS_LIBRARY_SYMBOL;
+
+	typedef struct _LS_LIBRARY_INDEX
+	{
+		WWuString Path;
+		DWORD Result;
+		DWORD MemberCount;
+		DWORD ObjectCount;
+		DWORD ImportCount;
+		wuvector<LS_LIBRARY_SYMBOL> Symbols;
+
+		_LS_LIBRARY_INDEX()
+			: Result(ERROR_SUCCESS), MemberCount(0), ObjectCount(0), ImportCount(0) { }
+
+		~_LS_LIBRARY_INDEX() { }
+
+	} LS_LIBRARY_INDEX, *PLS_LIBRARY_INDEX;
+
+	// Reader for static, and import libraries. The file is mapped, and the member headers,
+	// linker members, and long names are read in place. Object members are handed to
+	// 'CoffObject' by offset, without extracting them.
+	class ArchiveReader
+	{
+	public:
+		ArchiveReader();
+		~ArchiveReader();
+
+		const LSRESULT Open(const WWuString& file_path);
+		void Close() noexcept;
+
+		static bool IsArchive(const BYTE* data, size_t size) noexcept;
+
+		_NODISCARD DWORD MemberCount() const noexcept { return static_cast<DWORD>(_members.size()); }
+		_NODISCARD DWORD SymbolCount() const noexcept { return static_cast<DWORD>(_symbols.size()); }
+		_NODISCARD const LS_ARCHIVE_MEMBER& GetMember(DWORD index) const noexcept { return _members[index]; }
+		_NODISCARD const LS_ARCHIVE_SYMBOL& GetSymbol(DWORD index) const noexcept { return _symbols[index]; }
+
+		// Symbols are sorted by name. Binary search.
+		bool FindSymbol(const char* name, DWORD length, DWORD& member) const noexcept;
+
+		// Attaches the member data. 'object' is valid while the archive is open.
+		const LSRESULT OpenObject(DWORD member, CoffObject& object) const;
+		bool GetImportEntry(DWORD member, LS_IMPORT_ENTRY& entry) const noexcept;
+
+		// Indexes every library on 'thread_count' threads, copying the symbols out. Zero
+		// threads means one per processor. Failures are reported per file.
+		static void IndexBatch(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_LIBRARY_INDEX>& indexes);
+
+	private:
+		HANDLE _h_file;
+		HANDLE _h_map;
+		const BYTE* _view;
+		size_t _size;
+		const char* _long_names;
+		DWORD _long_names_size;
+		wuvector<LS_ARCHIVE_MEMBER> _members;
+		wuvector<LS_ARCHIVE_SYMBOL> _symbols;
+
+		bool ReadMembers();
+		bool ResolveName(const char* header_name, LS_ARCHIVE_MEMBER& member) const noexcept;
+		void ReadFirstLinkerMember(const LS_ARCHIVE_MEMBER& member);
+		void ReadSecondLinkerMember(const LS_ARCHIVE_MEMBER& member);
+		void IndexMembers();
+		bool FindMember(DWORD header_offset, DWORD& member) const noexcept;
+
+		static DWORD WINAPI IndexWorker(LPVOID context);
+	};
+}
\ No newline at end of file
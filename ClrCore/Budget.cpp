@@ -0,0 +1,56 @@
+#include "pch.h"
+
+#include "Budget.h"
+
+namespace LibSnitcher::Core
+{
+	CancellationToken::CancellationToken()
+		: _cancelled(0), _deadline(0) { }
+
+	CancellationToken::~CancellationToken() { }
+
+	void CancellationToken::Cancel() noexcept
+	{
+		InterlockedExchange(&_cancelled, 1);
+	}
+
+	void CancellationToken::Reset() noexcept
+	{
+		InterlockedExchange(&_cancelled, 0);
+		_deadline = 0;
+	}
+
+	void CancellationToken::SetDeadline(ULONGLONG milliseconds) noexcept
+	{
+		_deadline = milliseconds == 0 ? 0 : GetTickCount64() + milliseconds;
+	}
+
+	LS_WORK_STOP CancellationToken::Check() const noexcept
+	{
+		if (_cancelled != 0)
+			return WorkStopCancelled;
+
+		if (_deadline != 0 && GetTickCount64() >= _deadline)
+			return WorkStopDeadline;
+
+		return WorkStopNone;
+	}
+
+	WorkBudget::WorkBudget(const LS_WORK_LIMITS& limits, const CancellationToken* token) noexcept
+		: _limits(limits), _token(token), _descriptors(0), _thunks(0), _bytes(0), _polls(0), _stop(WorkStopNone)
+	{
+		// A file started after the deadline is not walked at all.
+		if (_token != NULL)
+			_stop = _token->Check();
+	}
+
+	WorkBudget::~WorkBudget() { }
+
+	bool WorkBudget::CheckSections(DWORD count) noexcept
+	{
+		if (_stop == WorkStopNone && _limits.MaxSections != 0 && count > _limits.MaxSections)
+			_stop = WorkStopSections;
+
+		return _stop == WorkStopNone;
+	}
+}
\ No newline at end of file
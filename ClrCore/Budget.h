@@ -0,0 +1,112 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// The token is polled once every this many budget checks. A tick count read is cheap, but not free.
+	#define LS_BUDGET_POLL_INTERVAL 256
+
+	// Why a walk stopped before the end of its tables. Anything but 'WorkStopNone' means a partial result.
+	typedef enum _LS_WORK_STOP
+	{
+		WorkStopNone,
+		WorkStopCancelled,
+		WorkStopDeadline,
+		WorkStopSections,
+		WorkStopDescriptors,
+		WorkStopThunks,
+		WorkStopBytes
+
+	} LS_WORK_STOP;
+
+	// Per-file limits. Zero means no limit. The defaults are far above what linkers produce,
+	// only crafted, or corrupt images reach them.
+	typedef struct _LS_WORK_LIMITS
+	{
+		DWORD MaxSections;
+		DWORD MaxDescriptors;
+		DWORD MaxThunks;
+		ULONGLONG MaxBytes;
+
+		_LS_WORK_LIMITS()
+			: MaxSections(1024), MaxDescriptors(16384), MaxThunks(1 << 20), MaxBytes(256ULL << 20) { }
+
+		~_LS_WORK_LIMITS() { }
+
+	} LS_WORK_LIMITS, *PLS_WORK_LIMITS;
+
+	// Cooperative cancellation, and an overall deadline, shared by every file of a batch.
+	// 'Cancel' can be called from any thread, workers see it on their next poll.
+	class CancellationToken
+	{
+	public:
+		CancellationToken();
+		~CancellationToken();
+
+		void Cancel() noexcept;
+
+		// Clears the cancellation, and the deadline. Not while workers are polling.
+		void Reset() noexcept;
+
+		// Milliseconds from now. Zero removes the deadline.
+		void SetDeadline(ULONGLONG milliseconds) noexcept;
+
+		// 'WorkStopCancelled', 'WorkStopDeadline', or 'WorkStopNone'.
+		LS_WORK_STOP Check() const noexcept;
+
+	private:
+		volatile LONG _cancelled;
+		ULONGLONG _deadline;
+	};
+
+	// The work done on one file, against the limits. Each counter returns false once the budget
+	// is spent, and keeps returning false. Walks stop there, and report what they have as partial.
+	class WorkBudget
+	{
+	public:
+		WorkBudget(const LS_WORK_LIMITS& limits, const CancellationToken* token = NULL) noexcept;
+		~WorkBudget();
+
+		bool CheckSections(DWORD count) noexcept;
+		bool AddDescriptor() noexcept { return Count(_descriptors, 1, _limits.MaxDescriptors, WorkStopDescriptors); }
+		bool AddThunk() noexcept { return Count(_thunks, 1, _limits.MaxThunks, WorkStopThunks); }
+		bool AddBytes(ULONGLONG count) noexcept { return Count(_bytes, count, _limits.MaxBytes, WorkStopBytes); }
+
+		_NODISCARD bool IsSpent() const noexcept { return _stop != WorkStopNone; }
+		_NODISCARD LS_WORK_STOP StopReason() const noexcept { return _stop; }
+
+		// A new budget with the same limits, and token. For a second walk over tables this one
+		// counted already, like the symbols after the imports, so they are not counted twice.
+		_NODISCARD WorkBudget Restart() const noexcept { return WorkBudget(_limits, _token); }
+
+	private:
+		LS_WORK_LIMITS _limits;
+		const CancellationToken* _token;
+		ULONGLONG _descriptors;
+		ULONGLONG _thunks;
+		ULONGLONG _bytes;
+		DWORD _polls;
+		LS_WORK_STOP _stop;
+
+		bool Count(ULONGLONG& counter, ULONGLONG count, ULONGLONG limit, LS_WORK_STOP reason) noexcept
+		{
+			if (_stop != WorkStopNone)
+				return false;
+
+			counter += count;
+			if (limit != 0 && counter > limit) {
+				_stop = reason;
+				return false;
+			}
+
+			if (_token != NULL && ++_polls % LS_BUDGET_POLL_INTERVAL == 0)
+				_stop = _token->Check();
+
+			return _stop == WorkStopNone;
+		}
+	};
+}
\ No newline at end of file
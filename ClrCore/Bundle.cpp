@@ -0,0 +1,228 @@
+#include "pch.h"
+
+#include "Bundle.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// SHA-256 of '.net core bundle'. The SDK looks for it in the apphost, and writes the header offset before it.
+	static const BYTE BundleSignature[LS_BUNDLE_SIGNATURE_SIZE] = {
+		0x8B, 0x12, 0x02, 0xB9, 0x6A, 0x61, 0x20, 0x38, 0x72, 0x7B, 0x93, 0x02, 0x14, 0xD7, 0xA0, 0x32,
+		0x13, 0xF5, 0xB9, 0xE6, 0xEF, 0xAE, 0x33, 0x18, 0xEE, 0x3B, 0x2D, 0xCE, 0x24, 0xB3, 0x6A, 0xAE
+	};
+
+	BundleReader::BundleReader()
+		: _h_file(INVALID_HANDLE_VALUE), _h_map(NULL), _view(NULL), _data(NULL), _size(0), _header_offset(0),
+			_major_version(0), _minor_version(0), _flags(0), _bundle_id(NULL), _bundle_id_length(0) { }
+
+	BundleReader::~BundleReader()
+	{
+		Close();
+	}
+
+	const LSRESULT BundleReader::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (_h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		// Empty files can't be mapped.
+		if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(IMAGE_DOS_HEADER)))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a single-file bundle.", __FILEW__, __LINE__);
+
+		_h_map = CreateFileMapping(_h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_h_map == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view = static_cast<const BYTE*>(MapViewOfFile(_h_map, FILE_MAP_READ, 0, 0, 0));
+		if (_view == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		return Attach(_view, static_cast<size_t>(file_size.QuadPart));
+	}
+
+	const LSRESULT BundleReader::Attach(const BYTE* data, size_t size)
+	{
+		// 'Open' attaches its own view.
+		if (data != _view)
+			Close();
+
+		_entries.clear();
+
+		ULONGLONG header_offset;
+		if (!FindHeaderOffset(data, size, header_offset) || header_offset == 0)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a single-file bundle.", __FILEW__, __LINE__);
+
+		_data = data;
+		_size = size;
+		_header_offset = header_offset;
+
+		// Major, minor, and the file count.
+		if (header_offset > size || size - header_offset < 12)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Bundle header out of bounds.", __FILEW__, __LINE__);
+
+		size_t offset = static_cast<size_t>(header_offset);
+		_major_version = *reinterpret_cast<const DWORD*>(data + offset);
+		_minor_version = *reinterpret_cast<const DWORD*>(data + offset + 4);
+		LONG file_count = *reinterpret_cast<const LONG*>(data + offset + 8);
+		offset += 12;
+
+		if (_major_version < 1 || _major_version > 6)
+			return LSRESULT(ERROR_NOT_SUPPORTED, L"Unsupported bundle version.", __FILEW__, __LINE__);
+
+		if (file_count < 0 || !ReadString(offset, _bundle_id, _bundle_id_length))
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid bundle header.", __FILEW__, __LINE__);
+
+		// Version 2 added the locations of the .deps.json, and .runtimeconfig.json, and the flags.
+		// They're in the manifest too, only the flags are kept.
+		_flags = 0;
+		if (_major_version >= 2) {
+			if (size - offset < 40)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid bundle header.", __FILEW__, __LINE__);
+
+			_flags = *reinterpret_cast<const ULONGLONG*>(data + offset + 32);
+			offset += 40;
+		}
+
+		// Offset, size, the compressed size from version 6, the type, and the path.
+		size_t fixed_size = _major_version >= 6 ? 25 : 17;
+		_entries.reserve(min(static_cast<size_t>(file_count), (size - offset) / (fixed_size + 1)));
+		for (LONG i = 0; i < file_count; i++) {
+			if (size - offset < fixed_size)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Bundle manifest out of bounds.", __FILEW__, __LINE__);
+
+			LS_BUNDLE_ENTRY entry{ };
+			entry.Offset = *reinterpret_cast<const ULONGLONG*>(data + offset);
+			entry.Size = *reinterpret_cast<const ULONGLONG*>(data + offset + 8);
+			entry.CompressedSize = _major_version >= 6 ? *reinterpret_cast<const ULONGLONG*>(data + offset + 16) : 0;
+
+			BYTE type = data[offset + fixed_size - 1];
+			entry.Type = type <= BundleFileSymbols ? static_cast<LS_BUNDLE_FILE_TYPE>(type) : BundleFileUnknown;
+			offset += fixed_size;
+
+			if (!ReadString(offset, entry.RelativePath, entry.PathLength))
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid bundle manifest entry.", __FILEW__, __LINE__);
+
+			ULONGLONG stored_size = entry.CompressedSize != 0 ? entry.CompressedSize : entry.Size;
+			if (entry.Offset > size || stored_size > size - entry.Offset)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Bundle entry out of bounds.", __FILEW__, __LINE__);
+
+			_entries.push_back(entry);
+		}
+
+		return LSRESULT();
+	}
+
+	void BundleReader::Close() noexcept
+	{
+		if (_view != NULL) {
+			UnmapViewOfFile(_view);
+			_view = NULL;
+		}
+
+		if (_h_map != NULL) {
+			CloseHandle(_h_map);
+			_h_map = NULL;
+		}
+
+		if (_h_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_h_file);
+			_h_file = INVALID_HANDLE_VALUE;
+		}
+
+		_data = NULL;
+		_size = 0;
+		_header_offset = 0;
+		_major_version = 0;
+		_minor_version = 0;
+		_flags = 0;
+		_bundle_id = NULL;
+		_bundle_id_length = 0;
+		_entries.clear();
+	}
+
+	bool BundleReader::FindHeaderOffset(const BYTE* data, size_t size, ULONGLONG& header_offset) noexcept
+	{
+		// The placeholder is in the apphost data, near the start. The embedded files come after it.
+		if (data == NULL || size < sizeof(ULONGLONG) + LS_BUNDLE_SIGNATURE_SIZE)
+			return false;
+
+		const BYTE* current = data + sizeof(ULONGLONG);
+		const BYTE* end = data + size - LS_BUNDLE_SIGNATURE_SIZE + 1;
+		while (current < end) {
+			current = static_cast<const BYTE*>(memchr(current, BundleSignature[0], end - current));
+			if (current == NULL)
+				return false;
+
+			if (memcmp(current, BundleSignature, LS_BUNDLE_SIGNATURE_SIZE) == 0) {
+				header_offset = *reinterpret_cast<const ULONGLONG*>(current - sizeof(ULONGLONG));
+				return true;
+			}
+
+			current++;
+		}
+
+		return false;
+	}
+
+	const char* BundleReader::BundleId(DWORD& length) const noexcept
+	{
+		length = _bundle_id_length;
+
+		return _bundle_id;
+	}
+
+	bool BundleReader::GetEntryData(DWORD index, const BYTE*& data, size_t& size) const noexcept
+	{
+		if (index >= _entries.size() || _entries[index].CompressedSize != 0)
+			return false;
+
+		data = _data + _entries[index].Offset;
+		size = static_cast<size_t>(_entries[index].Size);
+
+		return true;
+	}
+
+	bool BundleReader::GetCompressedData(DWORD index, const BYTE*& data, size_t& size) const noexcept
+	{
+		if (index >= _entries.size() || _entries[index].CompressedSize == 0)
+			return false;
+
+		data = _data + _entries[index].Offset;
+		size = static_cast<size_t>(_entries[index].CompressedSize);
+
+		return true;
+	}
+
+	bool BundleReader::ReadString(size_t& offset, const char*& value, DWORD& length) const noexcept
+	{
+		// Seven bits at a time, the high bit set while there's more. Five bytes at most for 32 bits.
+		DWORD result = 0;
+		for (DWORD shift = 0; shift < 35; shift += 7) {
+			if (offset >= _size)
+				return false;
+
+			BYTE current = _data[offset++];
+			result |= static_cast<DWORD>(current & 0x7F) << shift;
+			if ((current & 0x80) == 0) {
+				if (result > _size - offset)
+					return false;
+
+				value = reinterpret_cast<const char*>(_data + offset);
+				length = result;
+				offset += result;
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
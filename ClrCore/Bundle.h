@@ -0,0 +1,93 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_BUNDLE_SIGNATURE_SIZE 32
+
+	// Flags in the version 2 header and later.
+	#define LS_BUNDLE_FLAG_NETCOREAPP3_COMPAT 0x1
+
+	typedef enum _LS_BUNDLE_FILE_TYPE
+	{
+		BundleFileUnknown,
+		BundleFileAssembly,
+		BundleFileNativeBinary,
+		BundleFileDepsJson,
+		BundleFileRuntimeConfigJson,
+		BundleFileSymbols
+
+	} LS_BUNDLE_FILE_TYPE;
+
+	// A manifest entry. 'RelativePath' points into the file, is UTF-8, and is not null terminated.
+	typedef struct _LS_BUNDLE_ENTRY
+	{
+		ULONGLONG Offset;
+		ULONGLONG Size;
+
+		// Version 6 and later. Zero if the file is stored as is.
+		ULONGLONG CompressedSize;
+		LS_BUNDLE_FILE_TYPE Type;
+		const char* RelativePath;
+		DWORD PathLength;
+
+	} LS_BUNDLE_ENTRY, *PLS_BUNDLE_ENTRY;
+
+	// Reader for .NET single-file bundles. The apphost keeps the offset of the bundle header next
+	// to a known signature, the header, and the manifest follow the embedded files at the end of the
+	// file. Versions 1, 2, and 6 are read, the ones from .NET Core 3, .NET 5, and .NET 6 onwards.
+	// The file is mapped once, and embedded files are ranges of the mapping, nothing is extracted.
+	class BundleReader
+	{
+	public:
+		BundleReader();
+		~BundleReader();
+
+		// Fails with 'ERROR_BAD_FORMAT' for files that aren't bundles, apphosts without a bundle included.
+		const LSRESULT Open(const WWuString& file_path);
+
+		// 'data' is not copied, and must outlive the reader.
+		const LSRESULT Attach(const BYTE* data, size_t size);
+		void Close() noexcept;
+
+		// Finds the signature, and reads the header offset before it. Zero for an apphost without a bundle.
+		static bool FindHeaderOffset(const BYTE* data, size_t size, ULONGLONG& header_offset) noexcept;
+
+		_NODISCARD DWORD MajorVersion() const noexcept { return _major_version; }
+		_NODISCARD DWORD MinorVersion() const noexcept { return _minor_version; }
+		_NODISCARD ULONGLONG HeaderOffset() const noexcept { return _header_offset; }
+		_NODISCARD ULONGLONG Flags() const noexcept { return _flags; }
+		_NODISCARD DWORD EntryCount() const noexcept { return static_cast<DWORD>(_entries.size()); }
+		_NODISCARD const LS_BUNDLE_ENTRY& GetEntry(DWORD index) const noexcept { return _entries[index]; }
+
+		// UTF-8, not null terminated. Unique for each build of the bundle.
+		const char* BundleId(DWORD& length) const noexcept;
+
+		// The embedded file, in place. False for compressed files, their data is not an image.
+		bool GetEntryData(DWORD index, const BYTE*& data, size_t& size) const noexcept;
+
+		// The deflated data of a compressed file, for 'Inflater'. False for files stored as is.
+		bool GetCompressedData(DWORD index, const BYTE*& data, size_t& size) const noexcept;
+
+	private:
+		HANDLE _h_file;
+		HANDLE _h_map;
+		const BYTE* _view;
+		const BYTE* _data;
+		size_t _size;
+		ULONGLONG _header_offset;
+		DWORD _major_version;
+		DWORD _minor_version;
+		ULONGLONG _flags;
+		const char* _bundle_id;
+		DWORD _bundle_id_length;
+		wuvector<LS_BUNDLE_ENTRY> _entries;
+
+		// A BinaryWriter string, the UTF-8 length as a 7-bit encoded integer, and the bytes.
+		bool ReadString(size_t& offset, const char*& value, DWORD& length) const noexcept;
+	};
+}
\ No newline at end of file
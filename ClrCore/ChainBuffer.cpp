@@ -0,0 +1,205 @@
+#include "pch.h"
+
+#include "ChainBuffer.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	static size_t AlignArray(size_t offset) noexcept
+	{
+		return (offset + 7) & ~static_cast<size_t>(7);
+	}
+
+	const LSRESULT ChainBufferWriter::Serialize(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& buffer)
+	{
+		DWORD node_count = static_cast<DWORD>(graph.Nodes.size());
+		DWORD edge_count = static_cast<DWORD>(graph.Edges.size());
+
+		// Empty paths, and version strings all point here.
+		SnapshotStringTable strings;
+		strings.Intern(WWuString());
+
+		wuvector<LS_CHAIN_NODE> nodes(node_count);
+		for (DWORD i = 0; i < node_count; i++) {
+			const LS_RESOLVED_NODE& source = graph.Nodes[i];
+			LS_CHAIN_NODE& node = nodes[i];
+			ZeroMemory(&node, sizeof(node));
+
+			node.NameOffset = strings.Intern(source.Name);
+			node.KeyOffset = strings.Intern(source.Name.ToLower());
+			node.PathOffset = strings.Intern(source.Path);
+			node.Depth = source.Depth;
+			node.Result = source.Result;
+			node.Flags = source.Expanded ? LS_CHAIN_NODE_FLAG_EXPANDED : 0;
+			if (source.Image != nullptr) {
+				if (source.Image->BasicInfo.IsClr)
+					node.Flags |= LS_CHAIN_NODE_FLAG_CLR;
+
+				node.StopReason = source.Image->BasicInfo.StopReason;
+				if (source.Image->HasVersion) {
+					node.Flags |= LS_CHAIN_NODE_FLAG_VERSION;
+					node.FileVersionOffset = strings.Intern(source.Image->Version.FileVersion);
+					node.ProductVersionOffset = strings.Intern(source.Image->Version.ProductVersion);
+					node.CompanyNameOffset = strings.Intern(source.Image->Version.CompanyName);
+					node.FileDescriptionOffset = strings.Intern(source.Image->Version.FileDescription);
+				}
+			}
+		}
+
+		// Edges are grouped by parent already, but not in node order. Counting sort keeps each node's edge order.
+		for (const LS_RESOLVED_EDGE& edge : graph.Edges) {
+			if (edge.From >= node_count || edge.To >= node_count)
+				return LSRESULT(ERROR_INVALID_PARAMETER, L"Graph edge references a node out of range.", __FILEW__, __LINE__);
+
+			nodes[edge.From].EdgeCount++;
+		}
+
+		wuvector<DWORD> cursor(node_count);
+		for (DWORD i = 0, first = 0; i < node_count; i++) {
+			nodes[i].FirstEdge = first;
+			cursor[i] = first;
+			first += nodes[i].EdgeCount;
+		}
+
+		wuvector<LS_CHAIN_EDGE> edges(edge_count);
+		for (const LS_RESOLVED_EDGE& edge : graph.Edges)
+			edges[cursor[edge.From]++] = { edge.To, static_cast<DWORD>(edge.Kind) };
+
+		wuvector<DWORD> key_order(node_count);
+		for (DWORD i = 0; i < node_count; i++)
+			key_order[i] = i;
+
+		std::sort(key_order.begin(), key_order.end(), [&nodes, &strings](DWORD left, DWORD right) {
+			return wcscmp(strings.At(nodes[left].KeyOffset), strings.At(nodes[right].KeyOffset)) < 0;
+		});
+
+		// Laying out the arrays.
+		size_t nodes_offset = AlignArray(sizeof(LS_CHAIN_HEADER));
+		size_t edges_offset = AlignArray(nodes_offset + (nodes.size() * sizeof(LS_CHAIN_NODE)));
+		size_t key_order_offset = AlignArray(edges_offset + (edges.size() * sizeof(LS_CHAIN_EDGE)));
+		size_t strings_offset = AlignArray(key_order_offset + (key_order.size() * sizeof(DWORD)));
+		size_t total_size = strings_offset + strings.Size();
+		if (total_size > MAXDWORD)
+			return LSRESULT(ERROR_ARITHMETIC_OVERFLOW, L"Chain is too large for a chain buffer.", __FILEW__, __LINE__);
+
+		LS_CHAIN_HEADER header = {
+			node_count,
+			edge_count,
+			static_cast<DWORD>(nodes_offset),
+			static_cast<DWORD>(edges_offset),
+			static_cast<DWORD>(key_order_offset),
+			static_cast<DWORD>(strings_offset),
+			strings.Size(),
+			static_cast<LONG>(graph.StopReason)
+		};
+
+		// Padding stays zeroed.
+		buffer.assign(total_size, 0);
+		RtlCopyMemory(buffer.data(), &header, sizeof(header));
+		if (node_count > 0) {
+			RtlCopyMemory(buffer.data() + nodes_offset, nodes.data(), nodes.size() * sizeof(LS_CHAIN_NODE));
+			RtlCopyMemory(buffer.data() + key_order_offset, key_order.data(), key_order.size() * sizeof(DWORD));
+		}
+
+		if (edge_count > 0)
+			RtlCopyMemory(buffer.data() + edges_offset, edges.data(), edges.size() * sizeof(LS_CHAIN_EDGE));
+
+		RtlCopyMemory(buffer.data() + strings_offset, strings.Data(), strings.Size());
+
+		return LSRESULT();
+	}
+
+	ChainBufferReader::ChainBufferReader()
+		: _header(NULL), _nodes(NULL), _edges(NULL), _key_order(NULL), _strings(NULL) { }
+
+	ChainBufferReader::~ChainBufferReader() { }
+
+	const LSRESULT ChainBufferReader::Attach(const BYTE* data, size_t size)
+	{
+		_header = NULL;
+		if (data == NULL || size < sizeof(LS_CHAIN_HEADER))
+			return LSRESULT(ERROR_BAD_FORMAT, L"Chain buffer is truncated.", __FILEW__, __LINE__);
+
+		const LS_CHAIN_HEADER* header = reinterpret_cast<const LS_CHAIN_HEADER*>(data);
+		auto in_bounds = [size](DWORD offset, ULONGLONG length) {
+			return offset % 8 == 0 && offset <= size && length <= size - offset;
+		};
+
+		if (!in_bounds(header->NodesOffset, static_cast<ULONGLONG>(header->NodeCount) * sizeof(LS_CHAIN_NODE))
+			|| !in_bounds(header->EdgesOffset, static_cast<ULONGLONG>(header->EdgeCount) * sizeof(LS_CHAIN_EDGE))
+			|| !in_bounds(header->KeyOrderOffset, static_cast<ULONGLONG>(header->NodeCount) * sizeof(DWORD))
+			|| !in_bounds(header->StringsOffset, header->StringsSize))
+		{
+			return LSRESULT(ERROR_BAD_FORMAT, L"Chain buffer array out of bounds.", __FILEW__, __LINE__);
+		}
+
+		// The table ends with a null, so any offset inside it is a terminated string.
+		const WCHAR* strings = reinterpret_cast<const WCHAR*>(data + header->StringsOffset);
+		size_t length = header->StringsSize / sizeof(WCHAR);
+		if (header->StringsSize % sizeof(WCHAR) != 0 || length == 0 || strings[length - 1] != L'\0')
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid chain buffer string table.", __FILEW__, __LINE__);
+
+		_header = header;
+		_nodes = reinterpret_cast<const LS_CHAIN_NODE*>(data + header->NodesOffset);
+		_edges = reinterpret_cast<const LS_CHAIN_EDGE*>(data + header->EdgesOffset);
+		_key_order = reinterpret_cast<const DWORD*>(data + header->KeyOrderOffset);
+		_strings = strings;
+
+		// Checked once here, so the accessors are plain reads.
+		LSRESULT result;
+		for (DWORD i = 0; i < header->NodeCount && result.Result == ERROR_SUCCESS; i++) {
+			const LS_CHAIN_NODE& node = _nodes[i];
+			if (!CheckString(node.NameOffset) || !CheckString(node.KeyOffset) || !CheckString(node.PathOffset)
+				|| !CheckString(node.FileVersionOffset) || !CheckString(node.ProductVersionOffset)
+				|| !CheckString(node.CompanyNameOffset) || !CheckString(node.FileDescriptionOffset))
+			{
+				result = LSRESULT(ERROR_BAD_FORMAT, L"Chain buffer node string out of bounds.", __FILEW__, __LINE__);
+			}
+			else if (static_cast<ULONGLONG>(node.FirstEdge) + node.EdgeCount > header->EdgeCount || _key_order[i] >= header->NodeCount)
+				result = LSRESULT(ERROR_BAD_FORMAT, L"Invalid chain buffer node.", __FILEW__, __LINE__);
+		}
+
+		for (DWORD i = 0; i < header->EdgeCount && result.Result == ERROR_SUCCESS; i++) {
+			if (_edges[i].To >= header->NodeCount)
+				result = LSRESULT(ERROR_BAD_FORMAT, L"Chain buffer edge references a node out of range.", __FILEW__, __LINE__);
+		}
+
+		if (result.Result != ERROR_SUCCESS)
+			_header = NULL;
+
+		return result;
+	}
+
+	bool ChainBufferReader::FindNode(const WWuString& module_name, DWORD& index) const
+	{
+		if (_header == NULL)
+			return false;
+
+		WWuString key = module_name.ToLower();
+		DWORD low = 0;
+		DWORD high = _header->NodeCount;
+		while (low < high) {
+			DWORD middle = low + ((high - low) / 2);
+			DWORD candidate = _key_order[middle];
+			int comparison = wcscmp(GetString(_nodes[candidate].KeyOffset), key.GetBuffer());
+			if (comparison == 0) {
+				index = candidate;
+				return true;
+			}
+
+			if (comparison < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		return false;
+	}
+
+	bool ChainBufferReader::CheckString(DWORD offset) const noexcept
+	{
+		return offset % sizeof(WCHAR) == 0 && offset < _header->StringsSize;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Resolver.h"
+
+namespace LibSnitcher::Core
+{
+	///////////////////////////////////////////////////////////////////////////
+	//
+	//  ~ Chain buffer.
+	//
+	// ------------------------------------------------------------------------
+	//
+	//  A resolved chain in a single block, so the managed layer can get a
+	//  whole chain with one native call, and read it in place. Unlike a
+	//  snapshot it never leaves the process, so there is no section table,
+	//  or version. The buffer starts with LS_CHAIN_HEADER, and every array
+	//  starts at an 8 byte boundary.
+	//
+	//  Nodes:     'NodeCount' LS_CHAIN_NODE, in resolution order. Root is zero.
+	//  Edges:     'EdgeCount' LS_CHAIN_EDGE, grouped by importing node, in the
+	//             order of its tables. A node's edges are 'EdgeCount' entries
+	//             from 'FirstEdge'.
+	//  KeyOrder:  'NodeCount' DWORD node indexes, sorted by key (the lowercase
+	//             name), ordinal. Used for lookups.
+	//  Strings:   UTF-16LE, null terminated, interned. Referenced by byte offset.
+	//             Offset zero is the empty string.
+	//
+	///////////////////////////////////////////////////////////////////////////
+
+	#define LS_CHAIN_NODE_FLAG_CLR 0x1
+	#define LS_CHAIN_NODE_FLAG_VERSION 0x2
+
+	// Every edge of the node is in the buffer. Without it the node was not walked, and has none.
+	#define LS_CHAIN_NODE_FLAG_EXPANDED 0x4
+
+	typedef struct _LS_CHAIN_HEADER
+	{
+		DWORD NodeCount;
+		DWORD EdgeCount;
+		DWORD NodesOffset;
+		DWORD EdgesOffset;
+		DWORD KeyOrderOffset;
+		DWORD StringsOffset;
+		DWORD StringsSize;
+
+		// A 'LS_WORK_STOP'. Set when the resolution was cancelled, or ran past its deadline.
+		LONG StopReason;
+
+	} LS_CHAIN_HEADER, *PLS_CHAIN_HEADER;
+
+	typedef struct _LS_CHAIN_NODE
+	{
+		DWORD NameOffset;
+		DWORD KeyOffset;
+		DWORD PathOffset;
+
+		// With LS_CHAIN_NODE_FLAG_VERSION. From the first string table that has them.
+		DWORD FileVersionOffset;
+		DWORD ProductVersionOffset;
+		DWORD CompanyNameOffset;
+		DWORD FileDescriptionOffset;
+
+		DWORD Depth;
+		LONG Result;
+		DWORD Flags;
+
+		// A 'LS_WORK_STOP'. Anything but 'WorkStopNone' means the image tables were not read to the end.
+		LONG StopReason;
+
+		DWORD FirstEdge;
+		DWORD EdgeCount;
+
+	} LS_CHAIN_NODE, *PLS_CHAIN_NODE;
+
+	typedef struct _LS_CHAIN_EDGE
+	{
+		DWORD To;
+
+		// A 'LS_EDGE_KIND'.
+		DWORD Kind;
+
+	} LS_CHAIN_EDGE, *PLS_CHAIN_EDGE;
+
+	static_assert(sizeof(LS_CHAIN_HEADER) == 32, "Chain header layout changed.");
+	static_assert(sizeof(LS_CHAIN_NODE) == 52, "Chain node layout changed.");
+	static_assert(sizeof(LS_CHAIN_EDGE) == 8, "Chain edge layout changed.");
+
+	class ChainBufferWriter
+	{
+	public:
+		static const LSRESULT Serialize(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& buffer);
+	};
+
+	// Reads a chain buffer in place. Attaching checks every offset, and index
+	// once, so the accessors don't. Indexes past the counts are the caller's bug.
+	class ChainBufferReader
+	{
+	public:
+		ChainBufferReader();
+		~ChainBufferReader();
+
+		// Uses a buffer owned by the caller. It must outlive the reader.
+		const LSRESULT Attach(const BYTE* data, size_t size);
+
+		_NODISCARD DWORD NodeCount() const noexcept { return _header == NULL ? 0 : _header->NodeCount; }
+		_NODISCARD DWORD EdgeCount() const noexcept { return _header == NULL ? 0 : _header->EdgeCount; }
+		_NODISCARD LS_WORK_STOP StopReason() const noexcept { return _header == NULL ? WorkStopNone : static_cast<LS_WORK_STOP>(_header->StopReason); }
+		_NODISCARD const LS_CHAIN_NODE& GetNode(DWORD index) const noexcept { return _nodes[index]; }
+		_NODISCARD const LS_CHAIN_EDGE& GetEdge(DWORD index) const noexcept { return _edges[index]; }
+		_NODISCARD LPCWSTR GetString(DWORD offset) const noexcept { return _strings + (offset / sizeof(WCHAR)); }
+
+		// Binary search over the key order. Ignores case.
+		bool FindNode(const WWuString& module_name, DWORD& index) const;
+
+	private:
+		const LS_CHAIN_HEADER* _header;
+		const LS_CHAIN_NODE* _nodes;
+		const LS_CHAIN_EDGE* _edges;
+		const DWORD* _key_order;
+		const WCHAR* _strings;
+
+		bool CheckString(DWORD offset) const noexcept;
+	};
+}
\ No newline at end of file
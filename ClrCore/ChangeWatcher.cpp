@@ -0,0 +1,239 @@
+#include "pch.h"
+
+#include "ChangeWatcher.h"
+
+namespace LibSnitcher::Core
+{
+	static constexpr DWORD WatchFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+	DirectoryChangeWatcher::DirectoryChangeWatcher(IChangeSink* sink)
+		: _sink(sink)
+	{
+		InitializeSRWLock(&_lock);
+	}
+
+	DirectoryChangeWatcher::~DirectoryChangeWatcher()
+	{
+		UnwatchAll();
+	}
+
+	const LSRESULT DirectoryChangeWatcher::Watch(const WWuString& directory)
+	{
+		WWuString key = directory.ToLower();
+
+		AcquireSRWLockExclusive(&_lock);
+		auto existing = _directories.find(key);
+		if (existing != _directories.end()) {
+			if (!IsFailed(existing->second)) {
+				ReleaseSRWLockExclusive(&_lock);
+				return LSRESULT();
+			}
+
+			// Its completion is done, nothing is in flight, so it's closed right here.
+			Close(existing->second);
+			_directories.erase(existing);
+		}
+
+		HANDLE h_dir = CreateFile(directory.GetBuffer(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+
+		if (h_dir == INVALID_HANDLE_VALUE) {
+			ReleaseSRWLockExclusive(&_lock);
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+		}
+
+		PLS_WATCHED_DIRECTORY watched = new LS_WATCHED_DIRECTORY();
+		watched->Watcher = this;
+		watched->Path = directory;
+		watched->Handle = h_dir;
+		watched->Idle = CreateEvent(NULL, TRUE, TRUE, NULL);
+		watched->Io = watched->Idle == NULL ? NULL : CreateThreadpoolIo(h_dir, OnCompletion, watched, NULL);
+
+		bool armed = false;
+		if (watched->Io != NULL) {
+			AcquireSRWLockExclusive(&watched->Lock);
+			armed = Arm(watched);
+			ReleaseSRWLockExclusive(&watched->Lock);
+		}
+
+		if (!armed) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Close(watched);
+			ReleaseSRWLockExclusive(&_lock);
+
+			return result;
+		}
+
+		_directories.emplace(key, watched);
+		ReleaseSRWLockExclusive(&_lock);
+
+		return LSRESULT();
+	}
+
+	void DirectoryChangeWatcher::Unwatch(const WWuString& directory)
+	{
+		WWuString key = directory.ToLower();
+		PLS_WATCHED_DIRECTORY watched = NULL;
+
+		AcquireSRWLockExclusive(&_lock);
+		auto entry = _directories.find(key);
+		if (entry != _directories.end()) {
+			watched = entry->second;
+			_directories.erase(entry);
+		}
+		ReleaseSRWLockExclusive(&_lock);
+
+		if (watched != NULL)
+			Close(watched);
+	}
+
+	void DirectoryChangeWatcher::UnwatchAll()
+	{
+		wuvector<PLS_WATCHED_DIRECTORY> watched_list;
+
+		AcquireSRWLockExclusive(&_lock);
+		for (auto& entry : _directories)
+			watched_list.push_back(entry.second);
+
+		_directories.clear();
+		ReleaseSRWLockExclusive(&_lock);
+
+		for (PLS_WATCHED_DIRECTORY watched : watched_list)
+			Close(watched);
+	}
+
+	bool DirectoryChangeWatcher::IsWatching(const WWuString& directory)
+	{
+		WWuString key = directory.ToLower();
+
+		AcquireSRWLockShared(&_lock);
+		auto entry = _directories.find(key);
+		bool watching = entry != _directories.end() && !IsFailed(entry->second);
+		ReleaseSRWLockShared(&_lock);
+
+		return watching;
+	}
+
+	bool DirectoryChangeWatcher::IsFailed(PLS_WATCHED_DIRECTORY watched) noexcept
+	{
+		AcquireSRWLockShared(&watched->Lock);
+		bool failed = watched->Failed;
+		ReleaseSRWLockShared(&watched->Lock);
+
+		return failed;
+	}
+
+	bool DirectoryChangeWatcher::Arm(PLS_WATCHED_DIRECTORY watched) noexcept
+	{
+		ResetEvent(watched->Idle);
+		StartThreadpoolIo(watched->Io);
+		if (!ReadDirectoryChangesW(watched->Handle, watched->Buffer, sizeof(watched->Buffer), FALSE, WatchFilter, NULL, &watched->Overlapped, NULL)) {
+			DWORD error = GetLastError();
+			CancelThreadpoolIo(watched->Io);
+			SetEvent(watched->Idle);
+			SetLastError(error);
+
+			return false;
+		}
+
+		watched->Pending = true;
+
+		return true;
+	}
+
+	void DirectoryChangeWatcher::Close(PLS_WATCHED_DIRECTORY watched) noexcept
+	{
+		// After this the completion can't arm another read, so cancelling the one
+		// in flight, if any, is enough. We wait for it to complete before freeing.
+		AcquireSRWLockExclusive(&watched->Lock);
+		watched->Stopping = true;
+		if (watched->Pending)
+			CancelIoEx(watched->Handle, &watched->Overlapped);
+		ReleaseSRWLockExclusive(&watched->Lock);
+
+		if (watched->Io != NULL) {
+			WaitForSingleObject(watched->Idle, INFINITE);
+			WaitForThreadpoolIoCallbacks(watched->Io, FALSE);
+			CloseThreadpoolIo(watched->Io);
+		}
+
+		if (watched->Idle != NULL)
+			CloseHandle(watched->Idle);
+
+		CloseHandle(watched->Handle);
+		delete watched;
+	}
+
+	VOID CALLBACK DirectoryChangeWatcher::OnCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG io_result, ULONG_PTR bytes_transferred, PTP_IO io)
+	{
+		UNREFERENCED_PARAMETER(instance);
+		UNREFERENCED_PARAMETER(overlapped);
+		UNREFERENCED_PARAMETER(io);
+
+		PLS_WATCHED_DIRECTORY watched = static_cast<PLS_WATCHED_DIRECTORY>(context);
+
+		AcquireSRWLockExclusive(&watched->Lock);
+		watched->Pending = false;
+		if (watched->Stopping || io_result == ERROR_OPERATION_ABORTED) {
+			SetEvent(watched->Idle);
+			ReleaseSRWLockExclusive(&watched->Lock);
+
+			return;
+		}
+		ReleaseSRWLockExclusive(&watched->Lock);
+
+		IChangeSink* sink = watched->Watcher->_sink;
+
+		// Zero bytes means the system buffer overflowed, and the changes are lost.
+		if (io_result != NO_ERROR || bytes_transferred == 0) {
+			sink->OnOverflow(watched->Path);
+		}
+		else {
+			BYTE* position = reinterpret_cast<BYTE*>(watched->Buffer);
+			while (true) {
+				PFILE_NOTIFY_INFORMATION notify = reinterpret_cast<PFILE_NOTIFY_INFORMATION>(position);
+
+				LS_CHANGE_KIND kind;
+				switch (notify->Action) {
+					case FILE_ACTION_ADDED:
+					case FILE_ACTION_RENAMED_NEW_NAME:
+						kind = ChangeKindAdded;
+						break;
+
+					case FILE_ACTION_REMOVED:
+					case FILE_ACTION_RENAMED_OLD_NAME:
+						kind = ChangeKindRemoved;
+						break;
+
+					default:
+						kind = ChangeKindModified;
+						break;
+				}
+
+				// The file name is not null terminated.
+				wuvector<WCHAR> file_name(notify->FileName, notify->FileName + (notify->FileNameLength / sizeof(WCHAR)));
+				file_name.push_back(L'\0');
+				sink->OnFileChanged(watched->Path + L"\\" + file_name.data(), kind);
+
+				if (notify->NextEntryOffset == 0)
+					break;
+
+				position += notify->NextEntryOffset;
+			}
+		}
+
+		// Re-arming, unless we started closing while processing. If we can't, the directory is no longer
+		// reliable, and no longer watched. Chains under it are not served from the cache anymore.
+		AcquireSRWLockExclusive(&watched->Lock);
+		bool stopping = watched->Stopping;
+		bool armed = !stopping && Arm(watched);
+		if (!armed) {
+			watched->Failed = !stopping;
+			SetEvent(watched->Idle);
+		}
+		ReleaseSRWLockExclusive(&watched->Lock);
+
+		if (!stopping && !armed)
+			sink->OnOverflow(watched->Path);
+	}
+}
\ No newline at end of file
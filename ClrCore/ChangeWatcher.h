@@ -0,0 +1,97 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_CHANGE_KIND
+	{
+		ChangeKindModified,
+		ChangeKindAdded,
+		ChangeKindRemoved
+	} LS_CHANGE_KIND;
+
+	// Receives file changes from a watcher. Calls come from thread pool threads.
+	class IChangeSink
+	{
+	public:
+		virtual ~IChangeSink() { }
+
+		virtual void OnFileChanged(const WWuString& file_path, LS_CHANGE_KIND kind) = 0;
+
+		// The watcher lost track of what changed in 'directory'. Everything in it should be considered changed.
+		virtual void OnOverflow(const WWuString& directory) = 0;
+	};
+
+	class IChangeWatcher
+	{
+	public:
+		virtual ~IChangeWatcher() { }
+
+		// Watching is not recursive. Watching the same directory twice is a no-op.
+		virtual const LSRESULT Watch(const WWuString& directory) = 0;
+		virtual void Unwatch(const WWuString& directory) = 0;
+		virtual void UnwatchAll() = 0;
+		virtual bool IsWatching(const WWuString& directory) = 0;
+	};
+
+	class DirectoryChangeWatcher;
+
+	typedef struct _LS_WATCHED_DIRECTORY
+	{
+		DirectoryChangeWatcher* Watcher;
+		WWuString Path;
+		HANDLE Handle;
+		PTP_IO Io;
+		OVERLAPPED Overlapped;
+
+		// 'Stopping', 'Pending', and 'Failed' are guarded by 'Lock'. Once stopping, the read is not armed
+		// again. 'Failed' is set when it couldn't be, the directory is not watched anymore, and watching it
+		// again replaces the entry. 'Idle' is signaled while no read is in flight.
+		SRWLOCK Lock;
+		bool Stopping;
+		bool Pending;
+		bool Failed;
+		HANDLE Idle;
+
+		// 'ReadDirectoryChangesW' wants a DWORD aligned buffer.
+		DWORD Buffer[16384];
+
+		_LS_WATCHED_DIRECTORY()
+			: Watcher(NULL), Handle(INVALID_HANDLE_VALUE), Io(NULL), Overlapped(), Stopping(false), Pending(false), Failed(false), Idle(NULL)
+		{
+			InitializeSRWLock(&Lock);
+		}
+
+		~_LS_WATCHED_DIRECTORY() { }
+
+	} LS_WATCHED_DIRECTORY, *PLS_WATCHED_DIRECTORY;
+
+	// 'ReadDirectoryChangesW' based watcher. Each directory keeps one overlapped
+	// read in flight, completing on the thread pool.
+	class DirectoryChangeWatcher : public IChangeWatcher
+	{
+	public:
+		DirectoryChangeWatcher(IChangeSink* sink);
+		~DirectoryChangeWatcher();
+
+		const LSRESULT Watch(const WWuString& directory) override;
+		void Unwatch(const WWuString& directory) override;
+		void UnwatchAll() override;
+		bool IsWatching(const WWuString& directory) override;
+
+	private:
+		IChangeSink* _sink;
+		SRWLOCK _lock;
+		wumap<WWuString, PLS_WATCHED_DIRECTORY> _directories;
+
+		// Called with 'watched->Lock' held.
+		static bool Arm(PLS_WATCHED_DIRECTORY watched) noexcept;
+		static void Close(PLS_WATCHED_DIRECTORY watched) noexcept;
+		static bool IsFailed(PLS_WATCHED_DIRECTORY watched) noexcept;
+		static VOID CALLBACK OnCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG io_result, ULONG_PTR bytes_transferred, PTP_IO io);
+	};
+}
\ No newline at end of file
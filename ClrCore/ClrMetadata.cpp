@@ -0,0 +1,422 @@
+#include "pch.h"
+
+#include "ClrMetadata.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	#define LS_METADATA_SIGNATURE 0x424A5342
+
+	// AssemblyRef 'PublicKeyOrToken' is the full key when this is set.
+	#define LS_ASSEMBLY_FLAG_PUBLIC_KEY 0x0001
+
+	// Column codes. Below 0x40 an index into that table, then coded indexes, then fixed size columns.
+	#define LS_COLUMN_CODED(kind) (0x40 | (kind))
+	#define LS_COLUMN_U16 0x80
+	#define LS_COLUMN_U32 0x81
+	#define LS_COLUMN_STRING 0x82
+	#define LS_COLUMN_GUID 0x83
+	#define LS_COLUMN_BLOB 0x84
+	#define LS_COLUMN_END 0xFF
+
+	// Unused tags in a coded index.
+	#define LS_NO_TABLE 0xFE
+
+	typedef enum _LS_CODED_INDEX
+	{
+		CodedTypeDefOrRef,
+		CodedHasConstant,
+		CodedHasCustomAttribute,
+		CodedHasFieldMarshal,
+		CodedHasDeclSecurity,
+		CodedMemberRefParent,
+		CodedHasSemantics,
+		CodedMethodDefOrRef,
+		CodedMemberForwarded,
+		CodedImplementation,
+		CodedCustomAttributeType,
+		CodedResolutionScope,
+		CodedTypeOrMethodDef,
+		CodedIndexCount
+
+	} LS_CODED_INDEX;
+
+	// ECMA-335 II.24.2.6. The tag bits, and the tables each coded index can point to.
+	static const BYTE CodedIndexTagBits[CodedIndexCount] = { 2, 2, 5, 1, 2, 3, 1, 1, 1, 2, 3, 2, 1 };
+	static const BYTE CodedIndexTables[CodedIndexCount][23] = {
+		{ 0x02, 0x01, 0x1B, LS_COLUMN_END },
+		{ 0x04, 0x08, 0x17, LS_COLUMN_END },
+		{ 0x06, 0x04, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x00, 0x0E, 0x17, 0x14, 0x11, 0x1A, 0x1B, 0x20, 0x23, 0x26, 0x27, 0x28, 0x2A, 0x2C, 0x2B, LS_COLUMN_END },
+		{ 0x04, 0x08, LS_COLUMN_END },
+		{ 0x02, 0x06, 0x20, LS_COLUMN_END },
+		{ 0x02, 0x01, 0x1A, 0x06, 0x1B, LS_COLUMN_END },
+		{ 0x14, 0x17, LS_COLUMN_END },
+		{ 0x06, 0x0A, LS_COLUMN_END },
+		{ 0x04, 0x06, LS_COLUMN_END },
+		{ 0x26, 0x23, 0x27, LS_COLUMN_END },
+		{ LS_NO_TABLE, LS_NO_TABLE, 0x06, 0x0A, LS_NO_TABLE, LS_COLUMN_END },
+		{ 0x00, 0x1A, 0x23, 0x01, LS_COLUMN_END },
+		{ 0x02, 0x06, LS_COLUMN_END }
+	};
+
+	// ECMA-335 II.22, the columns of every table up to GenericParamConstraint. The Ptr, and Enc
+	// tables only show up in unoptimized '#-' streams, but they still have to be skipped over.
+	static const BYTE TableColumns[MetadataTableCount][10] = {
+		/* Module */                 { LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_GUID, LS_COLUMN_GUID, LS_COLUMN_GUID, LS_COLUMN_END },
+		/* TypeRef */                { LS_COLUMN_CODED(CodedResolutionScope), LS_COLUMN_STRING, LS_COLUMN_STRING, LS_COLUMN_END },
+		/* TypeDef */                { LS_COLUMN_U32, LS_COLUMN_STRING, LS_COLUMN_STRING, LS_COLUMN_CODED(CodedTypeDefOrRef), 0x04, 0x06, LS_COLUMN_END },
+		/* FieldPtr */               { 0x04, LS_COLUMN_END },
+		/* Field */                  { LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* MethodPtr */              { 0x06, LS_COLUMN_END },
+		/* MethodDef */              { LS_COLUMN_U32, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_BLOB, 0x08, LS_COLUMN_END },
+		/* ParamPtr */               { 0x08, LS_COLUMN_END },
+		/* Param */                  { LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_END },
+		/* InterfaceImpl */          { 0x02, LS_COLUMN_CODED(CodedTypeDefOrRef), LS_COLUMN_END },
+		/* MemberRef */              { LS_COLUMN_CODED(CodedMemberRefParent), LS_COLUMN_STRING, LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* Constant */               { LS_COLUMN_U16, LS_COLUMN_CODED(CodedHasConstant), LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* CustomAttribute */        { LS_COLUMN_CODED(CodedHasCustomAttribute), LS_COLUMN_CODED(CodedCustomAttributeType), LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* FieldMarshal */           { LS_COLUMN_CODED(CodedHasFieldMarshal), LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* DeclSecurity */           { LS_COLUMN_U16, LS_COLUMN_CODED(CodedHasDeclSecurity), LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* ClassLayout */            { LS_COLUMN_U16, LS_COLUMN_U32, 0x02, LS_COLUMN_END },
+		/* FieldLayout */            { LS_COLUMN_U32, 0x04, LS_COLUMN_END },
+		/* StandAloneSig */          { LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* EventMap */               { 0x02, 0x14, LS_COLUMN_END },
+		/* EventPtr */               { 0x14, LS_COLUMN_END },
+		/* Event */                  { LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_CODED(CodedTypeDefOrRef), LS_COLUMN_END },
+		/* PropertyMap */            { 0x02, 0x17, LS_COLUMN_END },
+		/* PropertyPtr */            { 0x17, LS_COLUMN_END },
+		/* Property */               { LS_COLUMN_U16, LS_COLUMN_STRING, LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* MethodSemantics */        { LS_COLUMN_U16, 0x06, LS_COLUMN_CODED(CodedHasSemantics), LS_COLUMN_END },
+		/* MethodImpl */             { 0x02, LS_COLUMN_CODED(CodedMethodDefOrRef), LS_COLUMN_CODED(CodedMethodDefOrRef), LS_COLUMN_END },
+		/* ModuleRef */              { LS_COLUMN_STRING, LS_COLUMN_END },
+		/* TypeSpec */               { LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* ImplMap */                { LS_COLUMN_U16, LS_COLUMN_CODED(CodedMemberForwarded), LS_COLUMN_STRING, 0x1A, LS_COLUMN_END },
+		/* FieldRVA */               { LS_COLUMN_U32, 0x04, LS_COLUMN_END },
+		/* EncLog */                 { LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_END },
+		/* EncMap */                 { LS_COLUMN_U32, LS_COLUMN_END },
+		/* Assembly */               { LS_COLUMN_U32, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U32, LS_COLUMN_BLOB, LS_COLUMN_STRING, LS_COLUMN_STRING, LS_COLUMN_END },
+		/* AssemblyProcessor */      { LS_COLUMN_U32, LS_COLUMN_END },
+		/* AssemblyOS */             { LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_END },
+		/* AssemblyRef */            { LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_U32, LS_COLUMN_BLOB, LS_COLUMN_STRING, LS_COLUMN_STRING, LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* AssemblyRefProcessor */   { LS_COLUMN_U32, 0x23, LS_COLUMN_END },
+		/* AssemblyRefOS */          { LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_U32, 0x23, LS_COLUMN_END },
+		/* File */                   { LS_COLUMN_U32, LS_COLUMN_STRING, LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* ExportedType */           { LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_STRING, LS_COLUMN_STRING, LS_COLUMN_CODED(CodedImplementation), LS_COLUMN_END },
+		/* ManifestResource */       { LS_COLUMN_U32, LS_COLUMN_U32, LS_COLUMN_STRING, LS_COLUMN_CODED(CodedImplementation), LS_COLUMN_END },
+		/* NestedClass */            { 0x02, 0x02, LS_COLUMN_END },
+		/* GenericParam */           { LS_COLUMN_U16, LS_COLUMN_U16, LS_COLUMN_CODED(CodedTypeOrMethodDef), LS_COLUMN_STRING, LS_COLUMN_END },
+		/* MethodSpec */             { LS_COLUMN_CODED(CodedMethodDefOrRef), LS_COLUMN_BLOB, LS_COLUMN_END },
+		/* GenericParamConstraint */ { 0x2A, LS_COLUMN_CODED(CodedTypeDefOrRef), LS_COLUMN_END }
+	};
+
+	WuString _LS_ASSEMBLY_REFERENCE::GetFullName() const
+	{
+		WuString full_name = WuString::Format("%s, Version=%hu.%hu.%hu.%hu, Culture=%s, PublicKeyToken=", Name == NULL ? "" : Name,
+			Version[0], Version[1], Version[2], Version[3], Culture == NULL || Culture[0] == '\0' ? "neutral" : Culture);
+
+		if (!HasPublicKeyToken)
+			return full_name + "null";
+
+		char token[(LS_PUBLIC_KEY_TOKEN_SIZE * 2) + 1];
+		for (DWORD i = 0; i < LS_PUBLIC_KEY_TOKEN_SIZE; i++)
+			sprintf_s(token + (i * 2), 3, "%02x", PublicKeyToken[i]);
+
+		return full_name + token;
+	}
+
+	MetadataReader::MetadataReader()
+		: _data(NULL), _size(0), _version(), _strings(NULL), _strings_size(0), _blobs(NULL), _blobs_size(0), _tables(NULL), _tables_size(0),
+			_string_index_size(2), _guid_index_size(2), _blob_index_size(2), _rows(), _row_sizes(), _table_offsets() { }
+
+	MetadataReader::~MetadataReader() { }
+
+	const LSRESULT MetadataReader::Attach(const BYTE* data, size_t size)
+	{
+		// Signature, version, reserved, and the version length.
+		if (data == NULL || size < 16 || *reinterpret_cast<const DWORD*>(data) != LS_METADATA_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid CLR metadata signature.", __FILEW__, __LINE__);
+
+		// The version string is padded to four bytes, and followed by the flags, and the stream count.
+		DWORD version_length = *reinterpret_cast<const DWORD*>(data + 12);
+		if (version_length > 255 || 16 + static_cast<size_t>(version_length) + 4 > size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid CLR metadata version.", __FILEW__, __LINE__);
+
+		memcpy(_version, data + 16, version_length);
+		_version[version_length] = '\0';
+
+		size_t offset = 16 + ((static_cast<size_t>(version_length) + 3) & ~static_cast<size_t>(3));
+		if (offset + 4 > size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid CLR metadata header.", __FILEW__, __LINE__);
+
+		WORD stream_count = *reinterpret_cast<const WORD*>(data + offset + 2);
+		offset += 4;
+
+		_strings = NULL;
+		_blobs = NULL;
+		_tables = NULL;
+		for (WORD i = 0; i < stream_count; i++) {
+			// Offset, size, and a null terminated name padded to four bytes.
+			if (offset + 8 > size)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid CLR metadata stream header.", __FILEW__, __LINE__);
+
+			DWORD stream_offset = *reinterpret_cast<const DWORD*>(data + offset);
+			DWORD stream_size = *reinterpret_cast<const DWORD*>(data + offset + 4);
+			const char* name = reinterpret_cast<const char*>(data + offset + 8);
+			size_t name_length = strnlen(name, min(static_cast<size_t>(32), size - offset - 8));
+			offset += 8 + ((name_length + 4) & ~static_cast<size_t>(3));
+
+			if (stream_offset > size || stream_size > size - stream_offset)
+				return LSRESULT(ERROR_BAD_FORMAT, L"CLR metadata stream out of bounds.", __FILEW__, __LINE__);
+
+			if (name_length == 8 && strncmp(name, "#Strings", 8) == 0) {
+				_strings = reinterpret_cast<const char*>(data + stream_offset);
+				_strings_size = stream_size;
+			}
+			else if (name_length == 5 && strncmp(name, "#Blob", 5) == 0) {
+				_blobs = data + stream_offset;
+				_blobs_size = stream_size;
+			}
+			else if (name_length == 2 && (strncmp(name, "#~", 2) == 0 || strncmp(name, "#-", 2) == 0)) {
+				_tables = data + stream_offset;
+				_tables_size = stream_size;
+			}
+		}
+
+		if (_tables == NULL)
+			return LSRESULT(ERROR_BAD_FORMAT, L"CLR metadata has no table stream.", __FILEW__, __LINE__);
+
+		_data = data;
+		_size = size;
+		if (!ComputeLayout())
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid CLR metadata table stream.", __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+
+	bool MetadataReader::GetAssembly(LS_ASSEMBLY_REFERENCE& assembly) const
+	{
+		const BYTE* row = GetRow(MetadataTableAssembly, 0);
+		if (row == NULL)
+			return false;
+
+		return ReadAssemblyRow(row, false, assembly);
+	}
+
+	void MetadataReader::GetAssemblyReferences(wuvector<LS_ASSEMBLY_REFERENCE>& references) const
+	{
+		for (DWORD i = 0; i < _rows[MetadataTableAssemblyRef]; i++) {
+			LS_ASSEMBLY_REFERENCE reference;
+			const BYTE* row = GetRow(MetadataTableAssemblyRef, i);
+			if (row != NULL && ReadAssemblyRow(row, true, reference))
+				references.push_back(reference);
+		}
+	}
+
+	void MetadataReader::GetModuleReferences(wuvector<WuString>& modules) const
+	{
+		for (DWORD i = 0; i < _rows[MetadataTableModuleRef]; i++) {
+			const BYTE* row = GetRow(MetadataTableModuleRef, i);
+			if (row == NULL)
+				continue;
+
+			const char* name = GetString(ReadIndex(row, _string_index_size));
+			if (name != NULL && name[0] != '\0')
+				modules.push_back(name);
+		}
+	}
+
+	bool MetadataReader::ComputeLayout() noexcept
+	{
+		// Reserved, major, minor, heap sizes, reserved, the valid, and sorted masks.
+		if (_tables_size < 24)
+			return false;
+
+		memset(_rows, 0, sizeof(_rows));
+
+		BYTE heap_sizes = _tables[6];
+		ULONGLONG valid = *reinterpret_cast<const ULONGLONG*>(_tables + 8);
+		_string_index_size = (heap_sizes & 0x01) ? 4 : 2;
+		_guid_index_size = (heap_sizes & 0x02) ? 4 : 2;
+		_blob_index_size = (heap_sizes & 0x04) ? 4 : 2;
+
+		// A row count for every table in the valid mask.
+		size_t offset = 24;
+		for (DWORD table = 0; table < 64; table++) {
+			if ((valid & (1ULL << table)) == 0)
+				continue;
+
+			if (offset + 4 > _tables_size)
+				return false;
+
+			// Tables past ours come after them, and don't move them.
+			if (table < MetadataTableCount)
+				_rows[table] = *reinterpret_cast<const DWORD*>(_tables + offset);
+
+			offset += 4;
+		}
+
+		// Unoptimized streams can have four bytes of extra data here.
+		if (heap_sizes & 0x40)
+			offset += 4;
+
+		// Tables are laid out in order, each row the size of its columns.
+		for (DWORD table = 0; table < MetadataTableCount; table++) {
+			DWORD row_size = 0;
+			for (DWORD column = 0; TableColumns[table][column] != LS_COLUMN_END; column++)
+				row_size += GetColumnSize(TableColumns[table][column]);
+
+			_row_sizes[table] = row_size;
+			_table_offsets[table] = offset;
+
+			ULONGLONG table_size = static_cast<ULONGLONG>(row_size) * _rows[table];
+			if (table_size > _tables_size - min(offset, _tables_size))
+				return false;
+
+			offset += static_cast<size_t>(table_size);
+		}
+
+		return true;
+	}
+
+	BYTE MetadataReader::GetColumnSize(BYTE column) const noexcept
+	{
+		switch (column) {
+			case LS_COLUMN_U16: return 2;
+			case LS_COLUMN_U32: return 4;
+			case LS_COLUMN_STRING: return _string_index_size;
+			case LS_COLUMN_GUID: return _guid_index_size;
+			case LS_COLUMN_BLOB: return _blob_index_size;
+		}
+
+		// A simple index is two bytes, unless the table has more rows than that.
+		if (column < 0x40)
+			return _rows[column] < 0x10000 ? 2 : 4;
+
+		// A coded index is two bytes, unless the largest table it points to doesn't fit next to the tag.
+		BYTE kind = column & 0x3F;
+		DWORD max_rows = 0;
+		for (DWORD i = 0; CodedIndexTables[kind][i] != LS_COLUMN_END; i++) {
+			if (CodedIndexTables[kind][i] != LS_NO_TABLE)
+				max_rows = max(max_rows, _rows[CodedIndexTables[kind][i]]);
+		}
+
+		return max_rows < (1UL << (16 - CodedIndexTagBits[kind])) ? 2 : 4;
+	}
+
+	const BYTE* MetadataReader::GetRow(LS_METADATA_TABLE table, DWORD index) const noexcept
+	{
+		if (_tables == NULL || index >= _rows[table])
+			return NULL;
+
+		return _tables + _table_offsets[table] + (static_cast<size_t>(index) * _row_sizes[table]);
+	}
+
+	const char* MetadataReader::GetString(DWORD index) const noexcept
+	{
+		if (_strings == NULL || index >= _strings_size)
+			return NULL;
+
+		// Not trusting the heap to end with a terminator.
+		const char* value = _strings + index;
+		if (strnlen(value, _strings_size - index) == _strings_size - index)
+			return NULL;
+
+		return value;
+	}
+
+	bool MetadataReader::GetBlob(DWORD index, const BYTE*& data, DWORD& size) const noexcept
+	{
+		if (_blobs == NULL || index >= _blobs_size)
+			return false;
+
+		// ECMA-335 II.24.2.4, the length is compressed in one, two, or four bytes.
+		const BYTE* blob = _blobs + index;
+		DWORD available = _blobs_size - index;
+		DWORD header;
+		if ((blob[0] & 0x80) == 0) {
+			size = blob[0];
+			header = 1;
+		}
+		else if ((blob[0] & 0xC0) == 0x80 && available >= 2) {
+			size = ((blob[0] & 0x3F) << 8) | blob[1];
+			header = 2;
+		}
+		else if ((blob[0] & 0xE0) == 0xC0 && available >= 4) {
+			size = ((blob[0] & 0x1F) << 24) | (blob[1] << 16) | (blob[2] << 8) | blob[3];
+			header = 4;
+		}
+		else
+			return false;
+
+		if (size > available - header)
+			return false;
+
+		data = blob + header;
+
+		return true;
+	}
+
+	bool MetadataReader::ReadAssemblyRow(const BYTE* row, bool is_reference, LS_ASSEMBLY_REFERENCE& assembly) const
+	{
+		// Assembly starts with the hash algorithm, AssemblyRef has the flags after the version.
+		if (!is_reference)
+			row += 4;
+
+		for (DWORD i = 0; i < 4; i++)
+			assembly.Version[i] = static_cast<WORD>(ReadIndex(row, 2));
+
+		assembly.Flags = ReadIndex(row, 4);
+		DWORD key_index = ReadIndex(row, _blob_index_size);
+		assembly.Name = GetString(ReadIndex(row, _string_index_size));
+		assembly.Culture = GetString(ReadIndex(row, _string_index_size));
+		if (assembly.Name == NULL)
+			return false;
+
+		// The Assembly row always has the full key, references usually have the token.
+		const BYTE* key;
+		DWORD key_size;
+		assembly.HasPublicKeyToken = false;
+		if (key_index == 0 || !GetBlob(key_index, key, key_size) || key_size == 0)
+			return true;
+
+		if (is_reference && (assembly.Flags & LS_ASSEMBLY_FLAG_PUBLIC_KEY) == 0) {
+			if (key_size != LS_PUBLIC_KEY_TOKEN_SIZE)
+				return true;
+
+			memcpy(assembly.PublicKeyToken, key, LS_PUBLIC_KEY_TOKEN_SIZE);
+			assembly.HasPublicKeyToken = true;
+		}
+		else
+			assembly.HasPublicKeyToken = ComputePublicKeyToken(key, key_size, assembly.PublicKeyToken);
+
+		return true;
+	}
+
+	DWORD MetadataReader::ReadIndex(const BYTE*& row, BYTE size) noexcept
+	{
+		DWORD value = size == 2 ? *reinterpret_cast<const WORD*>(row) : *reinterpret_cast<const DWORD*>(row);
+		row += size;
+
+		return value;
+	}
+
+	bool MetadataReader::ComputePublicKeyToken(const BYTE* key, DWORD key_size, BYTE token[LS_PUBLIC_KEY_TOKEN_SIZE]) noexcept
+	{
+		// The last eight bytes of the key's SHA-1, reversed.
+		BCRYPT_ALG_HANDLE h_provider;
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&h_provider, BCRYPT_SHA1_ALGORITHM, NULL, 0)))
+			return false;
+
+		BYTE hash[20];
+		NTSTATUS status = BCryptHash(h_provider, NULL, 0, const_cast<PUCHAR>(key), key_size, hash, sizeof(hash));
+		BCryptCloseAlgorithmProvider(h_provider, 0);
+		if (!NT_SUCCESS(status))
+			return false;
+
+		for (DWORD i = 0; i < LS_PUBLIC_KEY_TOKEN_SIZE; i++)
+			token[i] = hash[sizeof(hash) - 1 - i];
+
+		return true;
+	}
+}
\ No newline at end of file
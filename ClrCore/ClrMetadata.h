@@ -0,0 +1,96 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_PUBLIC_KEY_TOKEN_SIZE 8
+
+	// ECMA-335 II.22, the tables we read, or skip over.
+	typedef enum _LS_METADATA_TABLE
+	{
+		MetadataTableModule = 0x00,
+		MetadataTableTypeRef = 0x01,
+		MetadataTableTypeDef = 0x02,
+		MetadataTableModuleRef = 0x1A,
+		MetadataTableAssembly = 0x20,
+		MetadataTableAssemblyRef = 0x23,
+		MetadataTableGenericParamConstraint = 0x2C,
+		MetadataTableCount
+
+	} LS_METADATA_TABLE;
+
+	// An Assembly, or AssemblyRef row. Names point into the string heap, and are null terminated.
+	typedef struct _LS_ASSEMBLY_REFERENCE
+	{
+		const char* Name;
+		const char* Culture;
+		WORD Version[4];
+		DWORD Flags;
+		bool HasPublicKeyToken;
+		BYTE PublicKeyToken[LS_PUBLIC_KEY_TOKEN_SIZE];
+
+		_LS_ASSEMBLY_REFERENCE()
+			: Name(NULL), Culture(NULL), Version(), Flags(0), HasPublicKeyToken(false), PublicKeyToken() { }
+
+		~_LS_ASSEMBLY_REFERENCE() { }
+
+		// 'Name, Version=1.0.0.0, Culture=neutral, PublicKeyToken=null', the way 'AssemblyName.FullName' prints it.
+		WuString GetFullName() const;
+
+	} LS_ASSEMBLY_REFERENCE, *PLS_ASSEMBLY_REFERENCE;
+
+	// Reader for the CLR metadata of an image, from the metadata root the COR header points to.
+	// Only the table stream layout is computed, rows are read where they are. Nothing is copied,
+	// and nothing is loaded, so it works on images in any layout, and on images that aren't files.
+	class MetadataReader
+	{
+	public:
+		MetadataReader();
+		~MetadataReader();
+
+		// 'data' is the metadata root, the 'BSJB' signature, and must outlive the reader.
+		const LSRESULT Attach(const BYTE* data, size_t size);
+
+		// The runtime version the image was built against, 'v4.0.30319' for every current one.
+		_NODISCARD const char* Version() const noexcept { return _version; }
+		_NODISCARD DWORD GetRowCount(LS_METADATA_TABLE table) const noexcept { return _rows[table]; }
+
+		// The Assembly row. Modules that aren't the manifest module don't have one.
+		bool GetAssembly(LS_ASSEMBLY_REFERENCE& assembly) const;
+		void GetAssemblyReferences(wuvector<LS_ASSEMBLY_REFERENCE>& references) const;
+
+		// ModuleRef rows. For assemblies, these are the modules P/Invoke calls go to.
+		void GetModuleReferences(wuvector<WuString>& modules) const;
+
+	private:
+		const BYTE* _data;
+		size_t _size;
+		char _version[256];
+		const char* _strings;
+		DWORD _strings_size;
+		const BYTE* _blobs;
+		DWORD _blobs_size;
+		const BYTE* _tables;
+		size_t _tables_size;
+		BYTE _string_index_size;
+		BYTE _guid_index_size;
+		BYTE _blob_index_size;
+		DWORD _rows[MetadataTableCount];
+		DWORD _row_sizes[MetadataTableCount];
+		size_t _table_offsets[MetadataTableCount];
+
+		bool ComputeLayout() noexcept;
+		BYTE GetColumnSize(BYTE column) const noexcept;
+		const BYTE* GetRow(LS_METADATA_TABLE table, DWORD index) const noexcept;
+		const char* GetString(DWORD index) const noexcept;
+		bool GetBlob(DWORD index, const BYTE*& data, DWORD& size) const noexcept;
+		bool ReadAssemblyRow(const BYTE* row, bool is_reference, LS_ASSEMBLY_REFERENCE& assembly) const;
+
+		static DWORD ReadIndex(const BYTE*& row, BYTE size) noexcept;
+		static bool ComputePublicKeyToken(const BYTE* key, DWORD key_size, BYTE token[LS_PUBLIC_KEY_TOKEN_SIZE]) noexcept;
+	};
+}
\ No newline at end of file
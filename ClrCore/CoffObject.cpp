@@ -0,0 +1,476 @@
+#include "pch.h"
+
+#include "CoffObject.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// Not in every SDK version.
+	#ifndef IMAGE_FILE_MACHINE_ARM64EC
+	#define IMAGE_FILE_MACHINE_ARM64EC 0xA641
+	#endif
+
+	#ifndef IMAGE_FILE_MACHINE_ARM64X
+	#define IMAGE_FILE_MACHINE_ARM64X 0xA64E
+	#endif
+
+	// Identifies /bigobj files. Import objects, and LTCG objects share the anonymous header.
+	static const CLSID BigObjClassId = { 0xD1BAA1C7, 0xBAEE, 0x4BA9, { 0xAF, 0x20, 0xFA, 0xF6, 0x6A, 0xA4, 0xDC, 0xB8 } };
+
+	typedef struct _LS_SCAN_CONTEXT
+	{
+		const wuvector<WWuString>* Paths;
+		wuvector<LS_COFF_SCAN_RESULT>* Results;
+
+		// One per worker, merged at the end. Keyed by the name hash.
+		wuvector<wuhash_map<ULONGLONG, LS_COFF_SYMBOL_USAGE>>* Symbols;
+		volatile LONG Next;
+		volatile LONG NextWorker;
+
+	} LS_SCAN_CONTEXT, *PLS_SCAN_CONTEXT;
+
+	// FNV-1a. Names are hashed where they are, and copied only the first time a worker sees them.
+	static ULONGLONG HashName(const char* name, DWORD length) noexcept
+	{
+		ULONGLONG hash = 14695981039346656037ULL;
+		for (DWORD i = 0; i < length; i++) {
+			hash ^= static_cast<BYTE>(name[i]);
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	CoffObject::CoffObject()
+		: _h_file(INVALID_HANDLE_VALUE), _h_map(NULL), _view(NULL), _data(NULL), _size(0), _big_obj(false), _machine(0), _time_date_stamp(0),
+			_section_count(0), _sections(NULL), _symbols(NULL), _symbol_count(0), _symbol_size(0), _strings(NULL), _strings_size(0) { }
+
+	CoffObject::~CoffObject()
+	{
+		Close();
+	}
+
+	const LSRESULT CoffObject::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (_h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		// Empty files can't be mapped.
+		if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(IMAGE_FILE_HEADER)))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid COFF object.", __FILEW__, __LINE__);
+
+		_h_map = CreateFileMapping(_h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_h_map == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view = static_cast<const BYTE*>(MapViewOfFile(_h_map, FILE_MAP_READ, 0, 0, 0));
+		if (_view == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		return Attach(_view, static_cast<size_t>(file_size.QuadPart));
+	}
+
+	const LSRESULT CoffObject::Attach(const BYTE* data, size_t size)
+	{
+		// 'Open' attaches its own view.
+		if (data != _view)
+			Close();
+
+		DWORD section_offset;
+		DWORD symbol_offset;
+		if (!ReadHeader(data, size, _big_obj, _machine, section_offset, _section_count, symbol_offset, _symbol_count))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid COFF object.", __FILEW__, __LINE__);
+
+		_data = data;
+		_size = size;
+		_sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(data + section_offset);
+		_time_date_stamp = _big_obj ? reinterpret_cast<const ANON_OBJECT_HEADER_BIGOBJ*>(data)->TimeDateStamp : reinterpret_cast<const IMAGE_FILE_HEADER*>(data)->TimeDateStamp;
+		_symbol_size = _big_obj ? sizeof(IMAGE_SYMBOL_EX) : sizeof(IMAGE_SYMBOL);
+
+		// The string table follows the symbols, and starts with its size, the size field included.
+		_symbols = _symbol_count > 0 ? data + symbol_offset : NULL;
+		ULONGLONG strings_offset = static_cast<ULONGLONG>(symbol_offset) + (static_cast<ULONGLONG>(_symbol_count) * _symbol_size);
+		if (_symbols != NULL && strings_offset + sizeof(DWORD) <= size) {
+			DWORD strings_size = *reinterpret_cast<const DWORD*>(data + strings_offset);
+			if (strings_size >= sizeof(DWORD) && strings_offset + strings_size <= size) {
+				_strings = reinterpret_cast<const char*>(data + strings_offset);
+				_strings_size = strings_size;
+			}
+		}
+
+		return LSRESULT();
+	}
+
+	void CoffObject::Close() noexcept
+	{
+		if (_view != NULL) {
+			UnmapViewOfFile(_view);
+			_view = NULL;
+		}
+
+		if (_h_map != NULL) {
+			CloseHandle(_h_map);
+			_h_map = NULL;
+		}
+
+		if (_h_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_h_file);
+			_h_file = INVALID_HANDLE_VALUE;
+		}
+
+		_data = NULL;
+		_size = 0;
+		_section_count = 0;
+		_sections = NULL;
+		_symbols = NULL;
+		_symbol_count = 0;
+		_strings = NULL;
+		_strings_size = 0;
+	}
+
+	bool CoffObject::IsCoffObject(const BYTE* data, size_t size) noexcept
+	{
+		bool big_obj;
+		WORD machine;
+		DWORD section_offset, section_count, symbol_offset, symbol_count;
+
+		return ReadHeader(data, size, big_obj, machine, section_offset, section_count, symbol_offset, symbol_count);
+	}
+
+	const IMAGE_SECTION_HEADER* CoffObject::GetSection(DWORD index) const noexcept
+	{
+		if (index >= _section_count)
+			return NULL;
+
+		return &_sections[index];
+	}
+
+	bool CoffObject::GetSectionName(DWORD index, const char*& name, DWORD& length) const noexcept
+	{
+		const IMAGE_SECTION_HEADER* section = GetSection(index);
+		if (section == NULL)
+			return false;
+
+		const char* short_name = reinterpret_cast<const char*>(section->Name);
+		if (short_name[0] != '/' || _strings == NULL) {
+			name = short_name;
+			length = static_cast<DWORD>(strnlen(short_name, IMAGE_SIZEOF_SHORT_NAME));
+
+			return true;
+		}
+
+		// '/1234' in decimal, or '//AAAAAA' in base 64 for offsets that don't fit in seven digits.
+		ULONGLONG offset = 0;
+		if (short_name[1] == '/') {
+			for (DWORD i = 2; i < IMAGE_SIZEOF_SHORT_NAME; i++) {
+				char digit = short_name[i];
+				DWORD value;
+				if (digit >= 'A' && digit <= 'Z') value = digit - 'A';
+				else if (digit >= 'a' && digit <= 'z') value = digit - 'a' + 26;
+				else if (digit >= '0' && digit <= '9') value = digit - '0' + 52;
+				else if (digit == '+') value = 62;
+				else if (digit == '/') value = 63;
+				else return false;
+
+				offset = (offset * 64) + value;
+			}
+		}
+		else {
+			for (DWORD i = 1; i < IMAGE_SIZEOF_SHORT_NAME && short_name[i] != '\0'; i++) {
+				if (short_name[i] < '0' || short_name[i] > '9')
+					return false;
+
+				offset = (offset * 10) + (short_name[i] - '0');
+			}
+		}
+
+		if (offset > MAXDWORD)
+			return false;
+
+		name = GetString(static_cast<DWORD>(offset), length);
+
+		return name != NULL;
+	}
+
+	bool CoffObject::NextSymbol(DWORD& index, LS_COFF_SYMBOL& symbol) const noexcept
+	{
+		if (index >= _symbol_count)
+			return false;
+
+		const BYTE* record = _symbols + (static_cast<size_t>(index) * _symbol_size);
+		symbol.Index = index;
+
+		// Long names are a zero, and a string table offset.
+		if (*reinterpret_cast<const DWORD*>(record) == 0) {
+			symbol.Name = GetString(*reinterpret_cast<const DWORD*>(record + 4), symbol.NameLength);
+			if (symbol.Name == NULL) {
+				symbol.Name = "";
+				symbol.NameLength = 0;
+			}
+		}
+		else {
+			symbol.Name = reinterpret_cast<const char*>(record);
+			symbol.NameLength = static_cast<DWORD>(strnlen(symbol.Name, IMAGE_SIZEOF_SHORT_NAME));
+		}
+
+		if (_big_obj) {
+			const IMAGE_SYMBOL_EX* entry = reinterpret_cast<const IMAGE_SYMBOL_EX*>(record);
+			symbol.Value = entry->Value;
+			symbol.SectionNumber = entry->SectionNumber;
+			symbol.Type = entry->Type;
+			symbol.StorageClass = entry->StorageClass;
+			symbol.AuxCount = entry->NumberOfAuxSymbols;
+		}
+		else {
+			const IMAGE_SYMBOL* entry = reinterpret_cast<const IMAGE_SYMBOL*>(record);
+			symbol.Value = entry->Value;
+			symbol.SectionNumber = entry->SectionNumber;
+			symbol.Type = entry->Type;
+			symbol.StorageClass = entry->StorageClass;
+			symbol.AuxCount = entry->NumberOfAuxSymbols;
+		}
+
+		// A count running past the table is cut at the end.
+		DWORD remaining = _symbol_count - index - 1;
+		if (symbol.AuxCount > remaining)
+			symbol.AuxCount = static_cast<BYTE>(remaining);
+
+		symbol.AuxData = symbol.AuxCount > 0 ? record + _symbol_size : NULL;
+		index += 1 + symbol.AuxCount;
+
+		return true;
+	}
+
+	bool CoffObject::GetRelocations(DWORD index, const IMAGE_RELOCATION*& relocations, DWORD& count) const noexcept
+	{
+		const IMAGE_SECTION_HEADER* section = GetSection(index);
+		if (section == NULL)
+			return false;
+
+		relocations = NULL;
+		count = section->NumberOfRelocations;
+		if (count == 0)
+			return true;
+
+		ULONGLONG offset = section->PointerToRelocations;
+		if (offset + sizeof(IMAGE_RELOCATION) > _size)
+			return false;
+
+		const IMAGE_RELOCATION* first = reinterpret_cast<const IMAGE_RELOCATION*>(_data + offset);
+		if ((section->Characteristics & IMAGE_SCN_LNK_NRELOC_OVFL) != 0 && count == MAXWORD) {
+			if (first->RelocCount == 0)
+				return false;
+
+			count = first->RelocCount - 1;
+			offset += sizeof(IMAGE_RELOCATION);
+		}
+
+		if (offset + (static_cast<ULONGLONG>(count) * sizeof(IMAGE_RELOCATION)) > _size)
+			return false;
+
+		relocations = reinterpret_cast<const IMAGE_RELOCATION*>(_data + offset);
+
+		return true;
+	}
+
+	const char* CoffObject::GetString(DWORD offset, DWORD& length) const noexcept
+	{
+		if (_strings == NULL || offset < sizeof(DWORD) || offset >= _strings_size)
+			return NULL;
+
+		length = static_cast<DWORD>(strnlen(_strings + offset, _strings_size - offset));
+
+		return _strings + offset;
+	}
+
+	void CoffObject::Scan(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_COFF_SCAN_RESULT>& results, wuvector<LS_COFF_SYMBOL_USAGE>& symbols)
+	{
+		results.clear();
+		results.resize(file_paths.size());
+		symbols.clear();
+		if (file_paths.empty())
+			return;
+
+		if (thread_count == 0) {
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			thread_count = system_info.dwNumberOfProcessors;
+		}
+
+		// The calling thread is one of the workers.
+		thread_count = static_cast<DWORD>(min(static_cast<size_t>(thread_count), file_paths.size()));
+		thread_count = min(thread_count, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS));
+
+		wuvector<wuhash_map<ULONGLONG, LS_COFF_SYMBOL_USAGE>> worker_symbols(thread_count);
+		LS_SCAN_CONTEXT context{ &file_paths, &results, &worker_symbols, 0, 0 };
+		wuvector<HANDLE> threads;
+		for (DWORD i = 1; i < thread_count; i++) {
+			HANDLE h_thread = CreateThread(NULL, 0, ScanWorker, &context, 0, NULL);
+			if (h_thread == NULL)
+				break;
+
+			threads.push_back(h_thread);
+		}
+
+		ScanWorker(&context);
+
+		if (!threads.empty()) {
+			WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, INFINITE);
+			for (HANDLE h_thread : threads)
+				CloseHandle(h_thread);
+		}
+
+		// Merging into the first worker's map.
+		wuhash_map<ULONGLONG, LS_COFF_SYMBOL_USAGE>& merged = worker_symbols.front();
+		for (size_t i = 1; i < worker_symbols.size(); i++) {
+			for (auto& entry : worker_symbols[i]) {
+				LS_COFF_SYMBOL_USAGE& usage = merged[entry.first];
+				if (usage.Name.Length() == 0)
+					usage.Name = entry.second.Name;
+
+				usage.ReferenceCount += entry.second.ReferenceCount;
+				usage.DefinitionCount += entry.second.DefinitionCount;
+			}
+
+			worker_symbols[i].clear();
+		}
+
+		symbols.reserve(merged.size());
+		for (auto& entry : merged)
+			symbols.push_back(entry.second);
+
+		std::sort(symbols.begin(), symbols.end(), [](const LS_COFF_SYMBOL_USAGE& left, const LS_COFF_SYMBOL_USAGE& right) {
+			return left.Name < right.Name;
+		});
+	}
+
+	bool CoffObject::IsKnownMachine(WORD machine) noexcept
+	{
+		switch (machine) {
+			case IMAGE_FILE_MACHINE_I386:
+			case IMAGE_FILE_MACHINE_AMD64:
+			case IMAGE_FILE_MACHINE_ARM:
+			case IMAGE_FILE_MACHINE_ARMNT:
+			case IMAGE_FILE_MACHINE_ARM64:
+			case IMAGE_FILE_MACHINE_ARM64EC:
+			case IMAGE_FILE_MACHINE_ARM64X:
+			case IMAGE_FILE_MACHINE_IA64:
+
+			// Machine independent objects.
+			case IMAGE_FILE_MACHINE_UNKNOWN:
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	bool CoffObject::ReadHeader(const BYTE* data, size_t size, bool& big_obj, WORD& machine, DWORD& section_offset, DWORD& section_count, DWORD& symbol_offset, DWORD& symbol_count) noexcept
+	{
+		if (data == NULL || size < sizeof(IMAGE_FILE_HEADER))
+			return false;
+
+		const IMAGE_FILE_HEADER* header = reinterpret_cast<const IMAGE_FILE_HEADER*>(data);
+		if (header->Machine == IMAGE_FILE_MACHINE_UNKNOWN && header->NumberOfSections == MAXWORD) {
+			if (size < sizeof(ANON_OBJECT_HEADER_BIGOBJ))
+				return false;
+
+			const ANON_OBJECT_HEADER_BIGOBJ* anon_header = reinterpret_cast<const ANON_OBJECT_HEADER_BIGOBJ*>(data);
+			if (anon_header->Version < 2 || memcmp(&anon_header->ClassID, &BigObjClassId, sizeof(CLSID)) != 0)
+				return false;
+
+			big_obj = true;
+			machine = anon_header->Machine;
+			section_offset = sizeof(ANON_OBJECT_HEADER_BIGOBJ);
+			section_count = anon_header->NumberOfSections;
+			symbol_offset = anon_header->PointerToSymbolTable;
+			symbol_count = anon_header->NumberOfSymbols;
+		}
+		else {
+			big_obj = false;
+			machine = header->Machine;
+
+			// Objects have no optional header, but the format allows one.
+			section_offset = sizeof(IMAGE_FILE_HEADER) + header->SizeOfOptionalHeader;
+			section_count = header->NumberOfSections;
+			symbol_offset = header->PointerToSymbolTable;
+			symbol_count = header->NumberOfSymbols;
+		}
+
+		// Any machine is read. The tables are checked, not the machine, which 'IsKnownMachine' reports.
+		if (static_cast<ULONGLONG>(section_offset) + (static_cast<ULONGLONG>(section_count) * sizeof(IMAGE_SECTION_HEADER)) > size)
+			return false;
+
+		ULONGLONG symbol_size = big_obj ? sizeof(IMAGE_SYMBOL_EX) : sizeof(IMAGE_SYMBOL);
+		if (symbol_count > 0 && static_cast<ULONGLONG>(symbol_offset) + (static_cast<ULONGLONG>(symbol_count) * symbol_size) > size)
+			return false;
+
+		return true;
+	}
+
+	DWORD WINAPI CoffObject::ScanWorker(LPVOID context)
+	{
+		PLS_SCAN_CONTEXT scan = static_cast<PLS_SCAN_CONTEXT>(context);
+		wuhash_map<ULONGLONG, LS_COFF_SYMBOL_USAGE>& symbols = (*scan->Symbols)[InterlockedIncrement(&scan->NextWorker) - 1];
+
+		// Reused for the names copied.
+		wuvector<char> name_buffer;
+		CoffObject object;
+		LONG count = static_cast<LONG>(scan->Paths->size());
+		for (LONG index = InterlockedIncrement(&scan->Next) - 1; index < count; index = InterlockedIncrement(&scan->Next) - 1) {
+			LS_COFF_SCAN_RESULT& result = (*scan->Results)[index];
+			result.Path = (*scan->Paths)[index];
+
+			LSRESULT open_result = object.Open(result.Path);
+			result.Result = open_result.Result;
+			if (open_result.Result != ERROR_SUCCESS) {
+				object.Close();
+				continue;
+			}
+
+			result.Machine = object.Machine();
+			result.IsBigObj = object.IsBigObj();
+			result.SectionCount = object.SectionCount();
+			result.SymbolCount = object.SymbolCount();
+
+			DWORD symbol_index = 0;
+			LS_COFF_SYMBOL symbol;
+			while (object.NextSymbol(symbol_index, symbol)) {
+
+				// Weak externals have a default, so they never fail to link. Statics, and labels are local.
+				if (symbol.StorageClass != IMAGE_SYM_CLASS_EXTERNAL || symbol.SectionNumber == IMAGE_SYM_DEBUG || symbol.NameLength == 0)
+					continue;
+
+				// Undefined symbols with a value are common data, allocated by the linker.
+				bool defined = symbol.SectionNumber != IMAGE_SYM_UNDEFINED || symbol.Value != 0;
+				LS_COFF_SYMBOL_USAGE& usage = symbols[HashName(symbol.Name, symbol.NameLength)];
+				if (usage.Name.Length() == 0) {
+					name_buffer.assign(symbol.Name, symbol.Name + symbol.NameLength);
+					name_buffer.push_back('\0');
+					usage.Name = name_buffer.data();
+				}
+
+				if (defined) {
+					usage.DefinitionCount++;
+					result.DefinedCount++;
+				}
+				else {
+					usage.ReferenceCount++;
+					result.UndefinedCount++;
+				}
+			}
+
+			object.Close();
+		}
+
+		return 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// A symbol table record. Names point into the file, and are not null terminated.
+	typedef struct _LS_COFF_SYMBOL
+	{
+		DWORD Index;
+		const char* Name;
+		DWORD NameLength;
+		DWORD Value;
+
+		// 32 bits for /bigobj files. Zero is undefined, -1 absolute, and -2 debug.
+		LONG SectionNumber;
+		WORD Type;
+		BYTE StorageClass;
+		BYTE AuxCount;
+
+		// 'AuxCount' records, each the size of a symbol record.
+		const BYTE* AuxData;
+
+	} LS_COFF_SYMBOL, *PLS_COFF_SYMBOL;
+
+	// An external symbol across a set of objects, with how many symbol records reference, and define it.
+	typedef struct _LS_COFF_SYMBOL_USAGE
+	{
+		WuString Name;
+		DWORD ReferenceCount;
+		DWORD DefinitionCount;
+
+		_LS_COFF_SYMBOL_USAGE()
+			: ReferenceCount(0), DefinitionCount(0) { }
+
+		~_LS_COFF_SYMBOL_USAGE() { }
+
+	} LS_COFF_SYMBOL_USAGE, *PLS_COFF_SYMBOL_USAGE;
+
+	typedef struct _LS_COFF_SCAN_RESULT
+	{
+		WWuString Path;
+		DWORD Result;
+		WORD Machine;
+		bool IsBigObj;
+		DWORD SectionCount;
+		DWORD SymbolCount;
+		DWORD DefinedCount;
+		DWORD UndefinedCount;
+
+		_LS_COFF_SCAN_RESULT()
+			: Result(ERROR_SUCCESS), Machine(0), IsBigObj(false), SectionCount(0), SymbolCount(0), DefinedCount(0), UndefinedCount(0) { }
+
+		~_LS_COFF_SCAN_RESULT() { }
+
+	} LS_COFF_SCAN_RESULT, *PLS_COFF_SCAN_RESULT;
+
+	// Reader for COFF object files, regular and /bigobj. The file is mapped, or the data
+	// attached, and every table is read where it is. Nothing is copied, or allocated.
+	class CoffObject
+	{
+	public:
+		CoffObject();
+		~CoffObject();
+
+		const LSRESULT Open(const WWuString& file_path);
+
+		// 'data' is not copied, and must outlive the object. Archive members are read this way.
+		const LSRESULT Attach(const BYTE* data, size_t size);
+		void Close() noexcept;
+
+		// Checks the header, and that the section, and symbol tables are in 'size'.
+		static bool IsCoffObject(const BYTE* data, size_t size) noexcept;
+
+		// Machines this reader was written against. Objects for any other machine are still
+		// read, the symbol table layout doesn't depend on it, but callers can report them.
+		static bool IsKnownMachine(WORD machine) noexcept;
+
+		_NODISCARD WORD Machine() const noexcept { return _machine; }
+		_NODISCARD bool IsBigObj() const noexcept { return _big_obj; }
+		_NODISCARD DWORD TimeDateStamp() const noexcept { return _time_date_stamp; }
+		_NODISCARD DWORD SectionCount() const noexcept { return _section_count; }
+		_NODISCARD DWORD SymbolCount() const noexcept { return _symbol_count; }
+
+		// Zero based. Section numbers in the symbol table start at one.
+		const IMAGE_SECTION_HEADER* GetSection(DWORD index) const noexcept;
+
+		// Names longer than eight characters are '/' and a decimal offset into the string table.
+		bool GetSectionName(DWORD index, const char*& name, DWORD& length) const noexcept;
+
+		// Start with 'index' at zero. Aux records are returned with their symbol, and skipped.
+		bool NextSymbol(DWORD& index, LS_COFF_SYMBOL& symbol) const noexcept;
+
+		// Sections with more than 0xFFFF relocations keep the count in the first one, which is skipped.
+		bool GetRelocations(DWORD index, const IMAGE_RELOCATION*& relocations, DWORD& count) const noexcept;
+
+		// 'offset' counts the size field at the start of the table.
+		const char* GetString(DWORD offset, DWORD& length) const noexcept;
+
+		// Maps every object on 'thread_count' threads, and counts the external definitions, and
+		// references. Zero threads means one per processor. Failures are reported per file.
+		static void Scan(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_COFF_SCAN_RESULT>& results, wuvector<LS_COFF_SYMBOL_USAGE>& symbols);
+
+	private:
+		HANDLE _h_file;
+		HANDLE _h_map;
+		const BYTE* _view;
+		const BYTE* _data;
+		size_t _size;
+		bool _big_obj;
+		WORD _machine;
+		DWORD _time_date_stamp;
+		DWORD _section_count;
+		const IMAGE_SECTION_HEADER* _sections;
+		const BYTE* _symbols;
+		DWORD _symbol_count;
+		DWORD _symbol_size;
+		const char* _strings;
+		DWORD _strings_size;
+
+		static bool ReadHeader(const BYTE* data, size_t size, bool& big_obj, WORD& machine, DWORD& section_offset, DWORD& section_count, DWORD& symbol_offset, DWORD& symbol_count) noexcept;
+		static DWORD WINAPI ScanWorker(LPVOID context);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,486 @@
+#include "pch.h"
+
+#include "Corpus.h"
+
+namespace LibSnitcher::Core
+{
+	// The IoRing API is in kernelbase.dll from Windows 11 on. We target older systems, so the
+	// types are mirrored from 'ioringapi.h', and the functions looked up at run time.
+	#define LS_IORING_VERSION_1 1
+	#define LS_IORING_REF_RAW 0
+
+	typedef struct _LS_IORING_CREATE_FLAGS
+	{
+		INT Required;
+		INT Advisory;
+
+	} LS_IORING_CREATE_FLAGS;
+
+	typedef struct _LS_IORING_HANDLE_REF
+	{
+		INT Kind;
+		union
+		{
+			HANDLE Handle;
+			UINT32 Index;
+		} Handle;
+
+	} LS_IORING_HANDLE_REF;
+
+	typedef struct _LS_IORING_BUFFER_REF
+	{
+		INT Kind;
+		union
+		{
+			PVOID Address;
+			UINT64 IndexAndOffset;
+		} Buffer;
+
+	} LS_IORING_BUFFER_REF;
+
+	typedef struct _LS_IORING_CQE
+	{
+		UINT_PTR UserData;
+		HRESULT ResultCode;
+		ULONG_PTR Information;
+
+	} LS_IORING_CQE;
+
+	typedef HRESULT(WINAPI* PCreateIoRing)(INT version, LS_IORING_CREATE_FLAGS flags, UINT32 submission_size, UINT32 completion_size, PVOID* ring);
+	typedef HRESULT(WINAPI* PBuildIoRingReadFile)(PVOID ring, LS_IORING_HANDLE_REF file, LS_IORING_BUFFER_REF buffer, UINT32 size, UINT64 offset, UINT_PTR user_data, INT flags);
+	typedef HRESULT(WINAPI* PSubmitIoRing)(PVOID ring, UINT32 wait_count, UINT32 milliseconds, UINT32* submitted);
+	typedef HRESULT(WINAPI* PPopIoRingCompletion)(PVOID ring, LS_IORING_CQE* cqe);
+	typedef HRESULT(WINAPI* PSetIoRingCompletionEvent)(PVOID ring, HANDLE h_event);
+	typedef HRESULT(WINAPI* PCloseIoRing)(PVOID ring);
+
+	typedef struct _LS_IORING_API
+	{
+		PCreateIoRing Create;
+		PBuildIoRingReadFile BuildReadFile;
+		PSubmitIoRing Submit;
+		PPopIoRingCompletion PopCompletion;
+		PSetIoRingCompletionEvent SetCompletionEvent;
+		PCloseIoRing Close;
+
+	} LS_IORING_API, *PLS_IORING_API;
+
+	static LS_IORING_API IoRingApi;
+	static INIT_ONCE IoRingApiOnce = INIT_ONCE_STATIC_INIT;
+
+	static BOOL CALLBACK LoadIoRingApi(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+	{
+		UNREFERENCED_PARAMETER(init_once);
+		UNREFERENCED_PARAMETER(parameter);
+		UNREFERENCED_PARAMETER(context);
+
+		HMODULE module = GetModuleHandle(L"kernelbase.dll");
+		if (module == NULL)
+			return TRUE;
+
+		IoRingApi.Create = reinterpret_cast<PCreateIoRing>(GetProcAddress(module, "CreateIoRing"));
+		IoRingApi.BuildReadFile = reinterpret_cast<PBuildIoRingReadFile>(GetProcAddress(module, "BuildIoRingReadFile"));
+		IoRingApi.Submit = reinterpret_cast<PSubmitIoRing>(GetProcAddress(module, "SubmitIoRing"));
+		IoRingApi.PopCompletion = reinterpret_cast<PPopIoRingCompletion>(GetProcAddress(module, "PopIoRingCompletion"));
+		IoRingApi.SetCompletionEvent = reinterpret_cast<PSetIoRingCompletionEvent>(GetProcAddress(module, "SetIoRingCompletionEvent"));
+		IoRingApi.Close = reinterpret_cast<PCloseIoRing>(GetProcAddress(module, "CloseIoRing"));
+
+		// All, or nothing.
+		if (IoRingApi.Create == NULL || IoRingApi.BuildReadFile == NULL || IoRingApi.Submit == NULL
+			|| IoRingApi.PopCompletion == NULL || IoRingApi.SetCompletionEvent == NULL || IoRingApi.Close == NULL)
+		{
+			IoRingApi = LS_IORING_API{ };
+		}
+
+		return TRUE;
+	}
+
+	// Ring results are HRESULTs, files report Win32 codes like the rest of the library.
+	static LONG GetWin32Error(HRESULT h_result) noexcept
+	{
+		if (SUCCEEDED(h_result))
+			return ERROR_SUCCESS;
+
+		return HRESULT_FACILITY(h_result) == FACILITY_WIN32 ? HRESULT_CODE(h_result) : h_result;
+	}
+
+	static LONG GetStopError(LS_WORK_STOP stop_reason) noexcept
+	{
+		return stop_reason == WorkStopCancelled ? ERROR_CANCELLED : ERROR_TIMEOUT;
+	}
+
+	CorpusPipeline::CorpusPipeline(DWORD queue_depth, DWORD thread_count)
+		: _queue_depth(queue_depth == 0 ? LS_CORPUS_QUEUE_DEPTH : queue_depth), _thread_count(thread_count), _backend(CorpusBackendThreadPool),
+			_parser(NULL), _token(NULL), _pool(NULL), _cleanup_group(NULL), _callback_environ(), _slots(NULL), _done(NULL), _pending(0),
+				_ring(NULL), _ring_event(NULL), _ring_wait(NULL), _ring_queued(0)
+	{
+		InitializeSRWLock(&_ring_lock);
+		InitializeSRWLock(&_submit_lock);
+
+		if (_thread_count == 0) {
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			_thread_count = system_info.dwNumberOfProcessors;
+		}
+	}
+
+	CorpusPipeline::~CorpusPipeline()
+	{
+		Release();
+	}
+
+	const LSRESULT CorpusPipeline::Run(const wuvector<WWuString>& file_paths, CorpusParser& parser, const CancellationToken* token)
+	{
+		if (file_paths.empty())
+			return LSRESULT();
+
+		_parser = &parser;
+		_token = token;
+
+		_pool = CreateThreadpool(NULL);
+		_cleanup_group = CreateThreadpoolCleanupGroup();
+		_slots = CreateSemaphore(NULL, _queue_depth, _queue_depth, NULL);
+		_done = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (_pool == NULL || _cleanup_group == NULL || _slots == NULL || _done == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Release();
+			return result;
+		}
+
+		// Parsing is CPU work, more threads than processors only take turns.
+		SetThreadpoolThreadMaximum(_pool, _thread_count);
+		if (!SetThreadpoolThreadMinimum(_pool, 1)) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Release();
+			return result;
+		}
+
+		InitializeThreadpoolEnvironment(&_callback_environ);
+		SetThreadpoolCallbackPool(&_callback_environ, _pool);
+		SetThreadpoolCallbackCleanupGroup(&_callback_environ, _cleanup_group, NULL);
+
+		_backend = StartIoRing() ? CorpusBackendIoRing : CorpusBackendThreadPool;
+
+		// One for this loop, so the event isn't set before every file is queued.
+		_pending = 1;
+		DWORD first_read_size = parser.FirstReadSize();
+		for (size_t i = 0; i < file_paths.size(); i++) {
+			WaitForSingleObject(_slots, INFINITE);
+
+			PLS_CORPUS_FILE file = new LS_CORPUS_FILE();
+			file->Index = static_cast<DWORD>(i);
+			file->Path = &file_paths[i];
+			file->Size = first_read_size;
+			file->Pipeline = this;
+			InterlockedIncrement(&_pending);
+
+			LS_WORK_STOP stop_reason = _token == NULL ? WorkStopNone : _token->Check();
+			if (stop_reason != WorkStopNone) {
+				file->Result = GetStopError(stop_reason);
+				Complete(file);
+				continue;
+			}
+
+			if (!TrySubmitThreadpoolCallback(OnOpen, file, &_callback_environ)) {
+				file->Result = GetLastError();
+				Complete(file);
+			}
+		}
+
+		if (InterlockedDecrement(&_pending) == 0)
+			SetEvent(_done);
+
+		WaitForSingleObject(_done, INFINITE);
+		Release();
+
+		return LSRESULT();
+	}
+
+	void CorpusPipeline::Release() noexcept
+	{
+		StopIoRing();
+
+		// Waits for the last callbacks, the ones that set '_done'.
+		if (_cleanup_group != NULL) {
+			CloseThreadpoolCleanupGroupMembers(_cleanup_group, FALSE, NULL);
+			CloseThreadpoolCleanupGroup(_cleanup_group);
+			_cleanup_group = NULL;
+		}
+
+		if (_pool != NULL) {
+			CloseThreadpool(_pool);
+			DestroyThreadpoolEnvironment(&_callback_environ);
+			_pool = NULL;
+		}
+
+		if (_slots != NULL) {
+			CloseHandle(_slots);
+			_slots = NULL;
+		}
+
+		if (_done != NULL) {
+			CloseHandle(_done);
+			_done = NULL;
+		}
+
+		_parser = NULL;
+		_token = NULL;
+	}
+
+	bool CorpusPipeline::StartIoRing() noexcept
+	{
+		InitOnceExecuteOnce(&IoRingApiOnce, LoadIoRingApi, NULL, NULL);
+		if (IoRingApi.Create == NULL)
+			return false;
+
+		// At most one read per file in flight, so the queues never fill.
+		LS_IORING_CREATE_FLAGS flags{ };
+		if (FAILED(IoRingApi.Create(LS_IORING_VERSION_1, flags, _queue_depth, _queue_depth * 2, &_ring))) {
+			_ring = NULL;
+			return false;
+		}
+
+		// One entry per file at most, it never grows past this while the ring runs.
+		_ring_queued = 0;
+		_ring_built.clear();
+		_ring_built.reserve(_queue_depth);
+		_ring_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if (_ring_event != NULL && SUCCEEDED(IoRingApi.SetCompletionEvent(_ring, _ring_event)))
+			_ring_wait = CreateThreadpoolWait(OnRingCompletion, this, &_callback_environ);
+
+		if (_ring_wait == NULL) {
+			StopIoRing();
+			return false;
+		}
+
+		SetThreadpoolWait(_ring_wait, _ring_event, NULL);
+
+		return true;
+	}
+
+	void CorpusPipeline::StopIoRing() noexcept
+	{
+		if (_ring_wait != NULL) {
+			SetThreadpoolWait(_ring_wait, NULL, NULL);
+			WaitForThreadpoolWaitCallbacks(_ring_wait, TRUE);
+			CloseThreadpoolWait(_ring_wait);
+			_ring_wait = NULL;
+		}
+
+		if (_ring != NULL) {
+			IoRingApi.Close(_ring);
+			_ring = NULL;
+		}
+
+		if (_ring_event != NULL) {
+			CloseHandle(_ring_event);
+			_ring_event = NULL;
+		}
+	}
+
+	void CorpusPipeline::SubmitRing() noexcept
+	{
+		// Reads built while a submission is in the kernel go together in the next one.
+		// Checking again after releasing the lock, so no entry is left behind.
+		while (_ring_queued != 0 && TryAcquireSRWLockExclusive(&_submit_lock)) {
+			wuvector<PLS_CORPUS_FILE> failed;
+			LONG queued = InterlockedExchange(&_ring_queued, 0);
+			if (queued != 0) {
+				AcquireSRWLockExclusive(&_ring_lock);
+				if (_backend == CorpusBackendIoRing) {
+					UINT32 submitted = 0;
+					HRESULT h_result = IoRingApi.Submit(_ring, 0, 0, &submitted);
+
+					// Waiting for a later submission could wait forever, there might be none. The ring
+					// is not submitted again, the entries left in it are never read, and their files
+					// are read on the pool instead. Entries already in flight still complete on the ring.
+					if (FAILED(h_result)) {
+						_backend = CorpusBackendThreadPool;
+						if (submitted < _ring_built.size())
+							failed.assign(_ring_built.begin() + submitted, _ring_built.end());
+					}
+
+					_ring_built.clear();
+				}
+
+				ReleaseSRWLockExclusive(&_ring_lock);
+			}
+
+			ReleaseSRWLockExclusive(&_submit_lock);
+
+			for (PLS_CORPUS_FILE file : failed)
+				IssueRead(file);
+		}
+	}
+
+	void CorpusPipeline::IssueRead(PLS_CORPUS_FILE file) noexcept
+	{
+		// Reads past the end are cut, parsers get what the file has.
+		ULONGLONG remaining = file->Offset < file->FileSize ? file->FileSize - file->Offset : 0;
+		DWORD size = static_cast<DWORD>(min(static_cast<ULONGLONG>(file->Size), remaining));
+		file->BytesRead = 0;
+		if (size == 0) {
+			Parse(file);
+			return;
+		}
+
+		file->Buffer.resize(size);
+		if (_backend == CorpusBackendIoRing) {
+			LS_IORING_HANDLE_REF handle_ref{ LS_IORING_REF_RAW };
+			handle_ref.Handle.Handle = file->Handle;
+			LS_IORING_BUFFER_REF buffer_ref{ LS_IORING_REF_RAW };
+			buffer_ref.Buffer.Address = file->Buffer.data();
+
+			// Checked again under the lock, a failed submission can move the run to the pool meanwhile.
+			HRESULT h_result = S_OK;
+			AcquireSRWLockExclusive(&_ring_lock);
+			bool on_ring = _backend == CorpusBackendIoRing;
+			if (on_ring) {
+				h_result = IoRingApi.BuildReadFile(_ring, handle_ref, buffer_ref, size, file->Offset, reinterpret_cast<UINT_PTR>(file), 0);
+				if (SUCCEEDED(h_result))
+					_ring_built.push_back(file);
+			}
+
+			ReleaseSRWLockExclusive(&_ring_lock);
+			if (on_ring) {
+				if (FAILED(h_result)) {
+					file->Result = GetWin32Error(h_result);
+					Complete(file);
+					return;
+				}
+
+				InterlockedIncrement(&_ring_queued);
+				SubmitRing();
+
+				return;
+			}
+		}
+
+		// Files opened while the ring was in use get their completion here, on their first pool read.
+		if (file->Io == NULL) {
+			file->Io = CreateThreadpoolIo(file->Handle, OnIoCompletion, file, &_callback_environ);
+			if (file->Io == NULL) {
+				file->Result = GetLastError();
+				Complete(file);
+				return;
+			}
+		}
+
+		file->Overlapped = OVERLAPPED();
+		file->Overlapped.Offset = static_cast<DWORD>(file->Offset);
+		file->Overlapped.OffsetHigh = static_cast<DWORD>(file->Offset >> 32);
+
+		StartThreadpoolIo(file->Io);
+		if (!ReadFile(file->Handle, file->Buffer.data(), size, NULL, &file->Overlapped)) {
+			DWORD last_error = GetLastError();
+			if (last_error != ERROR_IO_PENDING) {
+				CancelThreadpoolIo(file->Io);
+				file->Result = last_error;
+				Complete(file);
+			}
+		}
+	}
+
+	void CorpusPipeline::Parse(PLS_CORPUS_FILE file) noexcept
+	{
+		// Files already being read finish their read, but don't start another.
+		if (file->Result == ERROR_SUCCESS && _token != NULL) {
+			LS_WORK_STOP stop_reason = _token->Check();
+			if (stop_reason != WorkStopNone)
+				file->Result = GetStopError(stop_reason);
+		}
+
+		if (file->Result == ERROR_SUCCESS && _parser->OnRead(*file, file->Buffer.data(), file->BytesRead) && file->Result == ERROR_SUCCESS) {
+			IssueRead(file);
+			return;
+		}
+
+		Complete(file);
+	}
+
+	void CorpusPipeline::Complete(PLS_CORPUS_FILE file) noexcept
+	{
+		_parser->OnComplete(*file);
+
+		if (file->Handle != INVALID_HANDLE_VALUE)
+			CloseHandle(file->Handle);
+
+		// Safe from the file's own completion callback, it's released once the callback returns.
+		if (file->Io != NULL)
+			CloseThreadpoolIo(file->Io);
+
+		delete file;
+
+		ReleaseSemaphore(_slots, 1, NULL);
+		if (InterlockedDecrement(&_pending) == 0)
+			SetEvent(_done);
+	}
+
+	VOID CALLBACK CorpusPipeline::OnOpen(PTP_CALLBACK_INSTANCE instance, PVOID context)
+	{
+		UNREFERENCED_PARAMETER(instance);
+
+		PLS_CORPUS_FILE file = static_cast<PLS_CORPUS_FILE>(context);
+		CorpusPipeline* pipeline = file->Pipeline;
+
+		// There's no open operation on the ring. Opens are cheap next to the reads, but they block,
+		// so they run here, and not on the thread queuing the files.
+		file->Handle = CreateFile(file->Path->GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (file->Handle == INVALID_HANDLE_VALUE) {
+			file->Result = GetLastError();
+			pipeline->Complete(file);
+			return;
+		}
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file->Handle, &file_size)) {
+			file->Result = GetLastError();
+			pipeline->Complete(file);
+			return;
+		}
+
+		file->FileSize = static_cast<ULONGLONG>(file_size.QuadPart);
+		pipeline->IssueRead(file);
+	}
+
+	VOID CALLBACK CorpusPipeline::OnParse(PTP_CALLBACK_INSTANCE instance, PVOID context)
+	{
+		UNREFERENCED_PARAMETER(instance);
+
+		PLS_CORPUS_FILE file = static_cast<PLS_CORPUS_FILE>(context);
+		file->Pipeline->Parse(file);
+	}
+
+	VOID CALLBACK CorpusPipeline::OnIoCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG io_result, ULONG_PTR bytes_transferred, PTP_IO io)
+	{
+		UNREFERENCED_PARAMETER(instance);
+		UNREFERENCED_PARAMETER(overlapped);
+		UNREFERENCED_PARAMETER(io);
+
+		// Already on the pool, parsing right here.
+		PLS_CORPUS_FILE file = static_cast<PLS_CORPUS_FILE>(context);
+		file->Result = io_result == ERROR_HANDLE_EOF ? ERROR_SUCCESS : io_result;
+		file->BytesRead = static_cast<DWORD>(bytes_transferred);
+		file->Pipeline->Parse(file);
+	}
+
+	VOID CALLBACK CorpusPipeline::OnRingCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WAIT wait, TP_WAIT_RESULT wait_result)
+	{
+		UNREFERENCED_PARAMETER(instance);
+		UNREFERENCED_PARAMETER(wait_result);
+
+		// Only this callback pops, and it doesn't run twice at once. Parsing goes to
+		// other threads, so the ring is drained as fast as the device fills it.
+		CorpusPipeline* pipeline = static_cast<CorpusPipeline*>(context);
+		LS_IORING_CQE cqe;
+		while (IoRingApi.PopCompletion(pipeline->_ring, &cqe) == S_OK) {
+			PLS_CORPUS_FILE file = reinterpret_cast<PLS_CORPUS_FILE>(cqe.UserData);
+			file->Result = GetWin32Error(cqe.ResultCode);
+			file->BytesRead = static_cast<DWORD>(cqe.Information);
+			if (!TrySubmitThreadpoolCallback(OnParse, file, &pipeline->_callback_environ))
+				pipeline->Parse(file);
+		}
+
+		// The event is auto-reset. Completions that came after the last pop left it signaled.
+		SetThreadpoolWait(wait, pipeline->_ring_event, NULL);
+	}
+}
\ No newline at end of file
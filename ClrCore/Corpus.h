@@ -0,0 +1,137 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Budget.h"
+
+namespace LibSnitcher::Core
+{
+	// Files open, or being read, at once. Also the IoRing submission queue size.
+	#define LS_CORPUS_QUEUE_DEPTH 64
+
+	typedef enum _LS_CORPUS_BACKEND
+	{
+		// Windows 11 IoRing. Reads are queued in batches, and completions popped from the ring.
+		CorpusBackendIoRing,
+
+		// Overlapped reads, completed on the thread pool.
+		CorpusBackendThreadPool
+
+	} LS_CORPUS_BACKEND;
+
+	class CorpusPipeline;
+
+	// A file going through the pipeline. 'Offset', and 'Size' are the read in flight, or the one
+	// that just completed. For a follow-up read, the parser sets them, and returns true.
+	typedef struct _LS_CORPUS_FILE
+	{
+		DWORD Index;
+		const WWuString* Path;
+		ULONGLONG FileSize;
+		LONG Result;
+
+		// Free for the parser. Zero on the first read.
+		DWORD Stage;
+
+		ULONGLONG Offset;
+		DWORD Size;
+
+		// Owned by the pipeline.
+		CorpusPipeline* Pipeline;
+		HANDLE Handle;
+		PTP_IO Io;
+		OVERLAPPED Overlapped;
+		DWORD BytesRead;
+		wuvector<BYTE> Buffer;
+
+		_LS_CORPUS_FILE()
+			: Index(0), Path(NULL), FileSize(0), Result(ERROR_SUCCESS), Stage(0), Offset(0), Size(0),
+				Pipeline(NULL), Handle(INVALID_HANDLE_VALUE), Io(NULL), Overlapped(), BytesRead(0) { }
+
+		~_LS_CORPUS_FILE() { }
+
+	} LS_CORPUS_FILE, *PLS_CORPUS_FILE;
+
+	// What the pipeline does with the bytes. Calls for different files run in parallel,
+	// calls for the same file one at a time.
+	class CorpusParser
+	{
+	public:
+		virtual ~CorpusParser() { }
+
+		// The first read of every file, from offset zero. Files smaller than that get what they have.
+		virtual DWORD FirstReadSize() const noexcept = 0;
+
+		// 'data' is valid until the call returns. Return true after setting 'file.Offset', and
+		// 'file.Size' for another read of the same file, false when the file is done.
+		// Failures go in 'file.Result'.
+		virtual bool OnRead(LS_CORPUS_FILE& file, const BYTE* data, DWORD size) = 0;
+
+		// Once per file, after the last read, or when it fails to open, or read.
+		virtual void OnComplete(const LS_CORPUS_FILE& file) { UNREFERENCED_PARAMETER(file); }
+	};
+
+	// Reads a corpus with the device queue kept full. Opens run on the pool, reads are queued on an
+	// IoRing when the system has one, or issued overlapped on the thread pool otherwise, and each
+	// completion is parsed on the pool as it arrives. Follow-up reads go back to the same queue.
+	// At most 'queue_depth' files are in flight. Past that, 'Run' waits for one to finish before
+	// opening the next, so buffers, and handles stay bounded however large the corpus is.
+	class CorpusPipeline
+	{
+	public:
+		// Zero threads means one per processor.
+		CorpusPipeline(DWORD queue_depth = LS_CORPUS_QUEUE_DEPTH, DWORD thread_count = 0);
+		~CorpusPipeline();
+
+		// Returns once every file completed. Per file failures go to the parser. Once 'token' is cancelled,
+		// or past its deadline, files complete with 'ERROR_CANCELLED', or 'ERROR_TIMEOUT' before their next read.
+		// One run at a time.
+		const LSRESULT Run(const wuvector<WWuString>& file_paths, CorpusParser& parser, const CancellationToken* token = NULL);
+
+		_NODISCARD LS_CORPUS_BACKEND Backend() const noexcept { return _backend; }
+
+	private:
+		DWORD _queue_depth;
+		DWORD _thread_count;
+		LS_CORPUS_BACKEND _backend;
+		CorpusParser* _parser;
+		const CancellationToken* _token;
+
+		PTP_POOL _pool;
+		PTP_CLEANUP_GROUP _cleanup_group;
+		TP_CALLBACK_ENVIRON _callback_environ;
+
+		// Released when a file completes, taken before one is opened.
+		HANDLE _slots;
+		HANDLE _done;
+		volatile LONG _pending;
+
+		// The ring, and its completion wait. Building, and submitting entries isn't thread-safe,
+		// '_ring_lock' guards both. Whoever holds '_submit_lock' submits what the others built.
+		// '_ring_built' has the files with an entry built, and not submitted yet, in build order.
+		// A failed submission moves '_backend' to the pool for the rest of the run, under the lock.
+		PVOID _ring;
+		HANDLE _ring_event;
+		PTP_WAIT _ring_wait;
+		SRWLOCK _ring_lock;
+		SRWLOCK _submit_lock;
+		volatile LONG _ring_queued;
+		wuvector<PLS_CORPUS_FILE> _ring_built;
+
+		bool StartIoRing() noexcept;
+		void StopIoRing() noexcept;
+		void SubmitRing() noexcept;
+		void Release() noexcept;
+
+		void IssueRead(PLS_CORPUS_FILE file) noexcept;
+		void Parse(PLS_CORPUS_FILE file) noexcept;
+		void Complete(PLS_CORPUS_FILE file) noexcept;
+
+		static VOID CALLBACK OnOpen(PTP_CALLBACK_INSTANCE instance, PVOID context);
+		static VOID CALLBACK OnParse(PTP_CALLBACK_INSTANCE instance, PVOID context);
+		static VOID CALLBACK OnIoCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PVOID overlapped, ULONG io_result, ULONG_PTR bytes_transferred, PTP_IO io);
+		static VOID CALLBACK OnRingCompletion(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WAIT wait, TP_WAIT_RESULT wait_result);
+	};
+}
\ No newline at end of file
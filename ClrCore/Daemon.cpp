@@ -0,0 +1,482 @@
+#include "pch.h"
+
+#include "Daemon.h"
+
+#include <afunix.h>
+
+namespace LibSnitcher::Core
+{
+	typedef struct _LS_DAEMON_CONNECTION
+	{
+		ResolverDaemon* Daemon;
+		SOCKET Client;
+
+	} LS_DAEMON_CONNECTION, *PLS_DAEMON_CONNECTION;
+
+	// Strings are referenced by byte offset into this table.
+	class StringTable
+	{
+	public:
+		DWORD Add(const WWuString& str)
+		{
+			DWORD offset = Size();
+			const WCHAR* buffer = str.GetBuffer();
+			_strings.insert(_strings.end(), buffer, buffer + str.Length() + 1);
+
+			return offset;
+		}
+
+		_NODISCARD DWORD Size() const noexcept { return static_cast<DWORD>(_strings.size() * sizeof(WCHAR)); }
+		_NODISCARD const WCHAR* Data() const noexcept { return _strings.data(); }
+
+	private:
+		wuvector<WCHAR> _strings;
+	};
+
+	static void AppendBytes(wuvector<BYTE>& payload, const void* data, size_t size)
+	{
+		const BYTE* bytes = static_cast<const BYTE*>(data);
+		payload.insert(payload.end(), bytes, bytes + size);
+	}
+
+	static bool ReceiveAll(SOCKET client, void* buffer, size_t size) noexcept
+	{
+		char* position = static_cast<char*>(buffer);
+		while (size > 0) {
+			int received = recv(client, position, static_cast<int>(min(size, static_cast<size_t>(INT_MAX))), 0);
+			if (received <= 0)
+				return false;
+
+			position += received;
+			size -= received;
+		}
+
+		return true;
+	}
+
+	static bool SendAll(SOCKET client, const void* buffer, size_t size) noexcept
+	{
+		const char* position = static_cast<const char*>(buffer);
+		while (size > 0) {
+			int sent = send(client, position, static_cast<int>(min(size, static_cast<size_t>(INT_MAX))), 0);
+			if (sent == SOCKET_ERROR)
+				return false;
+
+			position += sent;
+			size -= sent;
+		}
+
+		return true;
+	}
+
+	// Only removes what a previous instance left behind: a socket file nobody is listening on.
+	// Anything else at the path, a regular file, or a live daemon, is an error.
+	static LSRESULT RemoveStaleSocket(const WWuString& socket_path, const SOCKADDR_UN& address)
+	{
+		WIN32_FIND_DATA find_data;
+		HANDLE h_find = FindFirstFile(socket_path.GetBuffer(), &find_data);
+		if (h_find == INVALID_HANDLE_VALUE) {
+			DWORD error = GetLastError();
+			if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+				return LSRESULT();
+
+			return LSRESULT(error, __FILEW__, __LINE__);
+		}
+
+		FindClose(h_find);
+
+		// For reparse points 'dwReserved0' is the tag.
+		if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0 || find_data.dwReserved0 != IO_REPARSE_TAG_AF_UNIX)
+			return LSRESULT(ERROR_FILE_EXISTS, L"A file that is not a socket exists at the socket path.", __FILEW__, __LINE__);
+
+		SOCKET probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (probe == INVALID_SOCKET)
+			return LSRESULT(WSAGetLastError(), __FILEW__, __LINE__);
+
+		bool listening = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR;
+		closesocket(probe);
+		if (listening)
+			return LSRESULT(WSAEADDRINUSE, L"Another daemon is listening on the socket path.", __FILEW__, __LINE__);
+
+		if (!DeleteFile(socket_path.GetBuffer()))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+
+	ResolverDaemon::ResolverDaemon(const WWuString& sysroot)
+		: _listener(INVALID_SOCKET), _accept_thread(NULL), _running(0), _sxs(sysroot),
+			_invalidator(&_index, &_cache, &_chains),
+			_watcher(&_invalidator), _pool(NULL), _cleanup_group(NULL)
+	{
+		InitializeSRWLock(&_clients_lock);
+	}
+
+	ResolverDaemon::~ResolverDaemon()
+	{
+		Stop();
+	}
+
+	const LSRESULT ResolverDaemon::Start(const WWuString& socket_path)
+	{
+		if (_running != 0)
+			return LSRESULT(ERROR_ALREADY_INITIALIZED, __FILEW__, __LINE__);
+
+		WuString narrow_path = WWuStringToNarrow(socket_path);
+		SOCKADDR_UN address = { 0 };
+		if (narrow_path.Length() >= sizeof(address.sun_path))
+			return LSRESULT(ERROR_FILENAME_EXCED_RANGE, L"Socket path is too long.", __FILEW__, __LINE__);
+
+		address.sun_family = AF_UNIX;
+		strcpy_s(address.sun_path, narrow_path.GetBuffer());
+
+		WSADATA wsa_data;
+		int wsa_result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
+		if (wsa_result != 0)
+			return LSRESULT(wsa_result, __FILEW__, __LINE__);
+
+		_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (_listener == INVALID_SOCKET) {
+			LSRESULT result(WSAGetLastError(), __FILEW__, __LINE__);
+			WSACleanup();
+			return result;
+		}
+
+		// A previous instance might have left the socket file behind.
+		LSRESULT stale_result = RemoveStaleSocket(socket_path, address);
+		if (stale_result.Result != ERROR_SUCCESS) {
+			closesocket(_listener);
+			_listener = INVALID_SOCKET;
+			WSACleanup();
+			return stale_result;
+		}
+
+		if (bind(_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+			listen(_listener, SOMAXCONN) == SOCKET_ERROR)
+		{
+			LSRESULT result(WSAGetLastError(), __FILEW__, __LINE__);
+			closesocket(_listener);
+			_listener = INVALID_SOCKET;
+			WSACleanup();
+			return result;
+		}
+
+		_pool = CreateThreadpool(NULL);
+		_cleanup_group = CreateThreadpoolCleanupGroup();
+		if (_pool == NULL || _cleanup_group == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			if (_cleanup_group != NULL)
+				CloseThreadpoolCleanupGroup(_cleanup_group);
+			if (_pool != NULL)
+				CloseThreadpool(_pool);
+
+			_pool = NULL;
+			_cleanup_group = NULL;
+			closesocket(_listener);
+			_listener = INVALID_SOCKET;
+			WSACleanup();
+			return result;
+		}
+
+		InitializeThreadpoolEnvironment(&_callback_environ);
+		SetThreadpoolCallbackPool(&_callback_environ, _pool);
+		SetThreadpoolCallbackCleanupGroup(&_callback_environ, _cleanup_group, NULL);
+
+		// Directories that fail to be watched, like PATH entries that don't exist,
+		// are still searched. Chains reaching into them are just not cached.
+		for (const WWuString& directory : _index.GetSystemSearchOrder(false))
+			_watcher.Watch(directory);
+		for (const WWuString& directory : _index.GetSystemSearchOrder(true))
+			_watcher.Watch(directory);
+
+		_socket_path = socket_path;
+		_running = 1;
+		_accept_thread = CreateThread(NULL, 0, AcceptLoop, this, 0, NULL);
+		if (_accept_thread == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Stop();
+			return result;
+		}
+
+		return LSRESULT();
+	}
+
+	void ResolverDaemon::Stop() noexcept
+	{
+		if (InterlockedExchange(&_running, 0) == 0)
+			return;
+
+		// Closing the listener unblocks 'accept'.
+		closesocket(_listener);
+		_listener = INVALID_SOCKET;
+		if (_accept_thread != NULL) {
+			WaitForSingleObject(_accept_thread, INFINITE);
+			CloseHandle(_accept_thread);
+			_accept_thread = NULL;
+		}
+
+		// Clients close their own sockets once 'recv' returns.
+		AcquireSRWLockShared(&_clients_lock);
+		for (SOCKET client : _clients)
+			shutdown(client, SD_BOTH);
+		ReleaseSRWLockShared(&_clients_lock);
+
+		CloseThreadpoolCleanupGroupMembers(_cleanup_group, FALSE, NULL);
+		CloseThreadpoolCleanupGroup(_cleanup_group);
+		CloseThreadpool(_pool);
+		DestroyThreadpoolEnvironment(&_callback_environ);
+		_cleanup_group = NULL;
+		_pool = NULL;
+
+		_watcher.UnwatchAll();
+		_chains.Clear();
+
+		DeleteFile(_socket_path.GetBuffer());
+		WSACleanup();
+	}
+
+	DWORD WINAPI ResolverDaemon::AcceptLoop(LPVOID context)
+	{
+		ResolverDaemon* daemon = static_cast<ResolverDaemon*>(context);
+		while (daemon->_running != 0) {
+			SOCKET client = accept(daemon->_listener, NULL, NULL);
+			if (client == INVALID_SOCKET) {
+				int error = WSAGetLastError();
+				if (daemon->_running != 0 && (error == WSAECONNRESET || error == WSAEINTR))
+					continue;
+
+				break;
+			}
+
+			AcquireSRWLockExclusive(&daemon->_clients_lock);
+			daemon->_clients.push_back(client);
+			ReleaseSRWLockExclusive(&daemon->_clients_lock);
+
+			PLS_DAEMON_CONNECTION connection = new LS_DAEMON_CONNECTION{ daemon, client };
+			if (!TrySubmitThreadpoolCallback(ServeConnection, connection, &daemon->_callback_environ)) {
+				daemon->RemoveClient(client);
+				delete connection;
+			}
+		}
+
+		return 0;
+	}
+
+	VOID CALLBACK ResolverDaemon::ServeConnection(PTP_CALLBACK_INSTANCE instance, PVOID context)
+	{
+		UNREFERENCED_PARAMETER(instance);
+
+		PLS_DAEMON_CONNECTION connection = static_cast<PLS_DAEMON_CONNECTION>(context);
+		while (connection->Daemon->HandleRequest(connection->Client));
+
+		connection->Daemon->RemoveClient(connection->Client);
+		delete connection;
+	}
+
+	bool ResolverDaemon::HandleRequest(SOCKET client)
+	{
+		LS_DAEMON_REQUEST_HEADER request;
+		if (!ReceiveAll(client, &request, sizeof(request)))
+			return false;
+
+		// Malformed requests drop the connection, we can't tell where the next one starts.
+		if (request.Magic != LS_DAEMON_REQUEST_MAGIC ||
+			request.Version != LS_DAEMON_PROTOCOL_VERSION ||
+			request.NameSize > LS_DAEMON_MAX_NAME_SIZE ||
+			request.NameSize % sizeof(WCHAR) != 0)
+			return false;
+
+		wuvector<WCHAR> name_buffer(request.NameSize / sizeof(WCHAR) + 1, L'\0');
+		if (request.NameSize > 0 && !ReceiveAll(client, name_buffer.data(), request.NameSize))
+			return false;
+
+		WWuString name(name_buffer.data());
+		wuvector<BYTE> payload;
+		LONG result;
+		try {
+			switch (request.Opcode) {
+				case DaemonOpChain:
+					result = QueryChain(name, request.MaxDepth, payload);
+					break;
+
+				case DaemonOpHeaders:
+					result = QueryHeaders(name, payload);
+					break;
+
+				case DaemonOpReverseDependencies:
+					result = QueryReverseDependencies(name, payload);
+					break;
+
+				default:
+					result = ERROR_INVALID_FUNCTION;
+					break;
+			}
+		}
+		catch (...) {
+			payload.clear();
+			result = ERROR_NOT_ENOUGH_MEMORY;
+		}
+
+		LS_DAEMON_RESPONSE_HEADER response = { LS_DAEMON_RESPONSE_MAGIC, result, static_cast<DWORD>(payload.size()) };
+		if (!SendAll(client, &response, sizeof(response)))
+			return false;
+
+		return payload.empty() || SendAll(client, payload.data(), payload.size());
+	}
+
+	LONG ResolverDaemon::QueryChain(const WWuString& name, DWORD max_depth, wuvector<BYTE>& payload)
+	{
+		WWuString key = ChainCache::MakeKey(name, max_depth);
+		LS_CACHED_CHAIN cached;
+		ULONGLONG generation;
+		bool found = _chains.Lookup(key, cached, generation);
+		if (found && cached.Dirty.empty()) {
+			SerializeChain(*cached.Graph, payload);
+			return ERROR_SUCCESS;
+		}
+
+		// The application directory has to be watched before we resolve, or we could miss a change.
+		Resolver resolver(&_index, &_cache, NULL, false, &_sxs);
+		WWuString root_path;
+		if (resolver.FindModule(name, WWuString(), false, root_path)) {
+			PathCchRemoveFileSpec(root_path.GetBuffer(), root_path.Length() + 1);
+			_watcher.Watch(root_path);
+		}
+
+		wushared_ptr<LS_RESOLVED_GRAPH> graph = make_wushared<LS_RESOLVED_GRAPH>();
+		LSRESULT result = found ? resolver.ResolveChain(name, max_depth, graph.get(), cached.Graph.get(), &cached.Dirty)
+			: resolver.ResolveChain(name, max_depth, graph.get());
+
+		if (result.Result != ERROR_SUCCESS)
+			return result.Result;
+
+		if (IsWatched(*graph))
+			_chains.Insert(key, graph, generation);
+
+		SerializeChain(*graph, payload);
+
+		return ERROR_SUCCESS;
+	}
+
+	LONG ResolverDaemon::QueryHeaders(const WWuString& name, wuvector<BYTE>& payload)
+	{
+		Resolver resolver(&_index, &_cache, NULL, false, &_sxs);
+		WWuString image_path;
+		if (!resolver.FindModule(name, WWuString(), false, image_path))
+			return ERROR_MOD_NOT_FOUND;
+
+		wushared_ptr<LS_CACHED_IMAGE> image;
+		LSRESULT result = resolver.GetImage(image_path, 0, image);
+		if (result.Result != ERROR_SUCCESS)
+			return result.Result;
+
+		StringTable strings;
+		wuvector<DWORD> dependencies;
+		DWORD path_offset = strings.Add(image->Path);
+		for (WuString& dependency : image->BasicInfo.Dependencies)
+			dependencies.push_back(strings.Add(WuStringToWide(dependency)));
+
+		LS_DAEMON_HEADERS headers = {
+			image->Result,
+			image->Machine,
+			image->Magic,
+			image->Characteristics,
+			image->Subsystem,
+			image->TimeDateStamp,
+			image->SizeOfImage,
+			image->CheckSum,
+			image->BasicInfo.IsClr ? static_cast<DWORD>(LS_DAEMON_NODE_FLAG_CLR) : 0,
+			path_offset,
+			static_cast<DWORD>(dependencies.size()),
+			strings.Size()
+		};
+
+		AppendBytes(payload, &headers, sizeof(headers));
+		AppendBytes(payload, dependencies.data(), dependencies.size() * sizeof(DWORD));
+		AppendBytes(payload, strings.Data(), strings.Size());
+
+		return ERROR_SUCCESS;
+	}
+
+	LONG ResolverDaemon::QueryReverseDependencies(const WWuString& name, wuvector<BYTE>& payload)
+	{
+		// Module names are matched as imported, so we strip any directory.
+		WWuString module_name(PathFindFileName(name.GetBuffer()));
+		wuvector<WWuString> importers;
+		_cache.GetReverseDependencies(module_name, importers);
+
+		StringTable strings;
+		wuvector<DWORD> offsets;
+		for (WWuString& importer : importers)
+			offsets.push_back(strings.Add(importer));
+
+		LS_DAEMON_NAME_LIST list = { static_cast<DWORD>(offsets.size()), strings.Size() };
+		AppendBytes(payload, &list, sizeof(list));
+		AppendBytes(payload, offsets.data(), offsets.size() * sizeof(DWORD));
+		AppendBytes(payload, strings.Data(), strings.Size());
+
+		return ERROR_SUCCESS;
+	}
+
+	bool ResolverDaemon::IsWatched(const LS_RESOLVED_GRAPH& graph)
+	{
+		// Missing modules could show up in any search directory.
+		for (bool wow64 : { false, true }) {
+			for (const WWuString& directory : _index.GetSystemSearchOrder(wow64)) {
+				if (!_watcher.IsWatching(directory))
+					return false;
+			}
+		}
+
+		for (const LS_RESOLVED_NODE& node : graph.Nodes) {
+			if (WWuString::IsNullOrEmpty(node.Path))
+				continue;
+
+			WWuString directory(node.Path);
+			PathCchRemoveFileSpec(directory.GetBuffer(), directory.Length() + 1);
+			if (!_watcher.IsWatching(directory))
+				return false;
+		}
+
+		return true;
+	}
+
+	void ResolverDaemon::SerializeChain(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& payload)
+	{
+		StringTable strings;
+		wuvector<LS_DAEMON_NODE> nodes;
+		nodes.reserve(graph.Nodes.size());
+		for (const LS_RESOLVED_NODE& node : graph.Nodes) {
+			DWORD flags = 0;
+			if (node.Image != nullptr && node.Image->BasicInfo.IsClr)
+				flags |= LS_DAEMON_NODE_FLAG_CLR;
+
+			nodes.push_back({ strings.Add(node.Name), strings.Add(node.Path), node.Depth, node.Result, flags });
+		}
+
+		LS_DAEMON_CHAIN chain = { static_cast<DWORD>(graph.Nodes.size()), static_cast<DWORD>(graph.Edges.size()), strings.Size() };
+		payload.reserve(sizeof(chain) + (nodes.size() * sizeof(LS_DAEMON_NODE)) + (graph.Edges.size() * sizeof(LS_DAEMON_EDGE)) + strings.Size());
+		AppendBytes(payload, &chain, sizeof(chain));
+		AppendBytes(payload, nodes.data(), nodes.size() * sizeof(LS_DAEMON_NODE));
+		for (const LS_RESOLVED_EDGE& edge : graph.Edges) {
+			LS_DAEMON_EDGE wire_edge = { edge.From, edge.To };
+			AppendBytes(payload, &wire_edge, sizeof(wire_edge));
+		}
+
+		AppendBytes(payload, strings.Data(), strings.Size());
+	}
+
+	void ResolverDaemon::RemoveClient(SOCKET client) noexcept
+	{
+		AcquireSRWLockExclusive(&_clients_lock);
+		for (auto it = _clients.begin(); it != _clients.end(); it++) {
+			if (*it == client) {
+				_clients.erase(it);
+				break;
+			}
+		}
+		ReleaseSRWLockExclusive(&_clients_lock);
+
+		closesocket(client);
+	}
+}
\ No newline at end of file
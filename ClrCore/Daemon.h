@@ -0,0 +1,168 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Resolver.h"
+#include "Invalidation.h"
+
+#include <WinSock2.h>
+
+namespace LibSnitcher::Core
+{
+	///////////////////////////////////////////////////////////////////////////
+	//
+	//  ~ Resolver daemon wire protocol.
+	//
+	// ------------------------------------------------------------------------
+	//
+	//  All integers are little endian, and strings are UTF-16LE.
+	//  A client sends a request header followed by 'NameSize' bytes of name,
+	//  and the daemon answers with a response header followed by 'PayloadSize'
+	//  bytes of payload. A connection can carry any number of requests.
+	//
+	//  Payloads reference strings by byte offset into a string table that
+	//  closes the payload. Every string is null terminated.
+	//
+	//  Chain:       LS_DAEMON_CHAIN, nodes, edges, string table.
+	//  Headers:     LS_DAEMON_HEADERS, dependency name offsets, string table.
+	//  ReverseDeps: LS_DAEMON_NAME_LIST, path offsets, string table.
+	//
+	///////////////////////////////////////////////////////////////////////////
+
+	#define LS_DAEMON_REQUEST_MAGIC 0x5144534C		// 'LSDQ'
+	#define LS_DAEMON_RESPONSE_MAGIC 0x5244534C		// 'LSDR'
+	#define LS_DAEMON_PROTOCOL_VERSION 1
+	#define LS_DAEMON_MAX_NAME_SIZE 65534
+
+	#define LS_DAEMON_NODE_FLAG_CLR 0x1
+
+	typedef enum _LS_DAEMON_OPCODE : WORD
+	{
+		DaemonOpChain = 1,
+		DaemonOpHeaders,
+		DaemonOpReverseDependencies
+	} LS_DAEMON_OPCODE;
+
+#pragma pack(push, 1)
+
+	typedef struct _LS_DAEMON_REQUEST_HEADER
+	{
+		DWORD Magic;
+		WORD Version;
+		WORD Opcode;
+		DWORD MaxDepth;
+		DWORD NameSize;
+
+	} LS_DAEMON_REQUEST_HEADER, *PLS_DAEMON_REQUEST_HEADER;
+
+	typedef struct _LS_DAEMON_RESPONSE_HEADER
+	{
+		DWORD Magic;
+		LONG Result;
+		DWORD PayloadSize;
+
+	} LS_DAEMON_RESPONSE_HEADER, *PLS_DAEMON_RESPONSE_HEADER;
+
+	typedef struct _LS_DAEMON_CHAIN
+	{
+		DWORD NodeCount;
+		DWORD EdgeCount;
+		DWORD StringTableSize;
+
+	} LS_DAEMON_CHAIN, *PLS_DAEMON_CHAIN;
+
+	typedef struct _LS_DAEMON_NODE
+	{
+		DWORD NameOffset;
+		DWORD PathOffset;
+		DWORD Depth;
+		LONG Result;
+		DWORD Flags;
+
+	} LS_DAEMON_NODE, *PLS_DAEMON_NODE;
+
+	typedef struct _LS_DAEMON_EDGE
+	{
+		DWORD From;
+		DWORD To;
+
+	} LS_DAEMON_EDGE, *PLS_DAEMON_EDGE;
+
+	typedef struct _LS_DAEMON_HEADERS
+	{
+		LONG Result;
+		WORD Machine;
+		WORD Magic;
+		WORD Characteristics;
+		WORD Subsystem;
+		DWORD TimeDateStamp;
+		DWORD SizeOfImage;
+		DWORD CheckSum;
+		DWORD Flags;
+		DWORD PathOffset;
+		DWORD DependencyCount;
+		DWORD StringTableSize;
+
+	} LS_DAEMON_HEADERS, *PLS_DAEMON_HEADERS;
+
+	typedef struct _LS_DAEMON_NAME_LIST
+	{
+		DWORD Count;
+		DWORD StringTableSize;
+
+	} LS_DAEMON_NAME_LIST, *PLS_DAEMON_NAME_LIST;
+
+#pragma pack(pop)
+
+	// Long running resolver. Keeps the image cache and the directory index warm,
+	// and answers queries over a Unix domain socket.
+	// Each connection is served from the thread pool.
+	// The search directories are watched, so resolved chains are served from
+	// memory until something they depend on changes on disk.
+	class ResolverDaemon
+	{
+	public:
+		// 'sysroot' is the Windows directory the WinSxS store is read from.
+		ResolverDaemon(const WWuString& sysroot);
+		~ResolverDaemon();
+
+		const LSRESULT Start(const WWuString& socket_path);
+		void Stop() noexcept;
+
+		_NODISCARD ImageCache* GetCache() noexcept { return &_cache; }
+		_NODISCARD DirectoryIndex* GetIndex() noexcept { return &_index; }
+		_NODISCARD ChainCache* GetChains() noexcept { return &_chains; }
+
+	private:
+		SOCKET _listener;
+		HANDLE _accept_thread;
+		volatile LONG _running;
+		WWuString _socket_path;
+		DirectoryIndex _index;
+		ImageCache _cache;
+		SxsStoreIndex _sxs;
+		ChainCache _chains;
+
+		// Declared after the caches, so watching stops before they are destroyed.
+		CacheInvalidator _invalidator;
+		DirectoryChangeWatcher _watcher;
+		SRWLOCK _clients_lock;
+		wuvector<SOCKET> _clients;
+		PTP_POOL _pool;
+		PTP_CLEANUP_GROUP _cleanup_group;
+		TP_CALLBACK_ENVIRON _callback_environ;
+
+		static DWORD WINAPI AcceptLoop(LPVOID context);
+		static VOID CALLBACK ServeConnection(PTP_CALLBACK_INSTANCE instance, PVOID context);
+
+		bool HandleRequest(SOCKET client);
+		LONG QueryChain(const WWuString& name, DWORD max_depth, wuvector<BYTE>& payload);
+		LONG QueryHeaders(const WWuString& name, wuvector<BYTE>& payload);
+		LONG QueryReverseDependencies(const WWuString& name, wuvector<BYTE>& payload);
+		bool IsWatched(const LS_RESOLVED_GRAPH& graph);
+		static void SerializeChain(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& payload);
+		void RemoveClient(SOCKET client) noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include "pch.h"
+
+#include "DebugDirectory.h"
+#include "Corpus.h"
+
+namespace LibSnitcher::Core
+{
+	// Headers are almost always in the first page. If the section table isn't, we read it separately.
+	static constexpr DWORD HeaderReadSize = 0x1000;
+
+	// Upper bounds for the entry data we read. Real records are much smaller.
+	static constexpr DWORD MaxDebugEntries = 64;
+	static constexpr DWORD MaxCodeViewSize = 0x1000;
+	static constexpr DWORD MaxPogoSize = 0x100000;
+
+	// What a symbol key read is waiting for. Past 'SymbolStageCodeView' the stage is the directory entry index too.
+	static constexpr DWORD SymbolStageHeaders = 0;
+	static constexpr DWORD SymbolStageDirectory = 1;
+	static constexpr DWORD SymbolStageCodeView = 2;
+
+	// The headers, the directory, and the CodeView records of a corpus, each one read
+	// as soon as the previous one completes, without a thread waiting on any of them.
+	class SymbolKeyParser : public CorpusParser
+	{
+	public:
+		SymbolKeyParser(wuvector<LS_SYMBOL_KEY>& keys)
+			: _keys(keys), _directories(keys.size()) { }
+
+		~SymbolKeyParser() { }
+
+		DWORD FirstReadSize() const noexcept override { return HeaderReadSize; }
+
+		bool OnRead(LS_CORPUS_FILE& file, const BYTE* data, DWORD size) override
+		{
+			wuvector<IMAGE_DEBUG_DIRECTORY>& directory = _directories[file.Index];
+			switch (file.Stage) {
+				case SymbolStageHeaders:
+				{
+					DWORD required;
+					ULONGLONG directory_offset;
+					DWORD entry_count;
+					LSRESULT result = DebugDirectoryReader::LocateDirectory(data, size, file.FileSize, required, directory_offset, entry_count);
+					if (result.Result != ERROR_SUCCESS) {
+						file.Result = result.Result;
+						return false;
+					}
+
+					// The section table is past the first page. Reading the headers again, up to its end.
+					// If we already did, the file shrank since it was opened.
+					if (required != 0) {
+						if (required <= file.Size) {
+							file.Result = ERROR_HANDLE_EOF;
+							return false;
+						}
+
+						file.Offset = 0;
+						file.Size = required;
+						return true;
+					}
+
+					if (entry_count == 0) {
+						file.Result = ERROR_NOT_FOUND;
+						return false;
+					}
+
+					file.Stage = SymbolStageDirectory;
+					file.Offset = directory_offset;
+					file.Size = entry_count * sizeof(IMAGE_DEBUG_DIRECTORY);
+					return true;
+				}
+
+				case SymbolStageDirectory:
+				{
+					if (size < file.Size) {
+						file.Result = ERROR_HANDLE_EOF;
+						return false;
+					}
+
+					const IMAGE_DEBUG_DIRECTORY* entries = reinterpret_cast<const IMAGE_DEBUG_DIRECTORY*>(data);
+					directory.assign(entries, entries + size / sizeof(IMAGE_DEBUG_DIRECTORY));
+
+					return NextCodeView(file, directory, 0);
+				}
+
+				default:
+				{
+					LS_CODEVIEW_INFO codeview;
+					if (!DebugDirectoryReader::ParseCodeView(data, size, codeview))
+						return NextCodeView(file, directory, file.Stage - SymbolStageCodeView + 1);
+
+					LS_SYMBOL_KEY& key = _keys[file.Index];
+					key.CodeView = codeview;
+					key.Key = DebugDirectoryReader::GetSymbolKey(codeview);
+					return false;
+				}
+			}
+		}
+
+		void OnComplete(const LS_CORPUS_FILE& file) override
+		{
+			LS_SYMBOL_KEY& key = _keys[file.Index];
+			key.Path = *file.Path;
+			key.Result = file.Result;
+
+			wuvector<IMAGE_DEBUG_DIRECTORY>().swap(_directories[file.Index]);
+		}
+
+	private:
+		wuvector<LS_SYMBOL_KEY>& _keys;
+
+		// The directory of each file, while its CodeView records are read. One element per file,
+		// so parsers on different files never touch the same one.
+		wuvector<wuvector<IMAGE_DEBUG_DIRECTORY>> _directories;
+
+		// Queues the read of the first CodeView entry from 'first' on, like 'Read' would have taken it.
+		static bool NextCodeView(LS_CORPUS_FILE& file, const wuvector<IMAGE_DEBUG_DIRECTORY>& directory, size_t first)
+		{
+			for (size_t i = first; i < directory.size(); i++) {
+				const IMAGE_DEBUG_DIRECTORY& entry = directory[i];
+				if (entry.Type != IMAGE_DEBUG_TYPE_CODEVIEW || entry.PointerToRawData == 0 || entry.SizeOfData == 0
+					|| static_cast<ULONGLONG>(entry.PointerToRawData) + entry.SizeOfData > file.FileSize)
+				{
+					continue;
+				}
+
+				file.Stage = SymbolStageCodeView + static_cast<DWORD>(i);
+				file.Offset = entry.PointerToRawData;
+				file.Size = min(entry.SizeOfData, MaxCodeViewSize);
+				return true;
+			}
+
+			file.Result = ERROR_NOT_FOUND;
+			return false;
+		}
+	};
+
+	DebugDirectoryReader::DebugDirectoryReader() { }
+	DebugDirectoryReader::~DebugDirectoryReader() { }
+
+	const LSRESULT DebugDirectoryReader::Read(const WWuString& file_path, DWORD flags, PLS_DEBUG_INFO debug_info)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LSRESULT result = Read(h_file, flags, debug_info);
+		CloseHandle(h_file);
+
+		return result;
+	}
+
+	const LSRESULT DebugDirectoryReader::Read(HANDLE h_file, DWORD flags, PLS_DEBUG_INFO debug_info)
+	{
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		DWORD header_size = static_cast<DWORD>(min(static_cast<ULONGLONG>(HeaderReadSize), static_cast<ULONGLONG>(file_size.QuadPart)));
+		_buffer.resize(header_size);
+		LSRESULT result = ReadAt(h_file, 0, header_size, _buffer.data());
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		DWORD required;
+		ULONGLONG directory_file_offset;
+		DWORD entry_count;
+		result = LocateDirectory(_buffer.data(), header_size, static_cast<ULONGLONG>(file_size.QuadPart), required, directory_file_offset, entry_count);
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		if (required != 0) {
+			_buffer.resize(required);
+			result = ReadAt(h_file, header_size, required - header_size, _buffer.data() + header_size);
+			if (result.Result != ERROR_SUCCESS)
+				return result;
+
+			result = LocateDirectory(_buffer.data(), required, static_cast<ULONGLONG>(file_size.QuadPart), required, directory_file_offset, entry_count);
+			if (result.Result != ERROR_SUCCESS)
+				return result;
+		}
+
+		// No debug directory entry, nothing to read.
+		if (entry_count == 0)
+			return LSRESULT();
+
+		wuvector<IMAGE_DEBUG_DIRECTORY> directory(entry_count);
+		result = ReadAt(h_file, directory_file_offset, entry_count * sizeof(IMAGE_DEBUG_DIRECTORY), reinterpret_cast<BYTE*>(directory.data()));
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		for (const IMAGE_DEBUG_DIRECTORY& entry : directory) {
+			debug_info->Entries.push_back({ entry.Type, entry.TimeDateStamp, entry.MajorVersion, entry.MinorVersion, entry.SizeOfData, entry.AddressOfRawData, entry.PointerToRawData });
+
+			// Entries pointing outside the file are listed, but not read.
+			bool readable = entry.PointerToRawData != 0 && entry.SizeOfData != 0
+				&& static_cast<ULONGLONG>(entry.PointerToRawData) + entry.SizeOfData <= static_cast<ULONGLONG>(file_size.QuadPart);
+
+			switch (entry.Type) {
+				case IMAGE_DEBUG_TYPE_CODEVIEW:
+				{
+					if ((flags & DebugReadCodeView) == 0 || !readable)
+						break;
+
+					DWORD size = min(entry.SizeOfData, MaxCodeViewSize);
+					_buffer.resize(size);
+					if (ReadAt(h_file, entry.PointerToRawData, size, _buffer.data()).Result != ERROR_SUCCESS)
+						break;
+
+					LS_CODEVIEW_INFO codeview;
+					if (ParseCodeView(_buffer.data(), size, codeview))
+						debug_info->CodeView.push_back(codeview);
+				} break;
+
+				case IMAGE_DEBUG_TYPE_POGO:
+				{
+					if ((flags & DebugReadPogo) == 0 || !readable)
+						break;
+
+					DWORD size = min(entry.SizeOfData, MaxPogoSize);
+					_buffer.resize(size);
+					if (ReadAt(h_file, entry.PointerToRawData, size, _buffer.data()).Result == ERROR_SUCCESS)
+						ParsePogo(_buffer.data(), size, debug_info);
+				} break;
+
+				case IMAGE_DEBUG_TYPE_REPRO:
+				{
+					debug_info->IsDeterministic = true;
+					if ((flags & DebugReadRepro) == 0 || !readable || entry.SizeOfData < sizeof(DWORD))
+						break;
+
+					// A length, followed by the hash the linker used in place of the time stamps.
+					DWORD size = min(entry.SizeOfData, MaxCodeViewSize);
+					_buffer.resize(size);
+					if (ReadAt(h_file, entry.PointerToRawData, size, _buffer.data()).Result != ERROR_SUCCESS)
+						break;
+
+					DWORD hash_size = min(*reinterpret_cast<DWORD*>(_buffer.data()), size - static_cast<DWORD>(sizeof(DWORD)));
+					debug_info->ReproHash.assign(_buffer.data() + sizeof(DWORD), _buffer.data() + sizeof(DWORD) + hash_size);
+				} break;
+
+				case IMAGE_DEBUG_TYPE_EMBEDDED_PORTABLE_PDB:
+				{
+					debug_info->HasEmbeddedPdb = true;
+					debug_info->EmbeddedPdbOffset = entry.PointerToRawData;
+					debug_info->EmbeddedPdbSize = entry.SizeOfData;
+					if ((flags & DebugReadEmbeddedPdb) == 0 || !readable || entry.SizeOfData < 2 * sizeof(DWORD))
+						break;
+
+					// 'MPDB', the uncompressed size, then the deflated PDB.
+					DWORD header[2];
+					if (ReadAt(h_file, entry.PointerToRawData, sizeof(header), reinterpret_cast<BYTE*>(header)).Result == ERROR_SUCCESS && header[0] == LS_EMBEDDED_PDB_MPDB)
+						debug_info->EmbeddedPdbUncompressedSize = header[1];
+				} break;
+			}
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT DebugDirectoryReader::LocateDirectory(const BYTE* headers, DWORD size, ULONGLONG file_size, DWORD& required, ULONGLONG& directory_offset, DWORD& entry_count)
+	{
+		required = 0;
+		directory_offset = 0;
+		entry_count = 0;
+		if (size < sizeof(IMAGE_DOS_HEADER))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(headers);
+		size_t nt_offset = static_cast<DWORD>(dos_header->e_lfanew);
+		size_t opt_offset = nt_offset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+		if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || opt_offset + sizeof(WORD) > size || *reinterpret_cast<const DWORD*>(headers + nt_offset) != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		IMAGE_FILE_HEADER file_header = *reinterpret_cast<const IMAGE_FILE_HEADER*>(headers + nt_offset + sizeof(DWORD));
+		bool pe32 = *reinterpret_cast<const WORD*>(headers + opt_offset) == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		size_t data_directory_offset = opt_offset + (pe32 ? 96 : 112);
+		size_t entry_offset = data_directory_offset + (IMAGE_DIRECTORY_ENTRY_DEBUG * sizeof(IMAGE_DATA_DIRECTORY));
+		size_t headers_end = min(static_cast<size_t>(size), opt_offset + file_header.SizeOfOptionalHeader);
+
+		// No debug directory entry.
+		if (entry_offset + sizeof(IMAGE_DATA_DIRECTORY) > headers_end || *reinterpret_cast<const DWORD*>(headers + data_directory_offset - sizeof(DWORD)) <= IMAGE_DIRECTORY_ENTRY_DEBUG)
+			return LSRESULT();
+
+		IMAGE_DATA_DIRECTORY debug_directory = *reinterpret_cast<const IMAGE_DATA_DIRECTORY*>(headers + entry_offset);
+		if (debug_directory.VirtualAddress == 0 || debug_directory.Size < sizeof(IMAGE_DEBUG_DIRECTORY))
+			return LSRESULT();
+
+		// The directory entry is an RVA. Finding the section it's in.
+		size_t section_offset = opt_offset + file_header.SizeOfOptionalHeader;
+		size_t section_end = section_offset + (static_cast<size_t>(file_header.NumberOfSections) * sizeof(IMAGE_SECTION_HEADER));
+		if (section_end > file_size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Section table is outside the file.", __FILEW__, __LINE__);
+
+		if (section_end > size) {
+			required = static_cast<DWORD>(section_end);
+			return LSRESULT();
+		}
+
+		// Directories in the headers have the same offset, and RVA.
+		directory_offset = debug_directory.VirtualAddress;
+		const IMAGE_SECTION_HEADER* sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(headers + section_offset);
+		for (WORD i = 0; i < file_header.NumberOfSections; i++) {
+			DWORD section_size = max(sections[i].Misc.VirtualSize, sections[i].SizeOfRawData);
+			if (debug_directory.VirtualAddress >= sections[i].VirtualAddress && debug_directory.VirtualAddress - sections[i].VirtualAddress < section_size) {
+				directory_offset = static_cast<ULONGLONG>(sections[i].PointerToRawData) + (debug_directory.VirtualAddress - sections[i].VirtualAddress);
+				break;
+			}
+		}
+
+		DWORD count = min(debug_directory.Size / static_cast<DWORD>(sizeof(IMAGE_DEBUG_DIRECTORY)), MaxDebugEntries);
+		if (directory_offset + count * sizeof(IMAGE_DEBUG_DIRECTORY) > file_size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Debug directory is outside the file.", __FILEW__, __LINE__);
+
+		entry_count = count;
+
+		return LSRESULT();
+	}
+
+	void DebugDirectoryReader::ReadSymbolKeys(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_SYMBOL_KEY>& keys)
+	{
+		keys.clear();
+		keys.resize(file_paths.size());
+		if (file_paths.empty())
+			return;
+
+		SymbolKeyParser parser(keys);
+		CorpusPipeline pipeline(LS_CORPUS_QUEUE_DEPTH, thread_count);
+		LSRESULT result = pipeline.Run(file_paths, parser);
+
+		// The pipeline didn't start, no file was read.
+		if (result.Result != ERROR_SUCCESS) {
+			for (size_t i = 0; i < keys.size(); i++) {
+				keys[i].Path = file_paths[i];
+				keys[i].Result = result.Result;
+			}
+		}
+	}
+
+	WWuString DebugDirectoryReader::GetSymbolKey(const LS_CODEVIEW_INFO& codeview)
+	{
+		// Symbol servers use the file name only.
+		WWuString pdb_name = WWuString(PathFindFileName(WuStringToWide(codeview.PdbPath).GetBuffer()));
+		if (pdb_name.Length() == 0)
+			return WWuString();
+
+		WWuString identifier;
+		switch (codeview.Format) {
+			case LS_CODEVIEW_RSDS:
+			{
+				const GUID& guid = codeview.Guid;
+				identifier = WWuString::Format(L"%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X", guid.Data1, guid.Data2, guid.Data3,
+					guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7], codeview.Age);
+			} break;
+
+			case LS_CODEVIEW_NB10:
+				identifier = WWuString::Format(L"%08X%X", codeview.Signature, codeview.Age);
+				break;
+
+			default:
+				return WWuString();
+		}
+
+		return pdb_name + L"/" + identifier + L"/" + pdb_name;
+	}
+
+	bool DebugDirectoryReader::ParseCodeView(const BYTE* data, size_t size, LS_CODEVIEW_INFO& codeview)
+	{
+		if (size < sizeof(DWORD))
+			return false;
+
+		// RSDS: signature, GUID, age, path. NB10: signature, offset, time stamp, age, path.
+		size_t path_offset;
+		codeview.Format = *reinterpret_cast<const DWORD*>(data);
+		switch (codeview.Format) {
+			case LS_CODEVIEW_RSDS:
+			{
+				if (size < 24)
+					return false;
+
+				memcpy(&codeview.Guid, data + 4, sizeof(GUID));
+				codeview.Age = *reinterpret_cast<const DWORD*>(data + 20);
+				path_offset = 24;
+			} break;
+
+			case LS_CODEVIEW_NB10:
+			{
+				if (size < 16)
+					return false;
+
+				codeview.Signature = *reinterpret_cast<const DWORD*>(data + 8);
+				codeview.Age = *reinterpret_cast<const DWORD*>(data + 12);
+				path_offset = 16;
+			} break;
+
+			default:
+				return false;
+		}
+
+		// The path is null terminated, unless the record was cut.
+		size_t path_length = strnlen(reinterpret_cast<const char*>(data + path_offset), size - path_offset);
+		wuvector<char> path(data + path_offset, data + path_offset + path_length);
+		path.push_back('\0');
+		codeview.PdbPath = path.data();
+
+		return true;
+	}
+
+	void DebugDirectoryReader::ParsePogo(const BYTE* data, size_t size, PLS_DEBUG_INFO debug_info)
+	{
+		if (size < sizeof(DWORD))
+			return;
+
+		debug_info->PogoSignature = *reinterpret_cast<const DWORD*>(data);
+
+		// RVA, size, and a null terminated name, padded to four bytes.
+		size_t offset = sizeof(DWORD);
+		while (offset + 2 * sizeof(DWORD) < size) {
+			const char* name = reinterpret_cast<const char*>(data + offset + 2 * sizeof(DWORD));
+			size_t name_length = strnlen(name, size - offset - 2 * sizeof(DWORD));
+			if (name_length == size - offset - 2 * sizeof(DWORD))
+				break;
+
+			LS_POGO_ENTRY entry;
+			entry.Rva = *reinterpret_cast<const DWORD*>(data + offset);
+			entry.Size = *reinterpret_cast<const DWORD*>(data + offset + sizeof(DWORD));
+			entry.Name = name;
+			debug_info->Pogo.push_back(entry);
+
+			offset = (offset + 2 * sizeof(DWORD) + name_length + 1 + 3) & ~static_cast<size_t>(3);
+		}
+	}
+
+	const LSRESULT DebugDirectoryReader::ReadAt(HANDLE h_file, ULONGLONG offset, DWORD size, BYTE* buffer)
+	{
+		// Positioned reads, so a batch doesn't pay for seeking.
+		OVERLAPPED overlapped{ };
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		DWORD bytes_read = 0;
+		if (!ReadFile(h_file, buffer, size, &bytes_read, &overlapped))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		if (bytes_read != size)
+			return LSRESULT(ERROR_HANDLE_EOF, __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
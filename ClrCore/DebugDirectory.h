@@ -0,0 +1,160 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// Not in every SDK version.
+	#ifndef IMAGE_DEBUG_TYPE_POGO
+	#define IMAGE_DEBUG_TYPE_POGO 13
+	#endif
+
+	#ifndef IMAGE_DEBUG_TYPE_REPRO
+	#define IMAGE_DEBUG_TYPE_REPRO 16
+	#endif
+
+	#ifndef IMAGE_DEBUG_TYPE_EMBEDDED_PORTABLE_PDB
+	#define IMAGE_DEBUG_TYPE_EMBEDDED_PORTABLE_PDB 17
+	#endif
+
+	// CodeView record signatures.
+	#define LS_CODEVIEW_RSDS 0x53445352
+	#define LS_CODEVIEW_NB10 0x3031424E
+
+	// Embedded portable PDB, and POGO signatures.
+	#define LS_EMBEDDED_PDB_MPDB 0x4244504D
+	#define LS_POGO_LTCG 0x4C544347
+	#define LS_POGO_PGU 0x50475500
+
+	// What to read besides the directory itself. Each one costs a read per entry.
+	typedef enum _LS_DEBUG_READ_FLAGS
+	{
+		DebugReadDirectory = 0,
+		DebugReadCodeView = 1,
+		DebugReadPogo = 2,
+		DebugReadRepro = 4,
+		DebugReadEmbeddedPdb = 8,
+		DebugReadAll = DebugReadCodeView | DebugReadPogo | DebugReadRepro | DebugReadEmbeddedPdb
+	} LS_DEBUG_READ_FLAGS;
+
+	typedef struct _LS_DEBUG_ENTRY
+	{
+		DWORD Type;
+		DWORD TimeDateStamp;
+		WORD MajorVersion;
+		WORD MinorVersion;
+		DWORD SizeOfData;
+		DWORD AddressOfRawData;
+		DWORD PointerToRawData;
+
+	} LS_DEBUG_ENTRY, *PLS_DEBUG_ENTRY;
+
+	typedef struct _LS_CODEVIEW_INFO
+	{
+		// LS_CODEVIEW_RSDS, or LS_CODEVIEW_NB10.
+		DWORD Format;
+
+		// RSDS has the GUID, NB10 the signature.
+		GUID Guid;
+		DWORD Signature;
+		DWORD Age;
+		WuString PdbPath;
+
+		_LS_CODEVIEW_INFO()
+			: Format(0), Guid(), Signature(0), Age(0) { }
+
+		~_LS_CODEVIEW_INFO() { }
+
+	} LS_CODEVIEW_INFO, *PLS_CODEVIEW_INFO;
+
+	typedef struct _LS_POGO_ENTRY
+	{
+		DWORD Rva;
+		DWORD Size;
+		WuString Name;
+
+		_LS_POGO_ENTRY()
+			: Rva(0), Size(0) { }
+
+		~_LS_POGO_ENTRY() { }
+
+	} LS_POGO_ENTRY, *PLS_POGO_ENTRY;
+
+	typedef struct _LS_DEBUG_INFO
+	{
+		wuvector<LS_DEBUG_ENTRY> Entries;
+		wuvector<LS_CODEVIEW_INFO> CodeView;
+
+		// LS_POGO_LTCG, or LS_POGO_PGU. Zero if there's no POGO entry.
+		DWORD PogoSignature;
+		wuvector<LS_POGO_ENTRY> Pogo;
+
+		// Deterministic builds have a repro entry. The hash is empty for older linkers.
+		bool IsDeterministic;
+		wuvector<BYTE> ReproHash;
+
+		// The compressed portable PDB stays in the file. This is where it is.
+		bool HasEmbeddedPdb;
+		DWORD EmbeddedPdbOffset;
+		DWORD EmbeddedPdbSize;
+		DWORD EmbeddedPdbUncompressedSize;
+
+		_LS_DEBUG_INFO()
+			: PogoSignature(0), IsDeterministic(false), HasEmbeddedPdb(false),
+				EmbeddedPdbOffset(0), EmbeddedPdbSize(0), EmbeddedPdbUncompressedSize(0) { }
+
+		~_LS_DEBUG_INFO() { }
+
+	} LS_DEBUG_INFO, *PLS_DEBUG_INFO;
+
+	// One file of a batch. 'Key' is the symbol server key of the first CodeView record.
+	typedef struct _LS_SYMBOL_KEY
+	{
+		WWuString Path;
+		LONG Result;
+		WWuString Key;
+		LS_CODEVIEW_INFO CodeView;
+
+		_LS_SYMBOL_KEY()
+			: Result(ERROR_SUCCESS) { }
+
+		~_LS_SYMBOL_KEY() { }
+
+	} LS_SYMBOL_KEY, *PLS_SYMBOL_KEY;
+
+	// Reads the debug directory from the file, not from a mapping. Only the headers,
+	// the directory, and the data of the entry types asked for are read, each one
+	// with a single positioned read.
+	class DebugDirectoryReader
+	{
+	public:
+		DebugDirectoryReader();
+		~DebugDirectoryReader();
+
+		const LSRESULT Read(const WWuString& file_path, DWORD flags, PLS_DEBUG_INFO debug_info);
+		const LSRESULT Read(HANDLE h_file, DWORD flags, PLS_DEBUG_INFO debug_info);
+
+		// Reads the CodeView records only, for every file, through the corpus pipeline, parsing
+		// on 'thread_count' threads. Failures are reported per file. Zero threads means one per processor.
+		static void ReadSymbolKeys(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_SYMBOL_KEY>& keys);
+
+		// 'name.pdb/GUIDAGE/name.pdb', the symbol server layout. Empty for unknown formats.
+		static WWuString GetSymbolKey(const LS_CODEVIEW_INFO& codeview);
+
+		// Where the debug directory is, from the start of the file. A 'required' size means the section table
+		// is past 'size', and the call must be repeated with that many bytes. No entries means no directory.
+		static const LSRESULT LocateDirectory(const BYTE* headers, DWORD size, ULONGLONG file_size, DWORD& required, ULONGLONG& directory_offset, DWORD& entry_count);
+
+		static bool ParseCodeView(const BYTE* data, size_t size, LS_CODEVIEW_INFO& codeview);
+		static void ParsePogo(const BYTE* data, size_t size, PLS_DEBUG_INFO debug_info);
+
+	private:
+		// Reused between files. Headers, and the directory are small.
+		wuvector<BYTE> _buffer;
+
+		static const LSRESULT ReadAt(HANDLE h_file, ULONGLONG offset, DWORD size, BYTE* buffer);
+	};
+}
\ No newline at end of file
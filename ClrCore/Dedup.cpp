@@ -0,0 +1,375 @@
+#include "pch.h"
+
+#include "Dedup.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_DEDUP_PASS
+	{
+		DedupPassSize,
+		DedupPassFast,
+		DedupPassFull
+
+	} LS_DEDUP_PASS;
+
+	typedef struct _LS_DEDUP_CONTEXT
+	{
+		wuvector<LS_DEDUP_FILE>* Files;
+		const wuvector<DWORD>* Work;
+		LS_DEDUP_PASS Pass;
+		BCRYPT_ALG_HANDLE Sha256;
+		volatile LONG Next;
+
+	} LS_DEDUP_CONTEXT, *PLS_DEDUP_CONTEXT;
+
+	static constexpr ULONGLONG Prime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr ULONGLONG Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr ULONGLONG Prime3 = 0x165667B19E3779F9ULL;
+
+	static inline ULONGLONG Round(ULONGLONG accumulator, ULONGLONG input) noexcept
+	{
+		accumulator += input * Prime2;
+		accumulator = _rotl64(accumulator, 31);
+
+		return accumulator * Prime1;
+	}
+
+	// Sorts 'indexes' with 'less', and keeps the runs 'equal' can't tell apart, with more than one file.
+	template<class L, class E>
+	static void GetCollisions(wuvector<DWORD>& indexes, L less, E equal, wuvector<wuvector<DWORD>>& runs)
+	{
+		runs.clear();
+		std::sort(indexes.begin(), indexes.end(), less);
+		for (size_t start = 0; start < indexes.size();) {
+			size_t end = start + 1;
+			while (end < indexes.size() && equal(indexes[start], indexes[end]))
+				end++;
+
+			if (end - start > 1)
+				runs.emplace_back(indexes.begin() + start, indexes.begin() + end);
+
+			start = end;
+		}
+	}
+
+	static void Flatten(const wuvector<wuvector<DWORD>>& runs, wuvector<DWORD>& indexes)
+	{
+		indexes.clear();
+		for (const wuvector<DWORD>& run : runs)
+			indexes.insert(indexes.end(), run.begin(), run.end());
+	}
+
+	void ContentDeduplicator::Deduplicate(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_DEDUP_FILE>& files, wuvector<LS_DUPLICATE_SET>& sets)
+	{
+		files.clear();
+		files.resize(file_paths.size());
+		sets.clear();
+		if (file_paths.empty())
+			return;
+
+		if (thread_count == 0) {
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			thread_count = system_info.dwNumberOfProcessors;
+		}
+
+		thread_count = min(thread_count, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS));
+
+		wuvector<DWORD> work(file_paths.size());
+		for (DWORD i = 0; i < static_cast<DWORD>(file_paths.size()); i++) {
+			files[i].Path = file_paths[i];
+			files[i].Canonical = i;
+			work[i] = i;
+		}
+
+		BCRYPT_ALG_HANDLE sha256 = NULL;
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&sha256, BCRYPT_SHA256_ALGORITHM, NULL, 0)))
+			sha256 = NULL;
+
+		LS_DEDUP_CONTEXT context{ &files, &work, DedupPassSize, sha256, 0 };
+		RunPass(&context, thread_count, work.size());
+
+		// Empty files, and the ones we couldn't read are their own.
+		auto excluded = [&files](DWORD index) { return files[index].Result != ERROR_SUCCESS || files[index].FileSize == 0; };
+		work.erase(std::remove_if(work.begin(), work.end(), excluded), work.end());
+
+		wuvector<wuvector<DWORD>> runs;
+		GetCollisions(work,
+			[&files](DWORD left, DWORD right) { return files[left].FileSize < files[right].FileSize || (files[left].FileSize == files[right].FileSize && left < right); },
+			[&files](DWORD left, DWORD right) { return files[left].FileSize == files[right].FileSize; },
+			runs);
+
+		Flatten(runs, work);
+		if (!work.empty()) {
+			context.Pass = DedupPassFast;
+			context.Next = 0;
+			RunPass(&context, thread_count, work.size());
+		}
+
+		auto failed = [&files](DWORD index) { return files[index].Result != ERROR_SUCCESS; };
+		work.erase(std::remove_if(work.begin(), work.end(), failed), work.end());
+
+		GetCollisions(work,
+			[&files](DWORD left, DWORD right) {
+				const LS_DEDUP_FILE& l = files[left];
+				const LS_DEDUP_FILE& r = files[right];
+				if (l.FileSize != r.FileSize)
+					return l.FileSize < r.FileSize;
+
+				if (l.FastHash != r.FastHash)
+					return l.FastHash < r.FastHash;
+
+				return left < right;
+			},
+			[&files](DWORD left, DWORD right) { return files[left].FileSize == files[right].FileSize && files[left].FastHash == files[right].FastHash; },
+			runs);
+
+		Flatten(runs, work);
+		if (!work.empty() && sha256 != NULL) {
+			context.Pass = DedupPassFull;
+			context.Next = 0;
+			RunPass(&context, thread_count, work.size());
+
+			work.erase(std::remove_if(work.begin(), work.end(), failed), work.end());
+
+			GetCollisions(work,
+				[&files](DWORD left, DWORD right) {
+					const LS_DEDUP_FILE& l = files[left];
+					const LS_DEDUP_FILE& r = files[right];
+					if (l.FileSize != r.FileSize)
+						return l.FileSize < r.FileSize;
+
+					int result = memcmp(l.FullHash, r.FullHash, LS_DEDUP_HASH_SIZE);
+					if (result != 0)
+						return result < 0;
+
+					return left < right;
+				},
+				[&files](DWORD left, DWORD right) {
+					return files[left].FileSize == files[right].FileSize && memcmp(files[left].FullHash, files[right].FullHash, LS_DEDUP_HASH_SIZE) == 0;
+				},
+				runs);
+
+			// Runs are sorted by index inside, the first file is the canonical one.
+			for (wuvector<DWORD>& run : runs) {
+				LS_DUPLICATE_SET set;
+				set.FileSize = files[run[0]].FileSize;
+				memcpy(set.Hash, files[run[0]].FullHash, LS_DEDUP_HASH_SIZE);
+				for (DWORD index : run)
+					files[index].Canonical = run[0];
+
+				set.Files = std::move(run);
+				sets.push_back(std::move(set));
+			}
+
+			std::sort(sets.begin(), sets.end(), [](const LS_DUPLICATE_SET& left, const LS_DUPLICATE_SET& right) {
+				return left.Files[0] < right.Files[0];
+			});
+		}
+
+		if (sha256 != NULL)
+			BCryptCloseAlgorithmProvider(sha256, 0);
+	}
+
+	ULONGLONG ContentDeduplicator::FastHash(const BYTE* data, size_t size, ULONGLONG seed) noexcept
+	{
+		ULONGLONG lanes[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+
+		size_t offset = 0;
+		for (; offset + 32 <= size; offset += 32) {
+			for (int i = 0; i < 4; i++) {
+				ULONGLONG word;
+				memcpy(&word, data + offset + (i * sizeof(ULONGLONG)), sizeof(word));
+				lanes[i] = Round(lanes[i], word);
+			}
+		}
+
+		ULONGLONG hash = _rotl64(lanes[0], 1) + _rotl64(lanes[1], 7) + _rotl64(lanes[2], 12) + _rotl64(lanes[3], 18);
+		hash += size;
+
+		for (; offset + sizeof(ULONGLONG) <= size; offset += sizeof(ULONGLONG)) {
+			ULONGLONG word;
+			memcpy(&word, data + offset, sizeof(word));
+			hash ^= Round(0, word);
+			hash = (_rotl64(hash, 27) * Prime1) + Prime3;
+		}
+
+		for (; offset < size; offset++) {
+			hash ^= data[offset] * Prime3;
+			hash = _rotl64(hash, 11) * Prime1;
+		}
+
+		hash ^= hash >> 33;
+		hash *= Prime2;
+		hash ^= hash >> 29;
+		hash *= Prime3;
+		hash ^= hash >> 32;
+
+		return hash;
+	}
+
+	void ContentDeduplicator::ReadSize(LS_DEDUP_FILE& file) noexcept
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesEx(file.Path.GetBuffer(), GetFileExInfoStandard, &attributes)) {
+			file.Result = GetLastError();
+			return;
+		}
+
+		if ((attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+			file.Result = ERROR_DIRECTORY_NOT_SUPPORTED;
+			return;
+		}
+
+		file.FileSize = (static_cast<ULONGLONG>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	}
+
+	void ContentDeduplicator::ComputeFastHash(LS_DEDUP_FILE& file, BYTE* buffer) noexcept
+	{
+		HANDLE h_file = CreateFile(file.Path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (h_file == INVALID_HANDLE_VALUE) {
+			file.Result = GetLastError();
+			return;
+		}
+
+		// Small files are read whole. The first page has the headers, the last one the end of the
+		// certificate table, or the overlay, and the pages in between catch patched code and data.
+		ULONGLONG page_count = (file.FileSize + LS_DEDUP_PAGE_SIZE - 1) / LS_DEDUP_PAGE_SIZE;
+		ULONGLONG samples = min(page_count, static_cast<ULONGLONG>(LS_DEDUP_SAMPLE_PAGES));
+		ULONGLONG hash = file.FileSize;
+		for (ULONGLONG i = 0; i < samples; i++) {
+			ULONGLONG page = samples == 1 ? 0 : ((page_count - 1) * i) / (samples - 1);
+			ULONGLONG offset = page * LS_DEDUP_PAGE_SIZE;
+			DWORD size = static_cast<DWORD>(min(static_cast<ULONGLONG>(LS_DEDUP_PAGE_SIZE), file.FileSize - offset));
+
+			OVERLAPPED overlapped{ };
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			DWORD bytes_read;
+			if (!ReadFile(h_file, buffer, size, &bytes_read, &overlapped)) {
+				file.Result = GetLastError();
+				CloseHandle(h_file);
+				return;
+			}
+
+			// The file changed since we got its size.
+			if (bytes_read != size) {
+				file.Result = ERROR_HANDLE_EOF;
+				CloseHandle(h_file);
+				return;
+			}
+
+			hash = FastHash(buffer, bytes_read, hash);
+		}
+
+		file.FastHash = hash;
+		file.HasFastHash = true;
+		CloseHandle(h_file);
+	}
+
+	void ContentDeduplicator::ComputeFullHash(LS_DEDUP_FILE& file, BCRYPT_ALG_HANDLE sha256, BYTE* buffer) noexcept
+	{
+		HANDLE h_file = CreateFile(file.Path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (h_file == INVALID_HANDLE_VALUE) {
+			file.Result = GetLastError();
+			return;
+		}
+
+		BCRYPT_HASH_HANDLE h_hash;
+		NTSTATUS status = BCryptCreateHash(sha256, &h_hash, NULL, 0, NULL, 0, 0);
+		if (!NT_SUCCESS(status)) {
+			file.Result = ERROR_NOT_ENOUGH_MEMORY;
+			CloseHandle(h_file);
+			return;
+		}
+
+		ULONGLONG total_read = 0;
+		for (;;) {
+			DWORD bytes_read;
+			if (!ReadFile(h_file, buffer, LS_DEDUP_CHUNK_SIZE, &bytes_read, NULL)) {
+				file.Result = GetLastError();
+				break;
+			}
+
+			if (bytes_read == 0)
+				break;
+
+			total_read += bytes_read;
+			status = BCryptHashData(h_hash, buffer, bytes_read, 0);
+			if (!NT_SUCCESS(status)) {
+				file.Result = ERROR_INVALID_DATA;
+				break;
+			}
+		}
+
+		if (file.Result == ERROR_SUCCESS && total_read != file.FileSize)
+			file.Result = ERROR_HANDLE_EOF;
+
+		if (file.Result == ERROR_SUCCESS) {
+			status = BCryptFinishHash(h_hash, file.FullHash, LS_DEDUP_HASH_SIZE, 0);
+			if (NT_SUCCESS(status))
+				file.HasFullHash = true;
+			else
+				file.Result = ERROR_INVALID_DATA;
+		}
+
+		BCryptDestroyHash(h_hash);
+		CloseHandle(h_file);
+	}
+
+	void ContentDeduplicator::RunPass(LPVOID context, DWORD thread_count, size_t work_count)
+	{
+		// The calling thread is one of the workers.
+		thread_count = static_cast<DWORD>(min(static_cast<size_t>(thread_count), work_count));
+
+		wuvector<HANDLE> threads;
+		for (DWORD i = 1; i < thread_count; i++) {
+			HANDLE h_thread = CreateThread(NULL, 0, DedupWorker, context, 0, NULL);
+			if (h_thread == NULL)
+				break;
+
+			threads.push_back(h_thread);
+		}
+
+		DedupWorker(context);
+
+		if (!threads.empty()) {
+			WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, INFINITE);
+			for (HANDLE h_thread : threads)
+				CloseHandle(h_thread);
+		}
+	}
+
+	DWORD WINAPI ContentDeduplicator::DedupWorker(LPVOID context)
+	{
+		PLS_DEDUP_CONTEXT batch = static_cast<PLS_DEDUP_CONTEXT>(context);
+
+		// One buffer per thread. A page for the samples, a chunk for the full hash.
+		wuvector<BYTE> buffer;
+		if (batch->Pass == DedupPassFast)
+			buffer.resize(LS_DEDUP_PAGE_SIZE);
+		else if (batch->Pass == DedupPassFull)
+			buffer.resize(LS_DEDUP_CHUNK_SIZE);
+
+		LONG count = static_cast<LONG>(batch->Work->size());
+		for (LONG index = InterlockedIncrement(&batch->Next) - 1; index < count; index = InterlockedIncrement(&batch->Next) - 1) {
+			LS_DEDUP_FILE& file = (*batch->Files)[(*batch->Work)[index]];
+			switch (batch->Pass) {
+				case DedupPassSize:
+					ReadSize(file);
+					break;
+				case DedupPassFast:
+					ComputeFastHash(file, buffer.data());
+					break;
+				case DedupPassFull:
+					ComputeFullHash(file, batch->Sha256, buffer.data());
+					break;
+			}
+		}
+
+		return 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_DEDUP_SAMPLE_PAGES 16
+	#define LS_DEDUP_PAGE_SIZE 0x1000
+	#define LS_DEDUP_CHUNK_SIZE 0x100000
+	#define LS_DEDUP_HASH_SIZE 32
+
+	typedef struct _LS_DEDUP_FILE
+	{
+		WWuString Path;
+		DWORD Result;
+		ULONGLONG FileSize;
+
+		// The headers, and LS_DEDUP_SAMPLE_PAGES pages spread over the file. Only for files sharing a size.
+		bool HasFastHash;
+		ULONGLONG FastHash;
+
+		// SHA-256 of the whole file. Only for files sharing a size, and a fast hash.
+		bool HasFullHash;
+		BYTE FullHash[LS_DEDUP_HASH_SIZE];
+
+		// The first file with the same content. Itself for unique files, and files that can't be read.
+		DWORD Canonical;
+
+		_LS_DEDUP_FILE()
+			: Result(ERROR_SUCCESS), FileSize(0), HasFastHash(false), FastHash(0), HasFullHash(false), FullHash(), Canonical(0) { }
+
+		~_LS_DEDUP_FILE() { }
+
+	} LS_DEDUP_FILE, *PLS_DEDUP_FILE;
+
+	// Files with the same content. 'Files' are indexes into the batch, the first is the canonical one.
+	typedef struct _LS_DUPLICATE_SET
+	{
+		ULONGLONG FileSize;
+		BYTE Hash[LS_DEDUP_HASH_SIZE];
+		wuvector<DWORD> Files;
+
+		_LS_DUPLICATE_SET()
+			: FileSize(0), Hash() { }
+
+		~_LS_DUPLICATE_SET() { }
+
+	} LS_DUPLICATE_SET, *PLS_DUPLICATE_SET;
+
+	// Finds files with the same content in a corpus, so each one is parsed once.
+	// Files are narrowed in three passes, each on 'thread_count' threads, and each only
+	// over the files the previous one couldn't tell apart:
+	//   - The size, from the file attributes.
+	//   - A 64-bit hash of the first page, the last page, and pages spread evenly in between.
+	//   - SHA-256 of the whole file.
+	// Most files in a corpus have a size of their own, and are never opened.
+	class ContentDeduplicator
+	{
+	public:
+		// Zero threads means one per processor. Failures are reported per file.
+		// Duplicate sets are in the order of their first file.
+		static void Deduplicate(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_DEDUP_FILE>& files, wuvector<LS_DUPLICATE_SET>& sets);
+
+		// Not cryptographic. 32 byte stripes, four lanes, multiply and rotate.
+		static ULONGLONG FastHash(const BYTE* data, size_t size, ULONGLONG seed) noexcept;
+
+	private:
+		static void ReadSize(LS_DEDUP_FILE& file) noexcept;
+		static void ComputeFastHash(LS_DEDUP_FILE& file, BYTE* buffer) noexcept;
+		static void ComputeFullHash(LS_DEDUP_FILE& file, BCRYPT_ALG_HANDLE sha256, BYTE* buffer) noexcept;
+
+		static void RunPass(LPVOID context, DWORD thread_count, size_t work_count);
+		static DWORD WINAPI DedupWorker(LPVOID context);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "pch.h"
+
+#include "DirectoryIndex.h"
+
+namespace LibSnitcher::Core
+{
+	static void AddSearchDirectory(wuvector<WWuString>& search_order, WWuString directory)
+	{
+		if (WWuString::IsNullOrWhiteSpace(directory))
+			return;
+
+		PathCchRemoveBackslash(directory.GetBuffer(), directory.Length() + 1);
+		WWuString key = directory.ToLower();
+		for (WWuString& existing : search_order) {
+			if (existing.ToLower() == key)
+				return;
+		}
+
+		search_order.push_back(directory);
+	}
+
+	DirectoryIndex::DirectoryIndex()
+	{
+		InitializeSRWLock(&_lock);
+
+		WCHAR system_dir[MAX_PATH]{ 0 };
+		WCHAR wow64_dir[MAX_PATH]{ 0 };
+		WCHAR windows_dir[MAX_PATH]{ 0 };
+		GetSystemDirectory(system_dir, MAX_PATH);
+		GetWindowsDirectory(windows_dir, MAX_PATH);
+
+		// On 32-bit systems there's no 'SysWOW64'.
+		if (GetSystemWow64Directory(wow64_dir, MAX_PATH) == 0)
+			wcscpy_s(wow64_dir, system_dir);
+
+		_system_directory = system_dir;
+		_wow64_directory = wow64_dir;
+		PathCchRemoveBackslash(_system_directory.GetBuffer(), _system_directory.Length() + 1);
+		PathCchRemoveBackslash(_wow64_directory.GetBuffer(), _wow64_directory.Length() + 1);
+
+		// Without a schema API set names are left unresolved, like before.
+		_api_sets.Load(_system_directory);
+		LoadKnownDlls();
+
+		// Same order as the standard search order, minus the current directory.
+		AddSearchDirectory(_search_order, system_dir);
+		AddSearchDirectory(_search_order, windows_dir);
+		AddSearchDirectory(_wow64_search_order, wow64_dir);
+		AddSearchDirectory(_wow64_search_order, windows_dir);
+
+		DWORD path_size = GetEnvironmentVariable(L"PATH", NULL, 0);
+		if (path_size > 0) {
+			wuunique_ha_ptr<WCHAR> path_var = make_wuunique_ha<WCHAR>(path_size * sizeof(WCHAR));
+			GetEnvironmentVariable(L"PATH", path_var.get(), path_size);
+
+			LPWSTR context = NULL;
+			LPWSTR token = wcstok_s(path_var.get(), L";", &context);
+			while (token != NULL) {
+				AddSearchDirectory(_search_order, token);
+				AddSearchDirectory(_wow64_search_order, token);
+				token = wcstok_s(NULL, L";", &context);
+			}
+		}
+	}
+
+	DirectoryIndex::~DirectoryIndex() { }
+
+	const wuvector<WWuString>& DirectoryIndex::GetSystemSearchOrder(bool wow64) const noexcept
+	{
+		return wow64 ? _wow64_search_order : _search_order;
+	}
+
+	bool DirectoryIndex::FindModule(const WWuString& module_name, const WWuString& app_directory, bool wow64, WWuString& module_path, const WWuString& importing_name)
+	{
+		WWuString key = module_name.ToLower();
+
+		// The loader redirects these before searching, there's no file with the contract name.
+		if (ApiSetSchema::IsApiSetName(module_name)) {
+			WWuString host_name;
+			if (!_api_sets.Resolve(module_name, importing_name, host_name))
+				return false;
+
+			key = host_name.ToLower();
+		}
+
+		// Known DLLs are mapped from the system directory, whatever is in the application directory.
+		if (_known_dlls.find(key) != _known_dlls.end() && FindInDirectory(key, wow64 ? _wow64_directory : _system_directory, module_path))
+			return true;
+
+		if (!WWuString::IsNullOrEmpty(app_directory) && FindInDirectory(key, app_directory, module_path))
+			return true;
+
+		for (const WWuString& directory : GetSystemSearchOrder(wow64)) {
+			if (FindInDirectory(key, directory, module_path))
+				return true;
+		}
+
+		return false;
+	}
+
+	void DirectoryIndex::Refresh(const WWuString& directory)
+	{
+		WWuString key = directory.ToLower();
+
+		AcquireSRWLockExclusive(&_lock);
+		_listings.erase(key);
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	void DirectoryIndex::ApplyChange(const WWuString& file_path, bool exists)
+	{
+		WWuString directory(file_path);
+		PathCchRemoveFileSpec(directory.GetBuffer(), directory.Length() + 1);
+		WWuString key = directory.ToLower();
+		WWuString file_key = WWuString(PathFindFileName(file_path.GetBuffer())).ToLower();
+
+		// Listings are shared with readers outside the lock, so we swap in a modified copy.
+		AcquireSRWLockExclusive(&_lock);
+		auto cached = _listings.find(key);
+		if (cached != _listings.end()) {
+			bool listed = cached->second->Files.find(file_key) != cached->second->Files.end();
+			if (listed != exists) {
+				wushared_ptr<LS_DIRECTORY_LISTING> listing = make_wushared<LS_DIRECTORY_LISTING>(*cached->second);
+				if (exists)
+					listing->Files.emplace(file_key, file_path);
+				else
+					listing->Files.erase(file_key);
+
+				cached->second = listing;
+			}
+		}
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	wushared_ptr<LS_DIRECTORY_LISTING> DirectoryIndex::GetListing(const WWuString& directory)
+	{
+		WWuString key = directory.ToLower();
+
+		AcquireSRWLockShared(&_lock);
+		auto cached = _listings.find(key);
+		if (cached != _listings.end()) {
+			wushared_ptr<LS_DIRECTORY_LISTING> listing = cached->second;
+			ReleaseSRWLockShared(&_lock);
+
+			return listing;
+		}
+		ReleaseSRWLockShared(&_lock);
+
+		// Enumerating outside the lock. If another thread got here first we keep its listing.
+		wushared_ptr<LS_DIRECTORY_LISTING> listing = EnumerateDirectory(directory);
+
+		AcquireSRWLockExclusive(&_lock);
+		auto inserted = _listings.emplace(key, listing);
+		listing = inserted.first->second;
+		ReleaseSRWLockExclusive(&_lock);
+
+		return listing;
+	}
+
+	bool DirectoryIndex::FindInDirectory(const WWuString& key, const WWuString& directory, WWuString& module_path)
+	{
+		wushared_ptr<LS_DIRECTORY_LISTING> listing = GetListing(directory);
+		auto file = listing->Files.find(key);
+		if (file == listing->Files.end())
+			return false;
+
+		module_path = file->second;
+
+		return true;
+	}
+
+	void DirectoryIndex::LoadKnownDlls()
+	{
+		HKEY h_key;
+		if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, L"SYSTEM\\CurrentControlSet\\Control\\Session Manager\\KnownDLLs", 0, KEY_QUERY_VALUE, &h_key) != ERROR_SUCCESS)
+			return;
+
+		// Value names are arbitrary, the data is the file name. 'DllDirectory', and 'DllDirectory32' are not modules.
+		WCHAR value_name[MAX_PATH];
+		WCHAR value_data[MAX_PATH];
+		for (DWORD index = 0; ; index++) {
+			DWORD name_size = MAX_PATH;
+			DWORD data_size = sizeof(value_data) - sizeof(WCHAR);
+			DWORD type = 0;
+			LSTATUS status = RegEnumValue(h_key, index, value_name, &name_size, NULL, &type, reinterpret_cast<LPBYTE>(value_data), &data_size);
+			if (status == ERROR_NO_MORE_ITEMS)
+				break;
+
+			if (status != ERROR_SUCCESS || type != REG_SZ || _wcsnicmp(value_name, L"DllDirectory", 12) == 0)
+				continue;
+
+			value_data[data_size / sizeof(WCHAR)] = L'\0';
+			if (value_data[0] != L'\0')
+				_known_dlls.emplace(WWuString(value_data).ToLower(), true);
+		}
+
+		RegCloseKey(h_key);
+	}
+
+	wushared_ptr<LS_DIRECTORY_LISTING> DirectoryIndex::EnumerateDirectory(const WWuString& directory)
+	{
+		wushared_ptr<LS_DIRECTORY_LISTING> listing = make_wushared<LS_DIRECTORY_LISTING>();
+		listing->Path = directory;
+
+		WIN32_FIND_DATA find_data;
+		WWuString filter = directory + L"\\*";
+		HANDLE h_find = FindFirstFileEx(filter.GetBuffer(), FindExInfoBasic, &find_data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+		if (h_find == INVALID_HANDLE_VALUE)
+			return listing;
+
+		do {
+			if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+				continue;
+
+			WWuString file_name(find_data.cFileName);
+			listing->Files.emplace(file_name.ToLower(), directory + L"\\" + file_name);
+
+		} while (FindNextFile(h_find, &find_data));
+
+		FindClose(h_find);
+
+		return listing;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "ApiSet.h"
+
+namespace LibSnitcher::Core
+{
+	// The file names of a single directory. Keys are lowercase, values are the full path.
+	typedef struct _LS_DIRECTORY_LISTING
+	{
+		WWuString Path;
+		wumap<WWuString, WWuString> Files;
+
+		_LS_DIRECTORY_LISTING() { }
+		~_LS_DIRECTORY_LISTING() { }
+
+	} LS_DIRECTORY_LISTING, *PLS_DIRECTORY_LISTING;
+
+	// Caches directory listings so module names can be resolved without touching
+	// the file system. Directories are enumerated once, the first time they are
+	// part of a search, and stay warm until refreshed.
+	class DirectoryIndex
+	{
+	public:
+		DirectoryIndex();
+		~DirectoryIndex();
+
+		// The directories the loader searches after the application directory,
+		// in order. 'wow64' picks 'SysWOW64' instead of 'System32'.
+		_NODISCARD const wuvector<WWuString>& GetSystemSearchOrder(bool wow64) const noexcept;
+
+		// Looks for 'module_name' the way the loader does. API set names are resolved to their
+		// host first, for 'importing_name' if any. Known DLLs come from the system directory,
+		// everything else from 'app_directory', if any, then from the system search order.
+		bool FindModule(const WWuString& module_name, const WWuString& app_directory, bool wow64, WWuString& module_path, const WWuString& importing_name = WWuString());
+
+		// Drops the listing of a directory, so the next search enumerates it again.
+		void Refresh(const WWuString& directory);
+
+		// Adds, or removes a single file from a cached listing. Directories not yet enumerated are left alone.
+		void ApplyChange(const WWuString& file_path, bool exists);
+
+	private:
+		SRWLOCK _lock;
+		WWuString _system_directory;
+		WWuString _wow64_directory;
+		ApiSetSchema _api_sets;
+
+		// Lowercase file names from the 'KnownDLLs' key.
+		wumap<WWuString, bool> _known_dlls;
+		wuvector<WWuString> _search_order;
+		wuvector<WWuString> _wow64_search_order;
+		wumap<WWuString, wushared_ptr<LS_DIRECTORY_LISTING>> _listings;
+
+		wushared_ptr<LS_DIRECTORY_LISTING> GetListing(const WWuString& directory);
+		bool FindInDirectory(const WWuString& key, const WWuString& directory, WWuString& module_path);
+		void LoadKnownDlls();
+		static wushared_ptr<LS_DIRECTORY_LISTING> EnumerateDirectory(const WWuString& directory);
+	};
+}
\ No newline at end of file
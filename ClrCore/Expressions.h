@@ -14,6 +14,9 @@ using wusshared_vector = std::shared_ptr<std::vector<T>>;
 template<class T, class U>
 using wumap = std::map<T, U>;
 
+template<class T, class U, class H = std::hash<T>>
+using wuhash_map = std::unordered_map<T, U, H>;
+
 template <class T, class U>
 using wusunique_map = std::unique_ptr<std::map<T, U>>;
 
@@ -0,0 +1,372 @@
+#include "pch.h"
+
+#include "FunctionTable.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// x64 unwind operations, from the PE format documentation.
+	typedef enum _LS_UNWIND_OPERATION
+	{
+		UnwindPushNonVolatile = 0,
+		UnwindAllocLarge = 1,
+		UnwindAllocSmall = 2,
+		UnwindSetFramePointer = 3,
+		UnwindSaveNonVolatile = 4,
+		UnwindSaveNonVolatileFar = 5,
+		UnwindEpilog = 6,
+		UnwindSpareCode = 7,
+		UnwindSaveXmm128 = 8,
+		UnwindSaveXmm128Far = 9,
+		UnwindPushMachineFrame = 10
+	} LS_UNWIND_OPERATION;
+
+	#define LS_UNW_FLAG_EHANDLER 0x1
+	#define LS_UNW_FLAG_UHANDLER 0x2
+	#define LS_UNW_FLAG_CHAININFO 0x4
+
+	// How many slots an operation takes, besides its own.
+	static DWORD GetExtraSlots(BYTE operation, BYTE operation_info, BYTE version) noexcept
+	{
+		switch (operation) {
+			case UnwindAllocLarge:
+				return operation_info == 0 ? 1 : 2;
+			case UnwindSaveNonVolatile:
+			case UnwindSaveXmm128:
+				return 1;
+			case UnwindSaveNonVolatileFar:
+			case UnwindSaveXmm128Far:
+				return 2;
+
+			// Version 1 had 'save xmm', and 'save xmm far' here.
+			case UnwindEpilog:
+				return version < 2 ? 1 : 0;
+			case UnwindSpareCode:
+				return version < 2 ? 2 : 1;
+			default:
+				return 0;
+		}
+	}
+
+	FunctionIndex::FunctionIndex()
+		: _h_file(INVALID_HANDLE_VALUE), _h_map(NULL), _view(NULL), _view_size(0), _machine(0),
+			_table(NULL), _count(0), _entry_size(0), _size_of_headers(0) { }
+
+	FunctionIndex::~FunctionIndex()
+	{
+		Close();
+	}
+
+	const LSRESULT FunctionIndex::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (_h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(IMAGE_DOS_HEADER)))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		// Mapped as data. The table is searched in place, so 100K functions cost nothing to open.
+		_h_map = CreateFileMapping(_h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_h_map == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view = static_cast<const BYTE*>(MapViewOfFile(_h_map, FILE_MAP_READ, 0, 0, 0));
+		if (_view == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view_size = static_cast<ULONGLONG>(file_size.QuadPart);
+
+		const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(_view);
+		ULONGLONG nt_offset = static_cast<DWORD>(dos_header->e_lfanew);
+		if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || nt_offset + sizeof(IMAGE_NT_HEADERS64) > _view_size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		const IMAGE_NT_HEADERS64* nt_headers = reinterpret_cast<const IMAGE_NT_HEADERS64*>(_view + nt_offset);
+		if (nt_headers->Signature != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		// Only PE32+ images have a function table we can read.
+		_machine = nt_headers->FileHeader.Machine;
+		if (nt_headers->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+			return LSRESULT(ERROR_NOT_SUPPORTED, L"Only x64, and ARM64 images have a supported function table.", __FILEW__, __LINE__);
+
+		switch (_machine) {
+			case IMAGE_FILE_MACHINE_AMD64:
+				_entry_size = 3 * sizeof(DWORD);
+				break;
+			case IMAGE_FILE_MACHINE_ARM64:
+				_entry_size = 2 * sizeof(DWORD);
+				break;
+			default:
+				return LSRESULT(ERROR_NOT_SUPPORTED, L"Only x64, and ARM64 images have a supported function table.", __FILEW__, __LINE__);
+		}
+
+		ULONGLONG section_offset = nt_offset + FIELD_OFFSET(IMAGE_NT_HEADERS64, OptionalHeader) + nt_headers->FileHeader.SizeOfOptionalHeader;
+		ULONGLONG section_end = section_offset + (static_cast<ULONGLONG>(nt_headers->FileHeader.NumberOfSections) * sizeof(IMAGE_SECTION_HEADER));
+		if (section_end > _view_size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Section table is outside the file.", __FILEW__, __LINE__);
+
+		const IMAGE_SECTION_HEADER* sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(_view + section_offset);
+		_sections.assign(sections, sections + nt_headers->FileHeader.NumberOfSections);
+		_size_of_headers = nt_headers->OptionalHeader.SizeOfHeaders;
+
+		if (nt_headers->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXCEPTION)
+			return LSRESULT();
+
+		IMAGE_DATA_DIRECTORY directory = nt_headers->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+		if (directory.VirtualAddress == 0 || directory.Size < _entry_size)
+			return LSRESULT();
+
+		_table = GetData(directory.VirtualAddress, directory.Size - (directory.Size % _entry_size));
+		if (_table == NULL)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Exception directory is outside the file.", __FILEW__, __LINE__);
+
+		_count = directory.Size / _entry_size;
+
+		return LSRESULT();
+	}
+
+	void FunctionIndex::Close() noexcept
+	{
+		if (_view != NULL) {
+			UnmapViewOfFile(_view);
+			_view = NULL;
+		}
+
+		if (_h_map != NULL) {
+			CloseHandle(_h_map);
+			_h_map = NULL;
+		}
+
+		if (_h_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_h_file);
+			_h_file = INVALID_HANDLE_VALUE;
+		}
+
+		_table = NULL;
+		_count = 0;
+		_sections.clear();
+	}
+
+	bool FunctionIndex::GetFunction(DWORD index, LS_FUNCTION_RANGE& function) const noexcept
+	{
+		if (index >= _count)
+			return false;
+
+		const DWORD* entry = reinterpret_cast<const DWORD*>(_table + (static_cast<size_t>(index) * _entry_size));
+		function.Index = index;
+		function.BeginAddress = entry[0];
+		if (_machine == IMAGE_FILE_MACHINE_AMD64) {
+			function.EndAddress = entry[1];
+			function.UnwindData = entry[2];
+
+			return true;
+		}
+
+		// ARM64 entries have no end. It's in the packed data, or in the .xdata header.
+		function.UnwindData = entry[1];
+		DWORD length = 0;
+		if ((function.UnwindData & 3) != 0)
+			length = ((function.UnwindData >> 2) & 0x7FF) * 4;
+		else {
+			const BYTE* xdata = GetData(function.UnwindData, sizeof(DWORD));
+			if (xdata != NULL)
+				length = (*reinterpret_cast<const DWORD*>(xdata) & 0x3FFFF) * 4;
+		}
+
+		function.EndAddress = function.BeginAddress + length;
+
+		return true;
+	}
+
+	bool FunctionIndex::Lookup(DWORD rva, LS_FUNCTION_RANGE& function) const noexcept
+	{
+		// The last function that begins at, or before 'rva'.
+		DWORD low = 0;
+		DWORD high = _count;
+		while (low < high) {
+			DWORD middle = low + ((high - low) / 2);
+			if (GetBeginAddress(middle) <= rva)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		if (low == 0 || !GetFunction(low - 1, function))
+			return false;
+
+		return rva < function.EndAddress;
+	}
+
+	void FunctionIndex::LookupBatch(const wuvector<DWORD>& rvas, wuvector<LS_FUNCTION_MATCH>& matches) const
+	{
+		matches.clear();
+		matches.resize(rvas.size());
+
+		wuvector<DWORD> order(rvas.size());
+		for (DWORD i = 0; i < order.size(); i++)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), [&rvas](DWORD left, DWORD right) {
+			return rvas[left] < rvas[right];
+		});
+
+		// Both sides are sorted, so the table cursor only moves forward.
+		DWORD cursor = 0;
+		for (DWORD query : order) {
+			DWORD rva = rvas[query];
+			LS_FUNCTION_MATCH& match = matches[query];
+			match.Rva = rva;
+			match.Found = false;
+			match.Function = LS_FUNCTION_RANGE();
+
+			while (cursor + 1 < _count && GetBeginAddress(cursor + 1) <= rva)
+				cursor++;
+
+			if (_count == 0 || GetBeginAddress(cursor) > rva)
+				continue;
+
+			if (GetFunction(cursor, match.Function))
+				match.Found = rva < match.Function.EndAddress;
+		}
+	}
+
+	const LSRESULT FunctionIndex::GetUnwindInfo(const LS_FUNCTION_RANGE& function, LS_UNWIND_INFO& unwind_info) const
+	{
+		unwind_info = LS_UNWIND_INFO();
+		unwind_info.Machine = _machine;
+
+		if (_machine == IMAGE_FILE_MACHINE_ARM64 && (function.UnwindData & 3) != 0) {
+			// Packed. Flag, function length, RegF, RegI, H, CR, and the frame size, in the entry itself.
+			unwind_info.IsPacked = true;
+			unwind_info.Flags = static_cast<BYTE>(function.UnwindData & 3);
+			unwind_info.FunctionLength = ((function.UnwindData >> 2) & 0x7FF) * 4;
+			unwind_info.FrameSize = ((function.UnwindData >> 23) & 0x1FF) * 16;
+
+			return LSRESULT();
+		}
+
+		const BYTE* header = GetData(function.UnwindData, sizeof(DWORD));
+		if (header == NULL)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Unwind data is outside the file.", __FILEW__, __LINE__);
+
+		if (_machine == IMAGE_FILE_MACHINE_ARM64) {
+			DWORD word = *reinterpret_cast<const DWORD*>(header);
+			unwind_info.FunctionLength = (word & 0x3FFFF) * 4;
+			unwind_info.Version = static_cast<BYTE>((word >> 18) & 3);
+			bool has_handler = ((word >> 20) & 1) != 0;
+			bool single_epilog = ((word >> 21) & 1) != 0;
+			unwind_info.Flags = static_cast<BYTE>((has_handler ? 1 : 0) | (single_epilog ? 2 : 0));
+			DWORD epilog_count = (word >> 22) & 0x1F;
+			DWORD code_words = (word >> 27) & 0x1F;
+			DWORD offset = sizeof(DWORD);
+
+			// Counts too big for the header are in an extension word.
+			if (epilog_count == 0 && code_words == 0) {
+				const BYTE* extension = GetData(function.UnwindData + offset, sizeof(DWORD));
+				if (extension == NULL)
+					return LSRESULT(ERROR_BAD_FORMAT, L"Unwind data is outside the file.", __FILEW__, __LINE__);
+
+				word = *reinterpret_cast<const DWORD*>(extension);
+				epilog_count = word & 0xFFFF;
+				code_words = (word >> 16) & 0xFF;
+				offset += sizeof(DWORD);
+			}
+
+			// With 'E' set, the count is the index of the single epilog's first code, not a count of scopes.
+			unwind_info.EpilogCount = single_epilog ? 1 : epilog_count;
+			if (!single_epilog)
+				offset += epilog_count * sizeof(DWORD);
+
+			const BYTE* codes = GetData(function.UnwindData + offset, code_words * sizeof(DWORD));
+			if (codes == NULL)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Unwind data is outside the file.", __FILEW__, __LINE__);
+
+			unwind_info.CodeBytes.assign(codes, codes + (code_words * sizeof(DWORD)));
+			offset += code_words * sizeof(DWORD);
+
+			if (has_handler) {
+				const BYTE* handler = GetData(function.UnwindData + offset, sizeof(DWORD));
+				unwind_info.HasExceptionHandler = handler != NULL;
+				if (handler != NULL)
+					unwind_info.ExceptionHandlerRva = *reinterpret_cast<const DWORD*>(handler);
+			}
+
+			return LSRESULT();
+		}
+
+		// x64 UNWIND_INFO.
+		unwind_info.Version = header[0] & 0x7;
+		unwind_info.Flags = header[0] >> 3;
+		unwind_info.PrologSize = header[1];
+		unwind_info.FrameRegister = header[3] & 0xF;
+		unwind_info.FrameOffset = header[3] >> 4;
+
+		// Slots are padded to an even count.
+		DWORD slot_count = header[2];
+		DWORD slots_size = ((slot_count + 1) & ~static_cast<DWORD>(1)) * sizeof(WORD);
+		const BYTE* slot_data = GetData(function.UnwindData + sizeof(DWORD), slot_count * sizeof(WORD));
+		if (slot_data == NULL)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Unwind data is outside the file.", __FILEW__, __LINE__);
+
+		const WORD* slots = reinterpret_cast<const WORD*>(slot_data);
+		for (DWORD i = 0; i < slot_count; i++) {
+			LS_UNWIND_CODE code{ };
+			code.CodeOffset = static_cast<BYTE>(slots[i] & 0xFF);
+			code.Operation = static_cast<BYTE>((slots[i] >> 8) & 0xF);
+			code.OperationInfo = static_cast<BYTE>(slots[i] >> 12);
+
+			DWORD extra = GetExtraSlots(code.Operation, code.OperationInfo, unwind_info.Version);
+			if (i + extra >= slot_count)
+				extra = 0;
+			if (extra == 1)
+				code.Operand = slots[i + 1];
+			else if (extra == 2)
+				code.Operand = MAKELONG(slots[i + 1], slots[i + 2]);
+
+			unwind_info.Codes.push_back(code);
+			i += extra;
+		}
+
+		DWORD trailer = function.UnwindData + sizeof(DWORD) + slots_size;
+		if ((unwind_info.Flags & LS_UNW_FLAG_CHAININFO) != 0) {
+			const BYTE* chained = GetData(trailer, 3 * sizeof(DWORD));
+			unwind_info.IsChained = chained != NULL;
+			if (chained != NULL)
+				unwind_info.ChainedFunctionRva = *reinterpret_cast<const DWORD*>(chained);
+		}
+		else if ((unwind_info.Flags & (LS_UNW_FLAG_EHANDLER | LS_UNW_FLAG_UHANDLER)) != 0) {
+			const BYTE* handler = GetData(trailer, sizeof(DWORD));
+			unwind_info.HasExceptionHandler = handler != NULL;
+			if (handler != NULL)
+				unwind_info.ExceptionHandlerRva = *reinterpret_cast<const DWORD*>(handler);
+		}
+
+		return LSRESULT();
+	}
+
+	DWORD FunctionIndex::GetBeginAddress(DWORD index) const noexcept
+	{
+		return *reinterpret_cast<const DWORD*>(_table + (static_cast<size_t>(index) * _entry_size));
+	}
+
+	const BYTE* FunctionIndex::GetData(DWORD rva, DWORD size) const noexcept
+	{
+		DWORD offset;
+		if (_view == NULL || !PeHelper::RvaToOffset(rva, _sections.data(), static_cast<DWORD>(_sections.size()), _size_of_headers, offset))
+			return NULL;
+
+		if (static_cast<ULONGLONG>(offset) + size > _view_size)
+			return NULL;
+
+		return _view + offset;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "PeHelper.h"
+
+namespace LibSnitcher::Core
+{
+	typedef struct _LS_FUNCTION_RANGE
+	{
+		DWORD Index;
+		DWORD BeginAddress;
+		DWORD EndAddress;
+
+		// x64: the UNWIND_INFO RVA. ARM64: the .xdata RVA, or the packed unwind data if the low bits are set.
+		DWORD UnwindData;
+
+	} LS_FUNCTION_RANGE, *PLS_FUNCTION_RANGE;
+
+	typedef struct _LS_FUNCTION_MATCH
+	{
+		DWORD Rva;
+		bool Found;
+		LS_FUNCTION_RANGE Function;
+
+	} LS_FUNCTION_MATCH, *PLS_FUNCTION_MATCH;
+
+	// An x64 UNWIND_CODE. 'Operand' is the one, or two extra slots some operations take.
+	typedef struct _LS_UNWIND_CODE
+	{
+		BYTE CodeOffset;
+		BYTE Operation;
+		BYTE OperationInfo;
+		DWORD Operand;
+
+	} LS_UNWIND_CODE, *PLS_UNWIND_CODE;
+
+	typedef struct _LS_UNWIND_INFO
+	{
+		WORD Machine;
+		BYTE Version;
+
+		// x64 UNW_FLAG_*. For ARM64 the 'X', and 'E' bits of the .xdata header.
+		BYTE Flags;
+		BYTE PrologSize;
+		BYTE FrameRegister;
+		BYTE FrameOffset;
+		bool HasExceptionHandler;
+		DWORD ExceptionHandlerRva;
+		bool IsChained;
+		DWORD ChainedFunctionRva;
+		wuvector<LS_UNWIND_CODE> Codes;
+
+		// ARM64. Packed unwind data has no .xdata, only the frame size, and register counts.
+		bool IsPacked;
+		DWORD FunctionLength;
+		DWORD FrameSize;
+		DWORD EpilogCount;
+		wuvector<BYTE> CodeBytes;
+
+		_LS_UNWIND_INFO()
+			: Machine(0), Version(0), Flags(0), PrologSize(0), FrameRegister(0), FrameOffset(0), HasExceptionHandler(false), ExceptionHandlerRva(0),
+				IsChained(false), ChainedFunctionRva(0), IsPacked(false), FunctionLength(0), FrameSize(0), EpilogCount(0) { }
+
+		~_LS_UNWIND_INFO() { }
+
+	} LS_UNWIND_INFO, *PLS_UNWIND_INFO;
+
+	// Index over the exception directory of an x64, or ARM64 image. The file is mapped
+	// as data, and the table is searched where it is. The loader requires it sorted by
+	// begin address, so there's nothing to build. Unwind data is decoded when asked for.
+	class FunctionIndex
+	{
+	public:
+		FunctionIndex();
+		~FunctionIndex();
+
+		// Images without an exception directory open with zero functions.
+		const LSRESULT Open(const WWuString& file_path);
+		void Close() noexcept;
+
+		_NODISCARD DWORD Count() const noexcept { return _count; }
+		_NODISCARD WORD Machine() const noexcept { return _machine; }
+
+		bool GetFunction(DWORD index, LS_FUNCTION_RANGE& function) const noexcept;
+
+		// Binary search. O(log n).
+		bool Lookup(DWORD rva, LS_FUNCTION_RANGE& function) const noexcept;
+
+		// Sorts the queries, and merges them with the table in one pass. Matches are in query order.
+		void LookupBatch(const wuvector<DWORD>& rvas, wuvector<LS_FUNCTION_MATCH>& matches) const;
+
+		const LSRESULT GetUnwindInfo(const LS_FUNCTION_RANGE& function, LS_UNWIND_INFO& unwind_info) const;
+
+	private:
+		HANDLE _h_file;
+		HANDLE _h_map;
+		const BYTE* _view;
+		ULONGLONG _view_size;
+		WORD _machine;
+		const BYTE* _table;
+		DWORD _count;
+		DWORD _entry_size;
+		DWORD _size_of_headers;
+		wuvector<IMAGE_SECTION_HEADER> _sections;
+
+		DWORD GetBeginAddress(DWORD index) const noexcept;
+
+		// Data at 'rva', if 'size' bytes of it are in the file.
+		const BYTE* GetData(DWORD rva, DWORD size) const noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "pch.h"
+
+#include "ImageCache.h"
+
+namespace LibSnitcher::Core
+{
+	ImageCache::ImageCache()
+	{
+		InitializeSRWLock(&_lock);
+	}
+
+	ImageCache::~ImageCache() { }
+
+	bool ImageCache::Lookup(const WWuString& image_path, wushared_ptr<LS_CACHED_IMAGE>& image)
+	{
+		WWuString key = image_path.ToLower();
+
+		AcquireSRWLockShared(&_lock);
+		auto cached = _images.find(key);
+		if (cached == _images.end()) {
+			ReleaseSRWLockShared(&_lock);
+			return false;
+		}
+
+		wushared_ptr<LS_CACHED_IMAGE> candidate = cached->second;
+		ReleaseSRWLockShared(&_lock);
+
+		// A stat is way cheaper than parsing again, and tells us if the file changed.
+		ULONGLONG file_size;
+		FILETIME last_write_time;
+		if (!GetFileIdentity(image_path, file_size, last_write_time) ||
+			file_size != candidate->FileSize ||
+			CompareFileTime(&last_write_time, &candidate->LastWriteTime) != 0)
+		{
+			Evict(image_path);
+			return false;
+		}
+
+		image = candidate;
+		return true;
+	}
+
+	void ImageCache::Insert(const wushared_ptr<LS_CACHED_IMAGE>& image)
+	{
+		WWuString key = image->Path.ToLower();
+
+		AcquireSRWLockExclusive(&_lock);
+		EvictUnlocked(key);
+		_images.emplace(key, image);
+		for (WuString& dependency : image->BasicInfo.Dependencies)
+			_importers[WuStringToWide(dependency).ToLower()].emplace(key, image->Path);
+
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	void ImageCache::Evict(const WWuString& image_path)
+	{
+		WWuString key = image_path.ToLower();
+
+		AcquireSRWLockExclusive(&_lock);
+		EvictUnlocked(key);
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	void ImageCache::GetReverseDependencies(const WWuString& module_name, wuvector<WWuString>& importers)
+	{
+		WWuString key = module_name.ToLower();
+
+		AcquireSRWLockShared(&_lock);
+		auto entry = _importers.find(key);
+		if (entry != _importers.end()) {
+			for (auto& importer : entry->second)
+				importers.push_back(importer.second);
+		}
+		ReleaseSRWLockShared(&_lock);
+	}
+
+	size_t ImageCache::Count()
+	{
+		AcquireSRWLockShared(&_lock);
+		size_t count = _images.size();
+		ReleaseSRWLockShared(&_lock);
+
+		return count;
+	}
+
+	bool ImageCache::GetFileIdentity(const WWuString& file_path, ULONGLONG& file_size, FILETIME& last_write_time) noexcept
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesEx(file_path.GetBuffer(), GetFileExInfoStandard, &attributes))
+			return false;
+
+		file_size = (static_cast<ULONGLONG>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+		last_write_time = attributes.ftLastWriteTime;
+
+		return true;
+	}
+
+	void ImageCache::EvictUnlocked(const WWuString& key)
+	{
+		auto cached = _images.find(key);
+		if (cached == _images.end())
+			return;
+
+		for (WuString& dependency : cached->second->BasicInfo.Dependencies) {
+			auto entry = _importers.find(WuStringToWide(dependency).ToLower());
+			if (entry != _importers.end()) {
+				entry->second.erase(key);
+				if (entry->second.empty())
+					_importers.erase(entry);
+			}
+		}
+
+		_images.erase(cached);
+	}
+}
\ No newline at end of file
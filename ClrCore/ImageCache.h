@@ -0,0 +1,84 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "PeHelper.h"
+#include "Resources.h"
+#include "Manifest.h"
+#include "LoadCost.h"
+
+namespace LibSnitcher::Core
+{
+	// What we keep from a parsed image. The file size, and last write time
+	// identify the version of the file the entry was built from.
+	typedef struct _LS_CACHED_IMAGE
+	{
+		WWuString Path;
+		ULONGLONG FileSize;
+		FILETIME LastWriteTime;
+		LONG Result;
+		WORD Machine;
+		WORD Magic;
+		WORD Characteristics;
+		WORD Subsystem;
+		DWORD TimeDateStamp;
+		DWORD SizeOfImage;
+		DWORD CheckSum;
+		PeHelper::LS_IMAGE_BASIC_INFORMATION BasicInfo;
+
+		// Symbols are only collected when asked for.
+		bool HasSymbols;
+		PeHelper::LS_IMAGE_SYMBOLS Symbols;
+
+		// Module names from the read-only data, only scanned when asked for.
+		bool HasHeuristicDependencies;
+		wuvector<WuString> HeuristicDependencies;
+
+		// From RT_VERSION, read while the image is mapped for the imports.
+		bool HasVersion;
+		LS_VERSION_INFO Version;
+
+		// The 'dependentAssembly' identities from the embedded manifest. The image activation context.
+		wuvector<LS_ASSEMBLY_IDENTITY> SxsDependencies;
+
+		// Relocations, TLS, and load config, for load cost reports.
+		LS_LOAD_COST LoadCost;
+
+		_LS_CACHED_IMAGE()
+			: FileSize(0), LastWriteTime(), Result(ERROR_SUCCESS), Machine(0), Magic(0),
+				Characteristics(0), Subsystem(0), TimeDateStamp(0), SizeOfImage(0), CheckSum(0), HasSymbols(false), HasHeuristicDependencies(false), HasVersion(false), LoadCost() { }
+
+		~_LS_CACHED_IMAGE() { }
+
+	} LS_CACHED_IMAGE, *PLS_CACHED_IMAGE;
+
+	// Thread-safe cache of parsed images, keyed by path.
+	// It also keeps a reverse index, from a dependency name to the images importing it.
+	class ImageCache
+	{
+	public:
+		ImageCache();
+		~ImageCache();
+
+		// Returns false if the image is not cached, or if the file changed since it was.
+		bool Lookup(const WWuString& image_path, wushared_ptr<LS_CACHED_IMAGE>& image);
+		void Insert(const wushared_ptr<LS_CACHED_IMAGE>& image);
+		void Evict(const WWuString& image_path);
+
+		// Lists the path of every cached image that imports 'module_name'.
+		void GetReverseDependencies(const WWuString& module_name, wuvector<WWuString>& importers);
+
+		_NODISCARD size_t Count();
+
+		static bool GetFileIdentity(const WWuString& file_path, ULONGLONG& file_size, FILETIME& last_write_time) noexcept;
+
+	private:
+		SRWLOCK _lock;
+		wumap<WWuString, wushared_ptr<LS_CACHED_IMAGE>> _images;
+		wumap<WWuString, wumap<WWuString, WWuString>> _importers;
+
+		void EvictUnlocked(const WWuString& key);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "pch.h"
+
+#include "ImageHasher.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+#ifndef NT_SUCCESS
+#define NT_SUCCESS(status) (((NTSTATUS)(status)) >= 0)
+#endif
+
+namespace LibSnitcher::Core
+{
+	static constexpr DWORD NoRegion = MAXDWORD;
+	static const BYTE ZeroPage[LS_HASH_PAGE_SIZE] = { 0 };
+
+	// A span of the file that goes into the Authenticode digest. Spans in the same
+	// region are paged together, from 'RegionStart'. Region zero are the headers,
+	// the sections follow. 'NoRegion' spans are not paged.
+	typedef struct _LS_HASH_RANGE
+	{
+		ULONGLONG Start;
+		ULONGLONG End;
+		DWORD Region;
+		ULONGLONG RegionStart;
+
+	} LS_HASH_RANGE, *PLS_HASH_RANGE;
+
+	class HashState
+	{
+	public:
+		HashState()
+			: _handle(NULL) { }
+
+		~HashState() { Close(); }
+
+		NTSTATUS Open(BCRYPT_ALG_HANDLE algorithm) noexcept
+		{
+			Close();
+			return BCryptCreateHash(algorithm, &_handle, NULL, 0, NULL, 0, 0);
+		}
+
+		NTSTATUS Update(const BYTE* data, size_t size) noexcept
+		{
+			// 'BCryptHashData' takes a ULONG size.
+			while (size > 0) {
+				ULONG chunk = static_cast<ULONG>(min(size, static_cast<size_t>(MAXLONG)));
+				NTSTATUS status = BCryptHashData(_handle, const_cast<PUCHAR>(data), chunk, 0);
+				if (!NT_SUCCESS(status))
+					return status;
+
+				data += chunk;
+				size -= chunk;
+			}
+
+			return 0;
+		}
+
+		NTSTATUS Finish(BYTE* output, ULONG size) noexcept
+		{
+			NTSTATUS status = BCryptFinishHash(_handle, output, size, 0);
+			Close();
+
+			return status;
+		}
+
+		void Close() noexcept
+		{
+			if (_handle != NULL)
+				BCryptDestroyHash(_handle);
+
+			_handle = NULL;
+		}
+
+		_NODISCARD bool IsOpen() const noexcept { return _handle != NULL; }
+
+	private:
+		BCRYPT_HASH_HANDLE _handle;
+	};
+
+	// Hashes each page of a region separately, padding the last one with zeros.
+	class PageHasher
+	{
+	public:
+		PageHasher(BCRYPT_ALG_HANDLE algorithm, ULONG digest_size, wuvector<LS_PAGE_DIGEST>* output)
+			: _algorithm(algorithm), _digest_size(digest_size), _output(output), _region(NoRegion), _page_start(0), _fed(0) { }
+
+		NTSTATUS Feed(DWORD region, ULONGLONG region_start, ULONGLONG offset, const BYTE* data, size_t size) noexcept
+		{
+			while (size > 0) {
+				ULONGLONG page_start = region_start + (((offset - region_start) / LS_HASH_PAGE_SIZE) * LS_HASH_PAGE_SIZE);
+				if (!_state.IsOpen() || region != _region || page_start != _page_start) {
+					NTSTATUS status = Flush();
+					if (NT_SUCCESS(status))
+						status = _state.Open(_algorithm);
+					if (!NT_SUCCESS(status))
+						return status;
+
+					_region = region;
+					_page_start = page_start;
+					_fed = 0;
+				}
+
+				size_t take = static_cast<size_t>(min(static_cast<ULONGLONG>(size), page_start + LS_HASH_PAGE_SIZE - offset));
+				NTSTATUS status = _state.Update(data, take);
+				if (!NT_SUCCESS(status))
+					return status;
+
+				_fed += take;
+				offset += take;
+				data += take;
+				size -= take;
+			}
+
+			return 0;
+		}
+
+		NTSTATUS Finish(ULONGLONG end_offset) noexcept
+		{
+			NTSTATUS status = Flush();
+			if (NT_SUCCESS(status))
+				_output->push_back({ static_cast<DWORD>(end_offset), { 0 } });
+
+			return status;
+		}
+
+	private:
+		BCRYPT_ALG_HANDLE _algorithm;
+		ULONG _digest_size;
+		wuvector<LS_PAGE_DIGEST>* _output;
+		HashState _state;
+		DWORD _region;
+		ULONGLONG _page_start;
+		size_t _fed;
+
+		NTSTATUS Flush() noexcept
+		{
+			if (!_state.IsOpen())
+				return 0;
+
+			NTSTATUS status = _fed < LS_HASH_PAGE_SIZE ? _state.Update(ZeroPage, LS_HASH_PAGE_SIZE - _fed) : 0;
+			if (!NT_SUCCESS(status))
+				return status;
+
+			LS_PAGE_DIGEST page = { static_cast<DWORD>(_page_start), { 0 } };
+			status = _state.Finish(page.Digest, _digest_size);
+			if (NT_SUCCESS(status))
+				_output->push_back(page);
+
+			return status;
+		}
+	};
+
+	// Double buffered overlapped reads. The next chunk is read while the caller works on the current one.
+	class ChunkReader
+	{
+	public:
+		ChunkReader(BYTE* buffers[2])
+			: _file(INVALID_HANDLE_VALUE), _file_size(0), _current(1), _issued(-1), _issued_size(0), _overlapped()
+		{
+			_buffers[0] = buffers[0];
+			_buffers[1] = buffers[1];
+			_overlapped[0].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+			_overlapped[1].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		}
+
+		~ChunkReader()
+		{
+			Close();
+			if (_overlapped[0].hEvent != NULL)
+				CloseHandle(_overlapped[0].hEvent);
+			if (_overlapped[1].hEvent != NULL)
+				CloseHandle(_overlapped[1].hEvent);
+		}
+
+		const LSRESULT Open(const WWuString& file_path, ULONGLONG& file_size)
+		{
+			if (_overlapped[0].hEvent == NULL || _overlapped[1].hEvent == NULL)
+				return LSRESULT(ERROR_NOT_ENOUGH_MEMORY, __FILEW__, __LINE__);
+
+			_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+				FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+			if (_file == INVALID_HANDLE_VALUE)
+				return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(_file, &size))
+				return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+			_file_size = static_cast<ULONGLONG>(size.QuadPart);
+			file_size = _file_size;
+
+			return LSRESULT();
+		}
+
+		bool Issue(ULONGLONG offset) noexcept
+		{
+			int slot = 1 - _current;
+			OVERLAPPED& overlapped = _overlapped[slot];
+			HANDLE h_event = overlapped.hEvent;
+			ZeroMemory(&overlapped, sizeof(OVERLAPPED));
+			overlapped.hEvent = h_event;
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			_issued_size = static_cast<DWORD>(min(static_cast<ULONGLONG>(LS_HASH_CHUNK_SIZE), _file_size - offset));
+			if (!ReadFile(_file, _buffers[slot], _issued_size, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+				return false;
+
+			_issued = slot;
+			return true;
+		}
+
+		// The file changing size while we read is an error.
+		bool Wait(BYTE*& data, DWORD& size) noexcept
+		{
+			if (_issued < 0)
+				return false;
+
+			DWORD transferred = 0;
+			BOOL completed = GetOverlappedResult(_file, &_overlapped[_issued], &transferred, TRUE);
+			_current = _issued;
+			_issued = -1;
+			if (!completed)
+				return false;
+
+			if (transferred != _issued_size) {
+				SetLastError(ERROR_HANDLE_EOF);
+				return false;
+			}
+
+			data = _buffers[_current];
+			size = transferred;
+
+			return true;
+		}
+
+		void Close() noexcept
+		{
+			if (_file == INVALID_HANDLE_VALUE)
+				return;
+
+			// The buffers outlive us, a read can't be left writing into them.
+			if (_issued >= 0) {
+				DWORD transferred;
+				CancelIoEx(_file, &_overlapped[_issued]);
+				GetOverlappedResult(_file, &_overlapped[_issued], &transferred, TRUE);
+				_issued = -1;
+			}
+
+			CloseHandle(_file);
+			_file = INVALID_HANDLE_VALUE;
+		}
+
+	private:
+		HANDLE _file;
+		ULONGLONG _file_size;
+		BYTE* _buffers[2];
+		int _current;
+		int _issued;
+		DWORD _issued_size;
+		OVERLAPPED _overlapped[2];
+	};
+
+	// Adds a span, leaving out the certificate table.
+	static void AddRange(wuvector<LS_HASH_RANGE>& ranges, ULONGLONG start, ULONGLONG end, DWORD region, ULONGLONG region_start, ULONGLONG cert_start, ULONGLONG cert_end)
+	{
+		if (cert_end > cert_start && start < cert_end && cert_start < end) {
+			AddRange(ranges, start, cert_start, region, region_start, 0, 0);
+			AddRange(ranges, cert_end, end, region, region_start, 0, 0);
+			return;
+		}
+
+		if (start < end)
+			ranges.push_back({ start, end, region, region_start });
+	}
+
+	ImageHasher::ImageHasher()
+		: _sha1(NULL), _sha256(NULL)
+	{
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&_sha1, BCRYPT_SHA1_ALGORITHM, NULL, 0)))
+			_sha1 = NULL;
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&_sha256, BCRYPT_SHA256_ALGORITHM, NULL, 0)))
+			_sha256 = NULL;
+
+		// Page aligned, so the reads are too.
+		_buffers[0] = static_cast<BYTE*>(VirtualAlloc(NULL, LS_HASH_CHUNK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		_buffers[1] = static_cast<BYTE*>(VirtualAlloc(NULL, LS_HASH_CHUNK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	}
+
+	ImageHasher::~ImageHasher()
+	{
+		if (_sha1 != NULL)
+			BCryptCloseAlgorithmProvider(_sha1, 0);
+		if (_sha256 != NULL)
+			BCryptCloseAlgorithmProvider(_sha256, 0);
+		if (_buffers[0] != NULL)
+			VirtualFree(_buffers[0], 0, MEM_RELEASE);
+		if (_buffers[1] != NULL)
+			VirtualFree(_buffers[1], 0, MEM_RELEASE);
+	}
+
+	const LSRESULT ImageHasher::HashFile(const WWuString& file_path, LS_PAGE_HASH_ALGORITHM page_algorithm, PLS_IMAGE_DIGEST digest)
+	{
+		if (_sha1 == NULL || _sha256 == NULL || _buffers[0] == NULL || _buffers[1] == NULL)
+			return LSRESULT(ERROR_NOT_ENOUGH_MEMORY, __FILEW__, __LINE__);
+
+		*digest = LS_IMAGE_DIGEST();
+		digest->PageAlgorithm = page_algorithm;
+
+		ChunkReader reader(_buffers);
+		ULONGLONG file_size = 0;
+		LSRESULT result = reader.Open(file_path, file_size);
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		digest->FileSize = file_size;
+		if (file_size < sizeof(IMAGE_DOS_HEADER))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		// The headers come from the first chunk, we don't read them separately.
+		BYTE* data = NULL;
+		DWORD size = 0;
+		if (!reader.Issue(0) || !reader.Wait(data, size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(data);
+		ULONGLONG nt_offset = static_cast<DWORD>(dos_header->e_lfanew);
+		if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || nt_offset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + sizeof(WORD) > size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		if (*reinterpret_cast<DWORD*>(data + nt_offset) != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		PIMAGE_FILE_HEADER file_header = reinterpret_cast<PIMAGE_FILE_HEADER>(data + nt_offset + sizeof(DWORD));
+		ULONGLONG opt_offset = nt_offset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+		ULONGLONG section_offset = opt_offset + file_header->SizeOfOptionalHeader;
+		WORD section_count = file_header->NumberOfSections;
+		bool pe32 = *reinterpret_cast<WORD*>(data + opt_offset) == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		ULONGLONG directory_offset = opt_offset + (pe32 ? 96 : 112);
+
+		// Everything we read from the headers has to be in the first chunk.
+		if (file_header->SizeOfOptionalHeader < (pe32 ? 96 : 112) || section_offset + (static_cast<ULONGLONG>(section_count) * sizeof(IMAGE_SECTION_HEADER)) > size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Image headers are too large.", __FILEW__, __LINE__);
+
+		// 'CheckSum', 'SizeOfHeaders', and 'NumberOfRvaAndSizes' are at the same offset for PE32, and PE32+, until the directories.
+		ULONGLONG checksum_offset = opt_offset + 64;
+		DWORD size_of_headers = *reinterpret_cast<DWORD*>(data + opt_offset + 60);
+		DWORD directory_count = *reinterpret_cast<DWORD*>(data + directory_offset - sizeof(DWORD));
+		digest->HeaderCheckSum = *reinterpret_cast<DWORD*>(data + checksum_offset);
+
+		ULONGLONG cert_entry_offset = directory_offset + (IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY));
+		bool has_cert_entry = directory_count > IMAGE_DIRECTORY_ENTRY_SECURITY && cert_entry_offset + sizeof(IMAGE_DATA_DIRECTORY) <= section_offset;
+		ULONGLONG cert_start = 0;
+		ULONGLONG cert_end = 0;
+		if (has_cert_entry) {
+			// The certificate table entry holds a file offset, not an RVA.
+			PIMAGE_DATA_DIRECTORY cert_entry = reinterpret_cast<PIMAGE_DATA_DIRECTORY>(data + cert_entry_offset);
+			if (cert_entry->VirtualAddress != 0 && cert_entry->Size != 0 && cert_entry->VirtualAddress < file_size) {
+				digest->CertificateTableOffset = cert_entry->VirtualAddress;
+				digest->CertificateTableSize = cert_entry->Size;
+				cert_start = cert_entry->VirtualAddress;
+				cert_end = min(cert_start + cert_entry->Size, file_size);
+			}
+		}
+
+		// Building the spans. Overlapping sections are hashed once.
+		wuvector<LS_HASH_RANGE> ranges;
+		ULONGLONG header_end = min(static_cast<ULONGLONG>(size_of_headers), file_size);
+		if (has_cert_entry) {
+			AddRange(ranges, 0, min(checksum_offset, header_end), 0, 0, cert_start, cert_end);
+			AddRange(ranges, checksum_offset + sizeof(DWORD), min(cert_entry_offset, header_end), 0, 0, cert_start, cert_end);
+			AddRange(ranges, cert_entry_offset + sizeof(IMAGE_DATA_DIRECTORY), header_end, 0, 0, cert_start, cert_end);
+		}
+		else {
+			AddRange(ranges, 0, min(checksum_offset, header_end), 0, 0, cert_start, cert_end);
+			AddRange(ranges, checksum_offset + sizeof(DWORD), header_end, 0, 0, cert_start, cert_end);
+		}
+
+		wuvector<IMAGE_SECTION_HEADER> sections(reinterpret_cast<PIMAGE_SECTION_HEADER>(data + section_offset),
+			reinterpret_cast<PIMAGE_SECTION_HEADER>(data + section_offset) + section_count);
+
+		std::sort(sections.begin(), sections.end(), [](const IMAGE_SECTION_HEADER& left, const IMAGE_SECTION_HEADER& right) {
+			return left.PointerToRawData < right.PointerToRawData;
+		});
+
+		ULONGLONG sections_end = header_end;
+		for (DWORD i = 0; i < sections.size(); i++) {
+			if (sections[i].SizeOfRawData == 0)
+				continue;
+
+			ULONGLONG start = max(static_cast<ULONGLONG>(sections[i].PointerToRawData), sections_end);
+			ULONGLONG end = min(static_cast<ULONGLONG>(sections[i].PointerToRawData) + sections[i].SizeOfRawData, file_size);
+			AddRange(ranges, start, end, i + 1, sections[i].PointerToRawData, cert_start, cert_end);
+			sections_end = max(sections_end, end);
+		}
+
+		AddRange(ranges, sections_end, file_size, NoRegion, 0, cert_start, cert_end);
+
+		// Hashing.
+		HashState sha1;
+		HashState sha256;
+		NTSTATUS status = sha1.Open(_sha1);
+		if (NT_SUCCESS(status))
+			status = sha256.Open(_sha256);
+		if (!NT_SUCCESS(status))
+			return LSRESULT(status, __FILEW__, __LINE__, true);
+
+		PageHasher pages(page_algorithm == PageHashSha1 ? _sha1 : _sha256, page_algorithm == PageHashSha1 ? LS_SHA1_SIZE : LS_SHA256_SIZE, &digest->PageDigests);
+		ULONGLONG checksum_sum = 0;
+		ULONGLONG chunk_offset = 0;
+		size_t range_index = 0;
+		while (true) {
+			ULONGLONG chunk_end = chunk_offset + size;
+			bool more = chunk_end < file_size;
+			if (more && !reader.Issue(chunk_end))
+				return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+			// The checksum counts the checksum field as zero. We don't hash it either.
+			for (ULONGLONG offset = checksum_offset; offset < checksum_offset + sizeof(DWORD); offset++) {
+				if (offset >= chunk_offset && offset < chunk_end)
+					data[offset - chunk_offset] = 0;
+			}
+
+			checksum_sum += SumWords(data, size);
+
+			while (range_index < ranges.size() && ranges[range_index].Start < chunk_end) {
+				const LS_HASH_RANGE& range = ranges[range_index];
+				ULONGLONG start = max(range.Start, chunk_offset);
+				ULONGLONG end = min(range.End, chunk_end);
+				if (start < end) {
+					const BYTE* span = data + (start - chunk_offset);
+					size_t span_size = static_cast<size_t>(end - start);
+					status = sha1.Update(span, span_size);
+					if (NT_SUCCESS(status))
+						status = sha256.Update(span, span_size);
+					if (NT_SUCCESS(status) && page_algorithm != PageHashNone && range.Region != NoRegion)
+						status = pages.Feed(range.Region, range.RegionStart, start, span, span_size);
+					if (!NT_SUCCESS(status))
+						return LSRESULT(status, __FILEW__, __LINE__, true);
+				}
+
+				if (range.End > chunk_end)
+					break;
+
+				range_index++;
+			}
+
+			if (!more)
+				break;
+
+			chunk_offset = chunk_end;
+			if (!reader.Wait(data, size))
+				return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+		}
+
+		status = sha1.Finish(digest->Sha1, LS_SHA1_SIZE);
+		if (NT_SUCCESS(status))
+			status = sha256.Finish(digest->Sha256, LS_SHA256_SIZE);
+		if (NT_SUCCESS(status) && page_algorithm != PageHashNone)
+			status = pages.Finish(sections_end);
+		if (!NT_SUCCESS(status))
+			return LSRESULT(status, __FILEW__, __LINE__, true);
+
+		digest->ComputedCheckSum = FoldCheckSum(checksum_sum, file_size);
+
+		return LSRESULT();
+	}
+
+	ULONGLONG ImageHasher::SumWords(const BYTE* data, size_t size) noexcept
+	{
+		ULONGLONG total = 0;
+		size_t position = 0;
+		const __m128i zero = _mm_setzero_si128();
+
+		// Widening the words to 32-bit lanes. Each lane takes two words per block,
+		// so 16K blocks stay under 32 bits before we drain them.
+		while (size - position >= 16) {
+			size_t blocks = min((size - position) / 16, static_cast<size_t>(16384));
+			__m128i accumulator = _mm_setzero_si128();
+			for (size_t i = 0; i < blocks; i++) {
+				__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+				accumulator = _mm_add_epi32(accumulator, _mm_unpacklo_epi16(words, zero));
+				accumulator = _mm_add_epi32(accumulator, _mm_unpackhi_epi16(words, zero));
+				position += 16;
+			}
+
+			alignas(16) DWORD lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+			total += static_cast<ULONGLONG>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		}
+
+		for (; position + 1 < size; position += 2)
+			total += *reinterpret_cast<const WORD*>(data + position);
+
+		// An odd trailing byte counts as the low byte of a word.
+		if (position < size)
+			total += data[position];
+
+		return total;
+	}
+
+	DWORD ImageHasher::FoldCheckSum(ULONGLONG sum, ULONGLONG file_size) noexcept
+	{
+		// One's complement, folding the carries back in.
+		while ((sum >> 16) != 0)
+			sum = (sum & 0xFFFF) + (sum >> 16);
+
+		return static_cast<DWORD>(sum + file_size);
+	}
+}
\ No newline at end of file
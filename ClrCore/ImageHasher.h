@@ -0,0 +1,75 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_HASH_CHUNK_SIZE 0x100000
+	#define LS_HASH_PAGE_SIZE 0x1000
+	#define LS_SHA1_SIZE 20
+	#define LS_SHA256_SIZE 32
+
+	typedef enum _LS_PAGE_HASH_ALGORITHM
+	{
+		PageHashNone,
+		PageHashSha1,
+		PageHashSha256
+	} LS_PAGE_HASH_ALGORITHM;
+
+	// One page of a hashed region, zero padded to the page size.
+	// The last entry has the offset where the sections end, and an empty digest.
+	typedef struct _LS_PAGE_DIGEST
+	{
+		DWORD Offset;
+		BYTE Digest[LS_SHA256_SIZE];
+
+	} LS_PAGE_DIGEST, *PLS_PAGE_DIGEST;
+
+	typedef struct _LS_IMAGE_DIGEST
+	{
+		ULONGLONG FileSize;
+		DWORD HeaderCheckSum;
+		DWORD ComputedCheckSum;
+		DWORD CertificateTableOffset;
+		DWORD CertificateTableSize;
+		BYTE Sha1[LS_SHA1_SIZE];
+		BYTE Sha256[LS_SHA256_SIZE];
+		LS_PAGE_HASH_ALGORITHM PageAlgorithm;
+		wuvector<LS_PAGE_DIGEST> PageDigests;
+
+		_LS_IMAGE_DIGEST()
+			: FileSize(0), HeaderCheckSum(0), ComputedCheckSum(0), CertificateTableOffset(0),
+				CertificateTableSize(0), Sha1(), Sha256(), PageAlgorithm(PageHashNone) { }
+
+		~_LS_IMAGE_DIGEST() { }
+
+	} LS_IMAGE_DIGEST, *PLS_IMAGE_DIGEST;
+
+	// Computes the Authenticode digests, and the PE checksum of an image in one
+	// pass over the file. The file is read in LS_HASH_CHUNK_SIZE chunks, with the
+	// next chunk being read while the current one is hashed.
+	// The Authenticode digest skips the checksum field, the certificate table
+	// directory entry, and the certificate table. It covers the headers, the
+	// section raw data in file order, and whatever follows the last section.
+	// An instance can hash any number of files, one at a time.
+	class ImageHasher
+	{
+	public:
+		ImageHasher();
+		~ImageHasher();
+
+		const LSRESULT HashFile(const WWuString& file_path, LS_PAGE_HASH_ALGORITHM page_algorithm, PLS_IMAGE_DIGEST digest);
+
+		// The PE checksum word sum. 'size' must be even, except for the last block of a file.
+		static ULONGLONG SumWords(const BYTE* data, size_t size) noexcept;
+		static DWORD FoldCheckSum(ULONGLONG sum, ULONGLONG file_size) noexcept;
+
+	private:
+		BCRYPT_ALG_HANDLE _sha1;
+		BCRYPT_ALG_HANDLE _sha256;
+		BYTE* _buffers[2];
+	};
+}
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "pch.h"
+
+#include "ImageView.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	ImageView::ImageView()
+		: _data(NULL), _size(0), _is_loaded(false), _nt_offset(0), _magic(0), _file_header(NULL), _sections(NULL), _section_count(0),
+			_size_of_headers(0), _size_of_image(0), _directories(NULL), _directory_count(0), _cor_header(NULL) { }
+
+	ImageView::~ImageView() { }
+
+	const LSRESULT ImageView::Attach(const BYTE* data, size_t size, bool is_loaded)
+	{
+		_data = NULL;
+		_size = 0;
+		_cor_header = NULL;
+
+		if (data == NULL || size < sizeof(IMAGE_DOS_HEADER))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(data);
+		if (dos_header->e_magic != IMAGE_DOS_SIGNATURE || dos_header->e_lfanew < 0)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		// The signature, the file header, and the optional header magic.
+		ULONGLONG nt_offset = static_cast<ULONGLONG>(dos_header->e_lfanew);
+		if (nt_offset + 4 + sizeof(IMAGE_FILE_HEADER) + sizeof(WORD) > size || *reinterpret_cast<const DWORD*>(data + nt_offset) != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		const IMAGE_FILE_HEADER* file_header = reinterpret_cast<const IMAGE_FILE_HEADER*>(data + nt_offset + 4);
+		ULONGLONG optional_offset = nt_offset + 4 + sizeof(IMAGE_FILE_HEADER);
+		ULONGLONG section_offset = optional_offset + file_header->SizeOfOptionalHeader;
+		ULONGLONG section_end = section_offset + (static_cast<ULONGLONG>(file_header->NumberOfSections) * sizeof(IMAGE_SECTION_HEADER));
+		if (section_end > size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Section table out of bounds.", __FILEW__, __LINE__);
+
+		// The fixed part of the optional header, without the data directories.
+		WORD magic = *reinterpret_cast<const WORD*>(data + optional_offset);
+		DWORD fixed_size;
+		const IMAGE_DATA_DIRECTORY* directories;
+		DWORD directory_count;
+		if (magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC && file_header->SizeOfOptionalHeader >= offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory)) {
+			const IMAGE_OPTIONAL_HEADER32* optional_header = reinterpret_cast<const IMAGE_OPTIONAL_HEADER32*>(data + optional_offset);
+			fixed_size = offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory);
+			directories = optional_header->DataDirectory;
+			directory_count = optional_header->NumberOfRvaAndSizes;
+			_size_of_headers = optional_header->SizeOfHeaders;
+			_size_of_image = optional_header->SizeOfImage;
+		}
+		else if (magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC && file_header->SizeOfOptionalHeader >= offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory)) {
+			const IMAGE_OPTIONAL_HEADER64* optional_header = reinterpret_cast<const IMAGE_OPTIONAL_HEADER64*>(data + optional_offset);
+			fixed_size = offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory);
+			directories = optional_header->DataDirectory;
+			directory_count = optional_header->NumberOfRvaAndSizes;
+			_size_of_headers = optional_header->SizeOfHeaders;
+			_size_of_image = optional_header->SizeOfImage;
+		}
+		else
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid optional header.", __FILEW__, __LINE__);
+
+		// Directories past the optional header size are not there, whatever the count says.
+		directory_count = min(directory_count, static_cast<DWORD>((file_header->SizeOfOptionalHeader - fixed_size) / sizeof(IMAGE_DATA_DIRECTORY)));
+		directory_count = min(directory_count, static_cast<DWORD>(IMAGE_NUMBEROF_DIRECTORY_ENTRIES));
+
+		_data = data;
+		_size = size;
+		_is_loaded = is_loaded;
+		_nt_offset = static_cast<DWORD>(nt_offset);
+		_magic = magic;
+		_file_header = file_header;
+		_sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(data + section_offset);
+		_section_count = file_header->NumberOfSections;
+		_directories = directories;
+		_directory_count = directory_count;
+
+		const IMAGE_DATA_DIRECTORY* cor_directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR);
+		if (cor_directory != NULL && cor_directory->VirtualAddress != 0 && cor_directory->Size >= sizeof(IMAGE_COR20_HEADER))
+			_cor_header = reinterpret_cast<const IMAGE_COR20_HEADER*>(GetData(cor_directory->VirtualAddress, sizeof(IMAGE_COR20_HEADER)));
+
+		return LSRESULT();
+	}
+
+	const BYTE* ImageView::GetData(DWORD rva, DWORD size) const noexcept
+	{
+		DWORD offset = rva;
+		if (_data == NULL || (!_is_loaded && !PeHelper::RvaToOffset(rva, _sections, _section_count, _size_of_headers, offset)))
+			return NULL;
+
+		if (offset > _size || size > _size - offset)
+			return NULL;
+
+		return _data + offset;
+	}
+
+	const IMAGE_DATA_DIRECTORY* ImageView::GetDirectory(DWORD index) const noexcept
+	{
+		if (index >= _directory_count)
+			return NULL;
+
+		return &_directories[index];
+	}
+
+	const BYTE* ImageView::GetSection(const char* name, DWORD& size) const noexcept
+	{
+		for (DWORD i = 0; i < _section_count; i++) {
+			if (strncmp(reinterpret_cast<const char*>(_sections[i].Name), name, IMAGE_SIZEOF_SHORT_NAME) != 0)
+				continue;
+
+			// In a file the tail past the virtual size is padding. Some linkers leave the virtual size zero.
+			const IMAGE_SECTION_HEADER& section = _sections[i];
+			DWORD offset = _is_loaded ? section.VirtualAddress : section.PointerToRawData;
+			if (_is_loaded)
+				size = section.Misc.VirtualSize;
+			else
+				size = section.Misc.VirtualSize == 0 ? section.SizeOfRawData : min(section.Misc.VirtualSize, section.SizeOfRawData);
+
+			if (_data == NULL || offset > _size || size > _size - offset)
+				return NULL;
+
+			return _data + offset;
+		}
+
+		return NULL;
+	}
+
+	bool ImageView::FindExport(const char* name, DWORD& rva) const noexcept
+	{
+		const IMAGE_DATA_DIRECTORY* directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_EXPORT);
+		if (directory == NULL || directory->VirtualAddress == 0)
+			return false;
+
+		const IMAGE_EXPORT_DIRECTORY* exports = reinterpret_cast<const IMAGE_EXPORT_DIRECTORY*>(GetData(directory->VirtualAddress, sizeof(IMAGE_EXPORT_DIRECTORY)));
+		if (exports == NULL || exports->NumberOfNames == 0 || exports->NumberOfNames > MAXDWORD / sizeof(DWORD))
+			return false;
+
+		const DWORD* names = reinterpret_cast<const DWORD*>(GetData(exports->AddressOfNames, static_cast<DWORD>(exports->NumberOfNames * sizeof(DWORD))));
+		const WORD* ordinals = reinterpret_cast<const WORD*>(GetData(exports->AddressOfNameOrdinals, static_cast<DWORD>(exports->NumberOfNames * sizeof(WORD))));
+		if (names == NULL || ordinals == NULL)
+			return false;
+
+		// The linker sorts the names, the loader relies on it too.
+		LONG low = 0;
+		LONG high = static_cast<LONG>(exports->NumberOfNames) - 1;
+		while (low <= high) {
+			LONG middle = low + ((high - low) / 2);
+			const char* current = GetName(names[middle]);
+			if (current == NULL)
+				return false;
+
+			int comparison = strcmp(name, current);
+			if (comparison < 0)
+				high = middle - 1;
+			else if (comparison > 0)
+				low = middle + 1;
+			else {
+				if (ordinals[middle] >= exports->NumberOfFunctions)
+					return false;
+
+				const DWORD* function = reinterpret_cast<const DWORD*>(GetData(exports->AddressOfFunctions + (ordinals[middle] * static_cast<DWORD>(sizeof(DWORD))), sizeof(DWORD)));
+				if (function == NULL)
+					return false;
+
+				// Forwarders point to a name inside the export directory.
+				rva = *function;
+				return rva != 0 && (rva < directory->VirtualAddress || rva - directory->VirtualAddress >= directory->Size);
+			}
+		}
+
+		return false;
+	}
+
+	size_t ImageView::GetRequiredSize() const noexcept
+	{
+		if (_data == NULL)
+			return 0;
+
+		// The metadata is read through the COR header, so it counts once the COR header is there.
+		DWORD rvas[6] = { 0 };
+		const DWORD indexes[5] = { IMAGE_DIRECTORY_ENTRY_EXPORT, IMAGE_DIRECTORY_ENTRY_IMPORT, IMAGE_DIRECTORY_ENTRY_IAT, IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT, IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR };
+		for (DWORD i = 0; i < 5; i++) {
+			const IMAGE_DATA_DIRECTORY* directory = GetDirectory(indexes[i]);
+			if (directory != NULL)
+				rvas[i] = directory->VirtualAddress;
+		}
+
+		if (_cor_header != NULL)
+			rvas[5] = _cor_header->MetaData.VirtualAddress;
+
+		ULONGLONG required = _size_of_headers;
+		for (DWORD rva : rvas) {
+			if (rva == 0 || rva < _size_of_headers)
+				continue;
+
+			for (DWORD i = 0; i < _section_count; i++) {
+				DWORD section_size = max(_sections[i].Misc.VirtualSize, _sections[i].SizeOfRawData);
+				if (_sections[i].VirtualAddress <= rva && rva - _sections[i].VirtualAddress < section_size) {
+					required = max(required, static_cast<ULONGLONG>(_sections[i].PointerToRawData) + _sections[i].SizeOfRawData);
+					break;
+				}
+			}
+		}
+
+		return static_cast<size_t>(required);
+	}
+
+	bool ImageView::GetMetadata(const BYTE*& data, DWORD& size) const noexcept
+	{
+		if (_cor_header == NULL || _cor_header->MetaData.VirtualAddress == 0 || _cor_header->MetaData.Size == 0)
+			return false;
+
+		data = GetData(_cor_header->MetaData.VirtualAddress, _cor_header->MetaData.Size);
+		size = _cor_header->MetaData.Size;
+
+		return data != NULL;
+	}
+
+	void ImageView::GetHeaders(PeHelper::PLS_PORTABLE_EXECUTABLE pe_headers) const
+	{
+		if (_data == NULL)
+			return;
+
+		pe_headers->IsCoffOnly = false;
+		pe_headers->CoffHeaderOffset = _nt_offset + 4;
+		pe_headers->OptionalHeaderOffset = pe_headers->CoffHeaderOffset + 20;
+		pe_headers->IsDll = (_file_header->Characteristics & IMAGE_FILE_DLL) != 0;
+		pe_headers->IsExe = (_file_header->Characteristics & IMAGE_FILE_DLL) == 0;
+		pe_headers->Magic = _magic;
+
+		// The optional header can be shorter than the structure.
+		size_t header_size = _magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC ? sizeof(IMAGE_NT_HEADERS32) : sizeof(IMAGE_NT_HEADERS64);
+		header_size = min(header_size, static_cast<size_t>(4 + sizeof(IMAGE_FILE_HEADER) + _file_header->SizeOfOptionalHeader));
+		RtlZeroMemory(&pe_headers->NtHeaders64, sizeof(IMAGE_NT_HEADERS64));
+		RtlCopyMemory(&pe_headers->NtHeaders64, _data + _nt_offset, header_size);
+
+		WORD subsystem = _magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC ? pe_headers->NtHeaders32.OptionalHeader.Subsystem : pe_headers->NtHeaders64.OptionalHeader.Subsystem;
+		pe_headers->IsConsoleApplication = subsystem == IMAGE_SUBSYSTEM_WINDOWS_CUI;
+
+		pe_headers->SectionHeaders.assign(_sections, _sections + _section_count);
+
+		pe_headers->MetadataSize = 0;
+		pe_headers->MetadataStartOffset = 0;
+		if (_cor_header == NULL) {
+			pe_headers->CorHeaderOffset = -1;
+			return;
+		}
+
+		pe_headers->CorHeaderOffset = static_cast<DWORD>(reinterpret_cast<const BYTE*>(_cor_header) - _data);
+		RtlCopyMemory(&pe_headers->CorHeader, _cor_header, sizeof(IMAGE_COR20_HEADER));
+
+		const BYTE* metadata;
+		DWORD metadata_size;
+		if (GetMetadata(metadata, metadata_size)) {
+			pe_headers->MetadataSize = metadata_size;
+			pe_headers->MetadataStartOffset = static_cast<DWORD>(metadata - _data);
+		}
+	}
+
+	void ImageView::GetBasicInformation(PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, WorkBudget* budget) const
+	{
+		if (_data == NULL)
+			return;
+
+		basic_info->IsClr = _cor_header != NULL;
+		basic_info->SizeOfImage = _size_of_image;
+		basic_info->BytesRead = reinterpret_cast<const BYTE*>(_sections + _section_count) - _data;
+
+		const IMAGE_DATA_DIRECTORY* directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_IMPORT);
+		if (directory != NULL)
+			basic_info->ImportTableRva = directory->VirtualAddress;
+
+		if ((directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT)) != NULL)
+			basic_info->DelayLoadTableRva = directory->VirtualAddress;
+
+		if ((directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_EXPORT)) != NULL)
+			basic_info->ExportTableRva = directory->VirtualAddress;
+
+		if ((directory = GetDirectory(IMAGE_DIRECTORY_ENTRY_RESOURCE)) != NULL) {
+			basic_info->ResourceTableRva = directory->VirtualAddress;
+			basic_info->ResourceTableSize = directory->Size;
+		}
+
+		if (budget != NULL && !budget->CheckSections(_section_count)) {
+			basic_info->StopReason = budget->StopReason();
+			return;
+		}
+
+		// Descriptors are translated one at a time, a table can cross a section boundary.
+		if (basic_info->ImportTableRva > 0) {
+			DWORD rva = basic_info->ImportTableRva;
+			const IMAGE_IMPORT_DESCRIPTOR* descriptor;
+			while ((descriptor = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(GetData(rva, sizeof(IMAGE_IMPORT_DESCRIPTOR)))) != NULL && descriptor->Name != 0) {
+				// The name is charged with its descriptor.
+				const char* name = GetName(descriptor->Name);
+				size_t bytes = sizeof(IMAGE_IMPORT_DESCRIPTOR) + (name != NULL ? strlen(name) + 1 : 0);
+				if (budget != NULL && (!budget->AddDescriptor() || !budget->AddBytes(bytes)))
+					break;
+
+				if (name != NULL)
+					basic_info->Dependencies.push_back(name);
+
+				basic_info->BytesRead += bytes;
+				rva += sizeof(IMAGE_IMPORT_DESCRIPTOR);
+			}
+		}
+
+		if (basic_info->DelayLoadTableRva > 0 && (budget == NULL || !budget->IsSpent())) {
+			DWORD rva = basic_info->DelayLoadTableRva;
+			const IMAGE_DELAYLOAD_DESCRIPTOR* descriptor;
+			while ((descriptor = reinterpret_cast<const IMAGE_DELAYLOAD_DESCRIPTOR*>(GetData(rva, sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)))) != NULL && descriptor->DllNameRVA != 0) {
+				// The name is charged with its descriptor.
+				const char* name = GetName(descriptor->DllNameRVA);
+				size_t bytes = sizeof(IMAGE_DELAYLOAD_DESCRIPTOR) + (name != NULL ? strlen(name) + 1 : 0);
+				if (budget != NULL && (!budget->AddDescriptor() || !budget->AddBytes(bytes)))
+					break;
+
+				if (name != NULL)
+					basic_info->Dependencies.push_back(name);
+
+				basic_info->BytesRead += bytes;
+				rva += sizeof(IMAGE_DELAYLOAD_DESCRIPTOR);
+			}
+		}
+
+		if (budget != NULL)
+			basic_info->StopReason = budget->StopReason();
+	}
+
+	const char* ImageView::GetName(DWORD rva) const noexcept
+	{
+		const char* name = reinterpret_cast<const char*>(GetData(rva, 1));
+		if (name == NULL)
+			return NULL;
+
+		size_t available = _size - (reinterpret_cast<const BYTE*>(name) - _data);
+		size_t length = strnlen(name, available);
+		if (length == 0 || length == available)
+			return NULL;
+
+		return name;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "PeHelper.h"
+
+namespace LibSnitcher::Core
+{
+	// A PE image in memory the view doesn't own. A mapped file, or a range of one, like a file
+	// embedded in a single-file bundle, or an image mapping. RVAs are translated with the section
+	// table, and every read is bounded by the range, so nothing is copied, or extracted.
+	class ImageView
+	{
+	public:
+		ImageView();
+		~ImageView();
+
+		// 'data' is not copied, and must outlive the view. With 'is_loaded', 'data' is mapped as
+		// an image, a module handle for instance, and RVAs are offsets from it.
+		const LSRESULT Attach(const BYTE* data, size_t size, bool is_loaded = false);
+
+		_NODISCARD WORD Machine() const noexcept { return _file_header->Machine; }
+		_NODISCARD WORD Magic() const noexcept { return _magic; }
+		_NODISCARD WORD Characteristics() const noexcept { return _file_header->Characteristics; }
+		_NODISCARD DWORD SectionCount() const noexcept { return _section_count; }
+		_NODISCARD DWORD SizeOfImage() const noexcept { return _size_of_image; }
+		_NODISCARD size_t Size() const noexcept { return _size; }
+		_NODISCARD bool IsClr() const noexcept { return _cor_header != NULL; }
+
+		// NULL if the RVA isn't in the file, or 'size' bytes from it aren't.
+		const BYTE* GetData(DWORD rva, DWORD size) const noexcept;
+		const IMAGE_DATA_DIRECTORY* GetDirectory(DWORD index) const noexcept;
+		const IMAGE_COR20_HEADER* GetCorHeader() const noexcept { return _cor_header; }
+
+		// The data of the first section named 'name', NULL if there's none, or it's not all in the range.
+		const BYTE* GetSection(const char* name, DWORD& size) const noexcept;
+
+		// Binary search on the export name table. False for forwarded exports.
+		bool FindExport(const char* name, DWORD& rva) const noexcept;
+
+		// The file size the tables 'GetBasicInformation', and 'GetMetadata' read need. The headers, and
+		// the end of each section holding one. Resources, relocations, and what follows aren't needed.
+		_NODISCARD size_t GetRequiredSize() const noexcept;
+
+		// The metadata root, where 'MetadataReader' starts.
+		bool GetMetadata(const BYTE*& data, DWORD& size) const noexcept;
+
+		// The same as 'PeHelper::GetPeHeaders', for the range.
+		void GetHeaders(PeHelper::PLS_PORTABLE_EXECUTABLE pe_headers) const;
+
+		// The same as 'PeHelper::GetImageBasicInformation', for the range. Tables are walked by
+		// file offset, not by RVA. 'BytesRead' counts the headers, descriptors, and names read.
+		void GetBasicInformation(PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, WorkBudget* budget = NULL) const;
+
+	private:
+		const BYTE* _data;
+		size_t _size;
+		bool _is_loaded;
+		DWORD _nt_offset;
+		WORD _magic;
+		const IMAGE_FILE_HEADER* _file_header;
+		const IMAGE_SECTION_HEADER* _sections;
+		DWORD _section_count;
+		DWORD _size_of_headers;
+		DWORD _size_of_image;
+		const IMAGE_DATA_DIRECTORY* _directories;
+		DWORD _directory_count;
+		const IMAGE_COR20_HEADER* _cor_header;
+
+		// Names are bounded by the range, not by a terminator we might not find.
+		const char* GetName(DWORD rva) const noexcept;
+	};
+}
\ No newline at end of file
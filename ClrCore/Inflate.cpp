@@ -0,0 +1,459 @@
+#include "pch.h"
+
+#include "Inflate.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// RFC 1951, 3.2.5. Lengths for symbols 257 to 285, and distances for codes 0 to 29.
+	static const WORD LengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+
+	static const BYTE LengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+
+	static const WORD DistanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+
+	static const BYTE DistanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	// The order code length code lengths are sent in, 3.2.7.
+	static const BYTE CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// DEFLATE can't expand data more than 1032 to 1. Sizes past that come from a broken archive.
+	#define LS_INFLATE_MAX_RATIO 1032
+
+	Inflater::Inflater()
+		: _input(NULL), _input_size(0), _in_position(0), _bits(0), _bit_count(0), _out_position(0), _state(InflateStateHeader),
+			_is_final(false), _stored_remaining(0), _copy_length(0), _copy_distance(0), _literals(), _distances() { }
+
+	Inflater::~Inflater() { }
+
+	void Inflater::Reset(const BYTE* input, size_t size) noexcept
+	{
+		_input = input;
+		_input_size = size;
+		_in_position = 0;
+		_bits = 0;
+		_bit_count = 0;
+		_out_position = 0;
+		_state = InflateStateHeader;
+		_is_final = false;
+		_stored_remaining = 0;
+		_copy_length = 0;
+		_copy_distance = 0;
+	}
+
+	const LSRESULT Inflater::Inflate(BYTE* output, size_t limit)
+	{
+		while (_out_position < limit && _state != InflateStateDone) {
+			switch (_state) {
+				case InflateStateHeader:
+				{
+					LSRESULT result = ReadBlockHeader();
+					if (result.Result != ERROR_SUCCESS)
+						return result;
+				} break;
+
+				case InflateStateStored:
+				{
+					// What's left in the bit buffer are whole bytes, the block is byte aligned.
+					while (_stored_remaining > 0 && _out_position < limit && _bit_count >= 8) {
+						output[_out_position++] = static_cast<BYTE>(_bits);
+						_bits >>= 8;
+						_bit_count -= 8;
+						_stored_remaining--;
+					}
+
+					size_t count = min(static_cast<size_t>(_stored_remaining), limit - _out_position);
+					if (count > _input_size - _in_position)
+						return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+					memcpy(output + _out_position, _input + _in_position, count);
+					_out_position += count;
+					_in_position += count;
+					_stored_remaining -= static_cast<DWORD>(count);
+
+					if (_stored_remaining == 0)
+						_state = _is_final ? InflateStateDone : InflateStateHeader;
+				} break;
+
+				case InflateStateHuffman:
+				{
+					LSRESULT result = InflateHuffman(output, limit);
+					if (result.Result != ERROR_SUCCESS)
+						return result;
+				} break;
+			}
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT Inflater::InflateImage(const BYTE* input, size_t input_size, size_t size, wuvector<BYTE>& buffer, ImageView& view)
+	{
+		if (input_size <= MAXSIZE_T / LS_INFLATE_MAX_RATIO)
+			size = min(size, input_size * LS_INFLATE_MAX_RATIO);
+
+		Inflater inflater;
+		inflater.Reset(input, input_size);
+
+		// The headers first, then up to the end of the sections holding the tables. The COR header
+		// can put the metadata in a section further on, so it goes until nothing else is needed.
+		size_t limit = min(size, static_cast<size_t>(LS_INFLATE_HEADER_SIZE));
+		while (true) {
+
+			// The buffer doubles as the output comes, so a stream that ends early, or a size that's
+			// too large, only costs what was inflated, not what the headers claim.
+			while (inflater.TotalOut() < limit && !inflater.IsFinished()) {
+				size_t step = min(limit, max(inflater.TotalOut() * 2, static_cast<size_t>(LS_INFLATE_HEADER_SIZE)));
+				if (buffer.size() < step)
+					buffer.resize(step);
+
+				LSRESULT result = inflater.Inflate(buffer.data(), step);
+				if (result.Result != ERROR_SUCCESS)
+					return result;
+			}
+
+			size_t total = inflater.TotalOut();
+			if (total < 2 || buffer[0] != 'M' || buffer[1] != 'Z')
+				return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+			LSRESULT result = view.Attach(buffer.data(), total);
+			if (result.Result != ERROR_SUCCESS) {
+
+				// A section table that doesn't fit the first read.
+				if (inflater.IsFinished() || total >= size || limit >= LS_INFLATE_MAX_HEADER_SIZE)
+					return result;
+
+				limit = min(size, limit * 2);
+				continue;
+			}
+
+			size_t required = min(view.GetRequiredSize(), size);
+			if (required <= total || inflater.IsFinished())
+				return LSRESULT();
+
+			if (required > LS_INFLATE_MAX_IMAGE_SIZE)
+				return LSRESULT(ERROR_FILE_TOO_LARGE, L"The image tables are past the 256 MB a compressed image is inflated to.", __FILEW__, __LINE__);
+
+			limit = required;
+		}
+	}
+
+	void Inflater::Refill() noexcept
+	{
+		while (_bit_count <= 56 && _in_position < _input_size) {
+			_bits |= static_cast<ULONGLONG>(_input[_in_position++]) << _bit_count;
+			_bit_count += 8;
+		}
+	}
+
+	bool Inflater::GetBits(DWORD count, DWORD& value) noexcept
+	{
+		if (_bit_count < count) {
+			Refill();
+			if (_bit_count < count)
+				return false;
+		}
+
+		value = static_cast<DWORD>(_bits & ((1ULL << count) - 1));
+		_bits >>= count;
+		_bit_count -= count;
+
+		return true;
+	}
+
+	bool Inflater::Decode(const LS_HUFFMAN_TABLE& table, DWORD& symbol) noexcept
+	{
+		if (_bit_count < LS_INFLATE_MAX_BITS)
+			Refill();
+
+		WORD entry = table.Fast[_bits & ((1 << LS_INFLATE_FAST_BITS) - 1)];
+		if (entry != 0 && static_cast<DWORD>(entry & 0xF) <= _bit_count) {
+			symbol = entry >> 4;
+			_bits >>= (entry & 0xF);
+			_bit_count -= (entry & 0xF);
+			return true;
+		}
+
+		// Longer codes, one bit at a time. Codes of the same length are consecutive, in symbol order.
+		ULONGLONG bits = _bits;
+		LONG code = 0;
+		LONG first = 0;
+		LONG index = 0;
+		for (DWORD length = 1; length <= LS_INFLATE_MAX_BITS && length <= _bit_count; length++) {
+			code |= static_cast<LONG>(bits & 1);
+			bits >>= 1;
+
+			LONG count = table.Counts[length];
+			if (code - count < first) {
+				symbol = table.Symbols[index + (code - first)];
+				_bits >>= length;
+				_bit_count -= length;
+				return true;
+			}
+
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+
+		return false;
+	}
+
+	const LSRESULT Inflater::ReadBlockHeader()
+	{
+		DWORD is_final;
+		DWORD type;
+		if (!GetBits(1, is_final) || !GetBits(2, type))
+			return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+		_is_final = is_final != 0;
+		switch (type) {
+			case 0:
+			{
+				// Stored blocks start at a byte boundary, with the length, and its complement.
+				DWORD skipped;
+				DWORD length;
+				DWORD complement;
+				GetBits(_bit_count & 7, skipped);
+				if (!GetBits(16, length) || !GetBits(16, complement))
+					return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+				if (length != (~complement & 0xFFFF))
+					return LSRESULT(ERROR_INVALID_DATA, L"Invalid stored block length.", __FILEW__, __LINE__);
+
+				_stored_remaining = length;
+				_state = InflateStateStored;
+			} break;
+
+			case 1:
+			{
+				BYTE lengths[LS_INFLATE_MAX_LITERALS + LS_INFLATE_MAX_DISTANCES];
+				memset(lengths, 8, 144);
+				memset(lengths + 144, 9, 112);
+				memset(lengths + 256, 7, 24);
+				memset(lengths + 280, 8, 8);
+				memset(lengths + LS_INFLATE_MAX_LITERALS, 5, LS_INFLATE_MAX_DISTANCES);
+
+				BuildTable(lengths, LS_INFLATE_MAX_LITERALS, _literals);
+				BuildTable(lengths + LS_INFLATE_MAX_LITERALS, LS_INFLATE_MAX_DISTANCES, _distances);
+				_state = InflateStateHuffman;
+			} break;
+
+			case 2:
+			{
+				LSRESULT result = ReadDynamicTables();
+				if (result.Result != ERROR_SUCCESS)
+					return result;
+
+				_state = InflateStateHuffman;
+			} break;
+
+			default:
+				return LSRESULT(ERROR_INVALID_DATA, L"Invalid block type.", __FILEW__, __LINE__);
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT Inflater::ReadDynamicTables()
+	{
+		DWORD literal_count;
+		DWORD distance_count;
+		DWORD code_length_count;
+		if (!GetBits(5, literal_count) || !GetBits(5, distance_count) || !GetBits(4, code_length_count))
+			return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+		literal_count += 257;
+		distance_count += 1;
+		code_length_count += 4;
+		if (literal_count > 286 || distance_count > LS_INFLATE_MAX_DISTANCES)
+			return LSRESULT(ERROR_INVALID_DATA, L"Invalid code counts.", __FILEW__, __LINE__);
+
+		// The code the literal, and distance code lengths are sent with.
+		BYTE lengths[LS_INFLATE_MAX_LITERALS + LS_INFLATE_MAX_DISTANCES] = { 0 };
+		for (DWORD i = 0; i < code_length_count; i++) {
+			DWORD length;
+			if (!GetBits(3, length))
+				return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+			lengths[CodeLengthOrder[i]] = static_cast<BYTE>(length);
+		}
+
+		LS_HUFFMAN_TABLE code_lengths;
+		if (!BuildTable(lengths, 19, code_lengths))
+			return LSRESULT(ERROR_INVALID_DATA, L"Invalid code length code.", __FILEW__, __LINE__);
+
+		// Both sets are one sequence, repeats can cross from one to the other.
+		memset(lengths, 0, sizeof(lengths));
+		DWORD total = literal_count + distance_count;
+		DWORD index = 0;
+		while (index < total) {
+			DWORD symbol;
+			if (!Decode(code_lengths, symbol))
+				return LSRESULT(ERROR_INVALID_DATA, L"Invalid code length.", __FILEW__, __LINE__);
+
+			if (symbol < 16) {
+				lengths[index++] = static_cast<BYTE>(symbol);
+				continue;
+			}
+
+			BYTE value = 0;
+			DWORD repeat;
+			bool has_bits;
+			if (symbol == 16) {
+				if (index == 0)
+					return LSRESULT(ERROR_INVALID_DATA, L"Repeat with no previous length.", __FILEW__, __LINE__);
+
+				value = lengths[index - 1];
+				has_bits = GetBits(2, repeat);
+				repeat += 3;
+			}
+			else if (symbol == 17) {
+				has_bits = GetBits(3, repeat);
+				repeat += 3;
+			}
+			else {
+				has_bits = GetBits(7, repeat);
+				repeat += 11;
+			}
+
+			if (!has_bits)
+				return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+			if (repeat > total - index)
+				return LSRESULT(ERROR_INVALID_DATA, L"Code lengths out of bounds.", __FILEW__, __LINE__);
+
+			memset(lengths + index, value, repeat);
+			index += repeat;
+		}
+
+		// No end of block code, no way out of the block.
+		if (lengths[256] == 0)
+			return LSRESULT(ERROR_INVALID_DATA, L"Missing end of block code.", __FILEW__, __LINE__);
+
+		if (!BuildTable(lengths, literal_count, _literals) || !BuildTable(lengths + literal_count, distance_count, _distances))
+			return LSRESULT(ERROR_INVALID_DATA, L"Invalid Huffman code.", __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+
+	const LSRESULT Inflater::InflateHuffman(BYTE* output, size_t limit)
+	{
+		while (_copy_length > 0 && _out_position < limit) {
+			output[_out_position] = output[_out_position - _copy_distance];
+			_out_position++;
+			_copy_length--;
+		}
+
+		while (_out_position < limit) {
+			DWORD symbol;
+			if (!Decode(_literals, symbol))
+				return LSRESULT(ERROR_INVALID_DATA, L"Invalid literal, or length code.", __FILEW__, __LINE__);
+
+			if (symbol < 256) {
+				output[_out_position++] = static_cast<BYTE>(symbol);
+				continue;
+			}
+
+			if (symbol == 256) {
+				_state = _is_final ? InflateStateDone : InflateStateHeader;
+				return LSRESULT();
+			}
+
+			symbol -= 257;
+			if (symbol >= 29)
+				return LSRESULT(ERROR_INVALID_DATA, L"Invalid length code.", __FILEW__, __LINE__);
+
+			DWORD length;
+			if (!GetBits(LengthExtra[symbol], length))
+				return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+			length += LengthBase[symbol];
+
+			DWORD distance_symbol;
+			DWORD distance;
+			if (!Decode(_distances, distance_symbol) || distance_symbol >= LS_INFLATE_MAX_DISTANCES)
+				return LSRESULT(ERROR_INVALID_DATA, L"Invalid distance code.", __FILEW__, __LINE__);
+
+			if (!GetBits(DistanceExtra[distance_symbol], distance))
+				return LSRESULT(ERROR_INVALID_DATA, L"Compressed data is truncated.", __FILEW__, __LINE__);
+
+			distance += DistanceBase[distance_symbol];
+			if (distance > _out_position)
+				return LSRESULT(ERROR_INVALID_DATA, L"Distance too far back.", __FILEW__, __LINE__);
+
+			// Byte by byte, the match can overlap what it's copying. What doesn't fit is copied on the next call.
+			DWORD count = static_cast<DWORD>(min(static_cast<size_t>(length), limit - _out_position));
+			const BYTE* source = output + _out_position - distance;
+			BYTE* destination = output + _out_position;
+			for (DWORD i = 0; i < count; i++)
+				destination[i] = source[i];
+
+			_out_position += count;
+			_copy_length = length - count;
+			_copy_distance = distance;
+		}
+
+		return LSRESULT();
+	}
+
+	bool Inflater::BuildTable(const BYTE* lengths, DWORD count, LS_HUFFMAN_TABLE& table) noexcept
+	{
+		memset(table.Counts, 0, sizeof(table.Counts));
+		memset(table.Fast, 0, sizeof(table.Fast));
+		for (DWORD i = 0; i < count; i++)
+			table.Counts[lengths[i]]++;
+
+		table.Counts[0] = 0;
+
+		// Over-subscribed codes are invalid. Incomplete ones are allowed, a single distance code is.
+		LONG left = 1;
+		for (DWORD length = 1; length <= LS_INFLATE_MAX_BITS; length++) {
+			left <<= 1;
+			left -= table.Counts[length];
+			if (left < 0)
+				return false;
+		}
+
+		WORD offsets[LS_INFLATE_MAX_BITS + 2] = { 0 };
+		for (DWORD length = 1; length <= LS_INFLATE_MAX_BITS; length++)
+			offsets[length + 1] = offsets[length] + table.Counts[length];
+
+		for (DWORD i = 0; i < count; i++) {
+			if (lengths[i] != 0)
+				table.Symbols[offsets[lengths[i]]++] = static_cast<WORD>(i);
+		}
+
+		// The canonical codes of the short ones, bit reversed, since the stream is read from the low bit.
+		DWORD code = 0;
+		DWORD index = 0;
+		for (DWORD length = 1; length <= LS_INFLATE_MAX_BITS; length++) {
+			for (DWORD i = 0; i < table.Counts[length]; i++, index++, code++) {
+				if (length > LS_INFLATE_FAST_BITS)
+					continue;
+
+				DWORD reversed = 0;
+				for (DWORD bit = 0; bit < length; bit++)
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+				WORD entry = static_cast<WORD>((table.Symbols[index] << 4) | length);
+				for (DWORD slot = reversed; slot < (1 << LS_INFLATE_FAST_BITS); slot += (1 << length))
+					table.Fast[slot] = entry;
+			}
+
+			code <<= 1;
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "ImageView.h"
+
+namespace LibSnitcher::Core
+{
+	// Codes up to this length are decoded with one table lookup, longer ones bit by bit.
+	#define LS_INFLATE_FAST_BITS 9
+	#define LS_INFLATE_MAX_BITS 15
+	#define LS_INFLATE_MAX_LITERALS 288
+	#define LS_INFLATE_MAX_DISTANCES 30
+
+	// The first read of a compressed image, enough for the headers, and the section table of most.
+	#define LS_INFLATE_HEADER_SIZE 0x1000
+	#define LS_INFLATE_MAX_HEADER_SIZE 0x10000
+
+	// The most an image is inflated to, 256 MB. Tables past it fail the image, instead of allocating for it.
+	#define LS_INFLATE_MAX_IMAGE_SIZE 0x10000000
+
+	// A canonical Huffman code. 'Fast' entries are the symbol shifted left by four, and the code length.
+	typedef struct _LS_HUFFMAN_TABLE
+	{
+		WORD Counts[LS_INFLATE_MAX_BITS + 1];
+		WORD Symbols[LS_INFLATE_MAX_LITERALS];
+		WORD Fast[1 << LS_INFLATE_FAST_BITS];
+
+	} LS_HUFFMAN_TABLE, *PLS_HUFFMAN_TABLE;
+
+	// Raw DEFLATE decoder, RFC 1951, without the zlib, or gzip wrapper. The format zip entries,
+	// and compressed single-file bundle entries use.
+	// The output is the window, everything inflated so far stays in it, so the decoder can stop
+	// at any size, and continue later into the same buffer, grown if needed. Images are inflated
+	// only as far as the parser reads, the tail, resources, and signatures, is never decoded.
+	class Inflater
+	{
+	public:
+		Inflater();
+		~Inflater();
+
+		// 'input' is not copied, and must outlive the decoder.
+		void Reset(const BYTE* input, size_t size) noexcept;
+
+		// Inflates until 'output' has 'limit' bytes, or the stream ends. 'output' must hold what
+		// the previous calls inflated, at the same offsets.
+		const LSRESULT Inflate(BYTE* output, size_t limit);
+
+		_NODISCARD size_t TotalOut() const noexcept { return _out_position; }
+		_NODISCARD bool IsFinished() const noexcept { return _state == InflateStateDone; }
+
+		// Inflates the part of a compressed image the parser reads into 'buffer', and attaches
+		// 'view' to it. 'buffer' is only grown, so one can be used for any number of images, and
+		// only as the output comes, never past LS_INFLATE_MAX_IMAGE_SIZE. 'size' is the size of
+		// the image, from the archive, or the bundle manifest.
+		static const LSRESULT InflateImage(const BYTE* input, size_t input_size, size_t size, wuvector<BYTE>& buffer, ImageView& view);
+
+	private:
+		typedef enum _LS_INFLATE_STATE
+		{
+			InflateStateHeader,
+			InflateStateStored,
+			InflateStateHuffman,
+			InflateStateDone
+
+		} LS_INFLATE_STATE;
+
+		const BYTE* _input;
+		size_t _input_size;
+		size_t _in_position;
+		ULONGLONG _bits;
+		DWORD _bit_count;
+		size_t _out_position;
+		LS_INFLATE_STATE _state;
+		bool _is_final;
+		DWORD _stored_remaining;
+
+		// A match cut by the limit, finished on the next call.
+		DWORD _copy_length;
+		DWORD _copy_distance;
+		LS_HUFFMAN_TABLE _literals;
+		LS_HUFFMAN_TABLE _distances;
+
+		void Refill() noexcept;
+		bool GetBits(DWORD count, DWORD& value) noexcept;
+		bool Decode(const LS_HUFFMAN_TABLE& table, DWORD& symbol) noexcept;
+		const LSRESULT ReadBlockHeader();
+		const LSRESULT ReadDynamicTables();
+		const LSRESULT InflateHuffman(BYTE* output, size_t limit);
+
+		static bool BuildTable(const BYTE* lengths, DWORD count, LS_HUFFMAN_TABLE& table) noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#include "Invalidation.h"
+
+namespace LibSnitcher::Core
+{
+	ChainCache::ChainCache()
+		: _generation(0)
+	{
+		InitializeSRWLock(&_lock);
+	}
+
+	ChainCache::~ChainCache() { }
+
+	WWuString ChainCache::MakeKey(const WWuString& root, DWORD max_depth)
+	{
+		return WWuString::Format(L"%ws|%u", root.ToLower().GetBuffer(), max_depth);
+	}
+
+	bool ChainCache::Lookup(const WWuString& key, LS_CACHED_CHAIN& chain, ULONGLONG& generation)
+	{
+		AcquireSRWLockShared(&_lock);
+		generation = _generation;
+		auto cached = _chains.find(key);
+		bool found = cached != _chains.end();
+		if (found)
+			chain = cached->second;
+		ReleaseSRWLockShared(&_lock);
+
+		return found;
+	}
+
+	void ChainCache::Insert(const WWuString& key, const wushared_ptr<LS_RESOLVED_GRAPH>& graph, ULONGLONG generation)
+	{
+		AcquireSRWLockExclusive(&_lock);
+		if (generation == _generation) {
+			LS_CACHED_CHAIN& chain = _chains[key];
+			chain.Graph = graph;
+			chain.Dirty.clear();
+		}
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	size_t ChainCache::MarkDirty(const WWuString& module_name)
+	{
+		WWuString key = module_name.ToLower();
+		size_t affected = 0;
+
+		AcquireSRWLockExclusive(&_lock);
+		_generation++;
+		for (auto& entry : _chains) {
+			if (entry.second.Graph->NodeIndex.find(key) != entry.second.Graph->NodeIndex.end()) {
+				entry.second.Dirty[key] = true;
+				affected++;
+			}
+		}
+		ReleaseSRWLockExclusive(&_lock);
+
+		return affected;
+	}
+
+	void ChainCache::Clear()
+	{
+		AcquireSRWLockExclusive(&_lock);
+		_generation++;
+		_chains.clear();
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	CacheInvalidator::CacheInvalidator(DirectoryIndex* index, ImageCache* cache, ChainCache* chains)
+		: _index(index), _cache(cache), _chains(chains) { }
+
+	CacheInvalidator::~CacheInvalidator() { }
+
+	void CacheInvalidator::OnFileChanged(const WWuString& file_path, LS_CHANGE_KIND kind)
+	{
+		if (kind != ChangeKindModified)
+			_index->ApplyChange(file_path, kind == ChangeKindAdded);
+
+		_cache->Evict(file_path);
+
+		// A new file can also shadow a module found further down the search order,
+		// so we go by name, not by path.
+		_chains->MarkDirty(WWuString(PathFindFileName(file_path.GetBuffer())));
+	}
+
+	void CacheInvalidator::OnOverflow(const WWuString& directory)
+	{
+		// We don't know what changed. The image cache validates entries on lookup,
+		// so re-listing the directory, and dropping resolved chains is enough.
+		_index->Refresh(directory);
+		_chains->Clear();
+	}
+}
\ No newline at end of file
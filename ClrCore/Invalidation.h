@@ -0,0 +1,69 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "ChangeWatcher.h"
+#include "Resolver.h"
+
+namespace LibSnitcher::Core
+{
+	// A resolved chain, and the modules in it that changed since it was resolved.
+	typedef struct _LS_CACHED_CHAIN
+	{
+		wushared_ptr<LS_RESOLVED_GRAPH> Graph;
+		wumap<WWuString, bool> Dirty;
+
+		_LS_CACHED_CHAIN() { }
+		~_LS_CACHED_CHAIN() { }
+
+	} LS_CACHED_CHAIN, *PLS_CACHED_CHAIN;
+
+	// Thread-safe cache of resolved chains, keyed by root, and depth.
+	// Graphs are never modified once cached, changes are tracked in the dirty set.
+	class ChainCache
+	{
+	public:
+		ChainCache();
+		~ChainCache();
+
+		static WWuString MakeKey(const WWuString& root, DWORD max_depth);
+
+		// 'generation' is the invalidation count at lookup time, to be handed back to 'Insert'.
+		bool Lookup(const WWuString& key, LS_CACHED_CHAIN& chain, ULONGLONG& generation);
+
+		// Caches a fresh resolution. If something was invalidated since 'generation',
+		// the graph might be stale already, and it's not cached.
+		void Insert(const WWuString& key, const wushared_ptr<LS_RESOLVED_GRAPH>& graph, ULONGLONG generation);
+
+		// Marks 'module_name' dirty in every chain that reaches it.
+		// Returns the number of chains affected.
+		size_t MarkDirty(const WWuString& module_name);
+		void Clear();
+
+	private:
+		SRWLOCK _lock;
+		ULONGLONG _generation;
+		wumap<WWuString, LS_CACHED_CHAIN> _chains;
+	};
+
+	// Turns file change notifications into cache invalidations.
+	// A changed file is evicted from the image cache, and the directory index
+	// follows files being added, or removed. Every chain reaching the module
+	// is marked dirty with it, so the next query re-resolves only that subgraph.
+	class CacheInvalidator : public IChangeSink
+	{
+	public:
+		CacheInvalidator(DirectoryIndex* index, ImageCache* cache, ChainCache* chains);
+		~CacheInvalidator();
+
+		void OnFileChanged(const WWuString& file_path, LS_CHANGE_KIND kind) override;
+		void OnOverflow(const WWuString& directory) override;
+
+	private:
+		DirectoryIndex* _index;
+		ImageCache* _cache;
+		ChainCache* _chains;
+	};
+}
\ No newline at end of file
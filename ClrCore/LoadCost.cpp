@@ -0,0 +1,264 @@
+#include "pch.h"
+
+#include "LoadCost.h"
+
+#include <emmintrin.h>
+
+namespace LibSnitcher::Core
+{
+	// Offsets into IMAGE_LOAD_CONFIG_DIRECTORY32, and 64. Spelled out, because
+	// older SDKs don't have the newer fields, and we want to read them anyway.
+	typedef struct _LS_LOAD_CONFIG_LAYOUT
+	{
+		DWORD PointerSize;
+		DWORD SecurityCookie;
+		DWORD SEHandlerCount;
+		DWORD GuardCFFunctionCount;
+		DWORD GuardFlags;
+		DWORD GuardAddressTakenIatEntryCount;
+		DWORD GuardLongJumpTargetCount;
+		DWORD DynamicValueRelocTable;
+		DWORD CHPEMetadataPointer;
+		DWORD DynamicValueRelocTableOffset;
+		DWORD VolatileMetadataPointer;
+		DWORD GuardEHContinuationCount;
+
+	} LS_LOAD_CONFIG_LAYOUT;
+
+	static constexpr LS_LOAD_CONFIG_LAYOUT LoadConfigLayout32{ 4, 60, 68, 84, 88, 108, 116, 120, 124, 136, 160, 168 };
+	static constexpr LS_LOAD_CONFIG_LAYOUT LoadConfigLayout64{ 8, 88, 104, 136, 144, 168, 184, 192, 200, 224, 256, 272 };
+
+	const LSRESULT LoadCostReader::Read(HMODULE hmodule, PLS_LOAD_COST load_cost) noexcept
+	{
+		*load_cost = LS_LOAD_COST();
+
+		const BYTE* base = reinterpret_cast<const BYTE*>(hmodule);
+		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(hmodule);
+		if (dos_header->e_magic != IMAGE_DOS_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		PIMAGE_NT_HEADERS32 nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS32>((char*)hmodule + dos_header->e_lfanew);
+		if (nt_headers->Signature != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		bool pe32 = nt_headers->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		ULONGLONG image_base;
+		DWORD nr_rva_sizes;
+		PIMAGE_DATA_DIRECTORY data_dir;
+		WORD dll_characteristics;
+		if (pe32) {
+			load_cost->SizeOfImage = nt_headers->OptionalHeader.SizeOfImage;
+			image_base = nt_headers->OptionalHeader.ImageBase;
+			nr_rva_sizes = nt_headers->OptionalHeader.NumberOfRvaAndSizes;
+			data_dir = nt_headers->OptionalHeader.DataDirectory;
+			dll_characteristics = nt_headers->OptionalHeader.DllCharacteristics;
+		}
+		else {
+			PIMAGE_NT_HEADERS64 nt_headers64 = reinterpret_cast<PIMAGE_NT_HEADERS64>(nt_headers);
+			load_cost->SizeOfImage = nt_headers64->OptionalHeader.SizeOfImage;
+			image_base = nt_headers64->OptionalHeader.ImageBase;
+			nr_rva_sizes = nt_headers64->OptionalHeader.NumberOfRvaAndSizes;
+			data_dir = nt_headers64->OptionalHeader.DataDirectory;
+			dll_characteristics = nt_headers64->OptionalHeader.DllCharacteristics;
+		}
+
+		load_cost->DynamicBase = (dll_characteristics & IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE) != 0;
+
+		DWORD size_of_image = load_cost->SizeOfImage;
+		if (nr_rva_sizes > IMAGE_DIRECTORY_ENTRY_BASERELOC && data_dir[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress != 0) {
+			load_cost->HasRelocations = true;
+			ReadRelocations(base, size_of_image, data_dir[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress, data_dir[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size, &load_cost->Relocations);
+		}
+
+		if (nr_rva_sizes > IMAGE_DIRECTORY_ENTRY_TLS && data_dir[IMAGE_DIRECTORY_ENTRY_TLS].VirtualAddress != 0) {
+			load_cost->HasTls = true;
+			ReadTls(base, size_of_image, data_dir[IMAGE_DIRECTORY_ENTRY_TLS].VirtualAddress, image_base, pe32, &load_cost->Tls);
+		}
+
+		if (nr_rva_sizes > IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG && data_dir[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress != 0) {
+			load_cost->HasLoadConfig = true;
+			ReadLoadConfig(base, size_of_image, data_dir[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress, pe32, &load_cost->LoadConfig);
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT LoadCostReader::Read(const WWuString& file_path, PLS_LOAD_COST load_cost)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		// Mapping as an image, so RVAs are offsets from the view.
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY | SEC_IMAGE_NO_EXECUTE, 0, 0, NULL);
+		if (h_map == NULL) {
+			DWORD last_error = GetLastError();
+			CloseHandle(h_file);
+			return LSRESULT(last_error, __FILEW__, __LINE__);
+		}
+
+		LPVOID map_view = MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0);
+		if (map_view == NULL) {
+			DWORD last_error = GetLastError();
+			CloseHandle(h_map);
+			CloseHandle(h_file);
+			return LSRESULT(last_error, __FILEW__, __LINE__);
+		}
+
+		LSRESULT result = Read(static_cast<HMODULE>(map_view), load_cost);
+
+		UnmapViewOfFile(map_view);
+		CloseHandle(h_map);
+		CloseHandle(h_file);
+
+		return result;
+	}
+
+	void LoadCostReader::ReadRelocations(const BYTE* base, DWORD size_of_image, DWORD rva, DWORD size, PLS_RELOCATION_INFO relocations) noexcept
+	{
+		if (rva >= size_of_image)
+			return;
+
+		DWORD end = static_cast<DWORD>(min(static_cast<ULONGLONG>(rva) + size, static_cast<ULONGLONG>(size_of_image)));
+		DWORD offset = rva;
+		while (offset + sizeof(IMAGE_BASE_RELOCATION) <= end) {
+			const IMAGE_BASE_RELOCATION* block = reinterpret_cast<const IMAGE_BASE_RELOCATION*>(base + offset);
+			if (block->SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION) || block->SizeOfBlock > end - offset)
+				break;
+
+			// A block is a page RVA, and one word per fixup. Type in the high nibble, page offset in the rest.
+			size_t entry_count = (block->SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / sizeof(WORD);
+			ULONGLONG padding = CountPadding(reinterpret_cast<const WORD*>(block + 1), entry_count);
+
+			relocations->BlockCount++;
+			relocations->PaddingCount += padding;
+			relocations->FixupCount += entry_count - padding;
+			offset += block->SizeOfBlock;
+		}
+	}
+
+	void LoadCostReader::ReadTls(const BYTE* base, DWORD size_of_image, DWORD rva, ULONGLONG image_base, bool pe32, PLS_TLS_INFO tls) noexcept
+	{
+		ULONGLONG start_address;
+		ULONGLONG end_address;
+		ULONGLONG callbacks_address;
+		if (pe32) {
+			if (static_cast<ULONGLONG>(rva) + sizeof(IMAGE_TLS_DIRECTORY32) > size_of_image)
+				return;
+
+			const IMAGE_TLS_DIRECTORY32* directory = reinterpret_cast<const IMAGE_TLS_DIRECTORY32*>(base + rva);
+			start_address = directory->StartAddressOfRawData;
+			end_address = directory->EndAddressOfRawData;
+			callbacks_address = directory->AddressOfCallBacks;
+			tls->ZeroFillSize = directory->SizeOfZeroFill;
+		}
+		else {
+			if (static_cast<ULONGLONG>(rva) + sizeof(IMAGE_TLS_DIRECTORY64) > size_of_image)
+				return;
+
+			const IMAGE_TLS_DIRECTORY64* directory = reinterpret_cast<const IMAGE_TLS_DIRECTORY64*>(base + rva);
+			start_address = directory->StartAddressOfRawData;
+			end_address = directory->EndAddressOfRawData;
+			callbacks_address = directory->AddressOfCallBacks;
+			tls->ZeroFillSize = directory->SizeOfZeroFill;
+		}
+
+		if (end_address > start_address)
+			tls->TemplateSize = end_address - start_address;
+
+		// The callback array holds VAs for the preferred base, and ends with a null one.
+		// The view is not relocated, so the array VA is too.
+		if (callbacks_address <= image_base || callbacks_address - image_base >= size_of_image)
+			return;
+
+		DWORD pointer_size = pe32 ? sizeof(DWORD) : sizeof(ULONGLONG);
+		for (ULONGLONG offset = callbacks_address - image_base; offset + pointer_size <= size_of_image; offset += pointer_size) {
+			ULONGLONG callback = pe32 ? *reinterpret_cast<const DWORD*>(base + offset) : *reinterpret_cast<const ULONGLONG*>(base + offset);
+			if (callback == 0)
+				break;
+
+			tls->CallbackCount++;
+		}
+	}
+
+	void LoadCostReader::ReadLoadConfig(const BYTE* base, DWORD size_of_image, DWORD rva, bool pe32, PLS_LOAD_CONFIG_INFO load_config) noexcept
+	{
+		if (static_cast<ULONGLONG>(rva) + sizeof(DWORD) > size_of_image)
+			return;
+
+		// The first field is the size of the structure the linker wrote. That's our version.
+		load_config->Size = *reinterpret_cast<const DWORD*>(base + rva);
+		DWORD size = static_cast<DWORD>(min(static_cast<ULONGLONG>(load_config->Size), static_cast<ULONGLONG>(size_of_image) - rva));
+		const LS_LOAD_CONFIG_LAYOUT& layout = pe32 ? LoadConfigLayout32 : LoadConfigLayout64;
+
+		auto read_field = [base, rva, size](DWORD offset, DWORD width) -> ULONGLONG {
+			if (offset + width > size)
+				return 0;
+
+			return width == sizeof(DWORD) ? *reinterpret_cast<const DWORD*>(base + rva + offset) : *reinterpret_cast<const ULONGLONG*>(base + rva + offset);
+		};
+
+		load_config->SecurityCookie = read_field(layout.SecurityCookie, layout.PointerSize);
+		load_config->SEHandlerCount = read_field(layout.SEHandlerCount, layout.PointerSize);
+		load_config->GuardCFFunctionCount = read_field(layout.GuardCFFunctionCount, layout.PointerSize);
+		load_config->GuardFlags = static_cast<DWORD>(read_field(layout.GuardFlags, sizeof(DWORD)));
+		load_config->GuardAddressTakenIatEntryCount = read_field(layout.GuardAddressTakenIatEntryCount, layout.PointerSize);
+		load_config->GuardLongJumpTargetCount = read_field(layout.GuardLongJumpTargetCount, layout.PointerSize);
+		load_config->GuardEHContinuationCount = read_field(layout.GuardEHContinuationCount, layout.PointerSize);
+		load_config->HasChpeMetadata = read_field(layout.CHPEMetadataPointer, layout.PointerSize) != 0;
+		load_config->HasVolatileMetadata = read_field(layout.VolatileMetadataPointer, layout.PointerSize) != 0;
+		load_config->HasDynamicRelocations = read_field(layout.DynamicValueRelocTable, layout.PointerSize) != 0
+			|| read_field(layout.DynamicValueRelocTableOffset, sizeof(DWORD)) != 0;
+
+		// Guard table entries are an RVA, followed by 'n' bytes of metadata, 'n' in the guard flags.
+		ULONGLONG stride = sizeof(DWORD) + ((load_config->GuardFlags & IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK) >> IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT);
+		load_config->GuardTableSize = stride * (load_config->GuardCFFunctionCount + load_config->GuardAddressTakenIatEntryCount
+			+ load_config->GuardLongJumpTargetCount + load_config->GuardEHContinuationCount);
+	}
+
+	ULONGLONG LoadCostReader::CountPadding(const WORD* entries, size_t count) noexcept
+	{
+		ULONGLONG total = 0;
+		size_t position = 0;
+		const __m128i zero = _mm_setzero_si128();
+
+		// Matching lanes compare to -1, so subtracting counts them. 16-bit lanes
+		// take 32K blocks before they wrap, we drain them well before that.
+		while (count - position >= 8) {
+			size_t blocks = min((count - position) / 8, static_cast<size_t>(4096));
+			__m128i accumulator = _mm_setzero_si128();
+			for (size_t i = 0; i < blocks; i++) {
+				__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entries + position));
+				accumulator = _mm_sub_epi16(accumulator, _mm_cmpeq_epi16(_mm_srli_epi16(words, 12), zero));
+				position += 8;
+			}
+
+			__m128i wide = _mm_add_epi32(_mm_unpacklo_epi16(accumulator, zero), _mm_unpackhi_epi16(accumulator, zero));
+			wide = _mm_add_epi32(wide, _mm_shuffle_epi32(wide, _MM_SHUFFLE(1, 0, 3, 2)));
+			wide = _mm_add_epi32(wide, _mm_shuffle_epi32(wide, _MM_SHUFFLE(2, 3, 0, 1)));
+			total += static_cast<ULONGLONG>(_mm_cvtsi128_si32(wide));
+		}
+
+		for (; position < count; position++) {
+			if ((entries[position] >> 12) == IMAGE_REL_BASED_ABSOLUTE)
+				total++;
+		}
+
+		return total;
+	}
+
+	void LoadCostReader::Add(const LS_LOAD_COST& load_cost, LS_CHAIN_LOAD_COST& chain_cost) noexcept
+	{
+		chain_cost.ModuleCount++;
+		chain_cost.CommittedImageSize += load_cost.SizeOfImage;
+		chain_cost.FixupCount += load_cost.Relocations.FixupCount;
+		chain_cost.RelocationBlockCount += load_cost.Relocations.BlockCount;
+		chain_cost.GuardCFFunctionCount += load_cost.LoadConfig.GuardCFFunctionCount;
+		chain_cost.GuardTableSize += load_cost.LoadConfig.GuardTableSize;
+		if (load_cost.HasTls) {
+			chain_cost.TlsModuleCount++;
+			chain_cost.TlsCallbackCount += load_cost.Tls.CallbackCount;
+			chain_cost.TlsTemplateSize += load_cost.Tls.TemplateSize + load_cost.Tls.ZeroFillSize;
+		}
+	}
+}
\ No newline at end of file
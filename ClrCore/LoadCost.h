@@ -0,0 +1,105 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// Not in every SDK version.
+	#ifndef IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK
+	#define IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK 0xF0000000
+	#define IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT 28
+	#endif
+
+	typedef struct _LS_RELOCATION_INFO
+	{
+		DWORD BlockCount;
+
+		// Entries that patch the image. Absolute entries only pad blocks.
+		ULONGLONG FixupCount;
+		ULONGLONG PaddingCount;
+
+	} LS_RELOCATION_INFO, *PLS_RELOCATION_INFO;
+
+	typedef struct _LS_TLS_INFO
+	{
+		// Copied, and zero filled for every thread.
+		ULONGLONG TemplateSize;
+		DWORD ZeroFillSize;
+		DWORD CallbackCount;
+
+	} LS_TLS_INFO, *PLS_TLS_INFO;
+
+	// The load config fields that cost something at load. The directory grew with
+	// almost every release, so fields past the 'Size' the image declares are zero.
+	typedef struct _LS_LOAD_CONFIG_INFO
+	{
+		DWORD Size;
+		DWORD GuardFlags;
+		ULONGLONG SecurityCookie;
+		ULONGLONG SEHandlerCount;
+		ULONGLONG GuardCFFunctionCount;
+		ULONGLONG GuardAddressTakenIatEntryCount;
+		ULONGLONG GuardLongJumpTargetCount;
+		ULONGLONG GuardEHContinuationCount;
+		bool HasDynamicRelocations;
+		bool HasChpeMetadata;
+		bool HasVolatileMetadata;
+
+		// The guard tables, with the metadata bytes each entry carries.
+		ULONGLONG GuardTableSize;
+
+	} LS_LOAD_CONFIG_INFO, *PLS_LOAD_CONFIG_INFO;
+
+	typedef struct _LS_LOAD_COST
+	{
+		DWORD SizeOfImage;
+
+		// ASLR only moves images that opt in. The others are fixed up if their base is taken.
+		bool DynamicBase;
+		bool HasRelocations;
+		bool HasTls;
+		bool HasLoadConfig;
+		LS_RELOCATION_INFO Relocations;
+		LS_TLS_INFO Tls;
+		LS_LOAD_CONFIG_INFO LoadConfig;
+
+	} LS_LOAD_COST, *PLS_LOAD_COST;
+
+	// Totals for a resolved chain. Every module counts once.
+	typedef struct _LS_CHAIN_LOAD_COST
+	{
+		DWORD ModuleCount;
+		ULONGLONG CommittedImageSize;
+		ULONGLONG FixupCount;
+		DWORD RelocationBlockCount;
+		DWORD TlsModuleCount;
+		DWORD TlsCallbackCount;
+		ULONGLONG TlsTemplateSize;
+		ULONGLONG GuardCFFunctionCount;
+		ULONGLONG GuardTableSize;
+
+	} LS_CHAIN_LOAD_COST, *PLS_CHAIN_LOAD_COST;
+
+	// Parses the base relocation, TLS, and load config directories of an image
+	// mapped view. Tables outside 'SizeOfImage' are skipped, not failed.
+	class LoadCostReader
+	{
+	public:
+		static const LSRESULT Read(HMODULE hmodule, PLS_LOAD_COST load_cost) noexcept;
+
+		// Maps the file as an image, and reads it.
+		static const LSRESULT Read(const WWuString& file_path, PLS_LOAD_COST load_cost);
+
+		static void ReadRelocations(const BYTE* base, DWORD size_of_image, DWORD rva, DWORD size, PLS_RELOCATION_INFO relocations) noexcept;
+		static void ReadTls(const BYTE* base, DWORD size_of_image, DWORD rva, ULONGLONG image_base, bool pe32, PLS_TLS_INFO tls) noexcept;
+		static void ReadLoadConfig(const BYTE* base, DWORD size_of_image, DWORD rva, bool pe32, PLS_LOAD_CONFIG_INFO load_config) noexcept;
+
+		// Counts the type zero entries, eight at a time with SSE2.
+		static ULONGLONG CountPadding(const WORD* entries, size_t count) noexcept;
+
+		static void Add(const LS_LOAD_COST& load_cost, LS_CHAIN_LOAD_COST& chain_cost) noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "pch.h"
+
+#include "Manifest.h"
+
+namespace LibSnitcher::Core
+{
+	static bool IsXmlWhitespace(char c) noexcept
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	static bool IsNameTerminator(char c) noexcept
+	{
+		return IsXmlWhitespace(c) || c == '=' || c == '>' || c == '/';
+	}
+
+	// Drops the namespace prefix, as in 'asmv3:assemblyIdentity'.
+	static void ToLocalName(const char*& name, size_t& length) noexcept
+	{
+		for (size_t i = length; i > 0; i--) {
+			if (name[i - 1] == ':') {
+				name += i;
+				length -= i;
+				return;
+			}
+		}
+	}
+
+	static bool StartsWith(const char* position, const char* end, const char* prefix) noexcept
+	{
+		size_t length = strlen(prefix);
+		return static_cast<size_t>(end - position) >= length && strncmp(position, prefix, length) == 0;
+	}
+
+	XmlTokenizer::XmlTokenizer(const char* data, size_t size)
+		: _position(data), _end(data + size), _in_tag(false), _tag_name(NULL), _tag_name_length(0) { }
+
+	bool XmlTokenizer::Next(LS_XML_TOKEN& token) noexcept
+	{
+		token.Value = NULL;
+		token.ValueLength = 0;
+
+		// Attributes of the current start tag.
+		while (_in_tag) {
+			SkipWhitespace();
+			if (_position >= _end)
+				return false;
+
+			if (*_position == '/') {
+				// Self closing.
+				_in_tag = false;
+				SkipPast(">");
+				token.Kind = XmlTokenEndElement;
+				token.Name = _tag_name;
+				token.NameLength = _tag_name_length;
+				return true;
+			}
+
+			if (*_position == '>') {
+				_in_tag = false;
+				_position++;
+				break;
+			}
+
+			ReadName(token.Name, token.NameLength);
+			if (token.NameLength == 0) {
+				_position++;
+				continue;
+			}
+
+			SkipWhitespace();
+			if (_position < _end && *_position == '=') {
+				_position++;
+				SkipWhitespace();
+				if (_position < _end && (*_position == '"' || *_position == '\'')) {
+					char quote = *_position++;
+					const char* value = _position;
+					while (_position < _end && *_position != quote)
+						_position++;
+
+					token.Value = value;
+					token.ValueLength = _position - value;
+					if (_position < _end)
+						_position++;
+				}
+			}
+
+			ToLocalName(token.Name, token.NameLength);
+			token.Kind = XmlTokenAttribute;
+			return true;
+		}
+
+		// Content. Everything but tags is skipped.
+		while (_position < _end) {
+			if (*_position != '<') {
+				const char* next = static_cast<const char*>(memchr(_position, '<', _end - _position));
+				_position = next == NULL ? _end : next;
+				continue;
+			}
+
+			if (StartsWith(_position, _end, "<!--")) {
+				SkipPast("-->");
+				continue;
+			}
+
+			if (StartsWith(_position, _end, "<![CDATA[")) {
+				SkipPast("]]>");
+				continue;
+			}
+
+			if (StartsWith(_position, _end, "<?")) {
+				SkipPast("?>");
+				continue;
+			}
+
+			if (StartsWith(_position, _end, "<!")) {
+				SkipPast(">");
+				continue;
+			}
+
+			if (StartsWith(_position, _end, "</")) {
+				_position += 2;
+				ReadName(token.Name, token.NameLength);
+				SkipPast(">");
+				ToLocalName(token.Name, token.NameLength);
+				token.Kind = XmlTokenEndElement;
+				return true;
+			}
+
+			_position++;
+			ReadName(token.Name, token.NameLength);
+			ToLocalName(token.Name, token.NameLength);
+			_tag_name = token.Name;
+			_tag_name_length = token.NameLength;
+			_in_tag = true;
+			token.Kind = XmlTokenStartElement;
+			return true;
+		}
+
+		return false;
+	}
+
+	void XmlTokenizer::SkipPast(const char* terminator) noexcept
+	{
+		while (_position < _end && !StartsWith(_position, _end, terminator))
+			_position++;
+
+		_position = min(_position + strlen(terminator), _end);
+	}
+
+	void XmlTokenizer::SkipWhitespace() noexcept
+	{
+		while (_position < _end && IsXmlWhitespace(*_position))
+			_position++;
+	}
+
+	void XmlTokenizer::ReadName(const char*& name, size_t& length) noexcept
+	{
+		name = _position;
+		while (_position < _end && !IsNameTerminator(*_position))
+			_position++;
+
+		length = _position - name;
+	}
+
+	static WWuString ToLowerWide(const char* value, size_t length)
+	{
+		if (length == 0)
+			return WWuString();
+
+		int char_count = MultiByteToWideChar(CP_UTF8, 0, value, static_cast<int>(length), NULL, 0);
+		wuvector<WCHAR> buffer(static_cast<size_t>(char_count) + 1, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, value, static_cast<int>(length), buffer.data(), char_count);
+
+		return WWuString(buffer.data()).ToLower();
+	}
+
+	static void SetIdentityAttribute(LS_ASSEMBLY_IDENTITY& identity, const LS_XML_TOKEN& token)
+	{
+		if (token.Is("name"))
+			identity.Name = ToLowerWide(token.Value, token.ValueLength);
+		else if (token.Is("version"))
+			identity.Version = ToLowerWide(token.Value, token.ValueLength);
+		else if (token.Is("processorArchitecture"))
+			identity.ProcessorArchitecture = ToLowerWide(token.Value, token.ValueLength);
+		else if (token.Is("publicKeyToken"))
+			identity.PublicKeyToken = ToLowerWide(token.Value, token.ValueLength);
+		else if (token.Is("language"))
+			identity.Language = ToLowerWide(token.Value, token.ValueLength);
+		else if (token.Is("type"))
+			identity.Type = ToLowerWide(token.Value, token.ValueLength);
+	}
+
+	bool ManifestParser::Parse(const char* data, size_t size, LS_MANIFEST_INFO& manifest)
+	{
+		// We only keep the names of the open elements.
+		typedef struct _LS_OPEN_ELEMENT
+		{
+			const char* Name;
+			size_t Length;
+
+			bool Is(const char* name) const noexcept
+			{
+				return strlen(name) == Length && strncmp(Name, name, Length) == 0;
+			}
+
+		} LS_OPEN_ELEMENT;
+
+		wuvector<LS_OPEN_ELEMENT> open;
+		bool found_assembly = false;
+		XmlTokenizer tokenizer(data, size);
+		LS_XML_TOKEN token;
+		while (tokenizer.Next(token)) {
+			switch (token.Kind) {
+				case XmlTokenStartElement:
+				{
+					open.push_back({ token.Name, token.NameLength });
+					if (open.size() == 1 && token.Is("assembly"))
+						found_assembly = true;
+					else if (open.size() >= 2 && token.Is("assemblyIdentity") && open[open.size() - 2].Is("dependentAssembly"))
+						manifest.Dependencies.push_back(LS_ASSEMBLY_IDENTITY());
+				} break;
+
+				case XmlTokenEndElement:
+				{
+					if (!open.empty())
+						open.pop_back();
+				} break;
+
+				case XmlTokenAttribute:
+				{
+					if (open.size() < 2 || !open[0].Is("assembly"))
+						break;
+
+					const LS_OPEN_ELEMENT& element = open.back();
+					const LS_OPEN_ELEMENT& parent = open[open.size() - 2];
+					if (element.Is("assemblyIdentity")) {
+						if (open.size() == 2)
+							SetIdentityAttribute(manifest.Identity, token);
+						else if (parent.Is("dependentAssembly") && !manifest.Dependencies.empty())
+							SetIdentityAttribute(manifest.Dependencies.back(), token);
+					}
+					else if (element.Is("file") && open.size() == 2 && token.Is("name")) {
+						manifest.Files.push_back(ToLowerWide(token.Value, token.ValueLength));
+					}
+				} break;
+			}
+		}
+
+		return found_assembly;
+	}
+
+	void ManifestParser::SetDefaultArchitecture(wuvector<LS_ASSEMBLY_IDENTITY>& identities, WORD machine)
+	{
+		WWuString architecture = GetArchitectureName(machine);
+		for (LS_ASSEMBLY_IDENTITY& identity : identities) {
+			if (identity.ProcessorArchitecture.Length() == 0 || identity.ProcessorArchitecture == L"*")
+				identity.ProcessorArchitecture = architecture;
+		}
+	}
+
+	WWuString ManifestParser::GetArchitectureName(WORD machine)
+	{
+		// The names used in manifests, and in the WinSxS store.
+		switch (machine) {
+			case IMAGE_FILE_MACHINE_I386:
+				return L"x86";
+			case IMAGE_FILE_MACHINE_AMD64:
+				return L"amd64";
+			case IMAGE_FILE_MACHINE_ARM64:
+				return L"arm64";
+			case IMAGE_FILE_MACHINE_ARMNT:
+				return L"arm";
+			case IMAGE_FILE_MACHINE_IA64:
+				return L"ia64";
+			default:
+				return L"none";
+		}
+	}
+}
\ No newline at end of file
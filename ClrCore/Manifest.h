@@ -0,0 +1,96 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_XML_TOKEN_KIND
+	{
+		XmlTokenStartElement,
+		XmlTokenAttribute,
+		XmlTokenEndElement
+	} LS_XML_TOKEN_KIND;
+
+	// Names are local names, without the namespace prefix. Names, and values
+	// point into the document, and are not null terminated. Entities are not expanded.
+	typedef struct _LS_XML_TOKEN
+	{
+		LS_XML_TOKEN_KIND Kind;
+		const char* Name;
+		size_t NameLength;
+		const char* Value;
+		size_t ValueLength;
+
+		bool Is(const char* name) const noexcept
+		{
+			return strlen(name) == NameLength && strncmp(Name, name, NameLength) == 0;
+		}
+
+	} LS_XML_TOKEN, *PLS_XML_TOKEN;
+
+	// Pull tokenizer over an UTF-8 XML document. It doesn't build a tree, or allocate.
+	// Text, comments, CDATA, processing instructions, and the DOCTYPE are skipped.
+	// Self closing elements produce an end token. Well-formedness is not checked.
+	class XmlTokenizer
+	{
+	public:
+		XmlTokenizer(const char* data, size_t size);
+
+		bool Next(LS_XML_TOKEN& token) noexcept;
+
+	private:
+		const char* _position;
+		const char* _end;
+		bool _in_tag;
+		const char* _tag_name;
+		size_t _tag_name_length;
+
+		void SkipPast(const char* terminator) noexcept;
+		void SkipWhitespace() noexcept;
+		void ReadName(const char*& name, size_t& length) noexcept;
+	};
+
+	// An 'assemblyIdentity'. Values are lowercase, so identities compare as is.
+	typedef struct _LS_ASSEMBLY_IDENTITY
+	{
+		WWuString Name;
+		WWuString Version;
+		WWuString ProcessorArchitecture;
+		WWuString PublicKeyToken;
+		WWuString Language;
+		WWuString Type;
+
+		_LS_ASSEMBLY_IDENTITY() { }
+		~_LS_ASSEMBLY_IDENTITY() { }
+
+	} LS_ASSEMBLY_IDENTITY, *PLS_ASSEMBLY_IDENTITY;
+
+	typedef struct _LS_MANIFEST_INFO
+	{
+		LS_ASSEMBLY_IDENTITY Identity;
+
+		// 'dependentAssembly' identities. These make the activation context.
+		wuvector<LS_ASSEMBLY_IDENTITY> Dependencies;
+
+		// 'file' names, for assembly manifests.
+		wuvector<WWuString> Files;
+
+		_LS_MANIFEST_INFO() { }
+		~_LS_MANIFEST_INFO() { }
+
+	} LS_MANIFEST_INFO, *PLS_MANIFEST_INFO;
+
+	class ManifestParser
+	{
+	public:
+		// Returns false if there's no 'assembly' element.
+		static bool Parse(const char* data, size_t size, LS_MANIFEST_INFO& manifest);
+
+		// Replaces '*', or missing architectures with the one for 'machine'.
+		static void SetDefaultArchitecture(wuvector<LS_ASSEMBLY_IDENTITY>& identities, WORD machine);
+		static WWuString GetArchitectureName(WORD machine);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "pch.h"
+
+#define LS_API_EXPORTS
+#include "NativeApi.h"
+#include "Resolver.h"
+
+// The C interface mirrors these, it can't include the engine headers.
+static_assert(LS_API_IMPORT_HASH_SIZE == LS_IMPORT_HASH_SIZE, "Import hash size mismatch.");
+static_assert(LS_API_STOP_NONE == LibSnitcher::Core::WorkStopNone && LS_API_STOP_BYTES == LibSnitcher::Core::WorkStopBytes, "Stop reasons mismatch.");
+
+// Declared opaque, outside the namespace, by the C interface.
+typedef struct _LS_API_CONTEXT
+{
+	LibSnitcher::Core::LS_WORK_LIMITS Limits;
+	DWORD Flags;
+
+} LS_API_CONTEXT, *PLS_API_CONTEXT;
+
+namespace LibSnitcher::Core
+{
+	// Zeroed. Any NULL fails the whole copy, and the arena is destroyed with what it has.
+	static PVOID ArenaAllocate(HANDLE arena, size_t size) noexcept
+	{
+		return HeapAlloc(arena, HEAP_ZERO_MEMORY, size == 0 ? 1 : size);
+	}
+
+	static LPCWSTR ArenaCopy(HANDLE arena, const WWuString& string) noexcept
+	{
+		size_t size = (string.Length() + 1) * sizeof(WCHAR);
+		PVOID copy = ArenaAllocate(arena, size);
+		if (copy != NULL)
+			RtlCopyMemory(copy, string.GetBuffer(), size);
+
+		return static_cast<LPCWSTR>(copy);
+	}
+
+	// One block for the pointers, and one for the characters.
+	static bool ArenaCopy(HANDLE arena, const wuvector<WuString>& strings, DWORD& count, LPCSTR*& output) noexcept
+	{
+		size_t total_size = 0;
+		for (const WuString& string : strings)
+			total_size += string.Length() + 1;
+
+		count = static_cast<DWORD>(strings.size());
+		output = static_cast<LPCSTR*>(ArenaAllocate(arena, strings.size() * sizeof(LPCSTR)));
+		char* characters = static_cast<char*>(ArenaAllocate(arena, total_size));
+		if (output == NULL || characters == NULL)
+			return false;
+
+		for (size_t i = 0; i < strings.size(); i++) {
+			size_t size = strings[i].Length() + 1;
+			RtlCopyMemory(characters, strings[i].GetBuffer(), size);
+			output[i] = characters;
+			characters += size;
+		}
+
+		return true;
+	}
+
+	static LONG CopyImage(HANDLE arena, const LS_CACHED_IMAGE& image, PLS_API_IMAGE output) noexcept
+	{
+		output->Arena = arena;
+		output->Path = ArenaCopy(arena, image.Path);
+		output->Machine = image.Machine;
+		output->Magic = image.Magic;
+		output->Characteristics = image.Characteristics;
+		output->Subsystem = image.Subsystem;
+		output->TimeDateStamp = image.TimeDateStamp;
+		output->SizeOfImage = image.SizeOfImage;
+		output->CheckSum = image.CheckSum;
+		output->IsClr = image.BasicInfo.IsClr ? TRUE : FALSE;
+
+		// The first budget to run out, imports, or symbols.
+		output->StopReason = image.BasicInfo.StopReason != WorkStopNone ? image.BasicInfo.StopReason : image.Symbols.StopReason;
+
+		if (output->Path == NULL
+			|| !ArenaCopy(arena, image.BasicInfo.Dependencies, output->DependencyCount, output->Dependencies)
+			|| !ArenaCopy(arena, image.HeuristicDependencies, output->HeuristicCount, output->HeuristicDependencies)
+			|| !ArenaCopy(arena, image.Symbols.Imports, output->ImportCount, output->Imports)
+			|| !ArenaCopy(arena, image.Symbols.Exports, output->ExportCount, output->Exports))
+		{
+			return ERROR_NOT_ENOUGH_MEMORY;
+		}
+
+		output->HasImportHash = image.Symbols.HasImportHash ? TRUE : FALSE;
+		RtlCopyMemory(output->ImportHash, image.Symbols.ImportHash, LS_IMPORT_HASH_SIZE);
+		output->ExportHash = image.Symbols.ExportHash;
+
+		return ERROR_SUCCESS;
+	}
+}
+
+using namespace LibSnitcher::Core;
+
+LS_API LONG WINAPI LsCreateContext(const LS_API_OPTIONS* options, LS_CONTEXT* context)
+{
+	if (context == NULL)
+		return ERROR_INVALID_PARAMETER;
+
+	*context = NULL;
+	if (options != NULL && options->Version != LS_API_VERSION)
+		return ERROR_REVISION_MISMATCH;
+
+	PLS_API_CONTEXT new_context = static_cast<PLS_API_CONTEXT>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(LS_API_CONTEXT)));
+	if (new_context == NULL)
+		return ERROR_NOT_ENOUGH_MEMORY;
+
+	new_context->Limits = LS_WORK_LIMITS();
+	if (options != NULL) {
+		new_context->Flags = options->Flags;
+		new_context->Limits.MaxSections = options->MaxSections;
+		new_context->Limits.MaxDescriptors = options->MaxDescriptors;
+		new_context->Limits.MaxThunks = options->MaxThunks;
+		new_context->Limits.MaxBytes = options->MaxBytes;
+	}
+
+	*context = new_context;
+
+	return ERROR_SUCCESS;
+}
+
+LS_API void WINAPI LsCloseContext(LS_CONTEXT context)
+{
+	if (context != NULL)
+		HeapFree(GetProcessHeap(), 0, context);
+}
+
+LS_API LONG WINAPI LsParseImage(LS_CONTEXT context, LPCWSTR image_path, PLS_API_IMAGE* image)
+{
+	if (context == NULL || image_path == NULL || image == NULL)
+		return ERROR_INVALID_PARAMETER;
+
+	*image = NULL;
+
+	// Exceptions don't cross a C interface. The parsers only throw when allocations fail.
+	try {
+		LS_CACHED_IMAGE parsed;
+		parsed.Path = image_path;
+
+		WorkBudget budget(context->Limits);
+		Resolver::ParseImage(&parsed, (context->Flags & LS_API_PARSE_SYMBOLS) != 0, (context->Flags & LS_API_PARSE_HEURISTIC) != 0, budget);
+		if (parsed.Result != ERROR_SUCCESS)
+			return parsed.Result;
+
+		// Not serialized, only this call uses it until it returns.
+		HANDLE arena = HeapCreate(HEAP_NO_SERIALIZE, 0, 0);
+		if (arena == NULL)
+			return GetLastError();
+
+		PLS_API_IMAGE output = static_cast<PLS_API_IMAGE>(ArenaAllocate(arena, sizeof(LS_API_IMAGE)));
+		LONG result = output == NULL ? ERROR_NOT_ENOUGH_MEMORY : CopyImage(arena, parsed, output);
+		if (result != ERROR_SUCCESS) {
+			HeapDestroy(arena);
+			return result;
+		}
+
+		*image = output;
+
+		return ERROR_SUCCESS;
+	}
+	catch (...) {
+		return ERROR_NOT_ENOUGH_MEMORY;
+	}
+}
+
+LS_API void WINAPI LsFreeImage(PLS_API_IMAGE image)
+{
+	// The image is in the arena too.
+	if (image != NULL)
+		HeapDestroy(image->Arena);
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <windows.h>
+
+///////////////////////////////////////////////////////////////////////////
+//
+//  ~ Native C interface.
+//
+// ------------------------------------------------------------------------
+//
+//  For hosts that embed the engine without .NET. The header stands alone,
+//  it only needs 'windows.h', and can be included from C, or C++.
+//  Every function can be called from any number of threads at once:
+//
+//  - A context only holds the options. It's read-only once created, and
+//    can be shared by every thread until 'LsCloseContext'.
+//  - Each 'LsParseImage' call works on its own stack, and allocates its
+//    result in its own arena, a private heap. Nothing is cached, or
+//    shared between calls.
+//  - 'LsFreeImage' destroys the arena, and everything in it, at once.
+//    Any thread can free an image, but only once.
+//
+//  Functions return Win32 error codes, 'ERROR_SUCCESS' on success.
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Defined when building the engine itself.
+#ifdef LS_API_EXPORTS
+	#define LS_API __declspec(dllexport)
+#else
+	#define LS_API __declspec(dllimport)
+#endif
+
+#define LS_API_VERSION 1
+
+// What to read besides the headers, and the import, and delay load tables.
+#define LS_API_PARSE_SYMBOLS 0x1
+#define LS_API_PARSE_HEURISTIC 0x2
+
+// Why a list is partial. Zero means it's not.
+#define LS_API_STOP_NONE 0
+#define LS_API_STOP_CANCELLED 1
+#define LS_API_STOP_DEADLINE 2
+#define LS_API_STOP_SECTIONS 3
+#define LS_API_STOP_DESCRIPTORS 4
+#define LS_API_STOP_THUNKS 5
+#define LS_API_STOP_BYTES 6
+
+// The MD5 import hash.
+#define LS_API_IMPORT_HASH_SIZE 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _LS_API_OPTIONS
+{
+	// LS_API_VERSION.
+	DWORD Version;
+	DWORD Flags;
+
+	// Per image limits. Zero means no limit.
+	DWORD MaxSections;
+	DWORD MaxDescriptors;
+	DWORD MaxThunks;
+	DWORD Reserved;
+	ULONGLONG MaxBytes;
+
+} LS_API_OPTIONS, *PLS_API_OPTIONS;
+
+// Everything is in the arena of the call that returned it, strings included.
+typedef struct _LS_API_IMAGE
+{
+	LPCWSTR Path;
+	WORD Machine;
+	WORD Magic;
+	WORD Characteristics;
+	WORD Subsystem;
+	DWORD TimeDateStamp;
+	DWORD SizeOfImage;
+	DWORD CheckSum;
+	BOOL IsClr;
+
+	// A LS_API_STOP_* value. Anything but 'LS_API_STOP_NONE' means the lists below are partial.
+	LONG StopReason;
+
+	// Module names, as in the import, and delay load tables.
+	DWORD DependencyCount;
+	LPCSTR* Dependencies;
+
+	// With LS_API_PARSE_HEURISTIC. Module names found in the read-only data.
+	DWORD HeuristicCount;
+	LPCSTR* HeuristicDependencies;
+
+	// With LS_API_PARSE_SYMBOLS. Imports are 'module!function', exports are 'function'.
+	DWORD ImportCount;
+	LPCSTR* Imports;
+	DWORD ExportCount;
+	LPCSTR* Exports;
+	BOOL HasImportHash;
+	BYTE ImportHash[LS_API_IMPORT_HASH_SIZE];
+	ULONGLONG ExportHash;
+
+	// The private heap everything above lives in. Released by 'LsFreeImage'.
+	HANDLE Arena;
+
+} LS_API_IMAGE, *PLS_API_IMAGE;
+
+typedef struct _LS_API_CONTEXT* LS_CONTEXT;
+
+// A NULL 'options' means the default limits, and no flags.
+LS_API LONG WINAPI LsCreateContext(const LS_API_OPTIONS* options, LS_CONTEXT* context);
+LS_API void WINAPI LsCloseContext(LS_CONTEXT context);
+
+// Maps the file as an image, and parses it with the context options. On success '*image'
+// must be released with 'LsFreeImage'. On failure it's NULL.
+LS_API LONG WINAPI LsParseImage(LS_CONTEXT context, LPCWSTR image_path, PLS_API_IMAGE* image);
+LS_API void WINAPI LsFreeImage(PLS_API_IMAGE image);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
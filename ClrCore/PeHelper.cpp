@@ -1,6 +1,9 @@
 #include "pch.h"
 
 #include "PeHelper.h"
+#include "CoffObject.h"
+#include "ImageView.h"
+#include "SymbolHash.h"
 
 namespace LibSnitcher::Core
 {
@@ -11,12 +14,9 @@ namespace LibSnitcher::Core
 		if (!PathFileExists(image_path.GetBuffer()))
 			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
 
-		WWuString image_name(image_path);
-		PathStripPath(image_name.GetBuffer());
-
 		// Opening the file, and getting its size.
 		HANDLE h_file = CreateFile(image_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, NULL, NULL);
-		if (h_file == NULL)
+		if (h_file == INVALID_HANDLE_VALUE)
 			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
 
 		if (!GetFileSizeEx(h_file, &file_size))
@@ -25,9 +25,9 @@ namespace LibSnitcher::Core
 			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
 		}
 
-		// Creating file mapping, and view.
-		WWuString map_name = WWuString::Format(L"LibSnitcher-%ws", image_name.GetBuffer());
-		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY, 0, 0, map_name.GetBuffer());
+		// Creating file mapping, and view. Unnamed, a name is shared by every caller in the session,
+		// and two threads parsing files with the same name would get each other's mapping.
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY, 0, 0, NULL);
 		if (h_map == NULL)
 		{
 			CloseHandle(h_file);
@@ -43,8 +43,13 @@ namespace LibSnitcher::Core
 		}
 
 		// Testing if it's a valid image.
-		if (file_size.QuadPart < 20)
+		if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(IMAGE_FILE_HEADER)))
+		{
+			UnmapViewOfFile(map_view);
+			CloseHandle(h_map);
+			CloseHandle(h_file);
 			return LSRESULT(ERROR_BAD_FORMAT, __FILEW__, __LINE__);
+		}
 
 		bool coff_only;
 		DWORD pe_sig_ra;
@@ -67,31 +72,31 @@ namespace LibSnitcher::Core
 			// Copying the COFF header;
 			RtlCopyMemory(&pe_headers->CoffHeader, map_view, sizeof(IMAGE_FILE_HEADER));
 
-			if (file_size.QuadPart < (__int64)((pe_headers->CoffHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER)) + 20))
-				return LSRESULT(ERROR_BAD_FORMAT, __FILEW__, __LINE__);
-
-			// Copying the section headers.
-			LPVOID section_offset = (LPVOID)((char*)map_view + __LINE__);
-			for (size_t i = 0; i < pe_headers->CoffHeader.NumberOfSections; i++)
+			// The section table follows the header, and the optional header, if any.
+			CoffObject object;
+			LSRESULT result = object.Attach(static_cast<const BYTE*>(map_view), static_cast<size_t>(file_size.QuadPart));
+			if (result.Result != ERROR_SUCCESS)
 			{
-				IMAGE_SECTION_HEADER sec_header = { 0 };
-				memcpy(&sec_header, section_offset, sizeof(IMAGE_SECTION_HEADER));
-
-				pe_headers->SectionHeaders.push_back(sec_header);
-
-				section_offset = (LPVOID)((char*)section_offset + sizeof(IMAGE_SECTION_HEADER));
+				UnmapViewOfFile(map_view);
+				CloseHandle(h_map);
+				CloseHandle(h_file);
+				return result;
 			}
 
-			// Calculating metadata location (if any).
+			// Copying the section headers, and calculating metadata location (if any).
 			bool cor_found = false;
-			for (IMAGE_SECTION_HEADER& header : pe_headers->SectionHeaders)
+			for (DWORD i = 0; i < object.SectionCount(); i++)
 			{
-				LPSTR section_name = reinterpret_cast<char*>(header.Name);
-				if (strcmp(section_name, ".cormeta") == 0)
+				pe_headers->SectionHeaders.push_back(*object.GetSection(i));
+
+				// Names can be longer than eight characters, and aren't null terminated if they're eight.
+				const char* section_name;
+				DWORD name_length;
+				if (object.GetSectionName(i, section_name, name_length) && name_length == 8 && strncmp(section_name, ".cormeta", 8) == 0)
 				{
 					cor_found = true;
-					pe_headers->MetadataSize = header.SizeOfRawData;
-					pe_headers->MetadataStartOffset = header.PointerToRawData;
+					pe_headers->MetadataSize = object.GetSection(i)->SizeOfRawData;
+					pe_headers->MetadataStartOffset = object.GetSection(i)->PointerToRawData;
 				}
 			}
 			if (!cor_found)
@@ -100,109 +105,33 @@ namespace LibSnitcher::Core
 				pe_headers->MetadataSize = 0;
 				pe_headers->MetadataStartOffset = 0;
 			}
+
+			object.Close();
+			UnmapViewOfFile(map_view);
+			CloseHandle(h_map);
+			CloseHandle(h_file);
 		}
 		else
 		{
+			// 'ImageLoad' is single-threaded, and maps the file a second time. The view we
+			// have has the same headers, and 'ImageView' reads them within the file size.
+			ImageView view;
+			LSRESULT result = view.Attach(static_cast<const BYTE*>(map_view), static_cast<size_t>(file_size.QuadPart));
+			if (result.Result == ERROR_SUCCESS)
+				view.GetHeaders(pe_headers);
+
 			UnmapViewOfFile(map_view);
 			CloseHandle(h_map);
 			CloseHandle(h_file);
 
-			pe_headers->IsCoffOnly = false;
-			
-			PathStripPath(image_name.GetBuffer());
-			DWORD dw_result = PathCchRemoveFileSpec(image_path.GetBuffer(), image_path.Length());
-			if (dw_result != S_OK)
-				return LSRESULT(dw_result, __FILEW__, __LINE__);
-
-			WuString narrow_name = WWuStringToNarrow(image_name);
-			WuString narrow_path = WWuStringToNarrow(image_path);
-
-			PLOADED_IMAGE loaded_image = ImageLoad(narrow_name.GetBuffer(), narrow_path.GetBuffer());
-			if (loaded_image == NULL)
-				return LSRESULT(GetLastError(), __FILEW__, __LINE__);
-			
-			// Calculating COFF header offset.
-			pe_headers->CoffHeaderOffset = pe_sig_ra + 4;
-
-			pe_headers->OptionalHeaderOffset = pe_headers->CoffHeaderOffset + 20;
-			pe_headers->IsDll = (loaded_image->FileHeader->FileHeader.Characteristics & IMAGE_FILE_DLL) != 0;
-			pe_headers->IsExe = (loaded_image->FileHeader->FileHeader.Characteristics & IMAGE_FILE_DLL) == 0;
-			pe_headers->IsConsoleApplication = loaded_image->FileHeader->OptionalHeader.Subsystem == IMAGE_SUBSYSTEM_WINDOWS_CUI;
-
-			// Copying NT headers.
-			pe_headers->Magic = loaded_image->FileHeader->OptionalHeader.Magic;
-			if (pe_headers->Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)
-				RtlCopyMemory(&pe_headers->NtHeaders32, loaded_image->FileHeader, sizeof(IMAGE_NT_HEADERS32));
-			else
-				RtlCopyMemory(&pe_headers->NtHeaders64, loaded_image->FileHeader, sizeof(IMAGE_NT_HEADERS64));
-			
-			// Copying section headers.
-			PIMAGE_SECTION_HEADER section_offset = loaded_image->Sections;
-			for (size_t i = 0; i < loaded_image->NumberOfSections; i++)
-			{
-				IMAGE_SECTION_HEADER sec_header = { 0 };
-				RtlCopyMemory(&sec_header, section_offset, sizeof(IMAGE_SECTION_HEADER));
-				pe_headers->SectionHeaders.push_back(sec_header);
-
-				section_offset = (PIMAGE_SECTION_HEADER)((char*)section_offset + sizeof(IMAGE_SECTION_HEADER));
-			}
-
-			// Attempting to get COR header, and offsets;
-			DWORD cor_rel_offset = 0;
-			pe_headers->MetadataSize = 0;
-			pe_headers->MetadataStartOffset = 0;
-			LSRESULT result = GetDirectoryOffset(
-				loaded_image->FileHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_COM_DESCRIPTOR],
-				loaded_image->Sections,
-				(DWORD)loaded_image->NumberOfSections,
-				cor_rel_offset,
-				false
-			);
-			if (cor_rel_offset > 0)
-			{
-				pe_headers->CorHeaderOffset = cor_rel_offset;
-
-				LPVOID cor_offset = (LPVOID)((char*)loaded_image->MappedAddress + cor_rel_offset);
-				RtlCopyMemory(&pe_headers->CorHeader, cor_offset, sizeof(IMAGE_COR20_HEADER));
-
-				DWORD meta_rel_offset = 0;
-				result = GetDirectoryOffset(
-					pe_headers->CorHeader.MetaData,
-					loaded_image->Sections,
-					(DWORD)loaded_image->NumberOfSections,
-					meta_rel_offset,
-					false
-				);
-
-				if (meta_rel_offset == 0)
-				{
-					ImageUnload(loaded_image);
-					return LSRESULT(ERROR_BAD_FORMAT, L"COR header missing data directory.", __FILEW__, __LINE__);
-				}
-
-				DWORD meta_size = pe_headers->CorHeader.MetaData.Size;
-				if (meta_rel_offset < 0 ||
-					meta_rel_offset >= loaded_image->SizeOfImage ||
-					meta_size <= 0 ||
-					meta_rel_offset > loaded_image->SizeOfImage - meta_size)
-				{
-					ImageUnload(loaded_image);
-					return LSRESULT(ERROR_BAD_FORMAT, L"Invalid COR metadata section span.", __FILEW__, __LINE__);
-				}
-
-				pe_headers->MetadataSize = meta_size;
-				pe_headers->MetadataStartOffset = meta_rel_offset;
-			}
-			else
-				pe_headers->CorHeaderOffset = -1;
-
-			ImageUnload(loaded_image);
+			if (result.Result != ERROR_SUCCESS)
+				return result;
 		}
 
 		return LSRESULT();
 	}
 
-	const LSRESULT PeHelper::GetImageBasicInformation(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION image_info) noexcept
+	const LSRESULT PeHelper::GetImageBasicInformation(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION image_info, WorkBudget* budget) noexcept
 	{
 		// Checking if the file is a valid image.
 		bool coff_only = false;
@@ -217,6 +146,7 @@ namespace LibSnitcher::Core
 		WORD opt_header_size = *static_cast<WORD*>((LPVOID)((char*)hmodule + pe_sig_ra + 20));
 		LPVOID opt_header_offset = (LPVOID)((char*)hmodule + pe_sig_ra + 24);
 		WORD magic = *static_cast<WORD*>(opt_header_offset);
+		image_info->BytesRead = pe_sig_ra + 24 + opt_header_size;
 
 		// Getting size for the 'fixed' part of the optional header.
 		WORD fixed_opt_header_size = 112;
@@ -246,38 +176,267 @@ namespace LibSnitcher::Core
 		if (nr_rva_sizes >= 13)
 			image_info->DelayLoadTableRva = data_dir[IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT].VirtualAddress;
 
-		GetModuleDependencyTables(hmodule, image_info);
+		if (nr_rva_sizes >= 1)
+			image_info->ExportTableRva = data_dir[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
+
+		if (nr_rva_sizes >= 3) {
+			image_info->ResourceTableRva = data_dir[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress;
+			image_info->ResourceTableSize = data_dir[IMAGE_DIRECTORY_ENTRY_RESOURCE].Size;
+		}
+
+		// 'SizeOfImage' is at the same offset for PE32, and PE32+.
+		image_info->SizeOfImage = *static_cast<DWORD*>((LPVOID)((char*)opt_header_offset + 56));
+
+		// A section count no linker produces means a crafted image, we don't walk its tables.
+		WORD section_count = *static_cast<WORD*>((LPVOID)((char*)hmodule + pe_sig_ra + 6));
+		if (budget != NULL && !budget->CheckSections(section_count)) {
+			image_info->StopReason = budget->StopReason();
+			return LSRESULT();
+		}
+
+		GetModuleDependencyTables(hmodule, image_info, budget);
 
 		return LSRESULT();
 	}
 
-	void PeHelper::GetModuleDependencyTables(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION img_info) noexcept
+	void PeHelper::GetModuleDependencyTables(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION img_info, WorkBudget* budget) noexcept
 	{
+		char* base = (char*)hmodule;
+		DWORD image_size = img_info->SizeOfImage;
+		auto in_image = [image_size](ULONGLONG rva, ULONGLONG size) -> bool {
+			return rva != 0 && rva < image_size && size <= image_size - rva;
+		};
+
+		// One descriptor, and its name. False when the budget runs out.
+		auto add_dependency = [&](DWORD name_rva, size_t descriptor_size) -> bool {
+			if (budget != NULL && !budget->AddDescriptor())
+				return false;
+
+			size_t bytes = descriptor_size;
+			size_t length = 0;
+			if (in_image(name_rva, 1)) {
+				length = strnlen(base + name_rva, image_size - name_rva);
+				if (length == image_size - name_rva)
+					length = 0;
+			}
+
+			if (length > 0)
+				bytes += length + 1;
+
+			if (budget != NULL && !budget->AddBytes(bytes))
+				return false;
+
+			if (length > 0)
+				img_info->Dependencies.push_back(WuString(base + name_rva));
+
+			img_info->BytesRead += bytes;
+
+			return true;
+		};
+
 		if (img_info->ImportTableRva > 0)
 		{
-			PIMAGE_IMPORT_DESCRIPTOR imptab_opffset = (PIMAGE_IMPORT_DESCRIPTOR)((char*)hmodule + img_info->ImportTableRva);
-			while (imptab_opffset->Name != NULL)
+			PIMAGE_IMPORT_DESCRIPTOR imptab_opffset = (PIMAGE_IMPORT_DESCRIPTOR)(base + img_info->ImportTableRva);
+			while (in_image((char*)imptab_opffset - base, sizeof(IMAGE_IMPORT_DESCRIPTOR)) && imptab_opffset->Name != NULL)
 			{
-				LPSTR lib_name = (LPSTR)((char*)hmodule + imptab_opffset->Name);
-				if (lib_name != NULL)
-					img_info->Dependencies.push_back(lib_name);
+				if (!add_dependency(imptab_opffset->Name, sizeof(IMAGE_IMPORT_DESCRIPTOR)))
+					break;
 
 				imptab_opffset++;
 			}
 		}
 
-		if (img_info->DelayLoadTableRva > 0)
+		if (img_info->DelayLoadTableRva > 0 && (budget == NULL || !budget->IsSpent()))
 		{
-			PIMAGE_DELAYLOAD_DESCRIPTOR delload_opffset = (PIMAGE_DELAYLOAD_DESCRIPTOR)((char*)hmodule + img_info->DelayLoadTableRva);
-			while (delload_opffset->DllNameRVA != 0)
+			PIMAGE_DELAYLOAD_DESCRIPTOR delload_opffset = (PIMAGE_DELAYLOAD_DESCRIPTOR)(base + img_info->DelayLoadTableRva);
+			while (in_image((char*)delload_opffset - base, sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)) && delload_opffset->DllNameRVA != 0)
 			{
-				LPSTR lib_name = (LPSTR)((char*)hmodule + delload_opffset->DllNameRVA);
-				if (lib_name != NULL)
-					img_info->Dependencies.push_back(lib_name);
+				if (!add_dependency(delload_opffset->DllNameRVA, sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)))
+					break;
 
 				delload_opffset++;
 			}
 		}
+
+		if (budget != NULL)
+			img_info->StopReason = budget->StopReason();
+	}
+
+	void PeHelper::GetImageSymbols(HMODULE hmodule, const PeHelper::LS_IMAGE_BASIC_INFORMATION* img_info, PeHelper::PLS_IMAGE_SYMBOLS symbols, WorkBudget* budget) noexcept
+	{
+		char* base = (char*)hmodule;
+		DWORD image_size = img_info->SizeOfImage;
+		auto in_image = [image_size](ULONGLONG rva, ULONGLONG size) -> bool {
+			return rva != 0 && rva < image_size && size <= image_size - rva;
+		};
+
+		// Names are bounded by the image, not by a terminator we might not find. Each one read is charged.
+		auto read_name = [base, image_size, budget](DWORD rva, WuString& name) -> bool {
+			size_t length = strnlen(base + rva, image_size - rva);
+			if (length == 0 || length == image_size - rva)
+				return false;
+
+			if (budget != NULL && !budget->AddBytes(length + 1))
+				return false;
+
+			name = WuString(base + rva);
+			return true;
+		};
+
+		PIMAGE_DOS_HEADER dos_header = (PIMAGE_DOS_HEADER)hmodule;
+		bool pe32 = ((PIMAGE_NT_HEADERS32)(base + dos_header->e_lfanew))->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		DWORD thunk_size = pe32 ? sizeof(IMAGE_THUNK_DATA32) : sizeof(IMAGE_THUNK_DATA64);
+
+		// Import, and delay load name tables have the same layout. The imphash list is built
+		// in the same walk, for the import table only.
+		wuvector<char> import_list;
+		auto read_thunks = [&](const WuString& module_name, DWORD thunk_rva, wuvector<char>* hash_list) {
+			while (in_image(thunk_rva, thunk_size)) {
+				if (budget != NULL && (!budget->AddThunk() || !budget->AddBytes(thunk_size)))
+					return;
+
+				ULONGLONG thunk = pe32 ? *(DWORD*)(base + thunk_rva) : *(ULONGLONG*)(base + thunk_rva);
+				if (thunk == 0)
+					break;
+
+				bool by_ordinal = pe32 ? IMAGE_SNAP_BY_ORDINAL32(thunk) : IMAGE_SNAP_BY_ORDINAL64(thunk);
+				if (by_ordinal) {
+					symbols->Imports.push_back(module_name + "!#" + WuString::Format("%u", static_cast<DWORD>(thunk & 0xFFFF)));
+					if (hash_list != NULL)
+						SymbolHasher::AppendImport(*hash_list, module_name, static_cast<DWORD>(thunk & 0xFFFF));
+				}
+				else {
+					WuString function_name;
+					DWORD name_rva = static_cast<DWORD>(thunk & 0x7FFFFFFF) + 2;
+					if (in_image(name_rva, 1) && read_name(name_rva, function_name)) {
+						symbols->Imports.push_back(module_name + "!" + function_name);
+						if (hash_list != NULL)
+							SymbolHasher::AppendImport(*hash_list, module_name, function_name.GetBuffer(), function_name.Length());
+					}
+				}
+
+				thunk_rva += thunk_size;
+			}
+		};
+
+		if (in_image(img_info->ImportTableRva, sizeof(IMAGE_IMPORT_DESCRIPTOR)))
+		{
+			PIMAGE_IMPORT_DESCRIPTOR descriptor = (PIMAGE_IMPORT_DESCRIPTOR)(base + img_info->ImportTableRva);
+			while (in_image((char*)descriptor - base, sizeof(IMAGE_IMPORT_DESCRIPTOR)) && descriptor->Name != 0)
+			{
+				if (budget != NULL && (!budget->AddDescriptor() || !budget->AddBytes(sizeof(IMAGE_IMPORT_DESCRIPTOR))))
+					break;
+
+				WuString module_name;
+				if (in_image(descriptor->Name, 1) && read_name(descriptor->Name, module_name)) {
+					DWORD thunk_rva = descriptor->OriginalFirstThunk != 0 ? descriptor->OriginalFirstThunk : descriptor->FirstThunk;
+					read_thunks(module_name.ToLower(), thunk_rva, &import_list);
+				}
+
+				descriptor++;
+			}
+		}
+
+		if (in_image(img_info->DelayLoadTableRva, sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)))
+		{
+			PIMAGE_DELAYLOAD_DESCRIPTOR descriptor = (PIMAGE_DELAYLOAD_DESCRIPTOR)(base + img_info->DelayLoadTableRva);
+			while (in_image((char*)descriptor - base, sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)) && descriptor->DllNameRVA != 0)
+			{
+				if (budget != NULL && (!budget->AddDescriptor() || !budget->AddBytes(sizeof(IMAGE_DELAYLOAD_DESCRIPTOR))))
+					break;
+
+				// Old style descriptors hold VAs, we only read the RVA based ones.
+				WuString module_name;
+				if (descriptor->Attributes.RvaBased && in_image(descriptor->DllNameRVA, 1) && read_name(descriptor->DllNameRVA, module_name))
+					read_thunks(module_name.ToLower(), descriptor->ImportNameTableRVA, NULL);
+
+				descriptor++;
+			}
+		}
+
+		// The import hash of a truncated list would match nothing, or the wrong thing.
+		if (budget != NULL && budget->IsSpent()) {
+			symbols->StopReason = budget->StopReason();
+			return;
+		}
+
+		symbols->HasImportHash = SymbolHasher::FinishImportHash(import_list, symbols->ImportHash);
+
+		if (in_image(img_info->ExportTableRva, sizeof(IMAGE_EXPORT_DIRECTORY)))
+		{
+			PIMAGE_EXPORT_DIRECTORY directory = (PIMAGE_EXPORT_DIRECTORY)(base + img_info->ExportTableRva);
+			ULONGLONG function_count = directory->NumberOfFunctions;
+			ULONGLONG name_count = directory->NumberOfNames;
+			if (!in_image(directory->AddressOfFunctions, function_count * sizeof(DWORD)) ||
+				(name_count > 0 && (!in_image(directory->AddressOfNames, name_count * sizeof(DWORD)) ||
+				!in_image(directory->AddressOfNameOrdinals, name_count * sizeof(WORD)))))
+				return;
+
+			if (budget != NULL && !budget->AddBytes(sizeof(IMAGE_EXPORT_DIRECTORY))) {
+				symbols->StopReason = budget->StopReason();
+				symbols->ExportHash = 0;
+				return;
+			}
+
+			DWORD* functions = (DWORD*)(base + directory->AddressOfFunctions);
+			DWORD* names = (DWORD*)(base + directory->AddressOfNames);
+			WORD* name_ordinals = (WORD*)(base + directory->AddressOfNameOrdinals);
+			wuvector<bool> named(static_cast<size_t>(function_count), false);
+			for (DWORD i = 0; i < name_count; i++) {
+				if (budget != NULL && (!budget->AddThunk() || !budget->AddBytes(sizeof(DWORD) + sizeof(WORD))))
+					break;
+
+				WuString function_name;
+				if (in_image(names[i], 1) && read_name(names[i], function_name)) {
+					symbols->ExportHash += SymbolHasher::HashExport(function_name.GetBuffer(), function_name.Length());
+					symbols->Exports.push_back(function_name);
+				}
+
+				if (name_ordinals[i] < function_count)
+					named[name_ordinals[i]] = true;
+			}
+
+			for (DWORD i = 0; i < function_count && (budget == NULL || !budget->IsSpent()); i++) {
+				if (named[i])
+					continue;
+
+				if (budget != NULL && !budget->AddBytes(sizeof(DWORD)))
+					break;
+
+				if (functions[i] != 0) {
+					if (budget != NULL && !budget->AddThunk())
+						break;
+
+					WuString ordinal = WuString::Format("#%u", directory->Base + i);
+					symbols->ExportHash += SymbolHasher::HashExport(ordinal.GetBuffer(), ordinal.Length());
+					symbols->Exports.push_back(ordinal);
+				}
+			}
+
+			if (budget != NULL && budget->IsSpent()) {
+				symbols->StopReason = budget->StopReason();
+				symbols->ExportHash = 0;
+			}
+		}
+	}
+
+	bool PeHelper::RvaToOffset(DWORD rva, const IMAGE_SECTION_HEADER* sections, DWORD section_count, DWORD size_of_headers, DWORD& offset) noexcept
+	{
+		if (rva < size_of_headers) {
+			offset = rva;
+			return true;
+		}
+
+		for (DWORD i = 0; i < section_count; i++) {
+			// The raw data can be shorter than the section. What's past it is zero filled, and not in the file.
+			DWORD section_size = min(sections[i].Misc.VirtualSize == 0 ? sections[i].SizeOfRawData : sections[i].Misc.VirtualSize, sections[i].SizeOfRawData);
+			if (sections[i].VirtualAddress <= rva && rva - sections[i].VirtualAddress < section_size) {
+				offset = sections[i].PointerToRawData + (rva - sections[i].VirtualAddress);
+				return true;
+			}
+		}
+
+		return false;
 	}
 
 	const LSRESULT GetDirectoryOffset(IMAGE_DATA_DIRECTORY directory, PIMAGE_SECTION_HEADER sections, DWORD section_count, DWORD& offset, bool is_loaded)
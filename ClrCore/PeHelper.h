@@ -4,9 +4,14 @@
 
 #include "Common.h"
 #include "Expressions.h"
+#include "Budget.h"
 
 namespace LibSnitcher::Core
 {
+	#define LS_IMPORT_HASH_SIZE 16
+
+	// Has no state. Every method can be called from many threads at once, on the same instance, or not.
+	// For callers outside .NET, 'NativeApi.h' has the same parsing behind a C interface.
 	extern "C" public class __declspec(dllexport) PeHelper
 	{
 	public:
@@ -44,24 +49,67 @@ namespace LibSnitcher::Core
 			bool IsClr;
 			DWORD ImportTableRva;
 			DWORD DelayLoadTableRva;
+			DWORD ExportTableRva;
+			DWORD ResourceTableRva;
+			DWORD ResourceTableSize;
+			DWORD SizeOfImage;
+			ULONGLONG BytesRead;
 			wuvector<WuString> Dependencies;
 
+			// Set when a work budget ran out, 'Dependencies' has the ones read until then.
+			LS_WORK_STOP StopReason;
+
 			_LS_IMAGE_BASIC_INFORMATION()
-				: IsClr(false), ImportTableRva(0), DelayLoadTableRva(0) { }
+				: IsClr(false), ImportTableRva(0), DelayLoadTableRva(0), ExportTableRva(0),
+					ResourceTableRva(0), ResourceTableSize(0), SizeOfImage(0), BytesRead(0), StopReason(WorkStopNone) { }
 
 			~_LS_IMAGE_BASIC_INFORMATION() { }
 
 		} LS_IMAGE_BASIC_INFORMATION, *PLS_IMAGE_BASIC_INFORMATION;
 
+		typedef struct _LS_IMAGE_SYMBOLS
+		{
+			// 'module!function', or 'module!#ordinal'. Module names are lowercase.
+			wuvector<WuString> Imports;
+
+			// 'function', or '#ordinal' for functions exported by ordinal only.
+			wuvector<WuString> Exports;
+
+			// The imphash. MD5 of the 'module.function' list from the import table, delay loads are not in it.
+			bool HasImportHash;
+			BYTE ImportHash[LS_IMPORT_HASH_SIZE];
+
+			// Doesn't depend on the export order. Zero if there are no exports.
+			ULONGLONG ExportHash;
+
+			// Set when a work budget ran out. Hashes over a truncated list are not set.
+			LS_WORK_STOP StopReason;
+
+			_LS_IMAGE_SYMBOLS()
+				: HasImportHash(false), ImportHash(), ExportHash(0), StopReason(WorkStopNone) { }
+			~_LS_IMAGE_SYMBOLS() { }
+
+		} LS_IMAGE_SYMBOLS, *PLS_IMAGE_SYMBOLS;
+
 		// This function attempts to get all PE header information from the image.
 		// It is relatively expensive, and should be called only when full image
 		// information is required.
 		const LSRESULT GetPeHeaders(WWuString image_path, PLS_PORTABLE_EXECUTABLE pe_headers);
 
-		const LSRESULT GetImageBasicInformation(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION image_info) noexcept;
+		// With a budget the walks stop when it runs out, and 'StopReason' says why.
+		const LSRESULT GetImageBasicInformation(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION image_info, WorkBudget* budget = NULL) noexcept;
 
 		// This function attempts to list the module names in the image's import, and delay load tables.
-		void GetModuleDependencyTables(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION img_info) noexcept;
+		// Descriptors, and names, outside 'SizeOfImage' end the walk.
+		void GetModuleDependencyTables(HMODULE hmodule, PLS_IMAGE_BASIC_INFORMATION img_info, WorkBudget* budget = NULL) noexcept;
+
+		// Lists the imported, and exported functions. 'hmodule' must be mapped as an image, and
+		// 'img_info' filled by 'GetImageBasicInformation'. RVAs outside the image are skipped.
+		void GetImageSymbols(HMODULE hmodule, const LS_IMAGE_BASIC_INFORMATION* img_info, PLS_IMAGE_SYMBOLS symbols, WorkBudget* budget = NULL) noexcept;
+
+		// Translates an RVA to a file offset, using the section table. RVAs inside the
+		// headers are their own offset. Returns false if no section has 'rva'.
+		static bool RvaToOffset(DWORD rva, const IMAGE_SECTION_HEADER* sections, DWORD section_count, DWORD size_of_headers, DWORD& offset) noexcept;
 	};
 
 	static const LSRESULT GetDirectoryOffset(IMAGE_DATA_DIRECTORY directory, PIMAGE_SECTION_HEADER sections, DWORD section_count, DWORD& offset, bool is_loaded);
@@ -496,6 +496,26 @@ namespace LibSnitcher
 		property Boolean IsDll { Boolean get() { return _is_dll; } }
 		property Boolean IsExe { Boolean get() { return _is_exe; } }
 
+		// Parsed on first access, from the certificate table only.
+		property ImageSignature^ Signature {
+			ImageSignature^ get() {
+				if (_signature == nullptr)
+					_signature = Core::AuthenticodeSignature::Get(_path);
+
+				return _signature;
+			}
+		}
+
+		// Decoded on first access, from the bytes before the NT headers.
+		property RichHeaderInfo^ RichHeader {
+			RichHeaderInfo^ get() {
+				if (_rich_header == nullptr)
+					_rich_header = Core::RichHeader::Get(_path);
+
+				return _rich_header;
+			}
+		}
+
 		PortableExecutable(String^ file_path) {
 			if (String::IsNullOrEmpty(file_path))
 				throw gcnew ArgumentNullException("File path cannot be null or empty.");
@@ -503,11 +523,13 @@ namespace LibSnitcher
 			WWuString wrapped_path = Core::GetWideFromManagedString(file_path);
 			_wrapper = new Core::PeHelper::LS_PORTABLE_EXECUTABLE();
 
-			Core::LSRESULT result = _pe_helper->GetPeHeaders(wrapped_path, _wrapper);
+			Core::PeHelper pe_helper;
+			Core::LSRESULT result = pe_helper.GetPeHeaders(wrapped_path, _wrapper);
 			if (result.Result != ERROR_SUCCESS)
 				throw gcnew NativeException(result);
 
 			_name = Path::GetFileName(file_path);
+			_path = file_path;
 			if (_wrapper->IsCoffOnly) {
 				_coff_header = gcnew CoffHeader(_wrapper->CoffHeader);
 				_opt_headers = nullptr;
@@ -539,13 +561,15 @@ namespace LibSnitcher
 
 	private:
 		String^ _name;
+		String^ _path;
 		CoffHeader^ _coff_header;
 		OptionalHeader^ _opt_headers;
 		CorHeader^ _cor_header;
 		Boolean _is_console;
 		Boolean _is_exe;
 		Boolean _is_dll;
+		ImageSignature^ _signature;
+		RichHeaderInfo^ _rich_header;
 		Core::PeHelper::PLS_PORTABLE_EXECUTABLE _wrapper;
-		Core::PeHelper* _pe_helper;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "pch.h"
+
+#include "ReadyToRun.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	typedef struct _LS_READYTORUN_HEADER
+	{
+		DWORD Signature;
+		WORD MajorVersion;
+		WORD MinorVersion;
+		DWORD Flags;
+		DWORD NumberOfSections;
+
+	} LS_READYTORUN_HEADER, *PLS_READYTORUN_HEADER;
+
+	// A COR header, and a ReadyToRun header for each component.
+	typedef struct _LS_READYTORUN_COMPONENT_ENTRY
+	{
+		IMAGE_DATA_DIRECTORY CorHeader;
+		IMAGE_DATA_DIRECTORY ReadyToRunHeader;
+
+	} LS_READYTORUN_COMPONENT_ENTRY, *PLS_READYTORUN_COMPONENT_ENTRY;
+
+	const LSRESULT ReadyToRunReader::Read(const ImageView& image, LS_READYTORUN_INFO& info)
+	{
+		// Component assemblies, and single assemblies point to the header from the COR header.
+		DWORD header_rva = 0;
+		const IMAGE_COR20_HEADER* cor_header = image.GetCorHeader();
+		if (cor_header != NULL) {
+			if (cor_header->Flags & LS_COMIMAGE_FLAGS_IL_LIBRARY) {
+				info.IsNgenImage = true;
+				return LSRESULT();
+			}
+
+			header_rva = cor_header->ManagedNativeHeader.VirtualAddress;
+		}
+		else if (image.FindExport("RTR_HEADER", header_rva))
+			info.IsComposite = true;
+
+		if (header_rva == 0)
+			return LSRESULT();
+
+		const LS_READYTORUN_HEADER* header = reinterpret_cast<const LS_READYTORUN_HEADER*>(image.GetData(header_rva, sizeof(LS_READYTORUN_HEADER)));
+		if (header == NULL || header->Signature != LS_READYTORUN_SIGNATURE) {
+			info.IsComposite = false;
+			return LSRESULT();
+		}
+
+		if (header->NumberOfSections > MAXDWORD / sizeof(LS_READYTORUN_SECTION))
+			return LSRESULT(ERROR_BAD_FORMAT, L"Invalid ReadyToRun section count.", __FILEW__, __LINE__);
+
+		// The section table follows the header, and has the same layout as ours.
+		const LS_READYTORUN_SECTION* sections = reinterpret_cast<const LS_READYTORUN_SECTION*>(
+			image.GetData(header_rva + static_cast<DWORD>(sizeof(LS_READYTORUN_HEADER)), static_cast<DWORD>(header->NumberOfSections * sizeof(LS_READYTORUN_SECTION))));
+		if (sections == NULL && header->NumberOfSections > 0)
+			return LSRESULT(ERROR_BAD_FORMAT, L"ReadyToRun section table out of bounds.", __FILEW__, __LINE__);
+
+		info.IsReadyToRun = true;
+		info.MajorVersion = header->MajorVersion;
+		info.MinorVersion = header->MinorVersion;
+		info.Flags = header->Flags;
+		info.IsComponent = (header->Flags & LS_READYTORUN_FLAG_COMPONENT) != 0;
+		info.Sections.assign(sections, sections + header->NumberOfSections);
+
+		// The component count decides where the manifest components end, so it goes first.
+		DWORD component_count = 0;
+		const LS_READYTORUN_SECTION* manifest = NULL;
+		for (const LS_READYTORUN_SECTION& section : info.Sections) {
+			switch (section.Type) {
+				case ReadyToRunSectionCompilerIdentifier:
+					ReadString(image, section, info.CompilerIdentifier);
+					break;
+
+				case ReadyToRunSectionOwnerCompositeExecutable:
+					ReadString(image, section, info.OwnerComposite);
+					break;
+
+				case ReadyToRunSectionComponentAssemblies:
+					info.IsComposite = true;
+					component_count = section.Size / sizeof(LS_READYTORUN_COMPONENT_ENTRY);
+					break;
+
+				case ReadyToRunSectionManifestMetadata:
+					manifest = &section;
+					break;
+			}
+		}
+
+		if (manifest != NULL)
+			ReadManifest(image, *manifest, component_count, info);
+
+		return LSRESULT();
+	}
+
+	const LSRESULT ReadyToRunReader::Read(const WWuString& file_path, LS_READYTORUN_INFO& info)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(h_file, &file_size)) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		// Empty files can't be mapped.
+		if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(IMAGE_DOS_HEADER))) {
+			CloseHandle(h_file);
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+		}
+
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (h_map == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		const BYTE* map_view = static_cast<const BYTE*>(MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0));
+		if (map_view == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			CloseHandle(h_map);
+			CloseHandle(h_file);
+			return result;
+		}
+
+		ImageView image;
+		LSRESULT result = image.Attach(map_view, static_cast<size_t>(file_size.QuadPart));
+		if (result.Result == ERROR_SUCCESS)
+			result = Read(image, info);
+
+		UnmapViewOfFile(map_view);
+		CloseHandle(h_map);
+		CloseHandle(h_file);
+
+		return result;
+	}
+
+	void ReadyToRunReader::ReadManifest(const ImageView& image, const LS_READYTORUN_SECTION& section, DWORD component_count, LS_READYTORUN_INFO& info)
+	{
+		// A metadata root with only the AssemblyRef table, for references the IL metadata doesn't have.
+		const BYTE* data = image.GetData(section.Rva, section.Size);
+		MetadataReader metadata;
+		if (data == NULL || metadata.Attach(data, section.Size).Result != ERROR_SUCCESS)
+			return;
+
+		wuvector<LS_ASSEMBLY_REFERENCE> references;
+		metadata.GetAssemblyReferences(references);
+		for (size_t i = 0; i < references.size(); i++) {
+			if (i < component_count)
+				info.ComponentAssemblies.push_back(references[i].GetFullName());
+			else
+				info.ManifestReferences.push_back(references[i].GetFullName());
+		}
+	}
+
+	bool ReadyToRunReader::ReadString(const ImageView& image, const LS_READYTORUN_SECTION& section, WuString& value)
+	{
+		const char* data = reinterpret_cast<const char*>(image.GetData(section.Rva, section.Size));
+		if (data == NULL || section.Size == 0)
+			return false;
+
+		// Null terminated, or not, depending on the version.
+		size_t length = strnlen(data, section.Size);
+		wuvector<char> buffer(data, data + length);
+		buffer.push_back('\0');
+		value = buffer.data();
+
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "ImageView.h"
+#include "ClrMetadata.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_READYTORUN_SIGNATURE 0x00525452
+
+	// READYTORUN_FLAG_COMPONENT. The code is in the composite image named by the OwnerCompositeExecutable section.
+	#define LS_READYTORUN_FLAG_COMPONENT 0x00000020
+
+	// COMIMAGE_FLAGS_IL_LIBRARY, set on NGen images.
+	#define LS_COMIMAGE_FLAGS_IL_LIBRARY 0x00000004
+
+	// ReadyToRunSectionType, the ones we read.
+	typedef enum _LS_READYTORUN_SECTION_TYPE
+	{
+		ReadyToRunSectionCompilerIdentifier = 100,
+		ReadyToRunSectionManifestMetadata = 112,
+		ReadyToRunSectionComponentAssemblies = 115,
+		ReadyToRunSectionOwnerCompositeExecutable = 116
+
+	} LS_READYTORUN_SECTION_TYPE;
+
+	typedef struct _LS_READYTORUN_SECTION
+	{
+		DWORD Type;
+		DWORD Rva;
+		DWORD Size;
+
+	} LS_READYTORUN_SECTION, *PLS_READYTORUN_SECTION;
+
+	typedef struct _LS_READYTORUN_INFO
+	{
+		bool IsReadyToRun;
+
+		// NGen images are recognized by their COR header flags, their native header is not read.
+		bool IsNgenImage;
+		WORD MajorVersion;
+		WORD MinorVersion;
+		DWORD Flags;
+
+		// Composite images hold the code of their component assemblies, and have no COR header.
+		bool IsComposite;
+		bool IsComponent;
+		WuString OwnerComposite;
+		WuString CompilerIdentifier;
+		wuvector<LS_READYTORUN_SECTION> Sections;
+
+		// Full assembly names. In composite images, the manifest lists the components first.
+		wuvector<WuString> ComponentAssemblies;
+		wuvector<WuString> ManifestReferences;
+
+		_LS_READYTORUN_INFO()
+			: IsReadyToRun(false), IsNgenImage(false), MajorVersion(0), MinorVersion(0), Flags(0), IsComposite(false), IsComponent(false) { }
+
+		~_LS_READYTORUN_INFO() { }
+
+	} LS_READYTORUN_INFO, *PLS_READYTORUN_INFO;
+
+	// Reader for the READYTORUN_HEADER, and its section table. The header is found through the
+	// COR header 'ManagedNativeHeader', or the 'RTR_HEADER' export of composite images.
+	// Only the header, the section table, and the sections we read are touched.
+	class ReadyToRunReader
+	{
+	public:
+		// Images without ReadyToRun code are not an error, 'IsReadyToRun' is false.
+		static const LSRESULT Read(const ImageView& image, LS_READYTORUN_INFO& info);
+
+		// Maps the file, without 'SEC_IMAGE', so only the pages read are.
+		static const LSRESULT Read(const WWuString& file_path, LS_READYTORUN_INFO& info);
+
+	private:
+		static void ReadManifest(const ImageView& image, const LS_READYTORUN_SECTION& section, DWORD component_count, LS_READYTORUN_INFO& info);
+		static bool ReadString(const ImageView& image, const LS_READYTORUN_SECTION& section, WuString& value);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "pch.h"
+
+#include "Resolver.h"
+#include "StringScanner.h"
+
+namespace LibSnitcher::Core
+{
+	Resolver::Resolver(DirectoryIndex* index, ImageCache* cache, TraceRecorder* tracer, bool collect_symbols, SxsStoreIndex* sxs, bool scan_strings)
+		: _index(index), _cache(cache), _tracer(tracer), _collect_symbols(collect_symbols), _sxs(sxs), _scan_strings(scan_strings), _limits(), _token(NULL) { }
+
+	Resolver::~Resolver() { }
+
+	const LSRESULT Resolver::ResolveChain(const WWuString& root, DWORD max_depth, PLS_RESOLVED_GRAPH graph,
+		const LS_RESOLVED_GRAPH* previous, const wumap<WWuString, bool>* dirty)
+	{
+		graph->Nodes.clear();
+		graph->Edges.clear();
+		graph->NodeIndex.clear();
+		graph->StopReason = WorkStopNone;
+		graph->HasSymbols = _collect_symbols;
+
+		// Takes the lookup result of a clean module from the previous resolution.
+		auto reuse = [previous, dirty](const WWuString& key, LS_RESOLVED_NODE& node) -> bool {
+			if (previous == NULL || (dirty != NULL && dirty->find(key) != dirty->end()))
+				return false;
+
+			auto previous_node = previous->NodeIndex.find(key);
+			if (previous_node == previous->NodeIndex.end())
+				return false;
+
+			const LS_RESOLVED_NODE& source = previous->Nodes[previous_node->second];
+			node.Path = source.Path;
+			node.Result = source.Result;
+			node.Image = source.Image;
+
+			return true;
+		};
+
+		// Resolving the root. Its directory is the application directory for the whole chain.
+		LONGLONG start = _tracer != NULL ? _tracer->Now() : 0;
+		LS_RESOLVED_NODE root_node;
+		root_node.Name = root;
+		if (FindModule(root, WWuString(), false, root_node.Path)) {
+			root_node.Name = WWuString(PathFindFileName(root_node.Path.GetBuffer()));
+			LSRESULT result = GetImage(root_node.Path, 0, root_node.Image);
+			root_node.Result = result.Result != ERROR_SUCCESS ? result.Result : root_node.Image->Result;
+		}
+		else
+			root_node.Result = ERROR_MOD_NOT_FOUND;
+
+		WWuString app_directory(root_node.Path);
+		PathCchRemoveFileSpec(app_directory.GetBuffer(), app_directory.Length() + 1);
+
+		if (_tracer != NULL)
+			_tracer->Record(TraceEventResolve, root_node.Name.GetBuffer(), 0, root_node.Result, 0, start);
+
+		// The root's activation context applies to the whole process.
+		wushared_ptr<LS_CACHED_IMAGE> root_image = root_node.Image;
+
+		wumap<WWuString, DWORD>& visited = graph->NodeIndex;
+		visited.emplace(root_node.Name.ToLower(), 0);
+		graph->Nodes.push_back(root_node);
+
+		wuvector<DWORD> frontier{ 0 };
+		wuvector<DWORD> next_frontier;
+		for (DWORD depth = 0; !frontier.empty() && (max_depth == 0 || depth < max_depth); depth++) {
+			if (_tracer != NULL)
+				_tracer->RecordCounter(L"Frontier", frontier.size());
+
+			for (DWORD parent : frontier) {
+				// Checked once per module, the parse itself checks the token more often.
+				if (_token != NULL && (graph->StopReason = _token->Check()) != WorkStopNone)
+					return LSRESULT();
+
+				// Copying the shared pointer, 'Nodes' might reallocate while we go.
+				wushared_ptr<LS_CACHED_IMAGE> image = graph->Nodes[parent].Image;
+				if (image == nullptr || image->Result != ERROR_SUCCESS)
+					continue;
+
+				bool wow64 = image->Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+				auto resolve = [&](const WuString& dependency, LS_EDGE_KIND kind) {
+					WWuString name = WuStringToWide(dependency);
+					WWuString key = name.ToLower();
+
+					auto existing = visited.find(key);
+					if (existing != visited.end()) {
+						if (kind == EdgeKindImport || existing->second != parent)
+							graph->Edges.push_back({ parent, existing->second, kind });
+
+						return;
+					}
+
+					start = _tracer != NULL ? _tracer->Now() : 0;
+					LS_RESOLVED_NODE node;
+					node.Name = name;
+					node.Depth = depth + 1;
+					if (!reuse(key, node)) {
+						if (FindSxsModule(name, image.get(), root_image.get(), node.Path) || FindModule(name, app_directory, wow64, node.Path, image->Path)) {
+							LSRESULT result = GetImage(node.Path, node.Depth, node.Image);
+							node.Result = result.Result != ERROR_SUCCESS ? result.Result : node.Image->Result;
+						}
+						else
+							node.Result = ERROR_MOD_NOT_FOUND;
+					}
+
+					if (_tracer != NULL)
+						_tracer->Record(TraceEventResolve, name.GetBuffer(), node.Depth, node.Result, 0, start);
+
+					// Heuristic names that are not there are mostly strings that only look like file names.
+					if (kind == EdgeKindHeuristic && node.Result == ERROR_MOD_NOT_FOUND)
+						return;
+
+					DWORD index = static_cast<DWORD>(graph->Nodes.size());
+					graph->Nodes.push_back(node);
+					graph->Edges.push_back({ parent, index, kind });
+					visited.emplace(key, index);
+					next_frontier.push_back(index);
+				};
+
+				for (const WuString& dependency : image->BasicInfo.Dependencies)
+					resolve(dependency, EdgeKindImport);
+
+				if (_scan_strings) {
+					for (const WuString& dependency : image->HeuristicDependencies)
+						resolve(dependency, EdgeKindHeuristic);
+				}
+
+				graph->Nodes[parent].Expanded = true;
+			}
+
+			frontier.swap(next_frontier);
+			next_frontier.clear();
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT Resolver::GetImage(const WWuString& image_path, DWORD depth, wushared_ptr<LS_CACHED_IMAGE>& image)
+	{
+		// Entries parsed without symbols, or heuristic names are parsed again if we need them.
+		if (_cache->Lookup(image_path, image)) {
+			bool complete = (!_collect_symbols || image->HasSymbols) && (!_scan_strings || image->HasHeuristicDependencies);
+			if (complete || image->Result != ERROR_SUCCESS)
+				return LSRESULT();
+		}
+
+		wushared_ptr<LS_CACHED_IMAGE> entry = make_wushared<LS_CACHED_IMAGE>();
+		entry->Path = image_path;
+		if (!ImageCache::GetFileIdentity(image_path, entry->FileSize, entry->LastWriteTime))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LONGLONG start = _tracer != NULL ? _tracer->Now() : 0;
+		WorkBudget budget(_limits, _token);
+		ParseImage(entry.get(), _collect_symbols, _scan_strings, budget);
+
+		if (_tracer != NULL)
+			_tracer->Record(TraceEventParse, image_path.GetBuffer(), depth, entry->Result, entry->BasicInfo.BytesRead, start);
+
+		// Failed parses are cached too, so warm queries don't retry them until the file changes.
+		// Images cut short by the token are not, that's not something about the file.
+		LS_WORK_STOP stop = budget.StopReason();
+		LS_WORK_STOP symbol_stop = entry->Symbols.StopReason;
+		if (stop != WorkStopCancelled && stop != WorkStopDeadline && symbol_stop != WorkStopCancelled && symbol_stop != WorkStopDeadline)
+			_cache->Insert(entry);
+
+		image = entry;
+
+		return LSRESULT();
+	}
+
+	void Resolver::SetLimits(const LS_WORK_LIMITS& limits, const CancellationToken* token) noexcept
+	{
+		_limits = limits;
+		_token = token;
+	}
+
+	bool Resolver::FindModule(const WWuString& module_name, const WWuString& app_directory, bool wow64, WWuString& module_path, const WWuString& importing_name)
+	{
+		// Paths are taken as is.
+		if (module_name.Contains(L'\\') || module_name.Contains(L'/')) {
+			if (!PathFileExists(module_name.GetBuffer()))
+				return false;
+
+			WCHAR full_path[MAX_PATH]{ 0 };
+			if (GetFullPathName(module_name.GetBuffer(), MAX_PATH, full_path, NULL) == 0)
+				return false;
+
+			module_path = full_path;
+			return true;
+		}
+
+		return _index->FindModule(module_name, app_directory, wow64, module_path, importing_name);
+	}
+
+	void Resolver::GetLoadCost(const LS_RESOLVED_GRAPH& graph, LS_CHAIN_LOAD_COST& chain_cost) noexcept
+	{
+		chain_cost = LS_CHAIN_LOAD_COST();
+		for (const LS_RESOLVED_NODE& node : graph.Nodes) {
+			if (node.Image != nullptr && node.Image->Result == ERROR_SUCCESS)
+				LoadCostReader::Add(node.Image->LoadCost, chain_cost);
+		}
+	}
+
+	bool Resolver::FindSxsModule(const WWuString& module_name, const LS_CACHED_IMAGE* image, const LS_CACHED_IMAGE* root_image, WWuString& module_path)
+	{
+		// Side-by-side redirection happens before the search order, and only for names.
+		if (_sxs == NULL || module_name.Contains(L'\\') || module_name.Contains(L'/'))
+			return false;
+
+		if (image != NULL && !image->SxsDependencies.empty() && _sxs->FindModule(module_name, image->SxsDependencies, module_path))
+			return true;
+
+		if (root_image != NULL && root_image != image && !root_image->SxsDependencies.empty())
+			return _sxs->FindModule(module_name, root_image->SxsDependencies, module_path);
+
+		return false;
+	}
+
+	void Resolver::ParseImage(PLS_CACHED_IMAGE image, bool collect_symbols, bool scan_strings, WorkBudget& budget) noexcept
+	{
+		HANDLE h_file = CreateFile(image->Path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE) {
+			image->Result = GetLastError();
+			return;
+		}
+
+		// Mapping as an image, without going through the loader. RVAs can be used as offsets from the view.
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY | SEC_IMAGE_NO_EXECUTE, 0, 0, NULL);
+		if (h_map == NULL) {
+			image->Result = GetLastError();
+			CloseHandle(h_file);
+			return;
+		}
+
+		LPVOID map_view = MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0);
+		if (map_view == NULL) {
+			image->Result = GetLastError();
+			CloseHandle(h_map);
+			CloseHandle(h_file);
+			return;
+		}
+
+		PeHelper pe_helper;
+		LSRESULT result = pe_helper.GetImageBasicInformation(static_cast<HMODULE>(map_view), &image->BasicInfo, &budget);
+		image->Result = result.Result;
+		if (result.Result == ERROR_SUCCESS) {
+			PIMAGE_DOS_HEADER dos_header = static_cast<PIMAGE_DOS_HEADER>(map_view);
+			PIMAGE_NT_HEADERS32 nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS32>((char*)map_view + dos_header->e_lfanew);
+			image->Machine = nt_headers->FileHeader.Machine;
+			image->Characteristics = nt_headers->FileHeader.Characteristics;
+			image->TimeDateStamp = nt_headers->FileHeader.TimeDateStamp;
+			image->Magic = nt_headers->OptionalHeader.Magic;
+			if (image->Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+				image->SizeOfImage = nt_headers->OptionalHeader.SizeOfImage;
+				image->CheckSum = nt_headers->OptionalHeader.CheckSum;
+				image->Subsystem = nt_headers->OptionalHeader.Subsystem;
+			}
+			else {
+				PIMAGE_NT_HEADERS64 nt_headers64 = reinterpret_cast<PIMAGE_NT_HEADERS64>(nt_headers);
+				image->SizeOfImage = nt_headers64->OptionalHeader.SizeOfImage;
+				image->CheckSum = nt_headers64->OptionalHeader.CheckSum;
+				image->Subsystem = nt_headers64->OptionalHeader.Subsystem;
+			}
+
+			// The symbols walk the descriptors again, on a budget of their own. Their stop reason is in 'Symbols'.
+			if (collect_symbols) {
+				WorkBudget symbol_budget = budget.Restart();
+				pe_helper.GetImageSymbols(static_cast<HMODULE>(map_view), &image->BasicInfo, &image->Symbols, &symbol_budget);
+				image->HasSymbols = true;
+			}
+
+			if (scan_strings) {
+				ModuleNameScanner::ScanImage(static_cast<HMODULE>(map_view), &image->BasicInfo, image->HeuristicDependencies);
+				image->HasHeuristicDependencies = true;
+			}
+
+			LoadCostReader::Read(static_cast<HMODULE>(map_view), &image->LoadCost);
+
+			// Only RT_VERSION, and RT_MANIFEST are decoded. A bad resource directory doesn't fail the parse.
+			ResourceIndex resources;
+			if (resources.Build(static_cast<HMODULE>(map_view), image->SizeOfImage, image->BasicInfo.ResourceTableRva, image->BasicInfo.ResourceTableSize, &budget).Result == ERROR_SUCCESS) {
+				image->HasVersion = resources.GetVersionInfo(static_cast<HMODULE>(map_view), image->Version, &budget);
+
+				WuString manifest_text;
+				LS_MANIFEST_INFO manifest;
+				if (resources.GetManifest(static_cast<HMODULE>(map_view), manifest_text, &budget) && ManifestParser::Parse(manifest_text.GetBuffer(), manifest_text.Length(), manifest)) {
+					ManifestParser::SetDefaultArchitecture(manifest.Dependencies, image->Machine);
+					image->SxsDependencies = manifest.Dependencies;
+				}
+			}
+
+			// Resources cut short by the budget make the image partial too.
+			if (image->BasicInfo.StopReason == WorkStopNone)
+				image->BasicInfo.StopReason = budget.StopReason();
+		}
+
+		UnmapViewOfFile(map_view);
+		CloseHandle(h_map);
+		CloseHandle(h_file);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "DirectoryIndex.h"
+#include "ImageCache.h"
+#include "SxsIndex.h"
+#include "Trace.h"
+
+namespace LibSnitcher::Core
+{
+	typedef struct _LS_RESOLVED_NODE
+	{
+		WWuString Name;
+		WWuString Path;
+		DWORD Depth;
+		LONG Result;
+		wushared_ptr<LS_CACHED_IMAGE> Image;
+
+		// Its tables were walked, and every edge from it is in the graph. Nodes at the maximum
+		// depth, or left when the resolution stopped, have none, not because they import nothing.
+		bool Expanded;
+
+		_LS_RESOLVED_NODE()
+			: Depth(0), Result(ERROR_SUCCESS), Expanded(false) { }
+
+		~_LS_RESOLVED_NODE() { }
+
+	} LS_RESOLVED_NODE, *PLS_RESOLVED_NODE;
+
+	typedef enum _LS_EDGE_KIND
+	{
+		EdgeKindImport,
+
+		// Found by 'ModuleNameScanner' in the importing image data. Might never be loaded.
+		EdgeKindHeuristic
+
+	} LS_EDGE_KIND;
+
+	typedef struct _LS_RESOLVED_EDGE
+	{
+		DWORD From;
+		DWORD To;
+		LS_EDGE_KIND Kind;
+
+	} LS_RESOLVED_EDGE, *PLS_RESOLVED_EDGE;
+
+	// A dependency chain. Every module appears once, the root is node zero,
+	// and edges point from the importing module to its dependency.
+	// 'NodeIndex' maps the lowercase module name to its node.
+	typedef struct _LS_RESOLVED_GRAPH
+	{
+		wuvector<LS_RESOLVED_NODE> Nodes;
+		wuvector<LS_RESOLVED_EDGE> Edges;
+		wumap<WWuString, DWORD> NodeIndex;
+
+		// Set when the resolution was cancelled, or ran past its deadline. The graph has
+		// the modules resolved until then. Budgets spent on one image are in its 'BasicInfo'.
+		LS_WORK_STOP StopReason;
+
+		// Resolved with symbol collection. Without it every symbol list is empty, which is not the same as no symbols.
+		bool HasSymbols;
+
+		_LS_RESOLVED_GRAPH()
+			: StopReason(WorkStopNone), HasSymbols(false) { }
+		~_LS_RESOLVED_GRAPH() { }
+
+	} LS_RESOLVED_GRAPH, *PLS_RESOLVED_GRAPH;
+
+	// Native dependency chain resolver. Resolves the PE import, and delay load
+	// tables breadth-first, using the directory index to find modules, and the
+	// image cache to avoid parsing the same image twice.
+	// Unlike 'Wrapper', it maps images instead of loading them, and it does not
+	// resolve .NET assembly references.
+	class Resolver
+	{
+	public:
+		// With 'collect_symbols' images are parsed for their imported, and exported functions too.
+		// With 'sxs' names are looked up in the activation context of the importing image, then
+		// in the one of the root, before the search order.
+		// With 'scan_strings' module names found in the read-only data are resolved too, as heuristic edges.
+		// Names that are not found are left out, they are mostly noise.
+		Resolver(DirectoryIndex* index, ImageCache* cache, TraceRecorder* tracer = NULL, bool collect_symbols = false, SxsStoreIndex* sxs = NULL, bool scan_strings = false);
+		~Resolver();
+
+		// 'root' can be a path, or a module name. A 'max_depth' of zero means no limit.
+		// With a 'previous' resolution of the same chain, only the modules in 'dirty'
+		// (lowercase names), and the ones never seen before are looked up again.
+		const LSRESULT ResolveChain(const WWuString& root, DWORD max_depth, PLS_RESOLVED_GRAPH graph,
+			const LS_RESOLVED_GRAPH* previous = NULL, const wumap<WWuString, bool>* dirty = NULL);
+
+		// Gets the image from the cache, parsing it if it's not there.
+		const LSRESULT GetImage(const WWuString& image_path, DWORD depth, wushared_ptr<LS_CACHED_IMAGE>& image);
+
+		// Every image is parsed within 'limits'. With a 'token' the resolution stops between
+		// modules when it's cancelled, or past its deadline. The token must outlive the resolver.
+		void SetLimits(const LS_WORK_LIMITS& limits, const CancellationToken* token = NULL) noexcept;
+
+		// Finds the path for a module name, or path, in the standard search order. API set names
+		// resolve to the host for 'importing_name', a module name, or path.
+		bool FindModule(const WWuString& module_name, const WWuString& app_directory, bool wow64, WWuString& module_path, const WWuString& importing_name = WWuString());
+
+		// Sums the load cost of every module in the chain that parsed.
+		static void GetLoadCost(const LS_RESOLVED_GRAPH& graph, LS_CHAIN_LOAD_COST& chain_cost) noexcept;
+
+		// Maps 'image->Path', and fills the rest of the image. Uses nothing but its arguments,
+		// so it can run on many threads at once. Failures are in 'image->Result'.
+		static void ParseImage(PLS_CACHED_IMAGE image, bool collect_symbols, bool scan_strings, WorkBudget& budget) noexcept;
+
+	private:
+		DirectoryIndex* _index;
+		ImageCache* _cache;
+		TraceRecorder* _tracer;
+		bool _collect_symbols;
+		SxsStoreIndex* _sxs;
+		bool _scan_strings;
+		LS_WORK_LIMITS _limits;
+		const CancellationToken* _token;
+
+		bool FindSxsModule(const WWuString& module_name, const LS_CACHED_IMAGE* image, const LS_CACHED_IMAGE* root_image, WWuString& module_path);
+	};
+}
\ No newline at end of file
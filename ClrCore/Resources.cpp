@@ -0,0 +1,333 @@
+#include "pch.h"
+
+#include "Resources.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// 'RT_VERSION', and 'RT_MANIFEST' are pointer typed.
+	static constexpr DWORD ResourceTypeVersion = 16;
+	static constexpr DWORD ResourceTypeManifest = 24;
+
+	// Every version block starts with 'wLength', 'wValueLength', and 'wType'.
+	static constexpr size_t VersionBlockHeaderSize = 6;
+
+	// One block of a VS_VERSIONINFO tree.
+	typedef struct _LS_VERSION_BLOCK
+	{
+		LPCWSTR Key;
+		size_t KeyLength;
+		const BYTE* Value;
+		size_t ValueSize;
+		const BYTE* Children;
+		size_t ChildrenSize;
+		size_t Length;
+
+	} LS_VERSION_BLOCK, *PLS_VERSION_BLOCK;
+
+	static bool CompareEntries(const LS_RESOURCE_ENTRY& left, const LS_RESOURCE_ENTRY& right) noexcept
+	{
+		if (left.Type != right.Type)
+			return left.Type < right.Type;
+		if (left.Name != right.Name)
+			return left.Name < right.Name;
+
+		return left.Language < right.Language;
+	}
+
+	static size_t AlignDword(size_t offset) noexcept
+	{
+		return (offset + 3) & ~static_cast<size_t>(3);
+	}
+
+	static bool ReadVersionBlock(const BYTE* data, size_t size, LS_VERSION_BLOCK& block) noexcept
+	{
+		if (size < VersionBlockHeaderSize)
+			return false;
+
+		size_t length = *reinterpret_cast<const WORD*>(data);
+		size_t value_length = *reinterpret_cast<const WORD*>(data + 2);
+		WORD type = *reinterpret_cast<const WORD*>(data + 4);
+		if (length < VersionBlockHeaderSize || length > size)
+			return false;
+
+		// The key is null terminated, and must fit in the block.
+		LPCWSTR key = reinterpret_cast<LPCWSTR>(data + VersionBlockHeaderSize);
+		size_t max_key_length = (length - VersionBlockHeaderSize) / sizeof(WCHAR);
+		size_t key_length = 0;
+		while (key_length < max_key_length && key[key_length] != L'\0')
+			key_length++;
+
+		if (key_length == max_key_length)
+			return false;
+
+		// Text values have their length in characters.
+		size_t value_offset = AlignDword(VersionBlockHeaderSize + ((key_length + 1) * sizeof(WCHAR)));
+		size_t value_size = type == 1 ? value_length * sizeof(WCHAR) : value_length;
+		if (value_offset > length)
+			value_offset = length;
+		if (value_size > length - value_offset)
+			value_size = length - value_offset;
+
+		size_t children_offset = AlignDword(value_offset + value_size);
+		block.Key = key;
+		block.KeyLength = key_length;
+		block.Value = data + value_offset;
+		block.ValueSize = value_size;
+		block.Children = data + min(children_offset, length);
+		block.ChildrenSize = children_offset < length ? length - children_offset : 0;
+		block.Length = length;
+
+		return true;
+	}
+
+	// Calls 'callback' for each child block. Children start DWORD aligned.
+	template <class _callback>
+	static void ForEachVersionChild(const LS_VERSION_BLOCK& parent, _callback callback)
+	{
+		size_t offset = 0;
+		LS_VERSION_BLOCK child;
+		while (offset < parent.ChildrenSize && ReadVersionBlock(parent.Children + offset, parent.ChildrenSize - offset, child)) {
+			callback(child);
+			offset += AlignDword(child.Length);
+		}
+	}
+
+	static bool IsKey(const LS_VERSION_BLOCK& block, LPCWSTR key) noexcept
+	{
+		return wcslen(key) == block.KeyLength && wcsncmp(block.Key, key, block.KeyLength) == 0;
+	}
+
+	static void SetIfEmpty(WWuString& field, const LS_VERSION_BLOCK& block)
+	{
+		if (field.Length() > 0 || block.ValueSize < sizeof(WCHAR))
+			return;
+
+		// Some linkers count the terminator, some don't. We copy up to it.
+		wuvector<WCHAR> buffer(reinterpret_cast<LPCWSTR>(block.Value), reinterpret_cast<LPCWSTR>(block.Value) + (block.ValueSize / sizeof(WCHAR)));
+		buffer.push_back(L'\0');
+		field = buffer.data();
+	}
+
+	ResourceIndex::ResourceIndex()
+		: _size_of_image(0) { }
+
+	ResourceIndex::~ResourceIndex() { }
+
+	const LSRESULT ResourceIndex::Build(HMODULE hmodule, DWORD size_of_image, DWORD resource_rva, DWORD resource_size, WorkBudget* budget)
+	{
+		_entries.clear();
+		_names.clear();
+		_size_of_image = size_of_image;
+		if (resource_rva == 0 || resource_size == 0)
+			return LSRESULT();
+
+		if (resource_rva >= size_of_image)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Resource directory is outside the image.", __FILEW__, __LINE__);
+
+		// Offsets in the directory are from the start of the resource directory.
+		// Some linkers get the directory size wrong, so we bound by the image instead.
+		const BYTE* resource_base = reinterpret_cast<const BYTE*>(hmodule) + resource_rva;
+		size_t resource_limit = size_of_image - resource_rva;
+
+		// Crafted directories can point many entries at the same subdirectory, multiplying
+		// the work. Each directory is walked once, and the entries read are capped.
+		wumap<DWORD, bool> visited;
+		size_t entries_read = 0;
+		auto read_directory = [&](DWORD offset, const IMAGE_RESOURCE_DIRECTORY_ENTRY*& entries, DWORD& count) -> bool {
+			if (static_cast<size_t>(offset) + sizeof(IMAGE_RESOURCE_DIRECTORY) > resource_limit || !visited.emplace(offset, true).second)
+				return false;
+
+			const IMAGE_RESOURCE_DIRECTORY* directory = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY*>(resource_base + offset);
+			count = static_cast<DWORD>(directory->NumberOfNamedEntries) + directory->NumberOfIdEntries;
+			if (static_cast<size_t>(offset) + sizeof(IMAGE_RESOURCE_DIRECTORY) + (static_cast<size_t>(count) * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY)) > resource_limit)
+				return false;
+
+			if (entries_read >= LS_RESOURCE_MAX_ENTRIES)
+				return false;
+
+			count = static_cast<DWORD>(min(static_cast<size_t>(count), LS_RESOURCE_MAX_ENTRIES - entries_read));
+			if (budget != NULL && !budget->AddBytes(sizeof(IMAGE_RESOURCE_DIRECTORY) + (static_cast<ULONGLONG>(count) * sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY))))
+				return false;
+
+			entries_read += count;
+
+			entries = reinterpret_cast<const IMAGE_RESOURCE_DIRECTORY_ENTRY*>(directory + 1);
+			return true;
+		};
+
+		// The directory is always three levels deep. Type, name, and language.
+		const IMAGE_RESOURCE_DIRECTORY_ENTRY* types = NULL;
+		DWORD type_count = 0;
+		if (!read_directory(0, types, type_count)) {
+			if (budget != NULL && budget->IsSpent())
+				return LSRESULT();
+
+			return LSRESULT(ERROR_BAD_FORMAT, L"Resource directory is truncated.", __FILEW__, __LINE__);
+		}
+
+		for (DWORD i = 0; i < type_count; i++) {
+			const IMAGE_RESOURCE_DIRECTORY_ENTRY* names = NULL;
+			DWORD name_count = 0;
+			if (!types[i].DataIsDirectory || !read_directory(types[i].OffsetToDirectory, names, name_count))
+				continue;
+
+			DWORD type_key = GetKey(resource_base, resource_limit, types[i]);
+			for (DWORD j = 0; j < name_count; j++) {
+				const IMAGE_RESOURCE_DIRECTORY_ENTRY* languages = NULL;
+				DWORD language_count = 0;
+				if (!names[j].DataIsDirectory || !read_directory(names[j].OffsetToDirectory, languages, language_count))
+					continue;
+
+				DWORD name_key = GetKey(resource_base, resource_limit, names[j]);
+				for (DWORD k = 0; k < language_count; k++) {
+					if (languages[k].DataIsDirectory || static_cast<size_t>(languages[k].OffsetToData) + sizeof(IMAGE_RESOURCE_DATA_ENTRY) > resource_limit)
+						continue;
+
+					if (budget != NULL && !budget->AddBytes(sizeof(IMAGE_RESOURCE_DATA_ENTRY)))
+						break;
+
+					const IMAGE_RESOURCE_DATA_ENTRY* data = reinterpret_cast<const IMAGE_RESOURCE_DATA_ENTRY*>(resource_base + languages[k].OffsetToData);
+					_entries.push_back({ type_key, name_key, GetKey(resource_base, resource_limit, languages[k]), data->OffsetToData, data->Size, data->CodePage });
+				}
+			}
+		}
+
+		std::sort(_entries.begin(), _entries.end(), CompareEntries);
+
+		return LSRESULT();
+	}
+
+	bool ResourceIndex::Find(DWORD type, DWORD name, DWORD language, LS_RESOURCE_ENTRY& entry) const noexcept
+	{
+		LS_RESOURCE_ENTRY key = { type, name, language, 0, 0, 0 };
+		auto found = std::lower_bound(_entries.begin(), _entries.end(), key, CompareEntries);
+		if (found == _entries.end() || found->Type != type || found->Name != name || (language != 0 && found->Language != language))
+			return false;
+
+		entry = *found;
+		return true;
+	}
+
+	bool ResourceIndex::FindFirst(DWORD type, LS_RESOURCE_ENTRY& entry) const noexcept
+	{
+		LS_RESOURCE_ENTRY key = { type, 0, 0, 0, 0, 0 };
+		auto found = std::lower_bound(_entries.begin(), _entries.end(), key, CompareEntries);
+		if (found == _entries.end() || found->Type != type)
+			return false;
+
+		entry = *found;
+		return true;
+	}
+
+	LPCWSTR ResourceIndex::GetName(DWORD key) const noexcept
+	{
+		if ((key & LS_RESOURCE_NAMED) == 0)
+			return NULL;
+
+		size_t offset = key & ~LS_RESOURCE_NAMED;
+		return offset < _names.size() ? _names.data() + offset : NULL;
+	}
+
+	bool ResourceIndex::GetData(HMODULE hmodule, const LS_RESOURCE_ENTRY& entry, const BYTE*& data) const noexcept
+	{
+		if (entry.DataRva == 0 || static_cast<ULONGLONG>(entry.DataRva) + entry.Size > _size_of_image)
+			return false;
+
+		data = reinterpret_cast<const BYTE*>(hmodule) + entry.DataRva;
+		return true;
+	}
+
+	bool ResourceIndex::GetVersionInfo(HMODULE hmodule, LS_VERSION_INFO& version, WorkBudget* budget) const
+	{
+		LS_RESOURCE_ENTRY entry;
+		const BYTE* data = NULL;
+		if (!FindFirst(ResourceTypeVersion, entry) || !GetData(hmodule, entry, data))
+			return false;
+
+		if (budget != NULL && !budget->AddBytes(entry.Size))
+			return false;
+
+		return ReadVersionInfo(data, entry.Size, version);
+	}
+
+	bool ResourceIndex::GetManifest(HMODULE hmodule, WuString& manifest, WorkBudget* budget) const
+	{
+		LS_RESOURCE_ENTRY entry;
+		const BYTE* data = NULL;
+		if (!FindFirst(ResourceTypeManifest, entry) || !GetData(hmodule, entry, data))
+			return false;
+
+		if (budget != NULL && !budget->AddBytes(entry.Size))
+			return false;
+
+		// Skipping the UTF-8 BOM.
+		size_t size = entry.Size;
+		if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+			data += 3;
+			size -= 3;
+		}
+
+		wuvector<char> buffer(reinterpret_cast<const char*>(data), reinterpret_cast<const char*>(data) + size);
+		buffer.push_back('\0');
+		manifest = buffer.data();
+
+		return true;
+	}
+
+	bool ResourceIndex::ReadVersionInfo(const BYTE* data, size_t size, LS_VERSION_INFO& version)
+	{
+		// VS_VERSIONINFO { VS_FIXEDFILEINFO, StringFileInfo { StringTable { String... } ... }, VarFileInfo }
+		LS_VERSION_BLOCK root;
+		if (!ReadVersionBlock(data, size, root) || !IsKey(root, L"VS_VERSION_INFO"))
+			return false;
+
+		if (root.ValueSize >= sizeof(VS_FIXEDFILEINFO)) {
+			const VS_FIXEDFILEINFO* fixed_info = reinterpret_cast<const VS_FIXEDFILEINFO*>(root.Value);
+			if (fixed_info->dwSignature == VS_FFI_SIGNATURE) {
+				version.FixedFileVersion = (static_cast<ULONGLONG>(fixed_info->dwFileVersionMS) << 32) | fixed_info->dwFileVersionLS;
+				version.FixedProductVersion = (static_cast<ULONGLONG>(fixed_info->dwProductVersionMS) << 32) | fixed_info->dwProductVersionLS;
+			}
+		}
+
+		ForEachVersionChild(root, [&](const LS_VERSION_BLOCK& file_info) {
+			if (!IsKey(file_info, L"StringFileInfo"))
+				return;
+
+			ForEachVersionChild(file_info, [&](const LS_VERSION_BLOCK& table) {
+				ForEachVersionChild(table, [&](const LS_VERSION_BLOCK& string) {
+					if (IsKey(string, L"FileVersion"))
+						SetIfEmpty(version.FileVersion, string);
+					else if (IsKey(string, L"ProductVersion"))
+						SetIfEmpty(version.ProductVersion, string);
+					else if (IsKey(string, L"CompanyName"))
+						SetIfEmpty(version.CompanyName, string);
+					else if (IsKey(string, L"FileDescription"))
+						SetIfEmpty(version.FileDescription, string);
+				});
+			});
+		});
+
+		return true;
+	}
+
+	DWORD ResourceIndex::GetKey(const BYTE* resource_base, size_t resource_limit, const IMAGE_RESOURCE_DIRECTORY_ENTRY& entry)
+	{
+		if (!entry.NameIsString)
+			return entry.Id;
+
+		// IMAGE_RESOURCE_DIR_STRING_U. Counted, not null terminated. Names out of bounds are empty.
+		DWORD key = LS_RESOURCE_NAMED | static_cast<DWORD>(_names.size());
+		size_t offset = entry.NameOffset;
+		if (offset + sizeof(WORD) <= resource_limit) {
+			const IMAGE_RESOURCE_DIR_STRING_U* name = reinterpret_cast<const IMAGE_RESOURCE_DIR_STRING_U*>(resource_base + offset);
+			size_t length = min(static_cast<size_t>(name->Length), (resource_limit - offset - sizeof(WORD)) / sizeof(WCHAR));
+			_names.insert(_names.end(), name->NameString, name->NameString + length);
+		}
+
+		_names.push_back(L'\0');
+
+		return key;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Budget.h"
+
+namespace LibSnitcher::Core
+{
+	// Type, and name keys with this bit set are offsets into the index name pool.
+	#define LS_RESOURCE_NAMED 0x80000000
+
+	// Directory entries read while building an index, across all three levels. Past it the walk stops.
+	#define LS_RESOURCE_MAX_ENTRIES 65536
+
+	typedef struct _LS_RESOURCE_ENTRY
+	{
+		DWORD Type;
+		DWORD Name;
+		DWORD Language;
+
+		// The data RVA. The same as the offset from an image mapped view.
+		DWORD DataRva;
+		DWORD Size;
+		DWORD CodePage;
+
+	} LS_RESOURCE_ENTRY, *PLS_RESOURCE_ENTRY;
+
+	typedef struct _LS_VERSION_INFO
+	{
+		// From VS_FIXEDFILEINFO. Major, minor, build, and revision, from high to low word.
+		ULONGLONG FixedFileVersion;
+		ULONGLONG FixedProductVersion;
+
+		// From the first string table that has them.
+		WWuString FileVersion;
+		WWuString ProductVersion;
+		WWuString CompanyName;
+		WWuString FileDescription;
+
+		_LS_VERSION_INFO()
+			: FixedFileVersion(0), FixedProductVersion(0) { }
+
+		~_LS_VERSION_INFO() { }
+
+	} LS_VERSION_INFO, *PLS_VERSION_INFO;
+
+	// Index of the resource directory of an image mapped view, from (type, name, language)
+	// to the resource data. Building it walks the three directory levels, and nothing else.
+	// Resource data is not touched until asked for, and only RT_VERSION, and RT_MANIFEST
+	// are decoded. Entries are sorted by type, name, and language, with IDs before names.
+	class ResourceIndex
+	{
+	public:
+		ResourceIndex();
+		~ResourceIndex();
+
+		// 'hmodule' must be mapped as an image. Directories, and data outside 'size_of_image' are skipped.
+		// So are directories already walked, and everything past LS_RESOURCE_MAX_ENTRIES entries, or
+		// past the budget. The directories, and entries read are charged to it.
+		const LSRESULT Build(HMODULE hmodule, DWORD size_of_image, DWORD resource_rva, DWORD resource_size, WorkBudget* budget = NULL);
+
+		_NODISCARD const wuvector<LS_RESOURCE_ENTRY>& Entries() const noexcept { return _entries; }
+
+		// Language zero matches the first language found.
+		bool Find(DWORD type, DWORD name, DWORD language, LS_RESOURCE_ENTRY& entry) const noexcept;
+		bool FindFirst(DWORD type, LS_RESOURCE_ENTRY& entry) const noexcept;
+
+		// The name for a LS_RESOURCE_NAMED key, NULL for IDs.
+		_NODISCARD LPCWSTR GetName(DWORD key) const noexcept;
+
+		// The resource data, from the same view the index was built from.
+		bool GetData(HMODULE hmodule, const LS_RESOURCE_ENTRY& entry, const BYTE*& data) const noexcept;
+
+		// With a budget the resource data is charged to it, and not read once it runs out.
+		bool GetVersionInfo(HMODULE hmodule, LS_VERSION_INFO& version, WorkBudget* budget = NULL) const;
+
+		// The first RT_MANIFEST, as is. Manifests are UTF-8.
+		bool GetManifest(HMODULE hmodule, WuString& manifest, WorkBudget* budget = NULL) const;
+
+		static bool ReadVersionInfo(const BYTE* data, size_t size, LS_VERSION_INFO& version);
+
+	private:
+		DWORD _size_of_image;
+		wuvector<LS_RESOURCE_ENTRY> _entries;
+		wuvector<WCHAR> _names;
+
+		DWORD GetKey(const BYTE* resource_base, size_t resource_limit, const IMAGE_RESOURCE_DIRECTORY_ENTRY& entry);
+	};
+}
\ No newline at end of file
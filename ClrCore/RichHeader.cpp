@@ -0,0 +1,235 @@
+#include "pch.h"
+
+#include "RichHeader.h"
+#include "Corpus.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	// The Rich header sits in the first page for anything the linker produced.
+	static constexpr DWORD HeaderReadSize = 0x1000;
+	static constexpr DWORD MaxStubSize = 0x10000;
+
+	// The Rich header is always after the DOS header, and the stub.
+	static constexpr DWORD MinRichOffset = 0x80;
+
+	// Decodes each file as its first page completes, and adds it to the aggregate.
+	class RichHeaderParser : public CorpusParser
+	{
+	public:
+		RichHeaderParser(ToolchainAggregate& aggregate)
+			: _aggregate(aggregate) { }
+
+		~RichHeaderParser() { }
+
+		DWORD FirstReadSize() const noexcept override { return HeaderReadSize; }
+
+		bool OnRead(LS_CORPUS_FILE& file, const BYTE* data, DWORD size) override
+		{
+			const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(data);
+			if (size < sizeof(IMAGE_DOS_HEADER) || dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
+				file.Result = ERROR_BAD_FORMAT;
+				return false;
+			}
+
+			// Big stubs are read again from the start, it's rare enough.
+			DWORD stub_size = static_cast<DWORD>(dos_header->e_lfanew);
+			if (stub_size > size && stub_size <= MaxStubSize && stub_size > file.Size) {
+				file.Offset = 0;
+				file.Size = stub_size;
+				return true;
+			}
+
+			LS_RICH_HEADER rich_header;
+			RichHeaderReader::Decode(data, size, &rich_header);
+			_aggregate.Add(rich_header);
+
+			return false;
+		}
+
+		void OnComplete(const LS_CORPUS_FILE& file) override
+		{
+			if (file.Result != ERROR_SUCCESS)
+				_aggregate.AddFailure(file.Index, *file.Path, file.Result);
+		}
+
+	private:
+		ToolchainAggregate& _aggregate;
+	};
+
+	RichHeaderReader::RichHeaderReader() { }
+	RichHeaderReader::~RichHeaderReader() { }
+
+	const LSRESULT RichHeaderReader::Read(const WWuString& file_path, PLS_RICH_HEADER rich_header)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		DWORD bytes_read = 0;
+		_buffer.resize(HeaderReadSize);
+		if (!ReadFile(h_file, _buffer.data(), HeaderReadSize, &bytes_read, NULL)) {
+			DWORD last_error = GetLastError();
+			CloseHandle(h_file);
+			return LSRESULT(last_error, __FILEW__, __LINE__);
+		}
+
+		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(_buffer.data());
+		if (bytes_read < sizeof(IMAGE_DOS_HEADER) || dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
+			CloseHandle(h_file);
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+		}
+
+		// Big stubs need a second read. It's rare enough.
+		DWORD stub_size = static_cast<DWORD>(dos_header->e_lfanew);
+		if (stub_size > bytes_read && stub_size <= MaxStubSize) {
+			DWORD remaining = stub_size - bytes_read;
+			DWORD extra_read = 0;
+			_buffer.resize(stub_size);
+			if (ReadFile(h_file, _buffer.data() + bytes_read, remaining, &extra_read, NULL))
+				bytes_read += extra_read;
+		}
+
+		CloseHandle(h_file);
+		Decode(_buffer.data(), bytes_read, rich_header);
+
+		return LSRESULT();
+	}
+
+	bool RichHeaderReader::Decode(const BYTE* data, size_t size, PLS_RICH_HEADER rich_header)
+	{
+		if (size < sizeof(IMAGE_DOS_HEADER))
+			return false;
+
+		const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(data);
+		size_t end = min(size, static_cast<size_t>(static_cast<DWORD>(dos_header->e_lfanew)));
+		if (end < MinRichOffset + 2 * sizeof(DWORD))
+			return false;
+
+		// 'Rich' is in clear text, followed by the key.
+		const DWORD* dwords = reinterpret_cast<const DWORD*>(data);
+		size_t rich_index = 0;
+		for (size_t i = MinRichOffset / sizeof(DWORD); i + 1 < end / sizeof(DWORD); i++) {
+			if (dwords[i] == LS_RICH_SIGNATURE) {
+				rich_index = i;
+				break;
+			}
+		}
+
+		if (rich_index == 0)
+			return false;
+
+		// Walking back to 'DanS'.
+		DWORD key = dwords[rich_index + 1];
+		size_t dans_index = 0;
+		for (size_t i = rich_index; i > MinRichOffset / sizeof(DWORD); i--) {
+			if ((dwords[i - 1] ^ key) == LS_RICH_DANS) {
+				dans_index = i - 1;
+				break;
+			}
+		}
+
+		if (dans_index == 0)
+			return false;
+
+		rich_header->Present = true;
+		rich_header->Key = key;
+		rich_header->Offset = static_cast<DWORD>(dans_index * sizeof(DWORD));
+		rich_header->Size = static_cast<DWORD>((rich_index + 2 - dans_index) * sizeof(DWORD));
+
+		// Three padding DWORDs after 'DanS', then comp.id, and count pairs.
+		rich_header->Entries.clear();
+		for (size_t i = dans_index + 4; i + 1 < rich_index; i += 2) {
+			DWORD comp_id = dwords[i] ^ key;
+			rich_header->Entries.push_back({ HIWORD(comp_id), LOWORD(comp_id), dwords[i + 1] ^ key });
+		}
+
+		// The key is a checksum of the DOS header, and stub, without 'e_lfanew', and of the entries.
+		DWORD checksum = rich_header->Offset;
+		for (DWORD i = 0; i < rich_header->Offset; i++) {
+			if (i >= FIELD_OFFSET(IMAGE_DOS_HEADER, e_lfanew) && i < FIELD_OFFSET(IMAGE_DOS_HEADER, e_lfanew) + sizeof(LONG))
+				continue;
+
+			checksum += _rotl(static_cast<DWORD>(data[i]), i & 0x1F);
+		}
+
+		for (const LS_RICH_ENTRY& entry : rich_header->Entries)
+			checksum += _rotl(MAKELONG(entry.Build, entry.ProductId), entry.Count & 0x1F);
+
+		rich_header->ChecksumValid = checksum == key;
+
+		return true;
+	}
+
+	ToolchainAggregate::ToolchainAggregate()
+		: _file_count(0), _files_without_header(0)
+	{
+		InitializeSRWLock(&_lock);
+	}
+
+	ToolchainAggregate::~ToolchainAggregate() { }
+
+	void ToolchainAggregate::Add(const LS_RICH_HEADER& rich_header)
+	{
+		AcquireSRWLockExclusive(&_lock);
+		_file_count++;
+		if (!rich_header.Present)
+			_files_without_header++;
+
+		// Entries are unique by comp.id in linker output, but we don't count on it.
+		wumap<DWORD, bool> seen;
+		for (const LS_RICH_ENTRY& entry : rich_header.Entries) {
+			DWORD comp_id = MAKELONG(entry.Build, entry.ProductId);
+			auto count = _counts.emplace(comp_id, LS_TOOLCHAIN_COUNT{ entry.ProductId, entry.Build, 0, 0 }).first;
+			if (seen.emplace(comp_id, true).second)
+				count->second.FileCount++;
+
+			count->second.ObjectCount += entry.Count;
+		}
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	void ToolchainAggregate::AddFailure(DWORD index, const WWuString& file_path, LONG result)
+	{
+		AcquireSRWLockExclusive(&_lock);
+		LS_TOOLCHAIN_FAILURE& failure = _failures[index];
+		failure.Path = file_path;
+		failure.Result = result;
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	const LSRESULT ToolchainAggregate::AddFiles(const wuvector<WWuString>& file_paths, DWORD thread_count)
+	{
+		RichHeaderParser parser(*this);
+		CorpusPipeline pipeline(LS_CORPUS_QUEUE_DEPTH, thread_count);
+
+		return pipeline.Run(file_paths, parser);
+	}
+
+	void ToolchainAggregate::GetCounts(wuvector<LS_TOOLCHAIN_COUNT>& counts)
+	{
+		counts.clear();
+
+		AcquireSRWLockShared(&_lock);
+		counts.reserve(_counts.size());
+		for (const auto& count : _counts)
+			counts.push_back(count.second);
+		ReleaseSRWLockShared(&_lock);
+
+		std::stable_sort(counts.begin(), counts.end(), [](const LS_TOOLCHAIN_COUNT& left, const LS_TOOLCHAIN_COUNT& right) {
+			return left.FileCount > right.FileCount;
+		});
+	}
+
+	void ToolchainAggregate::GetFailures(wuvector<LS_TOOLCHAIN_FAILURE>& failures)
+	{
+		failures.clear();
+
+		AcquireSRWLockShared(&_lock);
+		failures.reserve(_failures.size());
+		for (const auto& failure : _failures)
+			failures.push_back(failure.second);
+		ReleaseSRWLockShared(&_lock);
+	}
+}
\ No newline at end of file
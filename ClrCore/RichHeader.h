@@ -0,0 +1,121 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	// 'Rich', and 'DanS'. The later is stored XORed with the key.
+	#define LS_RICH_SIGNATURE 0x68636952
+	#define LS_RICH_DANS 0x536E6144
+
+	// A comp.id, and how many objects it built. The product ID identifies the tool,
+	// and object kind (C, C++, assembly, import, linker...), the build its version.
+	typedef struct _LS_RICH_ENTRY
+	{
+		WORD ProductId;
+		WORD Build;
+		DWORD Count;
+
+	} LS_RICH_ENTRY, *PLS_RICH_ENTRY;
+
+	typedef struct _LS_RICH_HEADER
+	{
+		bool Present;
+
+		// The XOR key is also the header checksum.
+		DWORD Key;
+		bool ChecksumValid;
+
+		// From the file start. The header ends at the 'Rich' signature, plus the key.
+		DWORD Offset;
+		DWORD Size;
+		wuvector<LS_RICH_ENTRY> Entries;
+
+		_LS_RICH_HEADER()
+			: Present(false), Key(0), ChecksumValid(false), Offset(0), Size(0) { }
+
+		~_LS_RICH_HEADER() { }
+
+	} LS_RICH_HEADER, *PLS_RICH_HEADER;
+
+	// How many files, and objects a comp.id is in, across a corpus.
+	typedef struct _LS_TOOLCHAIN_COUNT
+	{
+		WORD ProductId;
+		WORD Build;
+		DWORD FileCount;
+		ULONGLONG ObjectCount;
+
+	} LS_TOOLCHAIN_COUNT, *PLS_TOOLCHAIN_COUNT;
+
+	// A file of the corpus that could not be opened, read, or was not an image.
+	typedef struct _LS_TOOLCHAIN_FAILURE
+	{
+		WWuString Path;
+		LONG Result;
+
+		_LS_TOOLCHAIN_FAILURE()
+			: Result(ERROR_SUCCESS) { }
+
+		~_LS_TOOLCHAIN_FAILURE() { }
+
+	} LS_TOOLCHAIN_FAILURE, *PLS_TOOLCHAIN_FAILURE;
+
+	// Decodes the undocumented header the Microsoft linker writes between the DOS stub,
+	// and the NT headers. Only the bytes before 'e_lfanew' are needed, so a file costs one read.
+	class RichHeaderReader
+	{
+	public:
+		RichHeaderReader();
+		~RichHeaderReader();
+
+		// Files without a Rich header succeed, with 'Present' false.
+		const LSRESULT Read(const WWuString& file_path, PLS_RICH_HEADER rich_header);
+
+		// 'data' is the start of the file, up to 'e_lfanew' at least.
+		static bool Decode(const BYTE* data, size_t size, PLS_RICH_HEADER rich_header);
+
+	private:
+		// Reused between files.
+		wuvector<BYTE> _buffer;
+	};
+
+	// Thread-safe comp.id counters, for a corpus.
+	class ToolchainAggregate
+	{
+	public:
+		ToolchainAggregate();
+		~ToolchainAggregate();
+
+		// A comp.id counts once per file, however many entries it has.
+		void Add(const LS_RICH_HEADER& rich_header);
+		void AddFailure(DWORD index, const WWuString& file_path, LONG result);
+
+		// Reads, and adds every file through the corpus pipeline, parsing on 'thread_count' threads.
+		// Zero means one per processor. Files that can't be read are not counted, they go to the failures.
+		const LSRESULT AddFiles(const wuvector<WWuString>& file_paths, DWORD thread_count = 0);
+
+		// Sorted by file count, highest first.
+		void GetCounts(wuvector<LS_TOOLCHAIN_COUNT>& counts);
+
+		// In the order of the paths given to 'AddFiles'.
+		void GetFailures(wuvector<LS_TOOLCHAIN_FAILURE>& failures);
+
+		_NODISCARD DWORD FileCount() const noexcept { return _file_count; }
+		_NODISCARD DWORD FilesWithoutHeader() const noexcept { return _files_without_header; }
+
+	private:
+		SRWLOCK _lock;
+		DWORD _file_count;
+		DWORD _files_without_header;
+
+		// Keyed by the comp.id, product ID in the high word.
+		wumap<DWORD, LS_TOOLCHAIN_COUNT> _counts;
+
+		// Keyed by the corpus file index.
+		wumap<DWORD, LS_TOOLCHAIN_FAILURE> _failures;
+	};
+}
\ No newline at end of file
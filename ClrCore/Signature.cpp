@@ -0,0 +1,817 @@
+#include "pch.h"
+
+#include "Signature.h"
+
+#ifndef NT_SUCCESS
+#define NT_SUCCESS(status) (((NTSTATUS)(status)) >= 0)
+#endif
+
+namespace LibSnitcher::Core
+{
+	// WIN_CERTIFICATE. We don't pull 'WinTrust.h' for these.
+	static constexpr DWORD CertificateHeaderSize = 8;
+	static constexpr WORD CertificateTypePkcsSignedData = 0x0002;
+
+	// Nested signatures can contain nested signatures.
+	static constexpr int MaxNesting = 4;
+
+	static const char* OidSignedData = "1.2.840.113549.1.7.2";
+	static const char* OidIndirectData = "1.3.6.1.4.1.311.2.1.4";
+	static const char* OidSigningTime = "1.2.840.113549.1.9.5";
+	static const char* OidCounterSignature = "1.2.840.113549.1.9.6";
+	static const char* OidTimestampToken = "1.3.6.1.4.1.311.3.3.1";
+	static const char* OidNestedSignature = "1.3.6.1.4.1.311.2.4.1";
+
+	typedef struct _LS_OID_NAME
+	{
+		const char* Oid;
+		const char* Name;
+
+	} LS_OID_NAME, *PLS_OID_NAME;
+
+	static const LS_OID_NAME AlgorithmNames[] = {
+		{ "1.2.840.113549.2.5", "md5" },
+		{ "1.3.14.3.2.26", "sha1" },
+		{ "2.16.840.1.101.3.4.2.1", "sha256" },
+		{ "2.16.840.1.101.3.4.2.2", "sha384" },
+		{ "2.16.840.1.101.3.4.2.3", "sha512" },
+	};
+
+	static const LS_OID_NAME AttributeNames[] = {
+		{ "2.5.4.3", "CN" },
+		{ "2.5.4.5", "SERIALNUMBER" },
+		{ "2.5.4.6", "C" },
+		{ "2.5.4.7", "L" },
+		{ "2.5.4.8", "S" },
+		{ "2.5.4.9", "STREET" },
+		{ "2.5.4.10", "O" },
+		{ "2.5.4.11", "OU" },
+		{ "1.2.840.113549.1.9.1", "E" },
+	};
+
+	static const char* LookupOidName(const LS_OID_NAME* names, size_t count, const WuString& oid) noexcept
+	{
+		for (size_t i = 0; i < count; i++) {
+			if (oid == names[i].Oid)
+				return names[i].Name;
+		}
+
+		return NULL;
+	}
+
+	static bool ReadDigits(const BYTE* data, size_t count, WORD& value) noexcept
+	{
+		value = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (data[i] < '0' || data[i] > '9')
+				return false;
+
+			value = static_cast<WORD>((value * 10) + (data[i] - '0'));
+		}
+
+		return true;
+	}
+
+	DerReader::DerReader(const BYTE* data, size_t size)
+		: _position(data), _end(data + size) { }
+
+	DerReader::DerReader(const LS_DER_ELEMENT& element)
+		: _position(element.Data), _end(element.Data + element.Size) { }
+
+	bool DerReader::Next(LS_DER_ELEMENT& element) noexcept
+	{
+		if (_end - _position < 2)
+			return false;
+
+		const BYTE* start = _position;
+		BYTE tag = start[0];
+		if ((tag & 0x1F) == 0x1F)
+			return false;
+
+		size_t length = start[1];
+		size_t header_size = 2;
+		if (length & 0x80) {
+			// Long form. 0x80 alone is the indefinite length.
+			size_t length_size = length & 0x7F;
+			if (length_size == 0 || length_size > 4 || static_cast<size_t>(_end - start) < 2 + length_size)
+				return false;
+
+			length = 0;
+			for (size_t i = 0; i < length_size; i++)
+				length = (length << 8) | start[2 + i];
+
+			header_size += length_size;
+		}
+
+		if (length > static_cast<size_t>(_end - start) - header_size)
+			return false;
+
+		element.Tag = tag;
+		element.Data = start + header_size;
+		element.Size = length;
+		element.Raw = start;
+		element.RawSize = header_size + length;
+		_position = start + element.RawSize;
+
+		return true;
+	}
+
+	bool DerReader::Expect(BYTE tag, LS_DER_ELEMENT& element) noexcept
+	{
+		return Next(element) && element.Tag == tag;
+	}
+
+	bool DerReader::Optional(BYTE tag, LS_DER_ELEMENT& element) noexcept
+	{
+		if (IsEmpty() || *_position != tag)
+			return false;
+
+		return Next(element);
+	}
+
+	WuString DerReader::ReadOid(const LS_DER_ELEMENT& element)
+	{
+		WuString output;
+		if (element.Size == 0)
+			return output;
+
+		// The first byte packs the first two arcs.
+		BYTE first = element.Data[0];
+		DWORD first_arc = first < 40 ? 0 : first < 80 ? 1 : 2;
+		output = WuString::Format("%u.%u", first_arc, first - (first_arc * 40));
+
+		ULONGLONG arc = 0;
+		for (size_t i = 1; i < element.Size; i++) {
+			arc = (arc << 7) | (element.Data[i] & 0x7F);
+			if ((element.Data[i] & 0x80) == 0) {
+				output += WuString::Format(".%llu", arc);
+				arc = 0;
+			}
+		}
+
+		return output;
+	}
+
+	bool DerReader::ReadTime(const LS_DER_ELEMENT& element, ULONGLONG& file_time) noexcept
+	{
+		// YYMMDDHHMM[SS]Z, or YYYYMMDDHHMM[SS[.fff]]Z. Authenticode times are UTC.
+		size_t year_size;
+		if (element.Tag == LS_DER_UTC_TIME)
+			year_size = 2;
+		else if (element.Tag == LS_DER_GENERALIZED_TIME)
+			year_size = 4;
+		else
+			return false;
+
+		if (element.Size < year_size + 8)
+			return false;
+
+		SYSTEMTIME system_time = { 0 };
+		const BYTE* data = element.Data;
+		if (!ReadDigits(data, year_size, system_time.wYear) ||
+			!ReadDigits(data + year_size, 2, system_time.wMonth) ||
+			!ReadDigits(data + year_size + 2, 2, system_time.wDay) ||
+			!ReadDigits(data + year_size + 4, 2, system_time.wHour) ||
+			!ReadDigits(data + year_size + 6, 2, system_time.wMinute))
+		{
+			return false;
+		}
+
+		if (element.Size >= year_size + 10)
+			ReadDigits(data + year_size + 8, 2, system_time.wSecond);
+
+		if (year_size == 2)
+			system_time.wYear += system_time.wYear < 50 ? 2000 : 1900;
+
+		FILETIME output;
+		if (!SystemTimeToFileTime(&system_time, &output))
+			return false;
+
+		file_time = (static_cast<ULONGLONG>(output.dwHighDateTime) << 32) | output.dwLowDateTime;
+
+		return true;
+	}
+
+	WWuString DerReader::ReadName(const LS_DER_ELEMENT& element)
+	{
+		// Name ::= SEQUENCE OF SET OF SEQUENCE { type OID, value ANY }
+		// The most specific RDN comes last in the encoding, and first in the string.
+		wuvector<WWuString> rdns;
+		DerReader reader(element);
+		LS_DER_ELEMENT rdn;
+		while (reader.Expect(LS_DER_SET, rdn)) {
+			WWuString current;
+			DerReader rdn_reader(rdn);
+			LS_DER_ELEMENT attribute;
+			while (rdn_reader.Expect(LS_DER_SEQUENCE, attribute)) {
+				DerReader attribute_reader(attribute);
+				LS_DER_ELEMENT type;
+				LS_DER_ELEMENT value;
+				if (!attribute_reader.Expect(LS_DER_OID, type) || !attribute_reader.Next(value))
+					break;
+
+				WuString oid = ReadOid(type);
+				const char* name = LookupOidName(AttributeNames, ARRAYSIZE(AttributeNames), oid);
+				if (current.Length() > 0)
+					current += L" + ";
+
+				current += WuStringToWide(name == NULL ? oid : WuString(name));
+				current += L"=";
+				current += ReadString(value);
+			}
+
+			rdns.push_back(current);
+		}
+
+		WWuString output;
+		for (auto it = rdns.rbegin(); it != rdns.rend(); it++) {
+			if (output.Length() > 0)
+				output += L", ";
+
+			output += *it;
+		}
+
+		return output;
+	}
+
+	WWuString DerReader::ReadString(const LS_DER_ELEMENT& element)
+	{
+		wuvector<WCHAR> buffer;
+		switch (element.Tag) {
+			case LS_DER_UTF8_STRING:
+			{
+				int char_count = MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCCH>(element.Data), static_cast<int>(element.Size), NULL, 0);
+				buffer.resize(static_cast<size_t>(char_count) + 1);
+				MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCCH>(element.Data), static_cast<int>(element.Size), buffer.data(), char_count);
+			} break;
+
+			case LS_DER_BMP_STRING:
+			{
+				// Big endian UTF-16.
+				for (size_t i = 0; i + 1 < element.Size; i += 2)
+					buffer.push_back(static_cast<WCHAR>((element.Data[i] << 8) | element.Data[i + 1]));
+
+				buffer.push_back(L'\0');
+			} break;
+
+			default:
+			{
+				// PrintableString, IA5String, and T61String. All single byte.
+				for (size_t i = 0; i < element.Size; i++)
+					buffer.push_back(static_cast<WCHAR>(element.Data[i]));
+
+				buffer.push_back(L'\0');
+			} break;
+		}
+
+		return WWuString(buffer.data());
+	}
+
+	WuString DerReader::ReadHex(const BYTE* data, size_t size)
+	{
+		static const char digits[] = "0123456789ABCDEF";
+
+		wuvector<char> buffer((size * 2) + 1, '\0');
+		for (size_t i = 0; i < size; i++) {
+			buffer[i * 2] = digits[data[i] >> 4];
+			buffer[(i * 2) + 1] = digits[data[i] & 0x0F];
+		}
+
+		return WuString(buffer.data());
+	}
+
+	static WuString GetAlgorithmName(const LS_DER_ELEMENT& algorithm_identifier)
+	{
+		// AlgorithmIdentifier ::= SEQUENCE { algorithm OID, parameters ANY OPTIONAL }
+		DerReader reader(algorithm_identifier);
+		LS_DER_ELEMENT oid_element;
+		if (!reader.Expect(LS_DER_OID, oid_element))
+			return WuString();
+
+		WuString oid = DerReader::ReadOid(oid_element);
+		const char* name = LookupOidName(AlgorithmNames, ARRAYSIZE(AlgorithmNames), oid);
+
+		return name == NULL ? oid : WuString(name);
+	}
+
+	static void AddDigestAlgorithm(PLS_SIGNATURE_INFO signature, const WuString& name)
+	{
+		for (const WuString& existing : signature->DigestAlgorithms) {
+			if (existing == name)
+				return;
+		}
+
+		signature->DigestAlgorithms.push_back(name);
+	}
+
+	// Attribute ::= SEQUENCE { type OID, values SET OF ANY }
+	// Returns the values set of the first attribute with type 'oid'.
+	static bool FindAttribute(const LS_DER_ELEMENT& attributes, const char* oid, LS_DER_ELEMENT& values)
+	{
+		DerReader reader(attributes);
+		LS_DER_ELEMENT attribute;
+		while (reader.Expect(LS_DER_SEQUENCE, attribute)) {
+			DerReader attribute_reader(attribute);
+			LS_DER_ELEMENT type;
+			if (attribute_reader.Expect(LS_DER_OID, type) && DerReader::ReadOid(type) == oid)
+				return attribute_reader.Expect(LS_DER_SET, values);
+		}
+
+		return false;
+	}
+
+	static bool FindSigningTime(const LS_DER_ELEMENT& attributes, ULONGLONG& signing_time)
+	{
+		LS_DER_ELEMENT values;
+		LS_DER_ELEMENT value;
+		if (!FindAttribute(attributes, OidSigningTime, values))
+			return false;
+
+		DerReader reader(values);
+		return reader.Next(value) && DerReader::ReadTime(value, signing_time);
+	}
+
+	// ContentInfo ::= SEQUENCE { contentType OID, content [0] EXPLICIT ANY }
+	static bool OpenSignedData(const LS_DER_ELEMENT& content_info, LS_DER_ELEMENT& signed_data)
+	{
+		DerReader reader(content_info);
+		LS_DER_ELEMENT type;
+		LS_DER_ELEMENT content;
+		if (!reader.Expect(LS_DER_OID, type) || DerReader::ReadOid(type) != OidSignedData || !reader.Expect(LS_DER_CONTEXT_0, content))
+			return false;
+
+		DerReader content_reader(content);
+		return content_reader.Expect(LS_DER_SEQUENCE, signed_data);
+	}
+
+	// SpcIndirectDataContent ::= SEQUENCE { data SpcAttributeTypeAndOptionalValue, messageDigest DigestInfo }
+	// DigestInfo ::= SEQUENCE { digestAlgorithm AlgorithmIdentifier, digest OCTET STRING }
+	static bool ReadIndirectData(const LS_DER_ELEMENT& encapsulated, WuString& algorithm, WuString& digest)
+	{
+		DerReader reader(encapsulated);
+		LS_DER_ELEMENT type;
+		LS_DER_ELEMENT content;
+		if (!reader.Expect(LS_DER_OID, type) || DerReader::ReadOid(type) != OidIndirectData || !reader.Expect(LS_DER_CONTEXT_0, content))
+			return false;
+
+		LS_DER_ELEMENT indirect_data;
+		LS_DER_ELEMENT data;
+		LS_DER_ELEMENT digest_info;
+		DerReader content_reader(content);
+		if (!content_reader.Expect(LS_DER_SEQUENCE, indirect_data))
+			return false;
+
+		DerReader indirect_reader(indirect_data);
+		if (!indirect_reader.Expect(LS_DER_SEQUENCE, data) || !indirect_reader.Expect(LS_DER_SEQUENCE, digest_info))
+			return false;
+
+		LS_DER_ELEMENT algorithm_identifier;
+		LS_DER_ELEMENT digest_value;
+		DerReader digest_reader(digest_info);
+		if (!digest_reader.Expect(LS_DER_SEQUENCE, algorithm_identifier) || !digest_reader.Expect(LS_DER_OCTET_STRING, digest_value))
+			return false;
+
+		algorithm = GetAlgorithmName(algorithm_identifier);
+		digest = DerReader::ReadHex(digest_value.Data, digest_value.Size);
+
+		return true;
+	}
+
+	// RFC 3161 timestamp token. A ContentInfo with SignedData, encapsulating a TSTInfo.
+	// TSTInfo ::= SEQUENCE { version, policy, messageImprint, serialNumber, genTime GeneralizedTime, ... }
+	static bool ReadTimestampToken(const LS_DER_ELEMENT& content_info, ULONGLONG& signing_time)
+	{
+		LS_DER_ELEMENT signed_data;
+		if (!OpenSignedData(content_info, signed_data))
+			return false;
+
+		LS_DER_ELEMENT version;
+		LS_DER_ELEMENT algorithms;
+		LS_DER_ELEMENT encapsulated;
+		DerReader reader(signed_data);
+		if (!reader.Expect(LS_DER_INTEGER, version) || !reader.Expect(LS_DER_SET, algorithms) || !reader.Expect(LS_DER_SEQUENCE, encapsulated))
+			return false;
+
+		LS_DER_ELEMENT type;
+		LS_DER_ELEMENT content;
+		LS_DER_ELEMENT octets;
+		DerReader encapsulated_reader(encapsulated);
+		if (!encapsulated_reader.Expect(LS_DER_OID, type) || !encapsulated_reader.Expect(LS_DER_CONTEXT_0, content))
+			return false;
+
+		DerReader content_reader(content);
+		if (!content_reader.Expect(LS_DER_OCTET_STRING, octets))
+			return false;
+
+		LS_DER_ELEMENT tst_info;
+		DerReader octets_reader(octets);
+		if (!octets_reader.Expect(LS_DER_SEQUENCE, tst_info))
+			return false;
+
+		LS_DER_ELEMENT element;
+		DerReader tst_reader(tst_info);
+		if (!tst_reader.Expect(LS_DER_INTEGER, element) || !tst_reader.Expect(LS_DER_OID, element) ||
+			!tst_reader.Expect(LS_DER_SEQUENCE, element) || !tst_reader.Expect(LS_DER_INTEGER, element) ||
+			!tst_reader.Expect(LS_DER_GENERALIZED_TIME, element))
+		{
+			return false;
+		}
+
+		return DerReader::ReadTime(element, signing_time);
+	}
+
+	// Looks for the certificate with the signer's issuer, and serial number in 'certificates'.
+	static bool FindSubject(const LS_DER_ELEMENT& certificates, const LS_DER_ELEMENT& issuer, const LS_DER_ELEMENT& serial, WWuString& subject)
+	{
+		DerReader reader(certificates);
+		LS_DER_ELEMENT certificate;
+		while (reader.Next(certificate)) {
+			// Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature }
+			// TBSCertificate ::= SEQUENCE { [0] version, serialNumber, signature, issuer, validity, subject, ... }
+			LS_DER_ELEMENT tbs;
+			DerReader certificate_reader(certificate);
+			if (certificate.Tag != LS_DER_SEQUENCE || !certificate_reader.Expect(LS_DER_SEQUENCE, tbs))
+				continue;
+
+			LS_DER_ELEMENT element;
+			LS_DER_ELEMENT certificate_serial;
+			LS_DER_ELEMENT certificate_issuer;
+			LS_DER_ELEMENT certificate_subject;
+			DerReader tbs_reader(tbs);
+			tbs_reader.Optional(LS_DER_CONTEXT_0, element);
+			if (!tbs_reader.Expect(LS_DER_INTEGER, certificate_serial) || !tbs_reader.Expect(LS_DER_SEQUENCE, element) ||
+				!tbs_reader.Expect(LS_DER_SEQUENCE, certificate_issuer) || !tbs_reader.Expect(LS_DER_SEQUENCE, element) ||
+				!tbs_reader.Expect(LS_DER_SEQUENCE, certificate_subject))
+			{
+				continue;
+			}
+
+			if (certificate_serial.RawSize == serial.RawSize && memcmp(certificate_serial.Raw, serial.Raw, serial.RawSize) == 0 &&
+				certificate_issuer.RawSize == issuer.RawSize && memcmp(certificate_issuer.Raw, issuer.Raw, issuer.RawSize) == 0)
+			{
+				subject = DerReader::ReadName(certificate_subject);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// SignerInfo ::= SEQUENCE { version, sid, digestAlgorithm, [0] authenticatedAttributes OPTIONAL,
+	//     digestEncryptionAlgorithm, encryptedDigest, [1] unauthenticatedAttributes OPTIONAL }
+	static bool ParseSignerInfo(const LS_DER_ELEMENT& signer_info, const LS_DER_ELEMENT* certificates, LS_SIGNER_INFO& signer, wuvector<LS_DER_ELEMENT>& nested)
+	{
+		LS_DER_ELEMENT version;
+		LS_DER_ELEMENT sid;
+		DerReader reader(signer_info);
+		if (!reader.Expect(LS_DER_INTEGER, version) || !reader.Next(sid))
+			return false;
+
+		// Version 3 signers use a subject key identifier instead. We leave those without identity.
+		if (sid.Tag == LS_DER_SEQUENCE) {
+			LS_DER_ELEMENT issuer;
+			LS_DER_ELEMENT serial;
+			DerReader sid_reader(sid);
+			if (!sid_reader.Expect(LS_DER_SEQUENCE, issuer) || !sid_reader.Expect(LS_DER_INTEGER, serial))
+				return false;
+
+			signer.Issuer = DerReader::ReadName(issuer);
+			signer.SerialNumber = DerReader::ReadHex(serial.Data, serial.Size);
+			if (certificates != NULL)
+				FindSubject(*certificates, issuer, serial, signer.Subject);
+		}
+
+		LS_DER_ELEMENT algorithm;
+		LS_DER_ELEMENT attributes;
+		LS_DER_ELEMENT element;
+		if (!reader.Expect(LS_DER_SEQUENCE, algorithm))
+			return false;
+
+		signer.DigestAlgorithm = GetAlgorithmName(algorithm);
+		if (reader.Optional(LS_DER_CONTEXT_0, attributes))
+			FindSigningTime(attributes, signer.SigningTime);
+
+		if (!reader.Expect(LS_DER_SEQUENCE, element) || !reader.Expect(LS_DER_OCTET_STRING, element))
+			return false;
+
+		if (!reader.Optional(LS_DER_CONTEXT_1, attributes))
+			return true;
+
+		// The timestamp is the trusted signing time, so it wins over the signed attribute.
+		LS_DER_ELEMENT values;
+		LS_DER_ELEMENT value;
+		if (FindAttribute(attributes, OidCounterSignature, values)) {
+			DerReader values_reader(values);
+			while (values_reader.Expect(LS_DER_SEQUENCE, value)) {
+				LS_DER_ELEMENT counter_attributes;
+				DerReader counter_reader(value);
+				if (counter_reader.Expect(LS_DER_INTEGER, element) && counter_reader.Next(element) &&
+					counter_reader.Expect(LS_DER_SEQUENCE, element) && counter_reader.Optional(LS_DER_CONTEXT_0, counter_attributes))
+				{
+					FindSigningTime(counter_attributes, signer.SigningTime);
+				}
+			}
+		}
+
+		if (FindAttribute(attributes, OidTimestampToken, values)) {
+			DerReader values_reader(values);
+			while (values_reader.Expect(LS_DER_SEQUENCE, value))
+				ReadTimestampToken(value, signer.SigningTime);
+		}
+
+		if (FindAttribute(attributes, OidNestedSignature, values)) {
+			DerReader values_reader(values);
+			while (values_reader.Expect(LS_DER_SEQUENCE, value))
+				nested.push_back(value);
+		}
+
+		return true;
+	}
+
+	static bool ParseContentInfo(const BYTE* data, size_t size, bool is_nested, PLS_SIGNATURE_INFO signature, int depth);
+
+	// SignedData ::= SEQUENCE { version, digestAlgorithms SET, contentInfo,
+	//     [0] certificates OPTIONAL, [1] crls OPTIONAL, signerInfos SET }
+	static bool ParseSignedData(const LS_DER_ELEMENT& signed_data, bool is_nested, PLS_SIGNATURE_INFO signature, int depth)
+	{
+		LS_DER_ELEMENT version;
+		LS_DER_ELEMENT algorithms;
+		LS_DER_ELEMENT encapsulated;
+		DerReader reader(signed_data);
+		if (!reader.Expect(LS_DER_INTEGER, version) || !reader.Expect(LS_DER_SET, algorithms) || !reader.Expect(LS_DER_SEQUENCE, encapsulated))
+			return false;
+
+		LS_DER_ELEMENT algorithm;
+		DerReader algorithms_reader(algorithms);
+		while (algorithms_reader.Expect(LS_DER_SEQUENCE, algorithm))
+			AddDigestAlgorithm(signature, GetAlgorithmName(algorithm));
+
+		WuString image_digest_algorithm;
+		WuString image_digest;
+		ReadIndirectData(encapsulated, image_digest_algorithm, image_digest);
+
+		LS_DER_ELEMENT certificates;
+		LS_DER_ELEMENT crls;
+		LS_DER_ELEMENT signer_infos;
+		bool has_certificates = reader.Optional(LS_DER_CONTEXT_0, certificates);
+		reader.Optional(LS_DER_CONTEXT_1, crls);
+		if (!reader.Expect(LS_DER_SET, signer_infos))
+			return false;
+
+		wuvector<LS_DER_ELEMENT> nested;
+		LS_DER_ELEMENT signer_info;
+		DerReader signers_reader(signer_infos);
+		while (signers_reader.Expect(LS_DER_SEQUENCE, signer_info)) {
+			LS_SIGNER_INFO signer;
+			signer.IsNested = is_nested;
+			signer.ImageDigestAlgorithm = image_digest_algorithm;
+			signer.ImageDigest = image_digest;
+			if (!ParseSignerInfo(signer_info, has_certificates ? &certificates : NULL, signer, nested))
+				return false;
+
+			signature->Signers.push_back(signer);
+		}
+
+		// The primary signers come first.
+		for (const LS_DER_ELEMENT& content_info : nested) {
+			if (!ParseContentInfo(content_info.Raw, content_info.RawSize, true, signature, depth + 1))
+				return false;
+		}
+
+		return true;
+	}
+
+	static bool ParseContentInfo(const BYTE* data, size_t size, bool is_nested, PLS_SIGNATURE_INFO signature, int depth)
+	{
+		if (depth > MaxNesting)
+			return false;
+
+		LS_DER_ELEMENT content_info;
+		LS_DER_ELEMENT signed_data;
+		DerReader reader(data, size);
+		if (!reader.Expect(LS_DER_SEQUENCE, content_info) || !OpenSignedData(content_info, signed_data))
+			return false;
+
+		return ParseSignedData(signed_data, is_nested, signature, depth);
+	}
+
+	SignatureCache::SignatureCache(size_t capacity)
+		: _capacity(capacity == 0 ? 1 : capacity), _next(0)
+	{
+		InitializeSRWLock(&_lock);
+	}
+
+	SignatureCache::~SignatureCache() { }
+
+	bool SignatureCache::Lookup(const LS_CONTENT_HASH& hash, wushared_ptr<LS_SIGNATURE_INFO>& signature)
+	{
+		AcquireSRWLockShared(&_lock);
+		auto cached = _signatures.find(hash);
+		bool found = cached != _signatures.end();
+		if (found)
+			signature = cached->second;
+
+		ReleaseSRWLockShared(&_lock);
+
+		return found;
+	}
+
+	void SignatureCache::Insert(const LS_CONTENT_HASH& hash, const wushared_ptr<LS_SIGNATURE_INFO>& signature)
+	{
+		AcquireSRWLockExclusive(&_lock);
+		auto inserted = _signatures.emplace(hash, signature);
+		if (!inserted.second)
+			inserted.first->second = signature;
+		else if (_order.size() < _capacity)
+			_order.push_back(hash);
+		else {
+			_signatures.erase(_order[_next]);
+			_order[_next] = hash;
+			_next = (_next + 1) % _capacity;
+		}
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	size_t SignatureCache::Count()
+	{
+		AcquireSRWLockShared(&_lock);
+		size_t count = _signatures.size();
+		ReleaseSRWLockShared(&_lock);
+
+		return count;
+	}
+
+	// Function statics aren't initialized thread-safely under /clr, so it's created under an init once,
+	// and kept for the process lifetime.
+	static SignatureCache* SharedSignatureCache = NULL;
+	static INIT_ONCE SharedSignatureCacheOnce = INIT_ONCE_STATIC_INIT;
+
+	static BOOL CALLBACK CreateSharedSignatureCache(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+	{
+		UNREFERENCED_PARAMETER(init_once);
+		UNREFERENCED_PARAMETER(parameter);
+		UNREFERENCED_PARAMETER(context);
+
+		SharedSignatureCache = new SignatureCache();
+
+		return TRUE;
+	}
+
+	SignatureCache& SignatureCache::Shared()
+	{
+		InitOnceExecuteOnce(&SharedSignatureCacheOnce, CreateSharedSignatureCache, NULL, NULL);
+
+		return *SharedSignatureCache;
+	}
+
+	SignatureReader::SignatureReader(SignatureCache* cache)
+		: _cache(cache), _sha256(NULL)
+	{
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&_sha256, BCRYPT_SHA256_ALGORITHM, NULL, 0)))
+			_sha256 = NULL;
+	}
+
+	SignatureReader::~SignatureReader()
+	{
+		if (_sha256 != NULL)
+			BCryptCloseAlgorithmProvider(_sha256, 0);
+	}
+
+	const LSRESULT SignatureReader::GetSignature(const WWuString& file_path, wushared_ptr<LS_SIGNATURE_INFO>& signature)
+	{
+		wuvector<BYTE> table;
+		LSRESULT result = ReadCertificateTable(file_path, table);
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		if (table.empty()) {
+			signature = make_wushared<LS_SIGNATURE_INFO>();
+			return LSRESULT();
+		}
+
+		if (_sha256 == NULL)
+			return LSRESULT(ERROR_NOT_ENOUGH_MEMORY, __FILEW__, __LINE__);
+
+		LS_CONTENT_HASH hash;
+		NTSTATUS status = BCryptHash(_sha256, NULL, 0, table.data(), static_cast<ULONG>(table.size()), hash.Bytes, LS_CONTENT_HASH_SIZE);
+		if (!NT_SUCCESS(status))
+			return LSRESULT(status, __FILEW__, __LINE__, true);
+
+		if (_cache != NULL && _cache->Lookup(hash, signature))
+			return LSRESULT();
+
+		wushared_ptr<LS_SIGNATURE_INFO> parsed = make_wushared<LS_SIGNATURE_INFO>();
+		result = Parse(table.data(), table.size(), parsed.get());
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		if (_cache != NULL)
+			_cache->Insert(hash, parsed);
+
+		signature = parsed;
+
+		return LSRESULT();
+	}
+
+	static const LSRESULT ReadCertificateTableFromHandle(HANDLE h_file, wuvector<BYTE>& table)
+	{
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		BYTE headers[0x1000];
+		DWORD bytes_read = 0;
+		if (!ReadFile(h_file, headers, sizeof(headers), &bytes_read, NULL))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(headers);
+		if (bytes_read < sizeof(IMAGE_DOS_HEADER) || dos_header->e_magic != IMAGE_DOS_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		size_t nt_offset = static_cast<DWORD>(dos_header->e_lfanew);
+		size_t opt_offset = nt_offset + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+		if (opt_offset + sizeof(WORD) > bytes_read || *reinterpret_cast<DWORD*>(headers + nt_offset) != IMAGE_NT_SIGNATURE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a valid image.", __FILEW__, __LINE__);
+
+		PIMAGE_FILE_HEADER file_header = reinterpret_cast<PIMAGE_FILE_HEADER>(headers + nt_offset + sizeof(DWORD));
+		bool pe32 = *reinterpret_cast<WORD*>(headers + opt_offset) == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		size_t directory_offset = opt_offset + (pe32 ? 96 : 112);
+		size_t entry_offset = directory_offset + (IMAGE_DIRECTORY_ENTRY_SECURITY * sizeof(IMAGE_DATA_DIRECTORY));
+		size_t headers_end = min(static_cast<size_t>(bytes_read), opt_offset + file_header->SizeOfOptionalHeader);
+
+		// No certificate table entry means no signature.
+		table.clear();
+		if (entry_offset + sizeof(IMAGE_DATA_DIRECTORY) > headers_end || *reinterpret_cast<DWORD*>(headers + directory_offset - sizeof(DWORD)) <= IMAGE_DIRECTORY_ENTRY_SECURITY)
+			return LSRESULT();
+
+		// The certificate table entry holds a file offset, not an RVA.
+		PIMAGE_DATA_DIRECTORY entry = reinterpret_cast<PIMAGE_DATA_DIRECTORY>(headers + entry_offset);
+		if (entry->VirtualAddress == 0 || entry->Size == 0)
+			return LSRESULT();
+
+		if (static_cast<ULONGLONG>(entry->VirtualAddress) + entry->Size > static_cast<ULONGLONG>(file_size.QuadPart))
+			return LSRESULT(ERROR_BAD_FORMAT, L"Certificate table is outside the file.", __FILEW__, __LINE__);
+
+		LARGE_INTEGER position;
+		position.QuadPart = entry->VirtualAddress;
+		if (!SetFilePointerEx(h_file, position, NULL, FILE_BEGIN))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		table.resize(entry->Size);
+		if (!ReadFile(h_file, table.data(), entry->Size, &bytes_read, NULL))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		if (bytes_read != entry->Size)
+			return LSRESULT(ERROR_HANDLE_EOF, __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+
+	const LSRESULT SignatureReader::ReadCertificateTable(const WWuString& file_path, wuvector<BYTE>& table)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LSRESULT result = ReadCertificateTableFromHandle(h_file, table);
+		CloseHandle(h_file);
+
+		return result;
+	}
+
+	bool SignatureReader::NextCertificate(const BYTE* table, size_t size, DWORD& offset, LS_CERTIFICATE_ENTRY& entry) noexcept
+	{
+		if (static_cast<size_t>(offset) + CertificateHeaderSize > size)
+			return false;
+
+		DWORD length = *reinterpret_cast<const DWORD*>(table + offset);
+		if (length < CertificateHeaderSize || length > size - offset)
+			return false;
+
+		entry.Offset = offset;
+		entry.Length = length;
+		entry.Revision = *reinterpret_cast<const WORD*>(table + offset + 4);
+		entry.CertificateType = *reinterpret_cast<const WORD*>(table + offset + 6);
+
+		// Entries are 8 byte aligned.
+		offset += (length + 7) & ~static_cast<DWORD>(7);
+
+		return true;
+	}
+
+	const LSRESULT SignatureReader::Parse(const BYTE* table, size_t size, PLS_SIGNATURE_INFO signature)
+	{
+		DWORD offset = 0;
+		LS_CERTIFICATE_ENTRY entry;
+		while (NextCertificate(table, size, offset, entry)) {
+			signature->Certificates.push_back(entry);
+			if (entry.CertificateType != CertificateTypePkcsSignedData)
+				continue;
+
+			if (!ParseContentInfo(table + entry.Offset + CertificateHeaderSize, entry.Length - CertificateHeaderSize, false, signature, 0))
+				return LSRESULT(ERROR_INVALID_DATA, L"Malformed PKCS #7 signature.", __FILEW__, __LINE__);
+		}
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_CONTENT_HASH_SIZE 32
+
+	// Signatures kept by the shared cache. Past it, the oldest ones are dropped.
+	#define LS_SIGNATURE_CACHE_CAPACITY 4096
+
+	#define LS_DER_INTEGER				0x02
+	#define LS_DER_OCTET_STRING			0x04
+	#define LS_DER_OID					0x06
+	#define LS_DER_UTF8_STRING			0x0C
+	#define LS_DER_PRINTABLE_STRING		0x13
+	#define LS_DER_T61_STRING			0x14
+	#define LS_DER_IA5_STRING			0x16
+	#define LS_DER_UTC_TIME				0x17
+	#define LS_DER_GENERALIZED_TIME		0x18
+	#define LS_DER_BMP_STRING			0x1E
+	#define LS_DER_SEQUENCE				0x30
+	#define LS_DER_SET					0x31
+	#define LS_DER_CONTEXT_0			0xA0
+	#define LS_DER_CONTEXT_1			0xA1
+
+	typedef struct _LS_DER_ELEMENT
+	{
+		BYTE Tag;
+
+		// The contents, without the tag, and length.
+		const BYTE* Data;
+		size_t Size;
+
+		// The whole element, used to compare names, and serial numbers.
+		const BYTE* Raw;
+		size_t RawSize;
+
+		_LS_DER_ELEMENT()
+			: Tag(0), Data(NULL), Size(0), Raw(NULL), RawSize(0) { }
+
+	} LS_DER_ELEMENT, *PLS_DER_ELEMENT;
+
+	// Walks the DER elements in a buffer, one level at a time. Constructed
+	// elements are walked with a new reader over their contents.
+	// Only definite lengths, and single byte tags are supported, which is what
+	// Authenticode signatures use. Anything else stops the walk.
+	class DerReader
+	{
+	public:
+		DerReader(const BYTE* data, size_t size);
+		DerReader(const LS_DER_ELEMENT& element);
+
+		bool Next(LS_DER_ELEMENT& element) noexcept;
+
+		// Same as 'Next', but fails if the element tag is not 'tag'.
+		bool Expect(BYTE tag, LS_DER_ELEMENT& element) noexcept;
+
+		// Reads the next element only if it has tag 'tag'.
+		bool Optional(BYTE tag, LS_DER_ELEMENT& element) noexcept;
+
+		_NODISCARD bool IsEmpty() const noexcept { return _position >= _end; }
+
+		// Dotted notation, like '1.2.840.113549.1.7.2'.
+		static WuString ReadOid(const LS_DER_ELEMENT& element);
+
+		// UTCTime, or GeneralizedTime, as a FILETIME.
+		static bool ReadTime(const LS_DER_ELEMENT& element, ULONGLONG& file_time) noexcept;
+
+		// An X.500 name, like 'CN=Contoso, O=Contoso Ltd, C=US'.
+		static WWuString ReadName(const LS_DER_ELEMENT& element);
+		static WWuString ReadString(const LS_DER_ELEMENT& element);
+		static WuString ReadHex(const BYTE* data, size_t size);
+
+	private:
+		const BYTE* _position;
+		const BYTE* _end;
+	};
+
+	// One WIN_CERTIFICATE in the attribute certificate table.
+	typedef struct _LS_CERTIFICATE_ENTRY
+	{
+		DWORD Offset;
+		DWORD Length;
+		WORD Revision;
+		WORD CertificateType;
+
+		_LS_CERTIFICATE_ENTRY()
+			: Offset(0), Length(0), Revision(0), CertificateType(0) { }
+
+	} LS_CERTIFICATE_ENTRY, *PLS_CERTIFICATE_ENTRY;
+
+	typedef struct _LS_SIGNER_INFO
+	{
+		WWuString Subject;
+		WWuString Issuer;
+		WuString SerialNumber;
+		WuString DigestAlgorithm;
+
+		// The image digest the signature covers, from 'SpcIndirectDataContent'.
+		WuString ImageDigestAlgorithm;
+		WuString ImageDigest;
+
+		// From the signing time attribute, the counter signature, or the RFC 3161 timestamp.
+		// Zero if the signature is not timestamped.
+		ULONGLONG SigningTime;
+
+		// Signatures appended with 'signtool /as'.
+		bool IsNested;
+
+		_LS_SIGNER_INFO()
+			: SigningTime(0), IsNested(false) { }
+
+		~_LS_SIGNER_INFO() { }
+
+	} LS_SIGNER_INFO, *PLS_SIGNER_INFO;
+
+	typedef struct _LS_SIGNATURE_INFO
+	{
+		wuvector<LS_CERTIFICATE_ENTRY> Certificates;
+		wuvector<LS_SIGNER_INFO> Signers;
+
+		// From every 'SignedData', without duplicates.
+		wuvector<WuString> DigestAlgorithms;
+
+		_LS_SIGNATURE_INFO() { }
+		~_LS_SIGNATURE_INFO() { }
+
+	} LS_SIGNATURE_INFO, *PLS_SIGNATURE_INFO;
+
+	typedef struct _LS_CONTENT_HASH
+	{
+		BYTE Bytes[LS_CONTENT_HASH_SIZE];
+
+		bool operator<(const _LS_CONTENT_HASH& other) const noexcept
+		{
+			return memcmp(Bytes, other.Bytes, LS_CONTENT_HASH_SIZE) < 0;
+		}
+
+	} LS_CONTENT_HASH, *PLS_CONTENT_HASH;
+
+	// Thread-safe cache of parsed signatures, keyed by the SHA-256 of the certificate table.
+	// The same signature blob always parses to the same result, so entries never go stale.
+	// Holds up to 'capacity' signatures, evicting in insertion order.
+	class SignatureCache
+	{
+	public:
+		SignatureCache(size_t capacity = LS_SIGNATURE_CACHE_CAPACITY);
+		~SignatureCache();
+
+		bool Lookup(const LS_CONTENT_HASH& hash, wushared_ptr<LS_SIGNATURE_INFO>& signature);
+		void Insert(const LS_CONTENT_HASH& hash, const wushared_ptr<LS_SIGNATURE_INFO>& signature);
+
+		_NODISCARD size_t Count();
+
+		// The cache shared by the managed wrappers.
+		static SignatureCache& Shared();
+
+	private:
+		SRWLOCK _lock;
+		size_t _capacity;
+		wumap<LS_CONTENT_HASH, wushared_ptr<LS_SIGNATURE_INFO>> _signatures;
+
+		// Insertion order, as a ring once full. '_next' is the oldest entry.
+		wuvector<LS_CONTENT_HASH> _order;
+		size_t _next;
+	};
+
+	// Reads Authenticode signatures without the platform trust APIs. Only the
+	// headers, and the certificate table are read from the file, and the PKCS #7
+	// is walked for the signer identities. Nothing is verified.
+	class SignatureReader
+	{
+	public:
+		SignatureReader(SignatureCache* cache);
+		~SignatureReader();
+
+		// Unsigned images get an empty signature info.
+		const LSRESULT GetSignature(const WWuString& file_path, wushared_ptr<LS_SIGNATURE_INFO>& signature);
+
+		static const LSRESULT ReadCertificateTable(const WWuString& file_path, wuvector<BYTE>& table);
+
+		// Walks the table one WIN_CERTIFICATE at a time. 'offset' starts at zero.
+		static bool NextCertificate(const BYTE* table, size_t size, DWORD& offset, LS_CERTIFICATE_ENTRY& entry) noexcept;
+
+		static const LSRESULT Parse(const BYTE* table, size_t size, PLS_SIGNATURE_INFO signature);
+
+	private:
+		SignatureCache* _cache;
+		BCRYPT_ALG_HANDLE _sha256;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,462 @@
+#include "pch.h"
+
+#include "Snapshot.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	static size_t AlignSection(size_t offset) noexcept
+	{
+		return (offset + 7) & ~static_cast<size_t>(7);
+	}
+
+	const LSRESULT SnapshotWriter::Serialize(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& buffer)
+	{
+		DWORD node_count = static_cast<DWORD>(graph.Nodes.size());
+		DWORD edge_count = static_cast<DWORD>(graph.Edges.size());
+
+		// Empty paths all point here.
+		SnapshotStringTable strings;
+		strings.Intern(WWuString());
+
+		wuvector<LS_SNAPSHOT_NODE> nodes(node_count);
+		for (DWORD i = 0; i < node_count; i++) {
+			const LS_RESOLVED_NODE& source = graph.Nodes[i];
+			LS_SNAPSHOT_NODE& node = nodes[i];
+			ZeroMemory(&node, sizeof(node));
+
+			node.NameOffset = strings.Intern(source.Name);
+			node.KeyOffset = strings.Intern(source.Name.ToLower());
+			node.PathOffset = strings.Intern(source.Path);
+			node.Depth = source.Depth;
+			node.Result = source.Result;
+			if (source.Image != nullptr) {
+				node.Flags = source.Image->BasicInfo.IsClr ? LS_SNAPSHOT_NODE_FLAG_CLR : 0;
+				node.Machine = source.Image->Machine;
+				node.Magic = source.Image->Magic;
+				node.Characteristics = source.Image->Characteristics;
+				node.Subsystem = source.Image->Subsystem;
+				node.TimeDateStamp = source.Image->TimeDateStamp;
+				node.SizeOfImage = source.Image->SizeOfImage;
+				node.CheckSum = source.Image->CheckSum;
+			}
+		}
+
+		// Edges are grouped by parent already, but not in node order. Counting sort keeps each node's edge order.
+		wuvector<DWORD> edge_index(static_cast<size_t>(node_count) + 1, 0);
+		for (const LS_RESOLVED_EDGE& edge : graph.Edges) {
+			if (edge.From >= node_count || edge.To >= node_count)
+				return LSRESULT(ERROR_INVALID_PARAMETER, L"Graph edge references a node out of range.", __FILEW__, __LINE__);
+
+			edge_index[edge.From + 1]++;
+		}
+
+		for (DWORD i = 0; i < node_count; i++)
+			edge_index[i + 1] += edge_index[i];
+
+		wuvector<DWORD> edges(edge_count);
+		wuvector<DWORD> cursor(edge_index.begin(), edge_index.end() - 1);
+		for (const LS_RESOLVED_EDGE& edge : graph.Edges)
+			edges[cursor[edge.From]++] = edge.To;
+
+		// Symbol lists, sorted per node.
+		wuvector<DWORD> import_index(static_cast<size_t>(node_count) + 1, 0);
+		wuvector<DWORD> export_index(static_cast<size_t>(node_count) + 1, 0);
+		wuvector<DWORD> imports;
+		wuvector<DWORD> exports;
+		auto by_string = [&strings](DWORD left, DWORD right) {
+			return wcscmp(strings.At(left), strings.At(right)) < 0;
+		};
+
+		for (DWORD i = 0; i < node_count; i++) {
+			const wushared_ptr<LS_CACHED_IMAGE>& image = graph.Nodes[i].Image;
+			if (image != nullptr && image->HasSymbols) {
+				size_t first = imports.size();
+				for (const WuString& symbol : image->Symbols.Imports)
+					imports.push_back(strings.Intern(WuStringToWide(symbol)));
+
+				std::sort(imports.begin() + first, imports.end(), by_string);
+
+				first = exports.size();
+				for (const WuString& symbol : image->Symbols.Exports)
+					exports.push_back(strings.Intern(WuStringToWide(symbol)));
+
+				std::sort(exports.begin() + first, exports.end(), by_string);
+			}
+
+			import_index[i + 1] = static_cast<DWORD>(imports.size());
+			export_index[i + 1] = static_cast<DWORD>(exports.size());
+		}
+
+		wuvector<DWORD> name_order(node_count);
+		for (DWORD i = 0; i < node_count; i++)
+			name_order[i] = i;
+
+		std::sort(name_order.begin(), name_order.end(), [&nodes, &strings](DWORD left, DWORD right) {
+			return wcscmp(strings.At(nodes[left].KeyOffset), strings.At(nodes[right].KeyOffset)) < 0;
+		});
+
+		// Laying out the sections.
+		struct { LS_SNAPSHOT_SECTION_KIND Kind; const void* Data; size_t Size; } contents[] = {
+			{ SnapshotSectionStrings, strings.Data(), strings.Size() },
+			{ SnapshotSectionNodes, nodes.data(), nodes.size() * sizeof(LS_SNAPSHOT_NODE) },
+			{ SnapshotSectionEdgeIndex, edge_index.data(), edge_index.size() * sizeof(DWORD) },
+			{ SnapshotSectionEdges, edges.data(), edges.size() * sizeof(DWORD) },
+			{ SnapshotSectionNameOrder, name_order.data(), name_order.size() * sizeof(DWORD) },
+			{ SnapshotSectionImportIndex, import_index.data(), import_index.size() * sizeof(DWORD) },
+			{ SnapshotSectionImports, imports.data(), imports.size() * sizeof(DWORD) },
+			{ SnapshotSectionExportIndex, export_index.data(), export_index.size() * sizeof(DWORD) },
+			{ SnapshotSectionExports, exports.data(), exports.size() * sizeof(DWORD) },
+		};
+
+		constexpr WORD section_count = static_cast<WORD>(sizeof(contents) / sizeof(contents[0]));
+		LS_SNAPSHOT_SECTION sections[section_count];
+		size_t offset = AlignSection(sizeof(LS_SNAPSHOT_HEADER) + sizeof(sections));
+		for (WORD i = 0; i < section_count; i++) {
+			sections[i] = { static_cast<DWORD>(contents[i].Kind), 0, offset, contents[i].Size };
+			offset = AlignSection(offset + contents[i].Size);
+		}
+
+		DWORD flags = graph.HasSymbols ? LS_SNAPSHOT_FLAG_SYMBOLS : 0;
+		LS_SNAPSHOT_HEADER header = { LS_SNAPSHOT_MAGIC, LS_SNAPSHOT_VERSION, section_count, node_count, edge_count, flags, 0, offset };
+
+		// Padding stays zeroed.
+		buffer.assign(offset, 0);
+		RtlCopyMemory(buffer.data(), &header, sizeof(header));
+		RtlCopyMemory(buffer.data() + sizeof(header), sections, sizeof(sections));
+		for (WORD i = 0; i < section_count; i++) {
+			if (contents[i].Size > 0)
+				RtlCopyMemory(buffer.data() + sections[i].Offset, contents[i].Data, contents[i].Size);
+		}
+
+		return LSRESULT();
+	}
+
+	const LSRESULT SnapshotWriter::Write(const LS_RESOLVED_GRAPH& graph, const WWuString& file_path)
+	{
+		wuvector<BYTE> buffer;
+		LSRESULT result = Serialize(graph, buffer);
+		if (result.Result != ERROR_SUCCESS)
+			return result;
+
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		const BYTE* position = buffer.data();
+		size_t remaining = buffer.size();
+		while (remaining > 0) {
+			DWORD written = 0;
+			DWORD chunk = static_cast<DWORD>(min(remaining, static_cast<size_t>(MAXDWORD)));
+			if (!WriteFile(h_file, position, chunk, &written, NULL)) {
+				result = LSRESULT(GetLastError(), __FILEW__, __LINE__);
+				CloseHandle(h_file);
+				return result;
+			}
+
+			position += written;
+			remaining -= written;
+		}
+
+		CloseHandle(h_file);
+
+		return LSRESULT();
+	}
+
+	SnapshotReader::SnapshotReader()
+		: _file(INVALID_HANDLE_VALUE), _mapping(NULL), _view(NULL), _data(NULL), _size(0), _header(NULL),
+			_strings(NULL), _strings_size(0), _nodes(NULL), _edge_index(NULL), _edges(NULL), _name_order(NULL),
+			_import_index(NULL), _imports(NULL), _import_count(0), _export_index(NULL), _exports(NULL), _export_count(0) { }
+
+	SnapshotReader::~SnapshotReader()
+	{
+		Close();
+	}
+
+	const LSRESULT SnapshotReader::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		// Empty files can't be mapped.
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_file, &file_size)) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Close();
+			return result;
+		}
+
+		if (static_cast<ULONGLONG>(file_size.QuadPart) < sizeof(LS_SNAPSHOT_HEADER)) {
+			Close();
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a dependency snapshot.", __FILEW__, __LINE__);
+		}
+
+		_mapping = CreateFileMapping(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Close();
+			return result;
+		}
+
+		_view = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (_view == NULL) {
+			LSRESULT result(GetLastError(), __FILEW__, __LINE__);
+			Close();
+			return result;
+		}
+
+		_data = static_cast<const BYTE*>(_view);
+		_size = static_cast<size_t>(file_size.QuadPart);
+
+		LSRESULT result = MapSections();
+		if (result.Result != ERROR_SUCCESS)
+			Close();
+
+		return result;
+	}
+
+	const LSRESULT SnapshotReader::Load(const void* data, size_t size)
+	{
+		Close();
+
+		_data = static_cast<const BYTE*>(data);
+		_size = size;
+
+		LSRESULT result = MapSections();
+		if (result.Result != ERROR_SUCCESS)
+			Close();
+
+		return result;
+	}
+
+	void SnapshotReader::Close() noexcept
+	{
+		if (_view != NULL)
+			UnmapViewOfFile(_view);
+		if (_mapping != NULL)
+			CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE)
+			CloseHandle(_file);
+
+		_file = INVALID_HANDLE_VALUE;
+		_mapping = NULL;
+		_view = NULL;
+		_data = NULL;
+		_size = 0;
+		_header = NULL;
+		_strings = NULL;
+		_strings_size = 0;
+		_nodes = NULL;
+		_edge_index = NULL;
+		_edges = NULL;
+		_name_order = NULL;
+		_import_index = NULL;
+		_imports = NULL;
+		_import_count = 0;
+		_export_index = NULL;
+		_exports = NULL;
+		_export_count = 0;
+	}
+
+	const LS_SNAPSHOT_NODE* SnapshotReader::GetNode(DWORD index) const noexcept
+	{
+		if (_header == NULL || index >= _header->NodeCount)
+			return NULL;
+
+		return _nodes + index;
+	}
+
+	LPCWSTR SnapshotReader::GetString(DWORD offset) const noexcept
+	{
+		// The table ends with a null, so any offset inside it is a terminated string.
+		if (offset % sizeof(WCHAR) != 0 || offset >= _strings_size)
+			return NULL;
+
+		return _strings + (offset / sizeof(WCHAR));
+	}
+
+	bool SnapshotReader::GetEdges(DWORD index, const DWORD*& targets, DWORD& count) const noexcept
+	{
+		if (_header == NULL)
+			return false;
+
+		return GetRange(_edge_index, _edges, _header->EdgeCount, index, targets, count);
+	}
+
+	bool SnapshotReader::GetImports(DWORD index, const DWORD*& symbols, DWORD& count) const noexcept
+	{
+		return GetRange(_import_index, _imports, _import_count, index, symbols, count);
+	}
+
+	bool SnapshotReader::GetExports(DWORD index, const DWORD*& symbols, DWORD& count) const noexcept
+	{
+		return GetRange(_export_index, _exports, _export_count, index, symbols, count);
+	}
+
+	bool SnapshotReader::GetRange(const DWORD* range_index, const DWORD* values, DWORD value_count, DWORD index, const DWORD*& range, DWORD& count) const noexcept
+	{
+		if (_header == NULL || index >= _header->NodeCount)
+			return false;
+
+		// Optional sections that are not there read as empty.
+		if (range_index == NULL) {
+			range = NULL;
+			count = 0;
+			return true;
+		}
+
+		DWORD begin = range_index[index];
+		DWORD end = range_index[index + 1];
+		if (begin > end || end > value_count)
+			return false;
+
+		range = values + begin;
+		count = end - begin;
+
+		return true;
+	}
+
+	bool SnapshotReader::FindNode(const WWuString& module_name, DWORD& index) const
+	{
+		if (_header == NULL)
+			return false;
+
+		WWuString key = module_name.ToLower();
+		DWORD low = 0;
+		DWORD high = _header->NodeCount;
+		while (low < high) {
+			DWORD middle = low + ((high - low) / 2);
+			DWORD candidate = _name_order[middle];
+			if (candidate >= _header->NodeCount)
+				return false;
+
+			LPCWSTR candidate_key = GetString(_nodes[candidate].KeyOffset);
+			int comparison = wcscmp(candidate_key == NULL ? L"" : candidate_key, key.GetBuffer());
+			if (comparison == 0) {
+				index = candidate;
+				return true;
+			}
+
+			if (comparison < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		return false;
+	}
+
+	const LSRESULT SnapshotReader::MapSections()
+	{
+		if (_size < sizeof(LS_SNAPSHOT_HEADER))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a dependency snapshot.", __FILEW__, __LINE__);
+
+		const LS_SNAPSHOT_HEADER* header = reinterpret_cast<const LS_SNAPSHOT_HEADER*>(_data);
+		if (header->Magic != LS_SNAPSHOT_MAGIC)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a dependency snapshot.", __FILEW__, __LINE__);
+
+		if (header->Version != LS_SNAPSHOT_VERSION)
+			return LSRESULT(ERROR_REVISION_MISMATCH, L"Unsupported dependency snapshot version.", __FILEW__, __LINE__);
+
+		ULONGLONG table_end = sizeof(LS_SNAPSHOT_HEADER) + (static_cast<ULONGLONG>(header->SectionCount) * sizeof(LS_SNAPSHOT_SECTION));
+		if (header->FileSize != _size || table_end > _size)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Dependency snapshot is truncated.", __FILEW__, __LINE__);
+
+		ULONGLONG node_count = header->NodeCount;
+		ULONGLONG edge_count = header->EdgeCount;
+		const LS_SNAPSHOT_SECTION* sections = reinterpret_cast<const LS_SNAPSHOT_SECTION*>(_data + sizeof(LS_SNAPSHOT_HEADER));
+		for (WORD i = 0; i < header->SectionCount; i++) {
+			const LS_SNAPSHOT_SECTION& section = sections[i];
+			if (section.Offset % 8 != 0 || section.Offset > _size || section.Size > _size - section.Offset)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Dependency snapshot section out of bounds.", __FILEW__, __LINE__);
+
+			const BYTE* data = _data + section.Offset;
+			switch (section.Kind) {
+				case SnapshotSectionStrings:
+				{
+					const WCHAR* strings = reinterpret_cast<const WCHAR*>(data);
+					size_t length = static_cast<size_t>(section.Size / sizeof(WCHAR));
+					if (section.Size % sizeof(WCHAR) != 0 || length == 0 || strings[length - 1] != L'\0')
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot string table.", __FILEW__, __LINE__);
+
+					_strings = strings;
+					_strings_size = static_cast<size_t>(section.Size);
+				} break;
+
+				case SnapshotSectionNodes:
+					if (section.Size != node_count * sizeof(LS_SNAPSHOT_NODE))
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot node table.", __FILEW__, __LINE__);
+
+					_nodes = reinterpret_cast<const LS_SNAPSHOT_NODE*>(data);
+					break;
+
+				case SnapshotSectionEdgeIndex:
+					if (section.Size != (node_count + 1) * sizeof(DWORD))
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot edge index.", __FILEW__, __LINE__);
+
+					_edge_index = reinterpret_cast<const DWORD*>(data);
+					break;
+
+				case SnapshotSectionEdges:
+					if (section.Size != edge_count * sizeof(DWORD))
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot edge table.", __FILEW__, __LINE__);
+
+					_edges = reinterpret_cast<const DWORD*>(data);
+					break;
+
+				case SnapshotSectionNameOrder:
+					if (section.Size != node_count * sizeof(DWORD))
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot name order.", __FILEW__, __LINE__);
+
+					_name_order = reinterpret_cast<const DWORD*>(data);
+					break;
+
+				case SnapshotSectionImportIndex:
+				case SnapshotSectionExportIndex:
+					if (section.Size != (node_count + 1) * sizeof(DWORD))
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot symbol index.", __FILEW__, __LINE__);
+
+					if (section.Kind == SnapshotSectionImportIndex)
+						_import_index = reinterpret_cast<const DWORD*>(data);
+					else
+						_export_index = reinterpret_cast<const DWORD*>(data);
+					break;
+
+				case SnapshotSectionImports:
+				case SnapshotSectionExports:
+					if (section.Size % sizeof(DWORD) != 0 || section.Size / sizeof(DWORD) > MAXDWORD)
+						return LSRESULT(ERROR_BAD_FORMAT, L"Invalid dependency snapshot symbol table.", __FILEW__, __LINE__);
+
+					if (section.Kind == SnapshotSectionImports) {
+						_imports = reinterpret_cast<const DWORD*>(data);
+						_import_count = static_cast<DWORD>(section.Size / sizeof(DWORD));
+					}
+					else {
+						_exports = reinterpret_cast<const DWORD*>(data);
+						_export_count = static_cast<DWORD>(section.Size / sizeof(DWORD));
+					}
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		// An index without its table is as good as no index.
+		if (_imports == NULL)
+			_import_index = NULL;
+		if (_exports == NULL)
+			_export_index = NULL;
+
+		if (_strings == NULL || _nodes == NULL || _edge_index == NULL || _edges == NULL || _name_order == NULL)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Dependency snapshot is missing sections.", __FILEW__, __LINE__);
+
+		_header = header;
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
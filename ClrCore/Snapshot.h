@@ -0,0 +1,193 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Resolver.h"
+
+namespace LibSnitcher::Core
+{
+	///////////////////////////////////////////////////////////////////////////
+	//
+	//  ~ Dependency snapshot file format.
+	//
+	// ------------------------------------------------------------------------
+	//
+	//  A snapshot is a resolved graph laid out so it can be used straight from
+	//  a mapped view. The file starts with LS_SNAPSHOT_HEADER, followed by
+	//  'SectionCount' LS_SNAPSHOT_SECTION entries. Every section starts at an
+	//  8 byte boundary. Readers ignore sections they don't know.
+	//
+	//  Strings:    UTF-16LE, null terminated, interned. Referenced by byte offset.
+	//  Nodes:      'NodeCount' LS_SNAPSHOT_NODE, in resolution order. Root is zero.
+	//  EdgeIndex:  'NodeCount + 1' DWORDs. The edges of node 'n' are the
+	//              targets from 'EdgeIndex[n]' to 'EdgeIndex[n + 1]' (CSR).
+	//  Edges:      'EdgeCount' DWORD target node indexes.
+	//  NameOrder:  'NodeCount' DWORD node indexes, sorted by key (the lowercase
+	//              name), ordinal. Used for lookups, and for merging snapshots.
+	//  ImportIndex, Imports, ExportIndex, Exports:
+	//              Optional. Per node symbol lists in the same CSR layout as
+	//              the edges, holding string offsets sorted by string, ordinal.
+	//              Imports are 'module!function', exports are 'function'.
+	//              Only meaningful with LS_SNAPSHOT_FLAG_SYMBOLS in the header.
+	//
+	///////////////////////////////////////////////////////////////////////////
+
+	#define LS_SNAPSHOT_MAGIC 0x4E53534C		// 'LSSN'
+	#define LS_SNAPSHOT_VERSION 2
+
+	// Symbols were collected. Without it the symbol lists are empty, or missing.
+	#define LS_SNAPSHOT_FLAG_SYMBOLS 0x1
+
+	#define LS_SNAPSHOT_NODE_FLAG_CLR 0x1
+
+	typedef enum _LS_SNAPSHOT_SECTION_KIND : DWORD
+	{
+		SnapshotSectionStrings = 1,
+		SnapshotSectionNodes,
+		SnapshotSectionEdgeIndex,
+		SnapshotSectionEdges,
+		SnapshotSectionNameOrder,
+		SnapshotSectionImportIndex,
+		SnapshotSectionImports,
+		SnapshotSectionExportIndex,
+		SnapshotSectionExports
+	} LS_SNAPSHOT_SECTION_KIND;
+
+	typedef struct _LS_SNAPSHOT_HEADER
+	{
+		DWORD Magic;
+		WORD Version;
+		WORD SectionCount;
+		DWORD NodeCount;
+		DWORD EdgeCount;
+		DWORD Flags;
+		DWORD Reserved;
+		ULONGLONG FileSize;
+
+	} LS_SNAPSHOT_HEADER, *PLS_SNAPSHOT_HEADER;
+
+	typedef struct _LS_SNAPSHOT_SECTION
+	{
+		DWORD Kind;
+		DWORD Reserved;
+		ULONGLONG Offset;
+		ULONGLONG Size;
+
+	} LS_SNAPSHOT_SECTION, *PLS_SNAPSHOT_SECTION;
+
+	typedef struct _LS_SNAPSHOT_NODE
+	{
+		DWORD NameOffset;
+		DWORD KeyOffset;
+		DWORD PathOffset;
+		DWORD Depth;
+		LONG Result;
+		DWORD Flags;
+		WORD Machine;
+		WORD Magic;
+		WORD Characteristics;
+		WORD Subsystem;
+		DWORD TimeDateStamp;
+		DWORD SizeOfImage;
+		DWORD CheckSum;
+		DWORD Reserved;
+
+	} LS_SNAPSHOT_NODE, *PLS_SNAPSHOT_NODE;
+
+	static_assert(sizeof(LS_SNAPSHOT_HEADER) == 32, "Snapshot header layout changed.");
+	static_assert(sizeof(LS_SNAPSHOT_SECTION) == 24, "Snapshot section layout changed.");
+	static_assert(sizeof(LS_SNAPSHOT_NODE) == 48, "Snapshot node layout changed.");
+
+	// Interned strings. The same string is always stored once. Also used by the chain buffer.
+	class SnapshotStringTable
+	{
+	public:
+		DWORD Intern(const WWuString& str)
+		{
+			auto existing = _offsets.find(str);
+			if (existing != _offsets.end())
+				return existing->second;
+
+			DWORD offset = Size();
+			const WCHAR* buffer = str.GetBuffer();
+			_strings.insert(_strings.end(), buffer, buffer + str.Length() + 1);
+			_offsets.emplace(str, offset);
+
+			return offset;
+		}
+
+		_NODISCARD DWORD Size() const noexcept { return static_cast<DWORD>(_strings.size() * sizeof(WCHAR)); }
+		_NODISCARD const WCHAR* Data() const noexcept { return _strings.data(); }
+		_NODISCARD const WCHAR* At(DWORD offset) const noexcept { return _strings.data() + (offset / sizeof(WCHAR)); }
+
+	private:
+		wuvector<WCHAR> _strings;
+		wumap<WWuString, DWORD> _offsets;
+	};
+
+	class SnapshotWriter
+	{
+	public:
+		static const LSRESULT Serialize(const LS_RESOLVED_GRAPH& graph, wuvector<BYTE>& buffer);
+		static const LSRESULT Write(const LS_RESOLVED_GRAPH& graph, const WWuString& file_path);
+	};
+
+	// Reads a snapshot in place. Opening only validates the header, and the
+	// section table, so it takes the same time regardless of the snapshot size.
+	// Accessors check their own bounds, and return NULL, or false when out of range.
+	class SnapshotReader
+	{
+	public:
+		SnapshotReader();
+		~SnapshotReader();
+
+		// Maps the file read-only.
+		const LSRESULT Open(const WWuString& file_path);
+
+		// Uses a buffer owned by the caller. It must outlive the reader.
+		const LSRESULT Load(const void* data, size_t size);
+		void Close() noexcept;
+
+		_NODISCARD DWORD NodeCount() const noexcept { return _header == NULL ? 0 : _header->NodeCount; }
+		_NODISCARD DWORD EdgeCount() const noexcept { return _header == NULL ? 0 : _header->EdgeCount; }
+		_NODISCARD const LS_SNAPSHOT_NODE* GetNode(DWORD index) const noexcept;
+		_NODISCARD LPCWSTR GetString(DWORD offset) const noexcept;
+		_NODISCARD const DWORD* GetNameOrder() const noexcept { return _name_order; }
+		bool GetEdges(DWORD index, const DWORD*& targets, DWORD& count) const noexcept;
+
+		// False when the snapshot was written without symbols, as opposed to modules without any.
+		_NODISCARD bool HasSymbols() const noexcept { return _header != NULL && (_header->Flags & LS_SNAPSHOT_FLAG_SYMBOLS) != 0; }
+
+		// Symbols are string offsets. Snapshots written without symbols have empty lists.
+		bool GetImports(DWORD index, const DWORD*& symbols, DWORD& count) const noexcept;
+		bool GetExports(DWORD index, const DWORD*& symbols, DWORD& count) const noexcept;
+
+		// Binary search over the name order.
+		bool FindNode(const WWuString& module_name, DWORD& index) const;
+
+	private:
+		HANDLE _file;
+		HANDLE _mapping;
+		LPVOID _view;
+		const BYTE* _data;
+		size_t _size;
+		const LS_SNAPSHOT_HEADER* _header;
+		const WCHAR* _strings;
+		size_t _strings_size;
+		const LS_SNAPSHOT_NODE* _nodes;
+		const DWORD* _edge_index;
+		const DWORD* _edges;
+		const DWORD* _name_order;
+		const DWORD* _import_index;
+		const DWORD* _imports;
+		DWORD _import_count;
+		const DWORD* _export_index;
+		const DWORD* _exports;
+		DWORD _export_count;
+
+		const LSRESULT MapSections();
+		bool GetRange(const DWORD* range_index, const DWORD* values, DWORD value_count, DWORD index, const DWORD*& range, DWORD& count) const noexcept;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "pch.h"
+
+#include "SnapshotDiff.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	static constexpr DWORD NoNode = MAXDWORD;
+
+	// A module name present in either snapshot, or both.
+	typedef struct _LS_DIFF_SLOT
+	{
+		DWORD Reference;
+		DWORD Difference;
+
+	} LS_DIFF_SLOT, *PLS_DIFF_SLOT;
+
+	static LPCWSTR GetNodeString(const SnapshotReader& reader, DWORD index, bool key) noexcept
+	{
+		const LS_SNAPSHOT_NODE* node = reader.GetNode(index);
+		LPCWSTR str = node == NULL ? NULL : reader.GetString(key ? node->KeyOffset : node->NameOffset);
+
+		return str == NULL ? L"" : str;
+	}
+
+	static DWORD CompareHeaders(const SnapshotReader& reference, DWORD reference_index, const SnapshotReader& difference, DWORD difference_index) noexcept
+	{
+		const LS_SNAPSHOT_NODE* left = reference.GetNode(reference_index);
+		const LS_SNAPSHOT_NODE* right = difference.GetNode(difference_index);
+		LPCWSTR left_path = reference.GetString(left->PathOffset);
+		LPCWSTR right_path = difference.GetString(right->PathOffset);
+
+		DWORD fields = 0;
+		if (_wcsicmp(left_path == NULL ? L"" : left_path, right_path == NULL ? L"" : right_path) != 0)
+			fields |= LS_DIFF_FIELD_PATH;
+		if (left->Result != right->Result)
+			fields |= LS_DIFF_FIELD_RESULT;
+		if (left->Machine != right->Machine)
+			fields |= LS_DIFF_FIELD_MACHINE;
+		if (left->Magic != right->Magic)
+			fields |= LS_DIFF_FIELD_MAGIC;
+		if (left->Characteristics != right->Characteristics)
+			fields |= LS_DIFF_FIELD_CHARACTERISTICS;
+		if (left->Subsystem != right->Subsystem)
+			fields |= LS_DIFF_FIELD_SUBSYSTEM;
+		if (left->TimeDateStamp != right->TimeDateStamp)
+			fields |= LS_DIFF_FIELD_TIMESTAMP;
+		if (left->SizeOfImage != right->SizeOfImage)
+			fields |= LS_DIFF_FIELD_SIZE_OF_IMAGE;
+		if (left->CheckSum != right->CheckSum)
+			fields |= LS_DIFF_FIELD_CHECKSUM;
+		if (left->Flags != right->Flags)
+			fields |= LS_DIFF_FIELD_FLAGS;
+
+		return fields;
+	}
+
+	// Translates a node's edges to slots, so both snapshots speak the same numbers.
+	static void GetSlotTargets(const SnapshotReader& reader, DWORD index, const wuvector<DWORD>& slot_of, wuvector<DWORD>& targets)
+	{
+		targets.clear();
+		if (index == NoNode)
+			return;
+
+		const DWORD* edges = NULL;
+		DWORD count = 0;
+		if (!reader.GetEdges(index, edges, count))
+			return;
+
+		for (DWORD i = 0; i < count; i++) {
+			if (edges[i] < slot_of.size() && slot_of[edges[i]] != NoNode)
+				targets.push_back(slot_of[edges[i]]);
+		}
+
+		std::sort(targets.begin(), targets.end());
+		targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+	}
+
+	static void PushEntry(wuvector<LS_DIFF_ENTRY>& entries, LS_DIFF_KIND kind, const WWuString& module_name, LPCWSTR target, DWORD fields = 0)
+	{
+		LS_DIFF_ENTRY entry;
+		entry.Kind = kind;
+		entry.Module = module_name;
+		if (target != NULL)
+			entry.Target = target;
+
+		entry.Fields = fields;
+		entries.push_back(entry);
+	}
+
+	static void MergeSymbols(const SnapshotReader& reference, DWORD reference_index, const SnapshotReader& difference, DWORD difference_index,
+		bool imports, const WWuString& module_name, wuvector<LS_DIFF_ENTRY>& entries)
+	{
+		const DWORD* left = NULL;
+		const DWORD* right = NULL;
+		DWORD left_count = 0;
+		DWORD right_count = 0;
+		bool left_ok = imports ? reference.GetImports(reference_index, left, left_count) : reference.GetExports(reference_index, left, left_count);
+		bool right_ok = imports ? difference.GetImports(difference_index, right, right_count) : difference.GetExports(difference_index, right, right_count);
+		if (!left_ok || !right_ok)
+			return;
+
+		LS_DIFF_KIND added = imports ? DiffImportAdded : DiffExportAdded;
+		LS_DIFF_KIND removed = imports ? DiffImportRemoved : DiffExportRemoved;
+		DWORD i = 0;
+		DWORD j = 0;
+		while (i < left_count || j < right_count) {
+			LPCWSTR left_symbol = i < left_count ? reference.GetString(left[i]) : NULL;
+			LPCWSTR right_symbol = j < right_count ? difference.GetString(right[j]) : NULL;
+			int comparison = left_symbol == NULL ? 1 : right_symbol == NULL ? -1 : wcscmp(left_symbol, right_symbol);
+			if (i < left_count && comparison < 0) {
+				PushEntry(entries, removed, module_name, left_symbol);
+				i++;
+			}
+			else if (j < right_count && comparison > 0) {
+				PushEntry(entries, added, module_name, right_symbol);
+				j++;
+			}
+			else {
+				i++;
+				j++;
+			}
+		}
+	}
+
+	const LSRESULT SnapshotDiff::Compare(const SnapshotReader& reference, const SnapshotReader& difference, wuvector<LS_DIFF_ENTRY>& entries)
+	{
+		const DWORD* reference_order = reference.GetNameOrder();
+		const DWORD* difference_order = difference.GetNameOrder();
+		if (reference_order == NULL || difference_order == NULL)
+			return LSRESULT(ERROR_INVALID_PARAMETER, L"Snapshot is not open.", __FILEW__, __LINE__);
+
+		// Merging the name orders.
+		DWORD reference_count = reference.NodeCount();
+		DWORD difference_count = difference.NodeCount();
+		wuvector<LS_DIFF_SLOT> slots;
+		wuvector<DWORD> reference_slot(reference_count, NoNode);
+		wuvector<DWORD> difference_slot(difference_count, NoNode);
+		slots.reserve(static_cast<size_t>(reference_count) + difference_count);
+
+		DWORD i = 0;
+		DWORD j = 0;
+		while (i < reference_count || j < difference_count) {
+			DWORD left = i < reference_count ? reference_order[i] : NoNode;
+			DWORD right = j < difference_count ? difference_order[j] : NoNode;
+			if ((left != NoNode && left >= reference_count) || (right != NoNode && right >= difference_count))
+				return LSRESULT(ERROR_BAD_FORMAT, L"Snapshot name order references a node out of range.", __FILEW__, __LINE__);
+
+			int comparison = left == NoNode ? 1 : right == NoNode ? -1 : wcscmp(GetNodeString(reference, left, true), GetNodeString(difference, right, true));
+			DWORD slot = static_cast<DWORD>(slots.size());
+			if (comparison < 0) {
+				slots.push_back({ left, NoNode });
+				reference_slot[left] = slot;
+				i++;
+			}
+			else if (comparison > 0) {
+				slots.push_back({ NoNode, right });
+				difference_slot[right] = slot;
+				j++;
+			}
+			else {
+				slots.push_back({ left, right });
+				reference_slot[left] = slot;
+				difference_slot[right] = slot;
+				i++;
+				j++;
+			}
+		}
+
+		auto slot_name = [&](DWORD slot) -> LPCWSTR {
+			const LS_DIFF_SLOT& current = slots[slot];
+			return current.Difference != NoNode ? GetNodeString(difference, current.Difference, false) : GetNodeString(reference, current.Reference, false);
+		};
+
+		bool compare_symbols = reference.HasSymbols() && difference.HasSymbols();
+
+		// Walking the slots in name order. Edge lists are merged by slot number.
+		wuvector<DWORD> reference_targets;
+		wuvector<DWORD> difference_targets;
+		for (DWORD slot = 0; slot < slots.size(); slot++) {
+			const LS_DIFF_SLOT& current = slots[slot];
+			WWuString module_name(slot_name(slot));
+
+			if (current.Reference == NoNode)
+				PushEntry(entries, DiffModuleAdded, module_name, NULL);
+			else if (current.Difference == NoNode)
+				PushEntry(entries, DiffModuleRemoved, module_name, NULL);
+			else {
+				DWORD fields = CompareHeaders(reference, current.Reference, difference, current.Difference);
+				if (fields != 0)
+					PushEntry(entries, DiffHeaderChanged, module_name, NULL, fields);
+			}
+
+			GetSlotTargets(reference, current.Reference, reference_slot, reference_targets);
+			GetSlotTargets(difference, current.Difference, difference_slot, difference_targets);
+			size_t left = 0;
+			size_t right = 0;
+			while (left < reference_targets.size() || right < difference_targets.size()) {
+				DWORD left_target = left < reference_targets.size() ? reference_targets[left] : NoNode;
+				DWORD right_target = right < difference_targets.size() ? difference_targets[right] : NoNode;
+				if (left_target < right_target) {
+					PushEntry(entries, DiffEdgeRemoved, module_name, slot_name(left_target));
+					left++;
+				}
+				else if (right_target < left_target) {
+					PushEntry(entries, DiffEdgeAdded, module_name, slot_name(right_target));
+					right++;
+				}
+				else {
+					left++;
+					right++;
+				}
+			}
+
+			// Symbols are compared for modules in both snapshots only. If either side was written
+			// without symbols every one of them would show as added, or removed.
+			if (compare_symbols && current.Reference != NoNode && current.Difference != NoNode) {
+				MergeSymbols(reference, current.Reference, difference, current.Difference, true, module_name, entries);
+				MergeSymbols(reference, current.Reference, difference, current.Difference, false, module_name, entries);
+			}
+		}
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Snapshot.h"
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_DIFF_KIND
+	{
+		DiffModuleAdded,
+		DiffModuleRemoved,
+		DiffEdgeAdded,
+		DiffEdgeRemoved,
+		DiffImportAdded,
+		DiffImportRemoved,
+		DiffExportAdded,
+		DiffExportRemoved,
+		DiffHeaderChanged
+	} LS_DIFF_KIND;
+
+	#define LS_DIFF_FIELD_PATH				0x0001
+	#define LS_DIFF_FIELD_RESULT			0x0002
+	#define LS_DIFF_FIELD_MACHINE			0x0004
+	#define LS_DIFF_FIELD_MAGIC				0x0008
+	#define LS_DIFF_FIELD_CHARACTERISTICS	0x0010
+	#define LS_DIFF_FIELD_SUBSYSTEM			0x0020
+	#define LS_DIFF_FIELD_TIMESTAMP			0x0040
+	#define LS_DIFF_FIELD_SIZE_OF_IMAGE		0x0080
+	#define LS_DIFF_FIELD_CHECKSUM			0x0100
+	#define LS_DIFF_FIELD_FLAGS				0x0200
+
+	typedef struct _LS_DIFF_ENTRY
+	{
+		LS_DIFF_KIND Kind;
+		WWuString Module;
+
+		// The dependency for edges, the symbol for imports, and exports.
+		WWuString Target;
+
+		// LS_DIFF_FIELD_* for header changes.
+		DWORD Fields;
+
+		_LS_DIFF_ENTRY()
+			: Kind(DiffModuleAdded), Fields(0) { }
+
+		~_LS_DIFF_ENTRY() { }
+
+	} LS_DIFF_ENTRY, *PLS_DIFF_ENTRY;
+
+	// Compares two snapshots, matching modules by name, case insensitive.
+	// Both name orders are merged in one pass, and the edge, and symbol lists
+	// of each module are merged the same way, so the cost is linear on the size
+	// of both snapshots, plus sorting each module's edges.
+	// Symbols are only compared when both snapshots have them.
+	// Entries come out ordered by module name.
+	class SnapshotDiff
+	{
+	public:
+		static const LSRESULT Compare(const SnapshotReader& reference, const SnapshotReader& difference, wuvector<LS_DIFF_ENTRY>& entries);
+	};
+}
\ No newline at end of file
@@ -52,6 +52,11 @@ struct _WChar_traits_ex : std::_WChar_traits<_char_type>
     _NODISCARD static inline const _char_type* findstr(const _char_type* first, const _char_type* second) {
         return wcsstr(reinterpret_cast<const wchar_t*>(first), reinterpret_cast<const wchar_t*>(second));
     }
+
+    static inline void lowercase(_char_type* buffer, const size_t count) noexcept {
+        for (size_t i = 0; i < count; i++)
+            buffer[i] = static_cast<_char_type>(towlower(static_cast<wint_t>(buffer[i])));
+    }
 };
 
 template <class _char_type, class _int_type>
@@ -78,6 +83,11 @@ struct _Narrow_char_traits_ex : std::_Narrow_char_traits<_char_type, _int_type>
     _NODISCARD static inline const _char_type* findstr(const _char_type* first, const _char_type* second) {
         return strstr(reinterpret_cast<const char*>(first), reinterpret_cast<const char*>(second));
     }
+
+    static inline void lowercase(_char_type* buffer, const size_t count) noexcept {
+        for (size_t i = 0; i < count; i++)
+            buffer[i] = static_cast<_char_type>(tolower(static_cast<unsigned char>(buffer[i])));
+    }
 };
 
 template <class _char_type>
@@ -381,6 +391,14 @@ public:
         return _traits::compare(_buffer + this->Length() - input_len, str._buffer, input_len) == 0;
     }
 
+    // Returns a lowercase copy. Useful for case-insensitive keys, like file names.
+    _NODISCARD inline WuBaseString ToLower() const {
+        WuBaseString output(*this);
+        _traits::lowercase(output._buffer, output.Length());
+
+        return output;
+    }
+
     inline _char_type operator[](const size_t index) {
         if (index < 0 && index > _char_count)
             throw "Index outside the boundaries of this string.";
@@ -588,6 +606,9 @@ _NODISCARD static WWuString WuStringToWide(const WuString& other) {
     mbsrtowcs_s(&converted_count, new_buffer, other_size + 2, &buffer, other_size, &state);
 
     WWuString result(new_buffer);
+    allocator->deallocate(new_buffer);
+    delete allocator;
+
     return result;
 }
 
@@ -600,5 +621,8 @@ _NODISCARD static WuString WWuStringToNarrow(const WWuString& other) {
     wcstombs_s(&converted_count, new_buffer, other_count + 1, other.GetBuffer(), other_count);
 
     WuString result(new_buffer);
+    allocator->deallocate(new_buffer);
+    delete allocator;
+
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "pch.h"
+
+#include "StringScanner.h"
+
+#include <algorithm>
+#include <immintrin.h>
+
+namespace LibSnitcher::Core
+{
+	// Not in every SDK version.
+	#ifndef PF_AVX2_INSTRUCTIONS_AVAILABLE
+	#define PF_AVX2_INSTRUCTIONS_AVAILABLE 40
+	#endif
+
+	// Longer runs are not file names.
+	static constexpr size_t MaxNameLength = MAX_PATH;
+
+	// Read once. Function statics aren't initialized thread-safely under /clr, and scans run on several threads.
+	static bool HasAvx2 = false;
+	static bool HasSse2 = false;
+	static INIT_ONCE CpuFeaturesOnce = INIT_ONCE_STATIC_INIT;
+
+	static BOOL CALLBACK ReadCpuFeatures(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+	{
+		UNREFERENCED_PARAMETER(init_once);
+		UNREFERENCED_PARAMETER(parameter);
+		UNREFERENCED_PARAMETER(context);
+
+		HasAvx2 = IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE) != FALSE;
+		HasSse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != FALSE;
+
+		return TRUE;
+	}
+
+	// File name characters we accept. Path separators, and spaces end a name.
+	static inline bool IsNameChar(BYTE value) noexcept
+	{
+		return (value >= 'a' && value <= 'z') || (value >= 'A' && value <= 'Z') || (value >= '0' && value <= '9')
+			|| value == '_' || value == '-' || value == '.' || value == '$' || value == '~' || value == '+';
+	}
+
+	static inline BYTE ToLowerAscii(BYTE value) noexcept
+	{
+		return (value >= 'A' && value <= 'Z') ? value + ('a' - 'A') : value;
+	}
+
+	static inline bool IsModuleExtension(BYTE first, BYTE second, BYTE third) noexcept
+	{
+		DWORD extension = (ToLowerAscii(first) << 16) | (ToLowerAscii(second) << 8) | ToLowerAscii(third);
+		switch (extension) {
+			case ('d' << 16) | ('l' << 8) | 'l':
+			case ('e' << 16) | ('x' << 8) | 'e':
+			case ('s' << 16) | ('y' << 8) | 's':
+			case ('d' << 16) | ('r' << 8) | 'v':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void ModuleNameScanner::ScanImage(HMODULE hmodule, const PeHelper::LS_IMAGE_BASIC_INFORMATION* basic_info, wuvector<WuString>& names)
+	{
+		names.clear();
+
+		const BYTE* base = reinterpret_cast<const BYTE*>(hmodule);
+		const IMAGE_DOS_HEADER* dos_header = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+		const IMAGE_NT_HEADERS32* nt_headers = reinterpret_cast<const IMAGE_NT_HEADERS32*>(base + dos_header->e_lfanew);
+		const IMAGE_SECTION_HEADER* sections = reinterpret_cast<const IMAGE_SECTION_HEADER*>(
+			reinterpret_cast<const BYTE*>(&nt_headers->OptionalHeader) + nt_headers->FileHeader.SizeOfOptionalHeader);
+
+		// Read-only initialized data. '.rdata', and the like.
+		DWORD size_of_image = basic_info->SizeOfImage;
+		for (WORD i = 0; i < nt_headers->FileHeader.NumberOfSections; i++) {
+			DWORD characteristics = sections[i].Characteristics;
+			if ((characteristics & IMAGE_SCN_CNT_INITIALIZED_DATA) == 0 || (characteristics & IMAGE_SCN_MEM_READ) == 0
+				|| (characteristics & (IMAGE_SCN_MEM_WRITE | IMAGE_SCN_MEM_EXECUTE)) != 0)
+				continue;
+
+			DWORD rva = sections[i].VirtualAddress;
+			DWORD size = sections[i].Misc.VirtualSize != 0 ? sections[i].Misc.VirtualSize : sections[i].SizeOfRawData;
+			if (rva >= size_of_image)
+				continue;
+
+			Scan(base + rva, min(size, size_of_image - rva), names);
+		}
+
+		std::sort(names.begin(), names.end());
+		names.erase(std::unique(names.begin(), names.end()), names.end());
+
+		// Leaving out the static imports, and the image's own export name.
+		wuvector<WuString> excluded;
+		excluded.reserve(basic_info->Dependencies.size() + 1);
+		for (const WuString& dependency : basic_info->Dependencies)
+			excluded.push_back(dependency.ToLower());
+
+		if (basic_info->ExportTableRva != 0 && static_cast<ULONGLONG>(basic_info->ExportTableRva) + sizeof(IMAGE_EXPORT_DIRECTORY) <= size_of_image) {
+			DWORD name_rva = reinterpret_cast<const IMAGE_EXPORT_DIRECTORY*>(base + basic_info->ExportTableRva)->Name;
+			if (name_rva != 0 && name_rva < size_of_image)
+				excluded.push_back(WuString(reinterpret_cast<const char*>(base + name_rva)).ToLower());
+		}
+
+		std::sort(excluded.begin(), excluded.end());
+		names.erase(std::remove_if(names.begin(), names.end(), [&excluded](const WuString& name) {
+			return std::binary_search(excluded.begin(), excluded.end(), name);
+		}), names.end());
+	}
+
+	void ModuleNameScanner::Scan(const BYTE* data, size_t size, wuvector<WuString>& names)
+	{
+		InitOnceExecuteOnce(&CpuFeaturesOnce, ReadCpuFeatures, NULL, NULL);
+
+		if (HasAvx2)
+			ScanAvx2(data, size, names);
+		else if (HasSse2)
+			ScanSse2(data, size, names);
+		else
+			ScanScalar(data, size, 0, names);
+	}
+
+	void ModuleNameScanner::ScanScalar(const BYTE* data, size_t size, size_t start, wuvector<WuString>& names)
+	{
+		for (size_t position = start; position < size; position++) {
+			if (data[position] == '.')
+				CheckCandidate(data, size, position, names);
+		}
+	}
+
+	void ModuleNameScanner::ScanSse2(const BYTE* data, size_t size, wuvector<WuString>& names)
+	{
+		const __m128i dot = _mm_set1_epi8('.');
+
+		size_t position = 0;
+		for (; position + sizeof(__m128i) <= size; position += sizeof(__m128i)) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+			unsigned long mask = static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, dot)));
+			while (mask != 0) {
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				CheckCandidate(data, size, position + bit, names);
+				mask &= mask - 1;
+			}
+		}
+
+		ScanScalar(data, size, position, names);
+	}
+
+	void ModuleNameScanner::ScanAvx2(const BYTE* data, size_t size, wuvector<WuString>& names)
+	{
+		const __m256i dot = _mm256_set1_epi8('.');
+
+		size_t position = 0;
+		for (; position + sizeof(__m256i) <= size; position += sizeof(__m256i)) {
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+			unsigned long mask = static_cast<unsigned long>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, dot)));
+			while (mask != 0) {
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				CheckCandidate(data, size, position + bit, names);
+				mask &= mask - 1;
+			}
+		}
+
+		ScanScalar(data, size, position, names);
+	}
+
+	void ModuleNameScanner::CheckCandidate(const BYTE* data, size_t size, size_t dot, wuvector<WuString>& names)
+	{
+		char name[MaxNameLength + 5];
+		size_t length = 0;
+		if (dot + 1 < size && data[dot + 1] != 0) {
+			// ASCII. The extension can't run into more name characters, like in '.dll.mui'.
+			if (dot + 3 >= size || !IsModuleExtension(data[dot + 1], data[dot + 2], data[dot + 3]))
+				return;
+
+			if (dot + 4 < size && IsNameChar(data[dot + 4]))
+				return;
+
+			size_t start = dot;
+			while (start > 0 && dot - start < MaxNameLength && IsNameChar(data[start - 1]))
+				start--;
+
+			while (start < dot && data[start] == '.')
+				start++;
+
+			if (start == dot)
+				return;
+
+			for (size_t i = start; i < dot + 4; i++)
+				name[length++] = static_cast<char>(ToLowerAscii(data[i]));
+		}
+		else {
+			// UTF-16LE. Every other byte is zero.
+			if (dot + 7 >= size || data[dot + 3] != 0 || data[dot + 5] != 0 || data[dot + 7] != 0)
+				return;
+
+			if (!IsModuleExtension(data[dot + 2], data[dot + 4], data[dot + 6]))
+				return;
+
+			if (dot + 9 < size && data[dot + 9] == 0 && IsNameChar(data[dot + 8]))
+				return;
+
+			size_t start = dot;
+			while (start >= 2 && (dot - start) / 2 < MaxNameLength && data[start - 1] == 0 && IsNameChar(data[start - 2]))
+				start -= 2;
+
+			while (start < dot && data[start] == '.')
+				start += 2;
+
+			if (start == dot)
+				return;
+
+			for (size_t i = start; i < dot + 8; i += 2)
+				name[length++] = static_cast<char>(ToLowerAscii(data[i]));
+		}
+
+		name[length] = '\0';
+		names.push_back(WuString(name));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "PeHelper.h"
+
+namespace LibSnitcher::Core
+{
+	// Finds module names in the read-only data of an image. Modules loaded with 'LoadLibrary'
+	// are not in the import tables, but their names usually are in '.rdata', as ASCII, or
+	// UTF-16LE strings. This is a heuristic, names found might never be loaded.
+	//
+	// The kernel looks for '.' 32, or 16 bytes at a time with AVX2, or SSE2, and only the
+	// candidates are checked for a '.dll', '.exe', '.sys', or '.drv' extension, and walked
+	// back to the start of the name. The tail, and processors without SSE2 go scalar.
+	class ModuleNameScanner
+	{
+	public:
+		// 'hmodule' is mapped as an image. Names the image imports statically are left out.
+		// Names are lowercase, file names only, without duplicates.
+		static void ScanImage(HMODULE hmodule, const PeHelper::LS_IMAGE_BASIC_INFORMATION* basic_info, wuvector<WuString>& names);
+
+		// Appends every name in 'data'. Duplicates are kept.
+		static void Scan(const BYTE* data, size_t size, wuvector<WuString>& names);
+
+		static void ScanScalar(const BYTE* data, size_t size, size_t start, wuvector<WuString>& names);
+		static void ScanSse2(const BYTE* data, size_t size, wuvector<WuString>& names);
+		static void ScanAvx2(const BYTE* data, size_t size, wuvector<WuString>& names);
+
+	private:
+		// Checks the candidate at 'dot', as ASCII, or UTF-16LE if the next byte is zero.
+		static void CheckCandidate(const BYTE* data, size_t size, size_t dot, wuvector<WuString>& names);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "pch.h"
+
+#include "SxsIndex.h"
+
+namespace LibSnitcher::Core
+{
+	size_t LS_WSTRING_HASH::operator()(const WWuString& key) const noexcept
+	{
+		ULONGLONG hash = 14695981039346656037ULL;
+		const WCHAR* buffer = key.GetBuffer();
+		for (size_t i = 0; i < key.Length(); i++) {
+			hash ^= buffer[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return static_cast<size_t>(hash);
+	}
+
+	SxsStoreIndex::SxsStoreIndex(const WWuString& sysroot)
+		: _built(false), _sysroot(sysroot)
+	{
+		InitializeSRWLock(&_lock);
+		PathCchRemoveBackslash(_sysroot.GetBuffer(), _sysroot.Length() + 1);
+	}
+
+	SxsStoreIndex::~SxsStoreIndex() { }
+
+	bool SxsStoreIndex::Find(const LS_ASSEMBLY_IDENTITY& identity, LS_SXS_ASSEMBLY& assembly)
+	{
+		EnsureBuilt();
+
+		bool found = false;
+		AcquireSRWLockShared(&_lock);
+		auto exact = _assemblies.find(GetKey(identity, true));
+		if (exact != _assemblies.end()) {
+			assembly = exact->second;
+			found = true;
+		}
+		else {
+			auto latest = _latest.find(GetKey(identity, false));
+			if (latest != _latest.end() && latest->second.VersionNumber >= ParseVersion(identity.Version)) {
+				assembly = latest->second;
+				found = true;
+			}
+		}
+		ReleaseSRWLockShared(&_lock);
+
+		return found;
+	}
+
+	bool SxsStoreIndex::FindModule(const WWuString& module_name, const wuvector<LS_ASSEMBLY_IDENTITY>& context, WWuString& module_path)
+	{
+		for (const LS_ASSEMBLY_IDENTITY& identity : context) {
+			LS_SXS_ASSEMBLY assembly;
+			if (!Find(identity, assembly))
+				continue;
+
+			WWuString candidate = assembly.Directory + L"\\" + module_name;
+			if (PathFileExists(candidate.GetBuffer())) {
+				module_path = candidate;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	size_t SxsStoreIndex::Count()
+	{
+		EnsureBuilt();
+
+		AcquireSRWLockShared(&_lock);
+		size_t count = _assemblies.size();
+		ReleaseSRWLockShared(&_lock);
+
+		return count;
+	}
+
+	WWuString SxsStoreIndex::GetDefaultSysroot()
+	{
+		WCHAR windows_dir[MAX_PATH]{ 0 };
+		GetWindowsDirectory(windows_dir, MAX_PATH);
+
+		return WWuString(windows_dir);
+	}
+
+	ULONGLONG SxsStoreIndex::ParseVersion(const WWuString& version) noexcept
+	{
+		ULONGLONG number = 0;
+		ULONGLONG part = 0;
+		int part_count = 0;
+		const WCHAR* buffer = version.GetBuffer();
+		for (size_t i = 0; i <= version.Length() && part_count < 4; i++) {
+			if (i == version.Length() || buffer[i] == L'.') {
+				number = (number << 16) | (part & 0xFFFF);
+				part = 0;
+				part_count++;
+			}
+			else if (buffer[i] >= L'0' && buffer[i] <= L'9')
+				part = part * 10 + (buffer[i] - L'0');
+		}
+
+		// '1.0' is '1.0.0.0'.
+		for (; part_count < 4; part_count++)
+			number <<= 16;
+
+		return number;
+	}
+
+	void SxsStoreIndex::EnsureBuilt()
+	{
+		AcquireSRWLockShared(&_lock);
+		bool built = _built;
+		ReleaseSRWLockShared(&_lock);
+		if (built)
+			return;
+
+		AcquireSRWLockExclusive(&_lock);
+		if (!_built) {
+			WWuString store = _sysroot + L"\\WinSxS";
+			WWuString filter = store + L"\\Manifests\\*.manifest";
+			WIN32_FIND_DATA find_data;
+			HANDLE h_find = FindFirstFileEx(filter.GetBuffer(), FindExInfoBasic, &find_data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+			if (h_find != INVALID_HANDLE_VALUE) {
+				do {
+					if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+						continue;
+
+					WWuString stem(find_data.cFileName);
+					PathCchRemoveExtension(stem.GetBuffer(), stem.Length() + 1);
+					stem = WWuString(stem.GetBuffer()).ToLower();
+
+					LS_ASSEMBLY_IDENTITY identity;
+					if (!ParseStem(stem, identity))
+						continue;
+
+					// Long names are shortened in the file name. The full name is in the manifest.
+					if (identity.Name.Contains(L"..")) {
+						WWuString manifest_path = store + L"\\Manifests\\" + find_data.cFileName;
+						if (!ReadManifestIdentity(manifest_path, identity))
+							continue;
+					}
+
+					Add(identity, store + L"\\" + stem);
+
+				} while (FindNextFile(h_find, &find_data));
+
+				FindClose(h_find);
+			}
+
+			_built = true;
+		}
+		ReleaseSRWLockExclusive(&_lock);
+	}
+
+	void SxsStoreIndex::Add(const LS_ASSEMBLY_IDENTITY& identity, const WWuString& directory)
+	{
+		LS_SXS_ASSEMBLY assembly;
+		assembly.Directory = directory;
+		assembly.Version = identity.Version;
+		assembly.VersionNumber = ParseVersion(identity.Version);
+
+		_assemblies.emplace(GetKey(identity, true), assembly);
+
+		auto latest = _latest.emplace(GetKey(identity, false), assembly);
+		if (!latest.second && latest.first->second.VersionNumber < assembly.VersionNumber)
+			latest.first->second = assembly;
+	}
+
+	bool SxsStoreIndex::ParseStem(const WWuString& stem, LS_ASSEMBLY_IDENTITY& identity)
+	{
+		// 'arch_name_publickeytoken_version_language_hash'. Names can have underscores, the other fields can't.
+		wuvector<size_t> separators;
+		const WCHAR* buffer = stem.GetBuffer();
+		for (size_t i = 0; i < stem.Length(); i++) {
+			if (buffer[i] == L'_')
+				separators.push_back(i);
+		}
+
+		if (separators.size() < 5)
+			return false;
+
+		auto field = [buffer](size_t begin, size_t end) -> WWuString {
+			wuvector<WCHAR> value(buffer + begin, buffer + end);
+			value.push_back(L'\0');
+
+			return WWuString(value.data());
+		};
+
+		size_t count = separators.size();
+		identity.ProcessorArchitecture = field(0, separators[0]);
+		identity.Name = field(separators[0] + 1, separators[count - 4]);
+		identity.PublicKeyToken = field(separators[count - 4] + 1, separators[count - 3]);
+		identity.Version = field(separators[count - 3] + 1, separators[count - 2]);
+		identity.Language = field(separators[count - 2] + 1, separators[count - 1]);
+
+		return identity.Name.Length() > 0;
+	}
+
+	bool SxsStoreIndex::ReadManifestIdentity(const WWuString& manifest_path, LS_ASSEMBLY_IDENTITY& identity)
+	{
+		HANDLE h_file = CreateFile(manifest_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		// Manifests are small. Anything bigger than this is not one.
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(h_file, &file_size) || file_size.QuadPart == 0 || file_size.QuadPart > 0x100000) {
+			CloseHandle(h_file);
+			return false;
+		}
+
+		DWORD bytes_read;
+		wuvector<char> content(static_cast<size_t>(file_size.QuadPart));
+		BOOL read = ReadFile(h_file, content.data(), static_cast<DWORD>(content.size()), &bytes_read, NULL);
+		CloseHandle(h_file);
+		if (!read)
+			return false;
+
+		// Newer systems store manifests delta compressed ('DCM' header). We don't decompress those.
+		const char* data = content.data();
+		size_t size = bytes_read;
+		if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+			data += 3;
+			size -= 3;
+		}
+
+		if (size == 0 || *data != '<')
+			return false;
+
+		LS_MANIFEST_INFO manifest;
+		if (!ManifestParser::Parse(data, size, manifest) || manifest.Identity.Name.Length() == 0)
+			return false;
+
+		// The version, and the rest of the key, stay the ones from the directory name.
+		identity.Name = manifest.Identity.Name;
+
+		return true;
+	}
+
+	WWuString SxsStoreIndex::GetKey(const LS_ASSEMBLY_IDENTITY& identity, bool with_version)
+	{
+		// Unsigned assemblies have 'none' as the token in the store.
+		WWuString key = identity.Name + L"|" + identity.ProcessorArchitecture + L"|";
+		key += identity.PublicKeyToken.Length() > 0 ? identity.PublicKeyToken : WWuString(L"none");
+		if (with_version) {
+			key += L"|";
+			key += identity.Version;
+		}
+
+		return key;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "Manifest.h"
+
+namespace LibSnitcher::Core
+{
+	// An assembly in the side-by-side store.
+	typedef struct _LS_SXS_ASSEMBLY
+	{
+		WWuString Directory;
+		WWuString Version;
+
+		// Major, minor, build, and revision, from high to low word.
+		ULONGLONG VersionNumber;
+
+		_LS_SXS_ASSEMBLY()
+			: VersionNumber(0) { }
+
+		~_LS_SXS_ASSEMBLY() { }
+
+	} LS_SXS_ASSEMBLY, *PLS_SXS_ASSEMBLY;
+
+	// FNV-1a over the characters. Keys are already lowercase.
+	struct LS_WSTRING_HASH
+	{
+		size_t operator()(const WWuString& key) const noexcept;
+	};
+
+	// Index of the WinSxS store, from an assembly identity to its directory.
+	// Built once, from the file names in 'WinSxS\Manifests', the first time it's
+	// queried. Lookups are hash lookups, and don't touch the file system.
+	class SxsStoreIndex
+	{
+	public:
+		// 'sysroot' is the Windows directory of the system to resolve against.
+		SxsStoreIndex(const WWuString& sysroot);
+		~SxsStoreIndex();
+
+		// Looks for the exact version, then for the highest version installed above it.
+		// The later stands in for publisher policy, which we don't evaluate.
+		bool Find(const LS_ASSEMBLY_IDENTITY& identity, LS_SXS_ASSEMBLY& assembly);
+
+		// Looks for 'module_name' in the assemblies of an activation context, in order.
+		bool FindModule(const WWuString& module_name, const wuvector<LS_ASSEMBLY_IDENTITY>& context, WWuString& module_path);
+
+		_NODISCARD size_t Count();
+
+		static WWuString GetDefaultSysroot();
+		static ULONGLONG ParseVersion(const WWuString& version) noexcept;
+
+	private:
+		SRWLOCK _lock;
+		bool _built;
+		WWuString _sysroot;
+		wuhash_map<WWuString, LS_SXS_ASSEMBLY, LS_WSTRING_HASH> _assemblies;
+		wuhash_map<WWuString, LS_SXS_ASSEMBLY, LS_WSTRING_HASH> _latest;
+
+		void EnsureBuilt();
+		void Add(const LS_ASSEMBLY_IDENTITY& identity, const WWuString& directory);
+
+		static bool ParseStem(const WWuString& stem, LS_ASSEMBLY_IDENTITY& identity);
+		static bool ReadManifestIdentity(const WWuString& manifest_path, LS_ASSEMBLY_IDENTITY& identity);
+		static WWuString GetKey(const LS_ASSEMBLY_IDENTITY& identity, bool with_version);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "pch.h"
+
+#include "SymbolHash.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	typedef struct _LS_SYMBOL_HASH_CONTEXT
+	{
+		const wuvector<WWuString>* Paths;
+		const wuvector<DWORD>* Work;
+		wuvector<LS_SYMBOL_HASH_RESULT>* Results;
+		ConcurrentGroupMap<LS_IMPORT_HASH, DWORD, LS_IMPORT_HASH_HASHER>* ImportGroups;
+		ConcurrentGroupMap<ULONGLONG, DWORD>* ExportGroups;
+		LS_WORK_LIMITS Limits;
+		const CancellationToken* Token;
+		volatile LONG Next;
+
+	} LS_SYMBOL_HASH_CONTEXT, *PLS_SYMBOL_HASH_CONTEXT;
+
+	static inline char ToLowerAscii(char value) noexcept
+	{
+		return (value >= 'A' && value <= 'Z') ? value + ('a' - 'A') : value;
+	}
+
+	// Opened once, and kept for the process lifetime. Algorithm handles can be shared between threads.
+	// Function statics aren't initialized thread-safely under /clr, so it's opened under an init once.
+	static BCRYPT_ALG_HANDLE Md5Provider = NULL;
+	static INIT_ONCE Md5ProviderOnce = INIT_ONCE_STATIC_INIT;
+
+	static BOOL CALLBACK OpenMd5Provider(PINIT_ONCE init_once, PVOID parameter, PVOID* context)
+	{
+		UNREFERENCED_PARAMETER(init_once);
+		UNREFERENCED_PARAMETER(parameter);
+		UNREFERENCED_PARAMETER(context);
+
+		if (!NT_SUCCESS(BCryptOpenAlgorithmProvider(&Md5Provider, BCRYPT_MD5_ALGORITHM, NULL, 0)))
+			Md5Provider = NULL;
+
+		return TRUE;
+	}
+
+	static BCRYPT_ALG_HANDLE GetMd5Provider() noexcept
+	{
+		InitOnceExecuteOnce(&Md5ProviderOnce, OpenMd5Provider, NULL, NULL);
+
+		return Md5Provider;
+	}
+
+	void SymbolHasher::AppendImport(wuvector<char>& list, const WuString& module, const char* function, size_t length)
+	{
+		AppendModule(list, module);
+		for (size_t i = 0; i < length; i++)
+			list.push_back(ToLowerAscii(function[i]));
+	}
+
+	void SymbolHasher::AppendImport(wuvector<char>& list, const WuString& module, DWORD ordinal)
+	{
+		char buffer[16];
+		int length = sprintf_s(buffer, "ord%u", ordinal);
+
+		AppendModule(list, module);
+		list.insert(list.end(), buffer, buffer + length);
+	}
+
+	bool SymbolHasher::FinishImportHash(const wuvector<char>& list, BYTE hash[LS_IMPORT_HASH_SIZE]) noexcept
+	{
+		BCRYPT_ALG_HANDLE provider = GetMd5Provider();
+		if (list.empty() || provider == NULL)
+			return false;
+
+		NTSTATUS status = BCryptHash(provider, NULL, 0, reinterpret_cast<PUCHAR>(const_cast<char*>(list.data())),
+			static_cast<ULONG>(list.size()), hash, LS_IMPORT_HASH_SIZE);
+
+		return NT_SUCCESS(status);
+	}
+
+	ULONGLONG SymbolHasher::HashExport(const char* name, size_t length) noexcept
+	{
+		// FNV-1a, with the SplitMix64 finalizer. Sums of plain FNV-1a values cluster.
+		ULONGLONG hash = 0xCBF29CE484222325ULL;
+		for (size_t i = 0; i < length; i++) {
+			hash ^= static_cast<BYTE>(name[i]);
+			hash *= 0x100000001B3ULL;
+		}
+
+		hash ^= hash >> 30;
+		hash *= 0xBF58476D1CE4E5B9ULL;
+		hash ^= hash >> 27;
+		hash *= 0x94D049BB133111EBULL;
+		hash ^= hash >> 31;
+
+		return hash;
+	}
+
+	void SymbolHasher::HashBatch(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_SYMBOL_HASH_RESULT>& results,
+		wuvector<LS_SYMBOL_HASH_GROUP>& groups, wuvector<LS_DUPLICATE_SET>* duplicates,
+		const LS_WORK_LIMITS* limits, const CancellationToken* token)
+	{
+		results.clear();
+		results.resize(file_paths.size());
+		groups.clear();
+		if (duplicates != NULL)
+			duplicates->clear();
+
+		if (file_paths.empty())
+			return;
+
+		// Only the first file of each duplicate set is mapped.
+		wuvector<LS_DEDUP_FILE> files;
+		wuvector<DWORD> work;
+		if (duplicates != NULL) {
+			ContentDeduplicator::Deduplicate(file_paths, thread_count, files, *duplicates);
+			for (DWORD i = 0; i < static_cast<DWORD>(files.size()); i++) {
+				if (files[i].Canonical == i)
+					work.push_back(i);
+			}
+		}
+		else {
+			work.resize(file_paths.size());
+			for (DWORD i = 0; i < static_cast<DWORD>(work.size()); i++)
+				work[i] = i;
+		}
+
+		if (thread_count == 0) {
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			thread_count = system_info.dwNumberOfProcessors;
+		}
+
+		// The calling thread is one of the workers.
+		thread_count = static_cast<DWORD>(min(static_cast<size_t>(thread_count), work.size()));
+		thread_count = min(thread_count, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS));
+
+		// Large, keep them off the stack.
+		auto import_groups = std::make_unique<ConcurrentGroupMap<LS_IMPORT_HASH, DWORD, LS_IMPORT_HASH_HASHER>>();
+		auto export_groups = std::make_unique<ConcurrentGroupMap<ULONGLONG, DWORD>>();
+
+		LS_SYMBOL_HASH_CONTEXT context{ &file_paths, &work, &results, import_groups.get(), export_groups.get(),
+			limits != NULL ? *limits : LS_WORK_LIMITS(), token, 0 };
+		wuvector<HANDLE> threads;
+		for (DWORD i = 1; i < thread_count; i++) {
+			HANDLE h_thread = CreateThread(NULL, 0, HashWorker, &context, 0, NULL);
+			if (h_thread == NULL)
+				break;
+
+			threads.push_back(h_thread);
+		}
+
+		HashWorker(&context);
+
+		if (!threads.empty()) {
+			WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, INFINITE);
+			for (HANDLE h_thread : threads)
+				CloseHandle(h_thread);
+		}
+
+		// Sharing the result of the canonical file.
+		for (DWORD i = 0; i < static_cast<DWORD>(files.size()); i++) {
+			DWORD canonical = files[i].Canonical;
+			if (canonical == i)
+				continue;
+
+			results[i] = results[canonical];
+			results[i].Path = file_paths[i];
+			if (results[i].Result != ERROR_SUCCESS)
+				continue;
+
+			if (results[i].HasImportHash)
+				import_groups->Add(results[i].ImportHash, i);
+
+			if (results[i].ExportCount > 0 && results[i].StopReason == WorkStopNone)
+				export_groups->Add(results[i].ExportHash, i);
+		}
+
+		import_groups->ForEach([&groups](const LS_IMPORT_HASH& hash, const wuvector<DWORD>& files) {
+			LS_SYMBOL_HASH_GROUP group;
+			group.Kind = SymbolHashImport;
+			group.ImportHash = hash;
+			group.Files = files;
+			groups.push_back(std::move(group));
+		});
+
+		export_groups->ForEach([&groups](ULONGLONG hash, const wuvector<DWORD>& files) {
+			LS_SYMBOL_HASH_GROUP group;
+			group.Kind = SymbolHashExport;
+			group.ExportHash = hash;
+			group.Files = files;
+			groups.push_back(std::move(group));
+		});
+
+		// Workers finish in any order.
+		for (LS_SYMBOL_HASH_GROUP& group : groups)
+			std::sort(group.Files.begin(), group.Files.end());
+
+		std::stable_sort(groups.begin(), groups.end(), [](const LS_SYMBOL_HASH_GROUP& left, const LS_SYMBOL_HASH_GROUP& right) {
+			if (left.Files.size() != right.Files.size())
+				return left.Files.size() > right.Files.size();
+
+			return left.Files[0] < right.Files[0];
+		});
+	}
+
+	void SymbolHasher::AppendModule(wuvector<char>& list, const WuString& module)
+	{
+		const char* name = module.GetBuffer();
+		size_t length = module.Length();
+		if (length > 4 && name[length - 4] == '.') {
+			const char* extension = name + length - 3;
+			if (strcmp(extension, "dll") == 0 || strcmp(extension, "sys") == 0 || strcmp(extension, "ocx") == 0)
+				length -= 4;
+		}
+
+		if (!list.empty())
+			list.push_back(',');
+
+		list.insert(list.end(), name, name + length);
+		list.push_back('.');
+	}
+
+	void SymbolHasher::HashImage(LS_SYMBOL_HASH_RESULT& result, WorkBudget& budget) noexcept
+	{
+		HANDLE h_file = CreateFile(result.Path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE) {
+			result.Result = GetLastError();
+			return;
+		}
+
+		// Mapped as an image, the tables are walked by RVA.
+		HANDLE h_map = CreateFileMapping(h_file, NULL, PAGE_READONLY | SEC_IMAGE_NO_EXECUTE, 0, 0, NULL);
+		if (h_map == NULL) {
+			result.Result = GetLastError();
+			CloseHandle(h_file);
+			return;
+		}
+
+		LPVOID map_view = MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0);
+		if (map_view == NULL) {
+			result.Result = GetLastError();
+			CloseHandle(h_map);
+			CloseHandle(h_file);
+			return;
+		}
+
+		PeHelper pe_helper;
+		PeHelper::LS_IMAGE_BASIC_INFORMATION basic_info;
+		LSRESULT parse_result = pe_helper.GetImageBasicInformation(static_cast<HMODULE>(map_view), &basic_info, &budget);
+		result.Result = parse_result.Result;
+		result.StopReason = budget.StopReason();
+		if (parse_result.Result == ERROR_SUCCESS && !budget.IsSpent()) {
+
+			// The symbols walk the descriptors again, on a budget of their own.
+			WorkBudget symbol_budget = budget.Restart();
+			PeHelper::LS_IMAGE_SYMBOLS symbols;
+			pe_helper.GetImageSymbols(static_cast<HMODULE>(map_view), &basic_info, &symbols, &symbol_budget);
+			result.StopReason = symbol_budget.StopReason();
+
+			result.HasImportHash = symbols.HasImportHash;
+			memcpy(result.ImportHash.Bytes, symbols.ImportHash, LS_IMPORT_HASH_SIZE);
+			result.ExportHash = symbols.ExportHash;
+			result.ImportCount = static_cast<DWORD>(symbols.Imports.size());
+			result.ExportCount = static_cast<DWORD>(symbols.Exports.size());
+		}
+
+		UnmapViewOfFile(map_view);
+		CloseHandle(h_map);
+		CloseHandle(h_file);
+	}
+
+	DWORD WINAPI SymbolHasher::HashWorker(LPVOID context)
+	{
+		PLS_SYMBOL_HASH_CONTEXT batch = static_cast<PLS_SYMBOL_HASH_CONTEXT>(context);
+
+		LONG count = static_cast<LONG>(batch->Work->size());
+		for (LONG next = InterlockedIncrement(&batch->Next) - 1; next < count; next = InterlockedIncrement(&batch->Next) - 1) {
+			DWORD index = (*batch->Work)[next];
+			LS_SYMBOL_HASH_RESULT& result = (*batch->Results)[index];
+			result.Path = (*batch->Paths)[index];
+
+			// Files left when the batch stops are claimed, and failed, without being opened.
+			WorkBudget budget(batch->Limits, batch->Token);
+			if (budget.IsSpent()) {
+				result.StopReason = budget.StopReason();
+				result.Result = result.StopReason == WorkStopDeadline ? ERROR_TIMEOUT : ERROR_CANCELLED;
+				continue;
+			}
+
+			HashImage(result, budget);
+			if (result.Result != ERROR_SUCCESS)
+				continue;
+
+			if (result.HasImportHash)
+				batch->ImportGroups->Add(result.ImportHash, index);
+
+			if (result.ExportCount > 0 && result.StopReason == WorkStopNone)
+				batch->ExportGroups->Add(result.ExportHash, index);
+		}
+
+		return 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+#include "PeHelper.h"
+#include "Dedup.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_GROUP_MAP_SHARD_BITS 6
+
+	typedef enum _LS_SYMBOL_HASH_KIND
+	{
+		SymbolHashImport,
+		SymbolHashExport
+
+	} LS_SYMBOL_HASH_KIND;
+
+	typedef struct _LS_IMPORT_HASH
+	{
+		BYTE Bytes[LS_IMPORT_HASH_SIZE];
+
+		bool operator==(const _LS_IMPORT_HASH& other) const noexcept
+		{
+			return memcmp(Bytes, other.Bytes, LS_IMPORT_HASH_SIZE) == 0;
+		}
+
+	} LS_IMPORT_HASH, *PLS_IMPORT_HASH;
+
+	// MD5 is already well distributed, any part of it will do.
+	struct LS_IMPORT_HASH_HASHER
+	{
+		size_t operator()(const LS_IMPORT_HASH& hash) const noexcept
+		{
+			size_t value;
+			memcpy(&value, hash.Bytes, sizeof(value));
+			return value;
+		}
+	};
+
+	typedef struct _LS_SYMBOL_HASH_RESULT
+	{
+		WWuString Path;
+		DWORD Result;
+		bool HasImportHash;
+		LS_IMPORT_HASH ImportHash;
+		ULONGLONG ExportHash;
+		DWORD ImportCount;
+		DWORD ExportCount;
+
+		// Partial results are not grouped by the hashes they couldn't finish.
+		LS_WORK_STOP StopReason;
+
+		_LS_SYMBOL_HASH_RESULT()
+			: Result(ERROR_SUCCESS), HasImportHash(false), ImportHash(), ExportHash(0), ImportCount(0), ExportCount(0), StopReason(WorkStopNone) { }
+
+		~_LS_SYMBOL_HASH_RESULT() { }
+
+	} LS_SYMBOL_HASH_RESULT, *PLS_SYMBOL_HASH_RESULT;
+
+	// Files sharing an import, or export hash. 'Files' are indexes into the batch results, in path order.
+	typedef struct _LS_SYMBOL_HASH_GROUP
+	{
+		LS_SYMBOL_HASH_KIND Kind;
+		LS_IMPORT_HASH ImportHash;
+		ULONGLONG ExportHash;
+		wuvector<DWORD> Files;
+
+		_LS_SYMBOL_HASH_GROUP()
+			: Kind(SymbolHashImport), ImportHash(), ExportHash(0) { }
+
+		~_LS_SYMBOL_HASH_GROUP() { }
+
+	} LS_SYMBOL_HASH_GROUP, *PLS_SYMBOL_HASH_GROUP;
+
+	// Hash map split in shards, each with its own lock, so threads adding different
+	// keys rarely wait on each other. Values are appended to the key's list.
+	template<class K, class V, class H = std::hash<K>>
+	class ConcurrentGroupMap
+	{
+	public:
+		ConcurrentGroupMap()
+		{
+			for (LS_SHARD& shard : _shards)
+				InitializeSRWLock(&shard.Lock);
+		}
+
+		~ConcurrentGroupMap() { }
+
+		void Add(const K& key, const V& value)
+		{
+			LS_SHARD& shard = _shards[GetShard(key)];
+			AcquireSRWLockExclusive(&shard.Lock);
+			shard.Groups[key].push_back(value);
+			ReleaseSRWLockExclusive(&shard.Lock);
+		}
+
+		// Not synchronized. Call it once every writer is done.
+		template<class F>
+		void ForEach(F callback) const
+		{
+			for (const LS_SHARD& shard : _shards) {
+				for (const auto& group : shard.Groups)
+					callback(group.first, group.second);
+			}
+		}
+
+	private:
+		typedef struct _LS_SHARD
+		{
+			SRWLOCK Lock;
+			wuhash_map<K, wuvector<V>, H> Groups;
+
+		} LS_SHARD;
+
+		LS_SHARD _shards[1 << LS_GROUP_MAP_SHARD_BITS];
+
+		// The top bits of a multiplicative hash. The map itself uses the low ones.
+		static size_t GetShard(const K& key) noexcept
+		{
+			ULONGLONG hash = static_cast<ULONGLONG>(H()(key)) * 0x9E3779B97F4A7C15ULL;
+			return static_cast<size_t>(hash >> (64 - LS_GROUP_MAP_SHARD_BITS));
+		}
+	};
+
+	// Import, and export hashes for clustering images by what they import, and export.
+	// The hashes are built by 'PeHelper::GetImageSymbols', while it walks the tables.
+	//
+	// The import hash is the imphash, as computed by pefile: the import table only, module names
+	// lowercase, without a '.dll', '.sys', or '.ocx' extension, function names lowercase, 'ord<n>'
+	// for imports by ordinal, joined as 'module.function' with commas, and hashed with MD5.
+	// pefile names some ws2_32, wsock32, and oleaut32 ordinals, we don't.
+	//
+	// The export hash is the sum of a 64-bit hash of each exported name, and '#ordinal' for
+	// ordinal only exports. Being a sum, it doesn't depend on the export table order.
+	class SymbolHasher
+	{
+	public:
+		// 'module' must be lowercase already.
+		static void AppendImport(wuvector<char>& list, const WuString& module, const char* function, size_t length);
+		static void AppendImport(wuvector<char>& list, const WuString& module, DWORD ordinal);
+		static bool FinishImportHash(const wuvector<char>& list, BYTE hash[LS_IMPORT_HASH_SIZE]) noexcept;
+
+		static ULONGLONG HashExport(const char* name, size_t length) noexcept;
+
+		// Maps every image on 'thread_count' threads, computing the hashes, and groups the files
+		// by hash as they finish. Zero threads means one per processor. Failures are reported per
+		// file. Groups are sorted by file count, the largest first.
+		// With 'duplicates', files with the same content are found first, and each is mapped once.
+		// The result is copied to the other paths, and the duplicate sets are returned.
+		// Each file is walked within 'limits'. Once 'token' is cancelled, or past its deadline, the
+		// files not started yet fail with 'ERROR_CANCELLED', or 'ERROR_TIMEOUT'.
+		static void HashBatch(const wuvector<WWuString>& file_paths, DWORD thread_count, wuvector<LS_SYMBOL_HASH_RESULT>& results,
+			wuvector<LS_SYMBOL_HASH_GROUP>& groups, wuvector<LS_DUPLICATE_SET>* duplicates = NULL,
+			const LS_WORK_LIMITS* limits = NULL, const CancellationToken* token = NULL);
+
+	private:
+		static void AppendModule(wuvector<char>& list, const WuString& module);
+		static void HashImage(LS_SYMBOL_HASH_RESULT& result, WorkBudget& budget) noexcept;
+		static DWORD WINAPI HashWorker(LPVOID context);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "pch.h"
+
+#include "Trace.h"
+
+namespace LibSnitcher::Core
+{
+	// Buffers the output so we don't call 'WriteFile' per event.
+	class TraceFileWriter
+	{
+	public:
+		TraceFileWriter(HANDLE h_file)
+			: _h_file(h_file), _used(0), _error(ERROR_SUCCESS) { }
+
+		void Append(const char* data, size_t size)
+		{
+			while (size > 0 && _error == ERROR_SUCCESS) {
+				size_t chunk = min(size, sizeof(_buffer) - _used);
+				memcpy(_buffer + _used, data, chunk);
+				_used += chunk;
+				data += chunk;
+				size -= chunk;
+
+				if (_used == sizeof(_buffer))
+					Flush();
+			}
+		}
+
+		void Append(const char* str) { Append(str, strlen(str)); }
+
+		// Names are converted to UTF-8, and escaped as JSON strings.
+		void AppendEscaped(LPCWSTR str)
+		{
+			char narrow[256];
+			int length = WideCharToMultiByte(CP_UTF8, 0, str, -1, narrow, sizeof(narrow), NULL, NULL);
+			if (length <= 0)
+				return;
+
+			for (int i = 0; i < length - 1; i++) {
+				unsigned char current = static_cast<unsigned char>(narrow[i]);
+				if (current == '"' || current == '\\') {
+					char escaped[2] = { '\\', static_cast<char>(current) };
+					Append(escaped, 2);
+				}
+				else if (current < 0x20) {
+					char escaped[8];
+					_snprintf_s(escaped, sizeof(escaped), _TRUNCATE, "\\u%04x", current);
+					Append(escaped);
+				}
+				else
+					Append(narrow + i, 1);
+			}
+		}
+
+		DWORD Flush()
+		{
+			if (_used > 0 && _error == ERROR_SUCCESS) {
+				DWORD written;
+				if (!WriteFile(_h_file, _buffer, static_cast<DWORD>(_used), &written, NULL))
+					_error = GetLastError();
+
+				_used = 0;
+			}
+
+			return _error;
+		}
+
+	private:
+		HANDLE _h_file;
+		size_t _used;
+		DWORD _error;
+		char _buffer[65536];
+	};
+
+	TraceRecorder::TraceRecorder(DWORD ring_capacity)
+		: _capacity(ring_capacity == 0 ? 1 : ring_capacity)
+	{
+		_tls_index = TlsAlloc();
+		InitializeSRWLock(&_rings_lock);
+		QueryPerformanceFrequency(&_frequency);
+
+		LARGE_INTEGER origin;
+		QueryPerformanceCounter(&origin);
+		_origin = origin.QuadPart;
+	}
+
+	TraceRecorder::~TraceRecorder()
+	{
+		for (PLS_TRACE_RING ring : _rings) {
+			HeapFree(GetProcessHeap(), 0, ring->Events);
+			delete ring;
+		}
+
+		if (_tls_index != TLS_OUT_OF_INDEXES)
+			TlsFree(_tls_index);
+	}
+
+	LONGLONG TraceRecorder::Now() const noexcept
+	{
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+
+		return counter.QuadPart;
+	}
+
+	void TraceRecorder::Record(LS_TRACE_EVENT_KIND kind, LPCWSTR name, DWORD depth, LONG result, ULONGLONG bytes_read, LONGLONG start) noexcept
+	{
+		PLS_TRACE_RING ring = GetThreadRing();
+		if (ring == NULL)
+			return;
+
+		LONG64 head = ring->Head;
+		PLS_TRACE_EVENT event = &ring->Events[head % _capacity];
+		event->Kind = kind;
+		event->ThreadId = ring->ThreadId;
+		event->Depth = depth;
+		event->Result = result;
+		event->BytesRead = bytes_read;
+		event->Start = start;
+		event->End = Now();
+		wcsncpy_s(event->Name, name == NULL ? L"" : name, _TRUNCATE);
+
+		// Publishing the slot.
+		InterlockedExchange64(&ring->Head, head + 1);
+	}
+
+	void TraceRecorder::RecordCounter(LPCWSTR name, ULONGLONG value) noexcept
+	{
+		LONGLONG now = Now();
+		Record(TraceEventCounter, name, 0, ERROR_SUCCESS, value, now);
+	}
+
+	PLS_TRACE_RING TraceRecorder::GetThreadRing() noexcept
+	{
+		if (_tls_index == TLS_OUT_OF_INDEXES)
+			return NULL;
+
+		PLS_TRACE_RING ring = static_cast<PLS_TRACE_RING>(TlsGetValue(_tls_index));
+		if (ring != NULL)
+			return ring;
+
+		// First event on this thread. This is the only time we lock.
+		PLS_TRACE_EVENT events = static_cast<PLS_TRACE_EVENT>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(LS_TRACE_EVENT) * _capacity));
+		if (events == NULL)
+			return NULL;
+
+		ring = new LS_TRACE_RING();
+		ring->ThreadId = GetCurrentThreadId();
+		ring->Events = events;
+
+		AcquireSRWLockExclusive(&_rings_lock);
+		_rings.push_back(ring);
+		ReleaseSRWLockExclusive(&_rings_lock);
+
+		TlsSetValue(_tls_index, ring);
+
+		return ring;
+	}
+
+	const LSRESULT TraceRecorder::WriteTraceEvents(const WWuString& file_path)
+	{
+		HANDLE h_file = CreateFile(file_path.GetBuffer(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		wuunique_ptr<TraceFileWriter> writer = make_wuunique<TraceFileWriter>(h_file);
+		DWORD process_id = GetCurrentProcessId();
+		double tick_to_us = 1000000.0 / static_cast<double>(_frequency.QuadPart);
+		bool first = true;
+		char line[512];
+
+		writer->Append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+		AcquireSRWLockShared(&_rings_lock);
+		for (PLS_TRACE_RING ring : _rings) {
+			_snprintf_s(line, sizeof(line), _TRUNCATE,
+				"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"Resolver %lu\"}}",
+				first ? "" : ",", process_id, ring->ThreadId, ring->ThreadId);
+			writer->Append(line);
+			first = false;
+
+			LONG64 head = ring->Head;
+			LONG64 begin = head > static_cast<LONG64>(_capacity) ? head - _capacity : 0;
+			for (LONG64 i = begin; i < head; i++) {
+				PLS_TRACE_EVENT event = &ring->Events[i % _capacity];
+				if (event->Kind == TraceEventCounter) {
+					writer->Append(",\n{\"name\":\"");
+					writer->AppendEscaped(event->Name);
+					_snprintf_s(line, sizeof(line), _TRUNCATE,
+						"\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"value\":%llu}}",
+						static_cast<double>(event->Start - _origin) * tick_to_us, process_id, event->ThreadId, event->BytesRead);
+					writer->Append(line);
+
+					continue;
+				}
+
+				writer->Append(",\n{\"name\":\"");
+				writer->AppendEscaped(event->Name);
+				_snprintf_s(line, sizeof(line), _TRUNCATE,
+					"\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu,"
+					"\"args\":{\"depth\":%lu,\"bytes\":%llu,\"result\":%ld}}",
+					event->Kind == TraceEventParse ? "parse" : "resolve",
+					static_cast<double>(event->Start - _origin) * tick_to_us,
+					static_cast<double>(event->End - event->Start) * tick_to_us,
+					process_id, event->ThreadId, event->Depth, event->BytesRead, event->Result);
+				writer->Append(line);
+			}
+
+			// Letting the reader know the ring wrapped, and older spans are gone.
+			if (begin > 0) {
+				_snprintf_s(line, sizeof(line), _TRUNCATE,
+					",\n{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"t\",\"ts\":0,\"pid\":%lu,\"tid\":%lu,\"args\":{\"count\":%lld}}",
+					process_id, ring->ThreadId, begin);
+				writer->Append(line);
+			}
+		}
+		ReleaseSRWLockShared(&_rings_lock);
+
+		writer->Append("\n]}\n");
+		DWORD error = writer->Flush();
+		CloseHandle(h_file);
+
+		if (error != ERROR_SUCCESS)
+			return LSRESULT(error, __FILEW__, __LINE__);
+
+		return LSRESULT();
+	}
+}
\ No newline at end of file
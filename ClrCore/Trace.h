@@ -0,0 +1,75 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	typedef enum _LS_TRACE_EVENT_KIND
+	{
+		TraceEventResolve,
+		TraceEventParse,
+		TraceEventCounter
+	} LS_TRACE_EVENT_KIND;
+
+	// A completed span, or a counter sample. The name is copied inline so
+	// recording an event never allocates. Counters keep their value in 'BytesRead'.
+	typedef struct _LS_TRACE_EVENT
+	{
+		LS_TRACE_EVENT_KIND Kind;
+		DWORD ThreadId;
+		DWORD Depth;
+		LONG Result;
+		ULONGLONG BytesRead;
+		LONGLONG Start;
+		LONGLONG End;
+		WCHAR Name[64];
+
+	} LS_TRACE_EVENT, *PLS_TRACE_EVENT;
+
+	// Single producer ring buffer. Only the owning thread advances 'Head',
+	// the recorder reads it once the run is over. When the ring wraps the
+	// oldest events are overwritten.
+	typedef struct _LS_TRACE_RING
+	{
+		DWORD ThreadId;
+		volatile LONG64 Head;
+		PLS_TRACE_EVENT Events;
+
+		_LS_TRACE_RING()
+			: ThreadId(0), Head(0), Events(NULL) { }
+
+		~_LS_TRACE_RING() { }
+
+	} LS_TRACE_RING, *PLS_TRACE_RING;
+
+	// Records module parse and resolve spans, and writes them as Trace Event
+	// JSON, loadable in Perfetto or 'chrome://tracing'.
+	// Each thread gets its own ring the first time it records, so the hot path
+	// takes no locks.
+	class TraceRecorder
+	{
+	public:
+		TraceRecorder(DWORD ring_capacity = 16384);
+		~TraceRecorder();
+
+		_NODISCARD LONGLONG Now() const noexcept;
+		void Record(LS_TRACE_EVENT_KIND kind, LPCWSTR name, DWORD depth, LONG result, ULONGLONG bytes_read, LONGLONG start) noexcept;
+		void RecordCounter(LPCWSTR name, ULONGLONG value) noexcept;
+
+		// Should only be called once the recording threads are done.
+		const LSRESULT WriteTraceEvents(const WWuString& file_path);
+
+	private:
+		DWORD _tls_index;
+		DWORD _capacity;
+		LONGLONG _origin;
+		LARGE_INTEGER _frequency;
+		SRWLOCK _rings_lock;
+		wuvector<PLS_TRACE_RING> _rings;
+
+		PLS_TRACE_RING GetThreadRing() noexcept;
+	};
+}
\ No newline at end of file
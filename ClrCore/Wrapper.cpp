@@ -4,16 +4,401 @@
 
 namespace LibSnitcher::Core
 {
-	ModuleBase^ Wrapper::GetDependencyList(String^ file_name, DependencySource source)
+	static WWuString GetSysroot(String^ sysroot)
 	{
+		if (String::IsNullOrEmpty(sysroot))
+			return SxsStoreIndex::GetDefaultSysroot();
+
+		return GetWideFromManagedString(sysroot);
+	}
+
+	Wrapper::Wrapper()
+		: _tracer(NULL), _sxs(NULL), _root_context(new wuvector<LS_ASSEMBLY_IDENTITY>()),
+			_module_contexts(new wumap<WWuString, wuvector<LS_ASSEMBLY_IDENTITY>>()), _scan_strings(false), _bundle(new BundleReader()),
+			_inflate_buffer(new wuvector<BYTE>()) { }
+
+	Wrapper::~Wrapper()
+	{
+		this->!Wrapper();
+	}
+
+	Wrapper::!Wrapper()
+	{
+		if (_tracer != NULL) {
+			delete _tracer;
+			_tracer = NULL;
+		}
+
+		if (_sxs != NULL) {
+			delete _sxs;
+			_sxs = NULL;
+		}
+
+		if (_root_context != NULL) {
+			delete _root_context;
+			_root_context = NULL;
+		}
+
+		if (_module_contexts != NULL) {
+			delete _module_contexts;
+			_module_contexts = NULL;
+		}
+
+		if (_bundle != NULL) {
+			delete _bundle;
+			_bundle = NULL;
+		}
+
+		if (_inflate_buffer != NULL) {
+			delete _inflate_buffer;
+			_inflate_buffer = NULL;
+		}
+	}
+
+	void Wrapper::StartTrace()
+	{
+		if (_tracer == NULL)
+			_tracer = new TraceRecorder();
+	}
+
+	void Wrapper::StopTrace(String^ file_path)
+	{
+		if (_tracer == NULL)
+			return;
+
+		LSRESULT result = _tracer->WriteTraceEvents(GetWideFromManagedString(file_path));
+		delete _tracer;
+		_tracer = NULL;
+
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+	}
+
+	ModuleBase^ Wrapper::GetDependencyList(String^ file_name, DependencySource source, Int32 depth, String^ importing_name)
+	{
+		if (_tracer == NULL)
+			return GetDependencyListCore(file_name, source, depth, importing_name);
+
+		LONGLONG start = _tracer->Now();
+		ModuleBase^ output = GetDependencyListCore(file_name, source, depth, importing_name);
+
+		LONG result = ERROR_SUCCESS;
+		NativeException^ native_exception = dynamic_cast<NativeException^>(output->LoaderException);
+		if (native_exception != nullptr)
+			result = native_exception->ErrorCode;
+		else if (output->LoaderException != nullptr)
+			result = output->LoaderException->HResult;
+
+		_tracer->Record(TraceEventResolve, GetWideFromManagedString(file_name).GetBuffer(), depth, result, output->BytesRead, start);
+
+		return output;
+	}
+
+	ResolvedChain^ Wrapper::ResolveChain(String^ file_name, Int32 depth)
+	{
+		if (String::IsNullOrEmpty(file_name))
+			throw gcnew ArgumentNullException("File name cannot be null or empty.");
+
+		if (depth < 0)
+			throw gcnew ArgumentOutOfRangeException("depth");
+
+		DirectoryIndex index;
+		ImageCache cache;
+		Resolver resolver(&index, &cache, _tracer, false, GetSxsIndex(), _scan_strings);
+		if (_limits != nullptr)
+			resolver.SetLimits(_limits->GetLimits(), _limits->GetToken());
+
+		LS_RESOLVED_GRAPH graph;
+		LSRESULT result = resolver.ResolveChain(GetWideFromManagedString(file_name), static_cast<DWORD>(depth), &graph);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		if (_limits != nullptr && graph.StopReason != WorkStopNone)
+			_limits->SetStopReason(graph.StopReason);
+
+		wuvector<BYTE>* buffer = new wuvector<BYTE>();
+		result = ChainBufferWriter::Serialize(graph, *buffer);
+		if (result.Result != ERROR_SUCCESS) {
+			delete buffer;
+			throw gcnew NativeException(result);
+		}
+
+		return gcnew ResolvedChain(buffer);
+	}
+
+	LSRESULT Wrapper::GetBasicInformation(HMODULE hmodule, String^ name, Int32 depth, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info)
+	{
+		// 'PeHelper' has no state, one per call.
+		PeHelper pe_helper;
+		WorkBudget budget = CreateBudget();
+		if (_tracer == NULL)
+			return pe_helper.GetImageBasicInformation(hmodule, basic_info, &budget);
+
+		LONGLONG start = _tracer->Now();
+		LSRESULT result = pe_helper.GetImageBasicInformation(hmodule, basic_info, &budget);
+		_tracer->Record(TraceEventParse, GetWideFromManagedString(name).GetBuffer(), depth, result.Result, basic_info->BytesRead, start);
+
+		return result;
+	}
+
+	WorkBudget Wrapper::CreateBudget()
+	{
+		if (_limits == nullptr)
+			return WorkBudget(LS_WORK_LIMITS());
+
+		return WorkBudget(_limits->GetLimits(), _limits->GetToken());
+	}
+
+	void Wrapper::ReadResources(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, ModuleBase^ module, Int32 depth)
+	{
+		// From the same view the imports were read from.
+		ResourceIndex resources;
+		LS_VERSION_INFO version;
+		WorkBudget budget = CreateBudget();
+		LSRESULT result = resources.Build(hmodule, basic_info->SizeOfImage, basic_info->ResourceTableRva, basic_info->ResourceTableSize, &budget);
+		if (result.Result != ERROR_SUCCESS)
+			return;
+
+		if (resources.GetVersionInfo(hmodule, version, &budget))
+			module->SetVersionInfo(version);
+
+		// The manifest dependencies are the activation context of this module. The root's is the one of the chain too.
+		WuString manifest_text;
+		LS_MANIFEST_INFO manifest;
+		if (resources.GetManifest(hmodule, manifest_text, &budget) && ManifestParser::Parse(manifest_text.GetBuffer(), manifest_text.Length(), manifest)) {
+			PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(hmodule);
+			PIMAGE_NT_HEADERS nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS>((char*)hmodule + dos_header->e_lfanew);
+			ManifestParser::SetDefaultArchitecture(manifest.Dependencies, nt_headers->FileHeader.Machine);
+			if (depth == 0)
+				*_root_context = manifest.Dependencies;
+			else
+				(*_module_contexts)[GetWideFromManagedString(module->Name).ToLower()] = manifest.Dependencies;
+		}
+	}
+
+	void Wrapper::ScanModuleNames(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, ModuleBase^ module)
+	{
+		if (!_scan_strings)
+			return;
+
+		wuvector<WuString> names;
+		ModuleNameScanner::ScanImage(hmodule, basic_info, names);
+		for (WuString& name : names)
+			module->Dependencies->Add(gcnew DependencyEntry(gcnew String(name.GetBuffer()), DependencySource::Heuristic));
+	}
+
+	void Wrapper::ReadReadyToRun(HMODULE hmodule, String^ path, ModuleBase^ module)
+	{
+		// 'SizeOfImage' is at the same offset in both optional headers.
+		PIMAGE_DOS_HEADER dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(hmodule);
+		PIMAGE_NT_HEADERS nt_headers = reinterpret_cast<PIMAGE_NT_HEADERS>((char*)hmodule + dos_header->e_lfanew);
+
+		ImageView view;
+		if (view.Attach(reinterpret_cast<const BYTE*>(hmodule), nt_headers->OptionalHeader.SizeOfImage, true).Result == ERROR_SUCCESS)
+			AddReadyToRunDependencies(view, path, module);
+	}
+
+	void Wrapper::AddReadyToRunDependencies(const ImageView& view, String^ path, ModuleBase^ module)
+	{
+		LS_READYTORUN_INFO info;
+		if (ReadyToRunReader::Read(view, info).Result != ERROR_SUCCESS || !info.IsReadyToRun)
+			return;
+
+		module->SetReadyToRun(info);
+
+		// The code of a component is in the composite image, next to it, or in the same bundle.
+		if (info.IsComponent && info.OwnerComposite.Length() > 0) {
+			String^ owner = GetStringFromUtf8(info.OwnerComposite.GetBuffer(), info.OwnerComposite.Length());
+			if (_bundle_entries != nullptr && _bundle_entries->ContainsKey(owner))
+				module->Dependencies->Add(gcnew DependencyEntry(owner, DependencySource::Bundle));
+			else if (!String::IsNullOrEmpty(path))
+				module->Dependencies->Add(gcnew DependencyEntry(Path::Combine(Path::GetDirectoryName(path), owner), DependencySource::ReadyToRun));
+			else
+				module->Dependencies->Add(gcnew DependencyEntry(owner, DependencySource::ReadyToRun));
+		}
+
+		// Components, and assemblies the compiled code depends on that the IL metadata might not reference.
+		Dictionary<String^, bool>^ existing = gcnew Dictionary<String^, bool>(StringComparer::OrdinalIgnoreCase);
+		for each (DependencyEntry^ entry in module->Dependencies)
+			existing[entry->Name] = true;
+
+		for (const WuString& name : info.ComponentAssemblies) {
+			String^ full_name = GetStringFromUtf8(name.GetBuffer(), name.Length());
+			if (existing->ContainsKey(full_name))
+				continue;
+
+			existing[full_name] = true;
+			module->Dependencies->Add(gcnew DependencyEntry(full_name, DependencySource::ReferencedAssemblies));
+		}
+
+		for (const WuString& name : info.ManifestReferences) {
+			String^ full_name = GetStringFromUtf8(name.GetBuffer(), name.Length());
+			if (existing->ContainsKey(full_name))
+				continue;
+
+			existing[full_name] = true;
+			module->Dependencies->Add(gcnew DependencyEntry(full_name, DependencySource::ReferencedAssemblies));
+		}
+	}
+
+	bool Wrapper::FindSxsModule(const WWuString& module_name, String^ importing_name, WWuString& module_path)
+	{
+		if (module_name.Contains(L'\\') || module_name.Contains(L'/'))
+			return false;
+
+		// The importing module's context, then the root's, like the native resolver.
+		if (!String::IsNullOrEmpty(importing_name)) {
+			auto context = _module_contexts->find(GetWideFromManagedString(importing_name).ToLower());
+			if (context != _module_contexts->end() && !context->second.empty() && GetSxsIndex()->FindModule(module_name, context->second, module_path))
+				return true;
+		}
+
+		if (_root_context->empty())
+			return false;
+
+		return GetSxsIndex()->FindModule(module_name, *_root_context, module_path);
+	}
+
+	SxsStoreIndex* Wrapper::GetSxsIndex()
+	{
+		// The store is only walked when a manifest asks for it.
+		if (_sxs == NULL)
+			_sxs = new SxsStoreIndex(GetSysroot(_sysroot));
+
+		return _sxs;
+	}
+
+	void Wrapper::AddBundledFiles(String^ path, ModuleBase^ module)
+	{
+		// Only the root can be the apphost of a bundle.
+		if (String::IsNullOrEmpty(path) || _bundle->Open(GetWideFromManagedString(path)).Result != ERROR_SUCCESS) {
+			_bundle->Close();
+			return;
+		}
+
+		// The host probes the bundle ignoring case.
+		_bundle_path = path;
+		_bundle_entries = gcnew Dictionary<String^, UInt32>(StringComparer::OrdinalIgnoreCase);
+		for (DWORD i = 0; i < _bundle->EntryCount(); i++) {
+			const LS_BUNDLE_ENTRY& entry = _bundle->GetEntry(i);
+			String^ relative_path = GetStringFromUtf8(entry.RelativePath, entry.PathLength);
+			_bundle_entries[relative_path] = i;
+
+			if (entry.Type == BundleFileAssembly || entry.Type == BundleFileNativeBinary)
+				module->Dependencies->Add(gcnew DependencyEntry(relative_path, DependencySource::Bundle));
+		}
+	}
+
+	ModuleBase^ Wrapper::GetBundledModule(String^ relative_path, Int32 depth)
+	{
+		// The path is the bundle, and the path in it.
+		String^ name = Path::GetFileName(relative_path);
+		String^ path = String::Concat(_bundle_path, "!", relative_path);
+
+		UInt32 index;
+		if (_bundle_entries == nullptr || !_bundle_entries->TryGetValue(relative_path, index))
+			return gcnew ModuleBase(name, path, String::Empty, false, false, gcnew NativeException(ERROR_FILE_NOT_FOUND));
+
+		// The same passes as for files on disk, on the range of the bundle mapping.
+		// Compressed entries are inflated as far as the tables go.
+		LONGLONG start = _tracer == NULL ? 0 : _tracer->Now();
+		const BYTE* data;
+		size_t size;
+		ImageView view;
+		auto basic_info = make_wushared<PeHelper::LS_IMAGE_BASIC_INFORMATION>();
+		LSRESULT result;
+		if (_bundle->GetEntryData(index, data, size))
+			result = view.Attach(data, size);
+		else if (_bundle->GetCompressedData(index, data, size))
+			result = Inflater::InflateImage(data, size, static_cast<size_t>(_bundle->GetEntry(index).Size), *_inflate_buffer, view);
+		else
+			result = LSRESULT(ERROR_BAD_FORMAT, L"Bundle entry data out of bounds.", __FILEW__, __LINE__);
+
+		if (result.Result == ERROR_SUCCESS) {
+			WorkBudget budget = CreateBudget();
+			view.GetBasicInformation(basic_info.get(), &budget);
+		}
+
+		if (_tracer != NULL)
+			_tracer->Record(TraceEventParse, GetWideFromManagedString(relative_path).GetBuffer(), depth, result.Result, basic_info->BytesRead, start);
+
+		if (result.Result != ERROR_SUCCESS)
+			return gcnew ModuleBase(name, path, String::Empty, false, false, gcnew NativeException(result));
+
+		// Imports of other embedded files are resolved from the bundle.
+		ModuleBase^ output = gcnew ModuleBase(name, path, String::Empty, true, nullptr, basic_info.get());
+		for (Int32 i = 0; i < output->Dependencies->Count; i++) {
+			if (_bundle_entries->ContainsKey(output->Dependencies[i]->Name))
+				output->Dependencies[i] = gcnew DependencyEntry(output->Dependencies[i]->Name, DependencySource::Bundle);
+		}
+
+		const BYTE* metadata_data;
+		DWORD metadata_size;
+		MetadataReader metadata;
+		if (!view.GetMetadata(metadata_data, metadata_size) || metadata.Attach(metadata_data, metadata_size).Result != ERROR_SUCCESS) {
+
+			// Composite images have no metadata of their own.
+			AddReadyToRunDependencies(view, nullptr, output);
+			return output;
+		}
+
+		LS_ASSEMBLY_REFERENCE assembly;
+		if (metadata.GetAssembly(assembly)) {
+			WuString full_name = assembly.GetFullName();
+			output->AssemblyFullName = GetStringFromUtf8(full_name.GetBuffer(), full_name.Length());
+		}
+
+		// So are references to assemblies in the bundle. The others go through reflection, like any other assembly.
+		wuvector<LS_ASSEMBLY_REFERENCE> references;
+		metadata.GetAssemblyReferences(references);
+		for (const LS_ASSEMBLY_REFERENCE& reference : references) {
+			String^ file_name = String::Concat(GetStringFromUtf8(reference.Name, strlen(reference.Name)), ".dll");
+			if (_bundle_entries->ContainsKey(file_name)) {
+				output->Dependencies->Add(gcnew DependencyEntry(file_name, DependencySource::Bundle));
+				continue;
+			}
+
+			WuString full_name = reference.GetFullName();
+			output->Dependencies->Add(gcnew DependencyEntry(GetStringFromUtf8(full_name.GetBuffer(), full_name.Length()), DependencySource::ReferencedAssemblies));
+		}
+
+		AddReadyToRunDependencies(view, nullptr, output);
+
+		return output;
+	}
+
+	ModuleBase^ Wrapper::GetDependencyListCore(String^ file_name, DependencySource source, Int32 depth, String^ importing_name)
+	{
+		if (depth == 0) {
+			_root_context->clear();
+			_module_contexts->clear();
+			_bundle->Close();
+			_bundle_path = nullptr;
+			_bundle_entries = nullptr;
+			if (_limits != nullptr)
+				_limits->Start();
+		}
+
+		// Embedded files are not on disk.
+		if (source == DependencySource::Bundle)
+			return GetBundledModule(file_name, depth);
+
 		String^ name;
 		String^ path;
+		WWuString sxs_path;
 		WWuString wrapped_path = GetWideFromManagedString(file_name);
 		if (PathFileExists(wrapped_path.GetBuffer()))
 		{
 			name = Path::GetFileName(file_name);
 			path = file_name;
 		}
+		else if (FindSxsModule(wrapped_path, importing_name, sxs_path))
+		{
+			// Side-by-side redirection comes before the search order.
+			name = file_name;
+			path = gcnew String(sxs_path.GetBuffer());
+			wrapped_path = sxs_path;
+		}
 		else
 		{
 			name = file_name;
@@ -23,7 +408,7 @@ namespace LibSnitcher::Core
 		HMODULE hmodule;
 		ModuleBase^ output;
 		Assembly^ assembly;
-		if (source == DependencySource::None || source == DependencySource::PeTables)
+		if (source == DependencySource::None || source == DependencySource::PeTables || source == DependencySource::Heuristic || source == DependencySource::ReadyToRun)
 		{
 			// Attempting to get a module handle.
 			DWORD last_error;
@@ -63,11 +448,13 @@ namespace LibSnitcher::Core
 
 				// Attempting to get basic PE information.
 				auto basic_info = make_wushared<PeHelper::LS_IMAGE_BASIC_INFORMATION>();
-				LSRESULT result = pe_helper->GetImageBasicInformation(hmodule, basic_info.get());
+				LSRESULT result = GetBasicInformation(hmodule, name, depth, basic_info.get());
 				if (result.Result != ERROR_SUCCESS)
 					return gcnew ModuleBase(name, path, assembly->FullName, true, true, gcnew NativeException(result));
 
 				output = gcnew ModuleBase(name, path, assembly->FullName, true, nullptr, basic_info.get());
+				ReadResources(hmodule, basic_info.get(), output, depth);
+				ScanModuleNames(hmodule, basic_info.get(), output);
 
 				for each (AssemblyName ^ ref_ass in assembly->GetReferencedAssemblies())
 					output->Dependencies->Add(gcnew DependencyEntry(ref_ass->FullName, DependencySource::ReferencedAssemblies));
@@ -82,11 +469,13 @@ namespace LibSnitcher::Core
 
 				// Attempting to get basic PE information.
 				auto basic_info = make_wushared<PeHelper::LS_IMAGE_BASIC_INFORMATION>();
-				LSRESULT result = pe_helper->GetImageBasicInformation(hmodule, basic_info.get());
+				LSRESULT result = GetBasicInformation(hmodule, name, depth, basic_info.get());
 				if (result.Result != ERROR_SUCCESS)
 					return gcnew ModuleBase(name, path, assembly->FullName, true, false, gcnew NativeException(result));
 
 				output = gcnew ModuleBase(name, path, String::Empty, true, nullptr, basic_info.get());
+				ReadResources(hmodule, basic_info.get(), output, depth);
+				ScanModuleNames(hmodule, basic_info.get(), output);
 
 				// Attempting to get the managed referenced assemblies list.
 				if (basic_info->IsClr)
@@ -120,11 +509,13 @@ namespace LibSnitcher::Core
 					return gcnew ModuleBase(name, path, assembly->FullName, true, true, loader_exception);
 
 				auto basic_info = make_wushared<PeHelper::LS_IMAGE_BASIC_INFORMATION>();
-				LSRESULT result = pe_helper->GetImageBasicInformation(hmodule, basic_info.get());
+				LSRESULT result = GetBasicInformation(hmodule, name, depth, basic_info.get());
 				if (result.Result != ERROR_SUCCESS)
 					return gcnew ModuleBase(name, path, assembly->FullName, true, true, gcnew NativeException(result));
 
 				output = gcnew ModuleBase(name, path, assembly->FullName, true, nullptr, basic_info.get());
+				ReadResources(hmodule, basic_info.get(), output, depth);
+				ScanModuleNames(hmodule, basic_info.get(), output);
 				
 				for each (AssemblyName ^ ref_ass in assembly->GetReferencedAssemblies())
 					output->Dependencies->Add(gcnew DependencyEntry(ref_ass->FullName, DependencySource::ReferencedAssemblies));
@@ -136,11 +527,13 @@ namespace LibSnitcher::Core
 					return gcnew ModuleBase(name, path, nullptr, false, true, loader_exception);
 
 				auto basic_info = make_wushared<PeHelper::LS_IMAGE_BASIC_INFORMATION>();
-				LSRESULT result = pe_helper->GetImageBasicInformation(hmodule, basic_info.get());
+				LSRESULT result = GetBasicInformation(hmodule, name, depth, basic_info.get());
 				if (result.Result != ERROR_SUCCESS)
 					return gcnew ModuleBase(name, path, nullptr, true, true, gcnew NativeException(result));
 
 				output = gcnew ModuleBase(name, path, String::Empty, true, nullptr, basic_info.get());
+				ReadResources(hmodule, basic_info.get(), output, depth);
+				ScanModuleNames(hmodule, basic_info.get(), output);
 
 				if (basic_info->IsClr)
 				{
@@ -156,11 +549,795 @@ namespace LibSnitcher::Core
 			}
 		}
 		
+		ReadReadyToRun(hmodule, path, output);
 		FreeLibrary(hmodule);
 
+		if (depth == 0)
+			AddBundledFiles(path, output);
+
 		return output;
 	}
 
+	ResolvedChain::ResolvedChain(wuvector<BYTE>* buffer)
+		: _buffer(buffer), _reader(new ChainBufferReader())
+	{
+		LSRESULT result = _reader->Attach(_buffer->data(), _buffer->size());
+		if (result.Result != ERROR_SUCCESS) {
+			this->!ResolvedChain();
+			throw gcnew NativeException(result);
+		}
+
+		_names = gcnew array<String^>(static_cast<Int32>(_reader->NodeCount()));
+	}
+
+	Int32 ResolvedChain::FindNode(String^ name)
+	{
+		DWORD index;
+		if (String::IsNullOrEmpty(name) || !_reader->FindNode(GetWideFromManagedString(name), index))
+			return -1;
+
+		return static_cast<Int32>(index);
+	}
+
+	String^ ResolvedChain::GetName(Int32 node)
+	{
+		const LS_CHAIN_NODE& chain_node = GetNode(node);
+		if (_names[node] == nullptr)
+			_names[node] = gcnew String(_reader->GetString(chain_node.NameOffset));
+
+		return _names[node];
+	}
+
+	String^ ResolvedChain::GetPath(Int32 node)
+	{
+		LPCWSTR path = _reader->GetString(GetNode(node).PathOffset);
+
+		return path[0] == L'\0' ? nullptr : gcnew String(path);
+	}
+
+	Exception^ ResolvedChain::GetLoaderException(Int32 node)
+	{
+		LONG result = GetNode(node).Result;
+
+		return result == ERROR_SUCCESS ? nullptr : gcnew NativeException(result);
+	}
+
+	const LS_CHAIN_NODE& ResolvedChain::GetNode(Int32 node)
+	{
+		if (node < 0 || node >= static_cast<Int32>(_reader->NodeCount()))
+			throw gcnew ArgumentOutOfRangeException("node");
+
+		return _reader->GetNode(static_cast<DWORD>(node));
+	}
+
+	const LS_CHAIN_EDGE& ResolvedChain::GetEdge(Int32 node, Int32 index)
+	{
+		const LS_CHAIN_NODE& chain_node = GetNode(node);
+		if (index < 0 || index >= static_cast<Int32>(chain_node.EdgeCount))
+			throw gcnew ArgumentOutOfRangeException("index");
+
+		return _reader->GetEdge(chain_node.FirstEdge + static_cast<DWORD>(index));
+	}
+
+	String^ ResolvedChain::GetVersionString(Int32 node, DWORD offset)
+	{
+		if ((GetNode(node).Flags & LS_CHAIN_NODE_FLAG_VERSION) == 0)
+			return nullptr;
+
+		return gcnew String(_reader->GetString(offset));
+	}
+
+	DaemonHost::DaemonHost(String^ sysroot)
+		: _daemon(new ResolverDaemon(GetSysroot(sysroot))) { }
+
+	DaemonHost::~DaemonHost()
+	{
+		this->!DaemonHost();
+	}
+
+	DaemonHost::!DaemonHost()
+	{
+		if (_daemon != NULL) {
+			delete _daemon;
+			_daemon = NULL;
+		}
+	}
+
+	void DaemonHost::Start(String^ socket_path)
+	{
+		if (String::IsNullOrEmpty(socket_path))
+			throw gcnew ArgumentNullException("Socket path cannot be null or empty.");
+
+		LSRESULT result = _daemon->Start(GetWideFromManagedString(socket_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+	}
+
+	void DaemonHost::Stop()
+	{
+		if (_daemon != NULL)
+			_daemon->Stop();
+	}
+
+	Int32 DependencySnapshot::Export(String^ file_name, Int32 depth, String^ file_path, String^ sysroot)
+	{
+		if (String::IsNullOrEmpty(file_name))
+			throw gcnew ArgumentNullException("File name cannot be null or empty.");
+
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("Snapshot path cannot be null or empty.");
+
+		if (depth < 0)
+			throw gcnew ArgumentOutOfRangeException("depth");
+
+		DirectoryIndex index;
+		ImageCache cache;
+		SxsStoreIndex sxs(GetSysroot(sysroot));
+		Resolver resolver(&index, &cache, NULL, true, &sxs);
+		LS_RESOLVED_GRAPH graph;
+		LSRESULT result = resolver.ResolveChain(GetWideFromManagedString(file_name), static_cast<DWORD>(depth), &graph);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		result = SnapshotWriter::Write(graph, GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return static_cast<Int32>(graph.Nodes.size());
+	}
+
+	List<SnapshotDiffEntry^>^ DependencySnapshot::Compare(String^ reference_path, String^ difference_path)
+	{
+		if (String::IsNullOrEmpty(reference_path) || String::IsNullOrEmpty(difference_path))
+			throw gcnew ArgumentNullException("Snapshot path cannot be null or empty.");
+
+		SnapshotReader reference;
+		LSRESULT result = reference.Open(GetWideFromManagedString(reference_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		SnapshotReader difference;
+		result = difference.Open(GetWideFromManagedString(difference_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		wuvector<LS_DIFF_ENTRY> entries;
+		result = SnapshotDiff::Compare(reference, difference, entries);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		List<SnapshotDiffEntry^>^ output = gcnew List<SnapshotDiffEntry^>(static_cast<Int32>(entries.size()));
+		for (LS_DIFF_ENTRY& entry : entries) {
+			output->Add(gcnew SnapshotDiffEntry(
+				static_cast<SnapshotDiffKind>(entry.Kind),
+				gcnew String(entry.Module.GetBuffer()),
+				entry.Target.Length() > 0 ? gcnew String(entry.Target.GetBuffer()) : nullptr,
+				static_cast<SnapshotHeaderField>(entry.Fields)
+			));
+		}
+
+		return output;
+	}
+
+	ImageDigest^ AuthenticodeHasher::Hash(String^ file_path, PageHashAlgorithm page_algorithm)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		ImageHasher hasher;
+		LS_IMAGE_DIGEST digest;
+		LSRESULT result = hasher.HashFile(GetWideFromManagedString(file_path), static_cast<LS_PAGE_HASH_ALGORITHM>(page_algorithm), &digest);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return gcnew ImageDigest(file_path, &digest);
+	}
+
+	ImageSignature^ AuthenticodeSignature::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		SignatureReader reader(&SignatureCache::Shared());
+		wushared_ptr<LS_SIGNATURE_INFO> signature;
+		LSRESULT result = reader.GetSignature(GetWideFromManagedString(file_path), signature);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return gcnew ImageSignature(file_path, *signature);
+	}
+
+	DebugEntry::DebugEntry(const LS_DEBUG_ENTRY& entry)
+		: _type(entry.Type), _time_date_stamp(GetDateTimeFromTimeT(entry.TimeDateStamp)), _size_of_data(entry.SizeOfData),
+			_address_of_raw_data(entry.AddressOfRawData), _pointer_to_raw_data(entry.PointerToRawData)
+	{
+		_version = String::Format("{0}.{1}", entry.MajorVersion, entry.MinorVersion);
+	}
+
+	ImageDebugInfo::ImageDebugInfo(String^ path, const LS_DEBUG_INFO& debug_info)
+		: _path(path), _is_deterministic(debug_info.IsDeterministic), _has_embedded_pdb(debug_info.HasEmbeddedPdb),
+			_embedded_pdb_size(debug_info.EmbeddedPdbSize), _embedded_pdb_uncompressed_size(debug_info.EmbeddedPdbUncompressedSize)
+	{
+		_entries = gcnew List<DebugEntry^>(static_cast<Int32>(debug_info.Entries.size()));
+		for (const LS_DEBUG_ENTRY& entry : debug_info.Entries)
+			_entries->Add(gcnew DebugEntry(entry));
+
+		_codeview = gcnew List<CodeViewInfo^>(static_cast<Int32>(debug_info.CodeView.size()));
+		for (const LS_CODEVIEW_INFO& codeview : debug_info.CodeView)
+			_codeview->Add(gcnew CodeViewInfo(codeview));
+
+		_pogo = gcnew List<PogoEntry^>(static_cast<Int32>(debug_info.Pogo.size()));
+		for (const LS_POGO_ENTRY& entry : debug_info.Pogo)
+			_pogo->Add(gcnew PogoEntry(entry));
+
+		// Repro entries from older linkers have no hash.
+		if (!debug_info.ReproHash.empty()) {
+			array<Byte>^ bytes = gcnew array<Byte>(static_cast<Int32>(debug_info.ReproHash.size()));
+			Marshal::Copy(IntPtr(const_cast<BYTE*>(debug_info.ReproHash.data())), bytes, 0, bytes->Length);
+			_repro_hash = BitConverter::ToString(bytes)->Replace("-", String::Empty);
+		}
+	}
+
+	ImageDebugInfo^ DebugDirectory::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		DebugDirectoryReader reader;
+		LS_DEBUG_INFO debug_info;
+		LSRESULT result = reader.Read(GetWideFromManagedString(file_path), DebugReadAll, &debug_info);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return gcnew ImageDebugInfo(file_path, debug_info);
+	}
+
+	List<SymbolKeyInfo^>^ DebugDirectory::GetSymbolKeys(IEnumerable<String^>^ file_paths, Int32 thread_count)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		if (thread_count < 0)
+			throw gcnew ArgumentOutOfRangeException("thread_count");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		wuvector<LS_SYMBOL_KEY> keys;
+		DebugDirectoryReader::ReadSymbolKeys(paths, static_cast<DWORD>(thread_count), keys);
+
+		List<SymbolKeyInfo^>^ output = gcnew List<SymbolKeyInfo^>(static_cast<Int32>(keys.size()));
+		for (const LS_SYMBOL_KEY& key : keys) {
+			String^ path = gcnew String(key.Path.GetBuffer());
+			if (key.Result != ERROR_SUCCESS)
+				output->Add(gcnew SymbolKeyInfo(path, nullptr, nullptr, gcnew NativeException(key.Result)));
+			else
+				output->Add(gcnew SymbolKeyInfo(path, gcnew String(key.Key.GetBuffer()), gcnew CodeViewInfo(key.CodeView), nullptr));
+		}
+
+		return output;
+	}
+
+	RichHeaderInfo^ RichHeader::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		RichHeaderReader reader;
+		LS_RICH_HEADER rich_header;
+		LSRESULT result = reader.Read(GetWideFromManagedString(file_path), &rich_header);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return gcnew RichHeaderInfo(file_path, rich_header);
+	}
+
+	ToolchainReport^ RichHeader::Aggregate(IEnumerable<String^>^ file_paths)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		ToolchainAggregate aggregate;
+		LSRESULT result = aggregate.AddFiles(paths);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		wuvector<LS_TOOLCHAIN_COUNT> counts;
+		aggregate.GetCounts(counts);
+
+		List<ToolchainCount^>^ output = gcnew List<ToolchainCount^>(static_cast<Int32>(counts.size()));
+		for (const LS_TOOLCHAIN_COUNT& count : counts)
+			output->Add(gcnew ToolchainCount(count));
+
+		wuvector<LS_TOOLCHAIN_FAILURE> failures;
+		aggregate.GetFailures(failures);
+
+		List<ToolchainFailure^>^ failure_list = gcnew List<ToolchainFailure^>(static_cast<Int32>(failures.size()));
+		for (const LS_TOOLCHAIN_FAILURE& failure : failures)
+			failure_list->Add(gcnew ToolchainFailure(gcnew String(failure.Path.GetBuffer()), gcnew NativeException(failure.Result)));
+
+		return gcnew ToolchainReport(output, failure_list);
+	}
+
+	ChainLoadCost^ LoadCost::Measure(String^ file_name, Int32 depth, String^ sysroot)
+	{
+		if (String::IsNullOrEmpty(file_name))
+			throw gcnew ArgumentNullException("File name cannot be null or empty.");
+
+		if (depth < 0)
+			throw gcnew ArgumentOutOfRangeException("depth");
+
+		DirectoryIndex index;
+		ImageCache cache;
+		SxsStoreIndex sxs(GetSysroot(sysroot));
+		Resolver resolver(&index, &cache, NULL, false, &sxs);
+		LS_RESOLVED_GRAPH graph;
+		LSRESULT result = resolver.ResolveChain(GetWideFromManagedString(file_name), static_cast<DWORD>(depth), &graph);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		LS_CHAIN_LOAD_COST chain_cost;
+		Resolver::GetLoadCost(graph, chain_cost);
+
+		List<ModuleLoadCost^>^ modules = gcnew List<ModuleLoadCost^>(static_cast<Int32>(graph.Nodes.size()));
+		for (const LS_RESOLVED_NODE& node : graph.Nodes) {
+			if (node.Image != nullptr && node.Image->Result == ERROR_SUCCESS)
+				modules->Add(gcnew ModuleLoadCost(gcnew String(node.Name.GetBuffer()), gcnew String(node.Path.GetBuffer()), node.Image->LoadCost));
+		}
+
+		return gcnew ChainLoadCost(file_name, chain_cost, modules);
+	}
+
+	List<FunctionMatch^>^ FunctionTable::Lookup(String^ file_path, IEnumerable<UInt32>^ rvas, bool include_unwind)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		if (rvas == nullptr)
+			throw gcnew ArgumentNullException("rvas");
+
+		wuvector<DWORD> queries;
+		for each (UInt32 rva in rvas)
+			queries.push_back(rva);
+
+		FunctionIndex index;
+		LSRESULT result = index.Open(GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		wuvector<LS_FUNCTION_MATCH> matches;
+		index.LookupBatch(queries, matches);
+
+		List<FunctionMatch^>^ output = gcnew List<FunctionMatch^>(static_cast<Int32>(matches.size()));
+		for (const LS_FUNCTION_MATCH& match : matches) {
+			UnwindInfo^ unwind = nullptr;
+			if (include_unwind && match.Found) {
+				LS_UNWIND_INFO unwind_info;
+				if (index.GetUnwindInfo(match.Function, unwind_info).Result == ERROR_SUCCESS)
+					unwind = gcnew UnwindInfo(unwind_info);
+			}
+
+			output->Add(gcnew FunctionMatch(file_path, match, unwind));
+		}
+
+		return output;
+	}
+
+	CoffObjectInfo^ CoffFile::Get(String^ file_path, bool include_relocations)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		CoffObject object;
+		LSRESULT result = object.Open(GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		List<CoffSection^>^ sections = gcnew List<CoffSection^>(static_cast<Int32>(object.SectionCount()));
+		for (DWORD i = 0; i < object.SectionCount(); i++) {
+			const char* name;
+			DWORD name_length;
+			String^ section_name = String::Empty;
+			if (object.GetSectionName(i, name, name_length))
+				section_name = gcnew String(const_cast<char*>(name), 0, static_cast<Int32>(name_length));
+
+			List<CoffRelocation^>^ relocations = nullptr;
+			const IMAGE_RELOCATION* entries;
+			DWORD count;
+			if (include_relocations && object.GetRelocations(i, entries, count)) {
+				relocations = gcnew List<CoffRelocation^>(static_cast<Int32>(count));
+				for (DWORD j = 0; j < count; j++)
+					relocations->Add(gcnew CoffRelocation(entries[j]));
+			}
+
+			sections->Add(gcnew CoffSection(section_name, *object.GetSection(i), relocations));
+		}
+
+		List<CoffSymbol^>^ symbols = gcnew List<CoffSymbol^>();
+		DWORD index = 0;
+		LS_COFF_SYMBOL symbol;
+		DWORD record_size = object.IsBigObj() ? sizeof(IMAGE_SYMBOL_EX) : sizeof(IMAGE_SYMBOL);
+		while (object.NextSymbol(index, symbol)) {
+			array<Byte>^ aux_data = gcnew array<Byte>(symbol.AuxCount * record_size);
+			if (aux_data->Length > 0)
+				Marshal::Copy(IntPtr(const_cast<BYTE*>(symbol.AuxData)), aux_data, 0, aux_data->Length);
+
+			symbols->Add(gcnew CoffSymbol(gcnew String(const_cast<char*>(symbol.Name), 0, static_cast<Int32>(symbol.NameLength)), symbol, aux_data));
+		}
+
+		return gcnew CoffObjectInfo(file_path, object.Machine(), object.IsBigObj(), GetDateTimeFromTimeT(object.TimeDateStamp()), sections, symbols);
+	}
+
+	CoffScanReport^ CoffFile::Scan(IEnumerable<String^>^ file_paths, Int32 thread_count, bool unresolved_only)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		if (thread_count < 0)
+			throw gcnew ArgumentOutOfRangeException("thread_count");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		wuvector<LS_COFF_SCAN_RESULT> results;
+		wuvector<LS_COFF_SYMBOL_USAGE> usages;
+		CoffObject::Scan(paths, static_cast<DWORD>(thread_count), results, usages);
+
+		List<CoffObjectSummary^>^ objects = gcnew List<CoffObjectSummary^>(static_cast<Int32>(results.size()));
+		for (const LS_COFF_SCAN_RESULT& result : results)
+			objects->Add(gcnew CoffObjectSummary(result, result.Result == ERROR_SUCCESS ? nullptr : gcnew NativeException(result.Result)));
+
+		List<CoffSymbolUsage^>^ symbols = gcnew List<CoffSymbolUsage^>();
+		for (const LS_COFF_SYMBOL_USAGE& usage : usages) {
+			if (!unresolved_only || usage.DefinitionCount == 0)
+				symbols->Add(gcnew CoffSymbolUsage(usage));
+		}
+
+		return gcnew CoffScanReport(objects, symbols);
+	}
+
+	LibraryInfo^ StaticLibrary::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		ArchiveReader reader;
+		LSRESULT result = reader.Open(GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		// Object members are attached in place, not extracted.
+		CoffObject object;
+		List<LibraryMember^>^ members = gcnew List<LibraryMember^>(static_cast<Int32>(reader.MemberCount()));
+		for (DWORD i = 0; i < reader.MemberCount(); i++) {
+			const LS_ARCHIVE_MEMBER& member = reader.GetMember(i);
+			String^ name = gcnew String(const_cast<char*>(member.Name), 0, static_cast<Int32>(member.NameLength));
+
+			LS_IMPORT_ENTRY entry;
+			if (reader.GetImportEntry(i, entry)) {
+				String^ import_name = entry.ImportName == NULL ? nullptr : gcnew String(const_cast<char*>(entry.ImportName), 0, static_cast<Int32>(entry.ImportNameLength));
+				String^ module = gcnew String(const_cast<char*>(entry.Module), 0, static_cast<Int32>(entry.ModuleLength));
+				members->Add(gcnew LibraryMember(name, member, entry.Machine, 1, module, import_name, entry.OrdinalOrHint));
+			}
+			else if (reader.OpenObject(i, object).Result == ERROR_SUCCESS)
+				members->Add(gcnew LibraryMember(name, member, object.Machine(), object.SymbolCount(), nullptr, nullptr, 0));
+			else
+				members->Add(gcnew LibraryMember(name, member, 0, 0, nullptr, nullptr, 0));
+		}
+
+		return gcnew LibraryInfo(file_path, members, reader.SymbolCount());
+	}
+
+	List<LibraryIndex^>^ StaticLibrary::GetSymbols(IEnumerable<String^>^ file_paths, Int32 thread_count)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		if (thread_count < 0)
+			throw gcnew ArgumentOutOfRangeException("thread_count");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		wuvector<LS_LIBRARY_INDEX> indexes;
+		ArchiveReader::IndexBatch(paths, static_cast<DWORD>(thread_count), indexes);
+
+		List<LibraryIndex^>^ output = gcnew List<LibraryIndex^>(static_cast<Int32>(indexes.size()));
+		for (const LS_LIBRARY_INDEX& index : indexes)
+			output->Add(gcnew LibraryIndex(index, index.Result == ERROR_SUCCESS ? nullptr : gcnew NativeException(index.Result)));
+
+		return output;
+	}
+
+	static List<DuplicateSet^>^ GetDuplicateSets(const wuvector<LS_DUPLICATE_SET>& sets, const wuvector<WWuString>& paths)
+	{
+		List<DuplicateSet^>^ output = gcnew List<DuplicateSet^>(static_cast<Int32>(sets.size()));
+		for (const LS_DUPLICATE_SET& set : sets) {
+			List<String^>^ set_paths = gcnew List<String^>(static_cast<Int32>(set.Files.size()));
+			for (DWORD file : set.Files)
+				set_paths->Add(gcnew String(paths[file].GetBuffer()));
+
+			output->Add(gcnew DuplicateSet(set, set_paths));
+		}
+
+		return output;
+	}
+
+	SymbolHashReport^ SymbolHash::Compute(IEnumerable<String^>^ file_paths, Int32 thread_count, bool deduplicate)
+	{
+		return Compute(file_paths, thread_count, deduplicate, nullptr);
+	}
+
+	SymbolHashReport^ SymbolHash::Compute(IEnumerable<String^>^ file_paths, Int32 thread_count, bool deduplicate, ScanLimits^ limits)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		if (thread_count < 0)
+			throw gcnew ArgumentOutOfRangeException("thread_count");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		wuvector<LS_SYMBOL_HASH_RESULT> results;
+		wuvector<LS_SYMBOL_HASH_GROUP> groups;
+		wuvector<LS_DUPLICATE_SET> duplicates;
+		if (limits != nullptr) {
+			limits->Start();
+			SymbolHasher::HashBatch(paths, static_cast<DWORD>(thread_count), results, groups, deduplicate ? &duplicates : NULL,
+				&limits->GetLimits(), limits->GetToken());
+		}
+		else
+			SymbolHasher::HashBatch(paths, static_cast<DWORD>(thread_count), results, groups, deduplicate ? &duplicates : NULL);
+
+		List<ImageSymbolHash^>^ images = gcnew List<ImageSymbolHash^>(static_cast<Int32>(results.size()));
+		for (const LS_SYMBOL_HASH_RESULT& result : results)
+			images->Add(gcnew ImageSymbolHash(result, result.Result == ERROR_SUCCESS ? nullptr : gcnew NativeException(result.Result)));
+
+		List<SymbolHashGroup^>^ output = gcnew List<SymbolHashGroup^>(static_cast<Int32>(groups.size()));
+		for (const LS_SYMBOL_HASH_GROUP& group : groups) {
+			List<String^>^ group_paths = gcnew List<String^>(static_cast<Int32>(group.Files.size()));
+			for (DWORD file : group.Files)
+				group_paths->Add(images[static_cast<Int32>(file)]->Path);
+
+			if (group.Kind == SymbolHashImport)
+				output->Add(gcnew SymbolHashGroup(SymbolHashKind::Import, ImageSymbolHash::ToImportHashString(group.ImportHash), group_paths));
+			else
+				output->Add(gcnew SymbolHashGroup(SymbolHashKind::Export, UInt64(group.ExportHash).ToString("x16"), group_paths));
+		}
+
+		return gcnew SymbolHashReport(images, output, GetDuplicateSets(duplicates, paths));
+	}
+
+	List<DuplicateSet^>^ ContentDedup::Find(IEnumerable<String^>^ file_paths, Int32 thread_count)
+	{
+		if (file_paths == nullptr)
+			throw gcnew ArgumentNullException("file_paths");
+
+		if (thread_count < 0)
+			throw gcnew ArgumentOutOfRangeException("thread_count");
+
+		wuvector<WWuString> paths;
+		for each (String^ file_path in file_paths) {
+			if (!String::IsNullOrEmpty(file_path))
+				paths.push_back(GetWideFromManagedString(file_path));
+		}
+
+		wuvector<LS_DEDUP_FILE> files;
+		wuvector<LS_DUPLICATE_SET> sets;
+		ContentDeduplicator::Deduplicate(paths, static_cast<DWORD>(thread_count), files, sets);
+
+		return GetDuplicateSets(sets, paths);
+	}
+
+	// The imports, and the CLR metadata of an image read in place, from a bundle, or a package.
+	static String^ ReadEmbeddedImage(const ImageView& view, List<String^>^ imports, List<String^>^ references, List<String^>^ pinvoke_modules, Exception^% error)
+	{
+		PeHelper::LS_IMAGE_BASIC_INFORMATION basic_info;
+		view.GetBasicInformation(&basic_info);
+		for (WuString& dependency : basic_info.Dependencies)
+			imports->Add(gcnew String(dependency.GetBuffer()));
+
+		const BYTE* metadata_data;
+		DWORD metadata_size;
+		if (!view.GetMetadata(metadata_data, metadata_size))
+			return nullptr;
+
+		MetadataReader metadata;
+		LSRESULT result = metadata.Attach(metadata_data, metadata_size);
+		if (result.Result != ERROR_SUCCESS) {
+			error = gcnew NativeException(result);
+			return nullptr;
+		}
+
+		String^ assembly_full_name = nullptr;
+		LS_ASSEMBLY_REFERENCE assembly;
+		if (metadata.GetAssembly(assembly)) {
+			WuString full_name = assembly.GetFullName();
+			assembly_full_name = GetStringFromUtf8(full_name.GetBuffer(), full_name.Length());
+		}
+
+		wuvector<LS_ASSEMBLY_REFERENCE> assembly_references;
+		metadata.GetAssemblyReferences(assembly_references);
+		for (const LS_ASSEMBLY_REFERENCE& reference : assembly_references) {
+			WuString full_name = reference.GetFullName();
+			references->Add(GetStringFromUtf8(full_name.GetBuffer(), full_name.Length()));
+		}
+
+		wuvector<WuString> modules;
+		metadata.GetModuleReferences(modules);
+		for (WuString& module : modules)
+			pinvoke_modules->Add(GetStringFromUtf8(module.GetBuffer(), module.Length()));
+
+		return assembly_full_name;
+	}
+
+	// Package entries are parsed by extension, the other files are never inflated.
+	static bool IsImageName(String^ name)
+	{
+		Int32 dot = name->LastIndexOf(L'.');
+		if (dot < 0 || dot < name->LastIndexOf(L'/'))
+			return false;
+
+		String^ extension = name->Substring(dot);
+		for each (String^ image_extension in gcnew array<String^> { ".dll", ".exe", ".sys", ".ocx", ".cpl", ".drv", ".efi", ".winmd" }) {
+			if (String::Equals(extension, image_extension, StringComparison::OrdinalIgnoreCase))
+				return true;
+		}
+
+		return false;
+	}
+
+	BundleInfo^ SingleFileBundle::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		BundleReader reader;
+		LSRESULT result = reader.Open(GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		wuvector<BYTE> buffer;
+		List<BundleEntry^>^ entries = gcnew List<BundleEntry^>(static_cast<Int32>(reader.EntryCount()));
+		for (DWORD i = 0; i < reader.EntryCount(); i++) {
+			const LS_BUNDLE_ENTRY& entry = reader.GetEntry(i);
+			BundleEntry^ output = gcnew BundleEntry(GetStringFromUtf8(entry.RelativePath, entry.PathLength), entry);
+			entries->Add(output);
+			if (entry.Type != BundleFileAssembly && entry.Type != BundleFileNativeBinary)
+				continue;
+
+			// Embedded files are ranges of the bundle mapping. Compressed ones are inflated as far as the tables go.
+			const BYTE* data;
+			size_t size;
+			ImageView view;
+			LSRESULT entry_result;
+			if (reader.GetEntryData(i, data, size))
+				entry_result = view.Attach(data, size);
+			else if (reader.GetCompressedData(i, data, size))
+				entry_result = Inflater::InflateImage(data, size, static_cast<size_t>(entry.Size), buffer, view);
+			else
+				entry_result = LSRESULT(ERROR_BAD_FORMAT, L"Bundle entry data out of bounds.", __FILEW__, __LINE__);
+
+			if (entry_result.Result != ERROR_SUCCESS) {
+				output->SetError(gcnew NativeException(entry_result));
+				continue;
+			}
+
+			Exception^ error = nullptr;
+			String^ assembly_full_name = ReadEmbeddedImage(view, output->Imports, output->References, output->PInvokeModules, error);
+			if (error != nullptr)
+				output->SetError(error);
+
+			output->SetImage(view.Machine(), view.IsClr(), assembly_full_name);
+		}
+
+		DWORD bundle_id_length;
+		const char* bundle_id = reader.BundleId(bundle_id_length);
+
+		return gcnew BundleInfo(file_path, reader, GetStringFromUtf8(bundle_id, bundle_id_length), entries);
+	}
+
+	PackageInfo^ PackageArchive::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		ZipReader reader;
+		LSRESULT result = reader.Open(GetWideFromManagedString(file_path));
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		wuvector<BYTE> buffer;
+		List<PackageEntry^>^ entries = gcnew List<PackageEntry^>(static_cast<Int32>(reader.EntryCount()));
+		for (DWORD i = 0; i < reader.EntryCount(); i++) {
+			const LS_ZIP_ENTRY& entry = reader.GetEntry(i);
+			PackageEntry^ output = gcnew PackageEntry(GetStringFromUtf8(entry.Name, entry.NameLength), entry);
+			entries->Add(output);
+			if (reader.IsDirectory(i) || !IsImageName(output->Name))
+				continue;
+
+			if (entry.Flags & LS_ZIP_FLAG_ENCRYPTED) {
+				output->SetError(gcnew NativeException(ERROR_NOT_SUPPORTED, "Encrypted entries are not read."));
+				continue;
+			}
+
+			const BYTE* data;
+			size_t size;
+			if (!reader.GetEntryData(i, data, size)) {
+				output->SetError(gcnew NativeException(ERROR_BAD_FORMAT, "Entry data out of bounds."));
+				continue;
+			}
+
+			// Stored entries are the image itself, in the mapping.
+			ImageView view;
+			UInt64 bytes_inflated = 0;
+			if (entry.Method == LS_ZIP_METHOD_STORED)
+				result = view.Attach(data, size);
+			else if (entry.Method == LS_ZIP_METHOD_DEFLATE) {
+				result = Inflater::InflateImage(data, size, static_cast<size_t>(entry.UncompressedSize), buffer, view);
+				if (result.Result == ERROR_SUCCESS)
+					bytes_inflated = view.Size();
+			}
+			else {
+				output->SetError(gcnew NativeException(ERROR_NOT_SUPPORTED, "Only stored, and deflated entries are read."));
+				continue;
+			}
+
+			if (result.Result != ERROR_SUCCESS) {
+				output->SetError(gcnew NativeException(result));
+				continue;
+			}
+
+			Exception^ error = nullptr;
+			String^ assembly_full_name = ReadEmbeddedImage(view, output->Imports, output->References, output->PInvokeModules, error);
+			output->SetImage(view.Machine(), view.IsClr(), assembly_full_name, bytes_inflated);
+			if (error != nullptr)
+				output->SetError(error);
+		}
+
+		return gcnew PackageInfo(file_path, entries);
+	}
+
+	ReadyToRunInfo^ ReadyToRunImage::Get(String^ file_path)
+	{
+		if (String::IsNullOrEmpty(file_path))
+			throw gcnew ArgumentNullException("File path cannot be null or empty.");
+
+		LS_READYTORUN_INFO info;
+		LSRESULT result = ReadyToRunReader::Read(GetWideFromManagedString(file_path), info);
+		if (result.Result != ERROR_SUCCESS)
+			throw gcnew NativeException(result);
+
+		return gcnew ReadyToRunInfo(file_path, info);
+	}
+
+	static String^ GetStringFromUtf8(const char* value, size_t length)
+	{
+		if (value == NULL || length == 0)
+			return String::Empty;
+
+		return gcnew String(const_cast<char*>(value), 0, static_cast<Int32>(length), Text::Encoding::UTF8);
+	}
+
 	static WuString GetNarrowFromManagedString(String^ str)
 	{
 		IntPtr pinned_str = Marshal::StringToHGlobalAnsi(str);
@@ -4,6 +4,28 @@
 
 #include "Common.h"
 #include "PeHelper.h"
+#include "Trace.h"
+#include "Daemon.h"
+#include "Snapshot.h"
+#include "ChainBuffer.h"
+#include "SnapshotDiff.h"
+#include "ImageHasher.h"
+#include "Signature.h"
+#include "Resources.h"
+#include "SxsIndex.h"
+#include "DebugDirectory.h"
+#include "RichHeader.h"
+#include "FunctionTable.h"
+#include "CoffObject.h"
+#include "Archive.h"
+#include "StringScanner.h"
+#include "SymbolHash.h"
+#include "ImageView.h"
+#include "ClrMetadata.h"
+#include "Bundle.h"
+#include "ReadyToRun.h"
+#include "Inflate.h"
+#include "Zip.h"
 
 #pragma managed
 
@@ -22,7 +44,16 @@ namespace LibSnitcher
 	{
 		None,
 		PeTables,
-		ReferencedAssemblies
+		ReferencedAssemblies,
+
+		// Module names found in the image read-only data. The module might never be loaded.
+		Heuristic,
+
+		// A file embedded in the single-file bundle the chain started from, by its path in the bundle.
+		Bundle,
+
+		// The composite image holding the ReadyToRun code of a component assembly, by its path.
+		ReadyToRun
 	};
 
 	public ref class DependencyEntry
@@ -39,6 +70,109 @@ namespace LibSnitcher
 		DependencySource _source;
 	};
 
+	// Why a scan stopped before the end of the image tables, or of the whole run.
+	public enum class WorkStopReason
+	{
+		None,
+		Cancelled,
+		Deadline,
+		Sections,
+		Descriptors,
+		Thunks,
+		Bytes
+	};
+
+	// Limits for a scan. The per-file ones stop the table walks of crafted, or corrupt images,
+	// the timeout, and 'Cancel', stop the whole scan. Results cut short are marked partial.
+	// Zero means no limit. The defaults are far above what linkers produce.
+	public ref class ScanLimits
+	{
+	public:
+		property UInt32 MaxSections {
+			UInt32 get() { return _limits->MaxSections; }
+			void set(UInt32 value) { _limits->MaxSections = value; }
+		}
+
+		property UInt32 MaxDescriptors {
+			UInt32 get() { return _limits->MaxDescriptors; }
+			void set(UInt32 value) { _limits->MaxDescriptors = value; }
+		}
+
+		property UInt32 MaxThunks {
+			UInt32 get() { return _limits->MaxThunks; }
+			void set(UInt32 value) { _limits->MaxThunks = value; }
+		}
+
+		property UInt64 MaxBytes {
+			UInt64 get() { return _limits->MaxBytes; }
+			void set(UInt64 value) { _limits->MaxBytes = value; }
+		}
+
+		// From the start of the scan. 'TimeSpan::Zero' means no timeout.
+		property TimeSpan Timeout {
+			TimeSpan get() { return _timeout; }
+			void set(TimeSpan value) { _timeout = value; }
+		}
+
+		// 'Cancelled', or 'Deadline' if the scan stopped because of it. Set by the 'Check' that saw
+		// it first, a deadline passing after the scan finished doesn't make it partial.
+		property WorkStopReason StopReason { WorkStopReason get() { return _stop_reason; } }
+
+		ScanLimits()
+			: _limits(new Core::LS_WORK_LIMITS()), _token(new Core::CancellationToken()), _timeout(TimeSpan::Zero), _stop_reason(WorkStopReason::None) { }
+
+		~ScanLimits() { this->!ScanLimits(); }
+
+		// Can be called from any thread, like the one running a cmdlet 'StopProcessing'.
+		void Cancel() { _token->Cancel(); }
+
+		// Polls the token. Walks call it before going on, the first reason seen is kept in 'StopReason'.
+		WorkStopReason Check()
+		{
+			if (_stop_reason == WorkStopReason::None)
+				_stop_reason = static_cast<WorkStopReason>(_token->Check());
+
+			return _stop_reason;
+		}
+
+	internal:
+		const Core::LS_WORK_LIMITS& GetLimits() { return *_limits; }
+		const Core::CancellationToken* GetToken() { return _token; }
+
+		// The timeout counts from here.
+		void Start()
+		{
+			_stop_reason = WorkStopReason::None;
+			_token->SetDeadline(static_cast<ULONGLONG>(_timeout.TotalMilliseconds));
+		}
+
+		// For native walks that stopped on the token themselves.
+		void SetStopReason(Core::LS_WORK_STOP reason)
+		{
+			if (_stop_reason == WorkStopReason::None)
+				_stop_reason = static_cast<WorkStopReason>(reason);
+		}
+
+	protected:
+		!ScanLimits() {
+			if (_limits != NULL) {
+				delete _limits;
+				_limits = NULL;
+			}
+
+			if (_token != NULL) {
+				delete _token;
+				_token = NULL;
+			}
+		}
+
+	private:
+		Core::PLS_WORK_LIMITS _limits;
+		Core::CancellationToken* _token;
+		TimeSpan _timeout;
+		WorkStopReason _stop_reason;
+	};
+
 	public ref class ModuleBase
 	{
 	public:
@@ -52,7 +186,21 @@ namespace LibSnitcher
 		property bool Loaded { bool get() { return _loaded; } }
 		property bool IsClr { bool get() { return _is_clr; } }
 		property Exception^ LoaderException { Exception^ get() { return _loader_exception; } }
+		property UInt64 BytesRead { UInt64 get() { return _wrapper == NULL ? 0 : _wrapper->BytesRead; } }
 		property List<DependencyEntry^>^ Dependencies { List<DependencyEntry^>^ get() { return _dependencies; } }
+		property String^ FileVersion { String^ get() { return _file_version; } }
+		property String^ ProductVersion { String^ get() { return _product_version; } }
+		property String^ CompanyName { String^ get() { return _company_name; } }
+		property String^ FileDescription { String^ get() { return _file_description; } }
+		property bool IsReadyToRun { bool get() { return _is_ready_to_run; } }
+		property bool IsCompositeImage { bool get() { return _is_composite_image; } }
+
+		// The composite image the ReadyToRun code of this component assembly is in.
+		property String^ OwnerComposite { String^ get() { return _owner_composite; } }
+
+		// Set when a limit stopped the walk of the import tables. 'Dependencies' has the ones read until then.
+		property WorkStopReason StopReason { WorkStopReason get() { return _stop_reason; } }
+		property bool IsPartial { bool get() { return _stop_reason != WorkStopReason::None; } }
 
 		ModuleBase(String^ name, String^ path, String^ ass_full_name,
 			bool loaded, Exception^ loader_exception, Core::PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info)
@@ -61,7 +209,9 @@ namespace LibSnitcher
 			_wrapper = new Core::PeHelper::LS_IMAGE_BASIC_INFORMATION();
 			_wrapper->DelayLoadTableRva = basic_info->DelayLoadTableRva;
 			_wrapper->ImportTableRva = basic_info->ImportTableRva;
+			_wrapper->BytesRead = basic_info->BytesRead;
 			_is_clr = basic_info->IsClr;
+			_stop_reason = static_cast<WorkStopReason>(basic_info->StopReason);
 
 			_dependencies = gcnew List<DependencyEntry^>();
 			for (WuString& dep : basic_info->Dependencies)
@@ -77,6 +227,20 @@ namespace LibSnitcher
 				delete _wrapper;
 		}
 
+	internal:
+		void SetVersionInfo(const Core::LS_VERSION_INFO& version) {
+			_file_version = gcnew String(version.FileVersion.GetBuffer());
+			_product_version = gcnew String(version.ProductVersion.GetBuffer());
+			_company_name = gcnew String(version.CompanyName.GetBuffer());
+			_file_description = gcnew String(version.FileDescription.GetBuffer());
+		}
+
+		void SetReadyToRun(const Core::LS_READYTORUN_INFO& info) {
+			_is_ready_to_run = info.IsReadyToRun;
+			_is_composite_image = info.IsComposite;
+			_owner_composite = info.OwnerComposite.Length() > 0 ? gcnew String(info.OwnerComposite.GetBuffer()) : nullptr;
+		}
+
 	protected:
 		!ModuleBase() {
 			if (_wrapper != NULL)
@@ -90,56 +254,1539 @@ namespace LibSnitcher
 		bool _loaded;
 		bool _is_clr;
 		Exception^ _loader_exception;
+		String^ _file_version;
+		String^ _product_version;
+		String^ _company_name;
+		String^ _file_description;
+		bool _is_ready_to_run;
+		bool _is_composite_image;
+		String^ _owner_composite;
+		WorkStopReason _stop_reason;
 		List<DependencyEntry^>^ _dependencies;
 		Core::PeHelper::PLS_IMAGE_BASIC_INFORMATION _wrapper;
 	};
 
-	[Serializable()]
-	public ref class NativeException : public Exception
+	// A chain resolved natively by 'Wrapper::ResolveChain', in one call. Nodes, edges, and strings stay in
+	// a single native buffer, read in place by node index. Names are created once per node, the other
+	// strings every time they are asked for, so ask once. Like the native resolver, it maps images,
+	// and does not resolve .NET assembly references.
+	public ref class ResolvedChain
 	{
 	public:
-		property Int32 ErrorCode { Int32 get() { return _error_code; } }
-		property String^ CompactTrace { String^ get() { return _compact_trace; } }
+		property Int32 NodeCount { Int32 get() { return static_cast<Int32>(_reader->NodeCount()); } }
+		property Int32 EdgeCount { Int32 get() { return static_cast<Int32>(_reader->EdgeCount()); } }
 
-		NativeException(Int32 error_code)
-			: Exception((gcnew String(Core::LSRESULT::GetErrorMessage(error_code).GetBuffer()))->Trim()),
-			  _error_code(error_code) { }
+		// Cancelled, or past the timeout. Modules not resolved by then are not in the chain.
+		property WorkStopReason StopReason { WorkStopReason get() { return static_cast<WorkStopReason>(_reader->StopReason()); } }
 
-		NativeException(Int32 error_code, String^ message)
-			: Exception(message), _error_code(error_code) { }
+		~ResolvedChain() { this->!ResolvedChain(); }
 
-		NativeException(Int32 error_code, String^ message, Exception^ inner_exception)
-			: Exception(message, inner_exception), _error_code(error_code) { }
+		// The node of a module name, ignoring case, or -1.
+		Int32 FindNode(String^ name);
 
-		NativeException(Core::LSRESULT& ls_error)
-			: Exception(gcnew String(ls_error.Message.GetBuffer())),
-			  _error_code(ls_error.Result),
-			  _compact_trace(gcnew String(ls_error.CompactTrace.GetBuffer())) { }
+		String^ GetName(Int32 node);
+
+		// Null when the module was not found.
+		String^ GetPath(Int32 node);
+
+		Int32 GetDepth(Int32 node) { return static_cast<Int32>(GetNode(node).Depth); }
+		bool IsLoaded(Int32 node) { return GetNode(node).Result == ERROR_SUCCESS; }
+		bool IsClr(Int32 node) { return (GetNode(node).Flags & LS_CHAIN_NODE_FLAG_CLR) != 0; }
+
+		// False for nodes at the maximum depth, or left when the resolution stopped. Their dependencies are not in the chain.
+		bool IsExpanded(Int32 node) { return (GetNode(node).Flags & LS_CHAIN_NODE_FLAG_EXPANDED) != 0; }
+
+		// Null when the module was loaded.
+		Exception^ GetLoaderException(Int32 node);
+
+		// Set when a limit stopped the walk of the import tables.
+		WorkStopReason GetStopReason(Int32 node) { return static_cast<WorkStopReason>(GetNode(node).StopReason); }
+
+		// Null when the image has no version resource.
+		String^ GetFileVersion(Int32 node) { return GetVersionString(node, GetNode(node).FileVersionOffset); }
+		String^ GetProductVersion(Int32 node) { return GetVersionString(node, GetNode(node).ProductVersionOffset); }
+		String^ GetCompanyName(Int32 node) { return GetVersionString(node, GetNode(node).CompanyNameOffset); }
+		String^ GetFileDescription(Int32 node) { return GetVersionString(node, GetNode(node).FileDescriptionOffset); }
+
+		// Dependencies are node indexes, in the order of the importing image tables. 'PeTables', or 'Heuristic'.
+		Int32 GetDependencyCount(Int32 node) { return static_cast<Int32>(GetNode(node).EdgeCount); }
+		Int32 GetDependency(Int32 node, Int32 index) { return static_cast<Int32>(GetEdge(node, index).To); }
+		DependencySource GetDependencySource(Int32 node, Int32 index) {
+			return GetEdge(node, index).Kind == Core::EdgeKindHeuristic ? DependencySource::Heuristic : DependencySource::PeTables;
+		}
+
+	internal:
+		// Takes ownership of the buffer.
+		ResolvedChain(wuvector<BYTE>* buffer);
 
 	protected:
-		NativeException()
-			: Exception() { }
+		!ResolvedChain() {
+			if (_reader != NULL) {
+				delete _reader;
+				_reader = NULL;
+			}
 
-		NativeException(SerializationInfo^ info, StreamingContext context)
-			: Exception(info, context) { }
+			if (_buffer != NULL) {
+				delete _buffer;
+				_buffer = NULL;
+			}
+		}
 
 	private:
-		Int32 _error_code;
-		String^ _compact_trace;
+		wuvector<BYTE>* _buffer;
+		Core::ChainBufferReader* _reader;
+		array<String^>^ _names;
+
+		const Core::LS_CHAIN_NODE& GetNode(Int32 node);
+		const Core::LS_CHAIN_EDGE& GetEdge(Int32 node, Int32 index);
+		String^ GetVersionString(Int32 node, DWORD offset);
 	};
-}
 
-namespace LibSnitcher::Core {
-	public ref class Wrapper
+	public enum class SnapshotDiffKind
+	{
+		ModuleAdded,
+		ModuleRemoved,
+		EdgeAdded,
+		EdgeRemoved,
+		ImportAdded,
+		ImportRemoved,
+		ExportAdded,
+		ExportRemoved,
+		HeaderChanged
+	};
+
+	[Flags]
+	public enum class SnapshotHeaderField
+	{
+		None = 0,
+		Path = LS_DIFF_FIELD_PATH,
+		Result = LS_DIFF_FIELD_RESULT,
+		Machine = LS_DIFF_FIELD_MACHINE,
+		Magic = LS_DIFF_FIELD_MAGIC,
+		Characteristics = LS_DIFF_FIELD_CHARACTERISTICS,
+		Subsystem = LS_DIFF_FIELD_SUBSYSTEM,
+		TimeDateStamp = LS_DIFF_FIELD_TIMESTAMP,
+		SizeOfImage = LS_DIFF_FIELD_SIZE_OF_IMAGE,
+		CheckSum = LS_DIFF_FIELD_CHECKSUM,
+		Flags = LS_DIFF_FIELD_FLAGS
+	};
+
+	public ref class SnapshotDiffEntry
+	{
+	public:
+		property SnapshotDiffKind Kind { SnapshotDiffKind get() { return _kind; } }
+		property String^ Module { String^ get() { return _module; } }
+		property String^ Target { String^ get() { return _target; } }
+		property SnapshotHeaderField ChangedFields { SnapshotHeaderField get() { return _changed_fields; } }
+
+		SnapshotDiffEntry(SnapshotDiffKind kind, String^ module, String^ target, SnapshotHeaderField changed_fields)
+			: _kind(kind), _module(module), _target(target), _changed_fields(changed_fields) { }
+
+	private:
+		SnapshotDiffKind _kind;
+		String^ _module;
+		String^ _target;
+		SnapshotHeaderField _changed_fields;
+	};
+
+	public enum class PageHashAlgorithm
+	{
+		None,
+		Sha1,
+		Sha256
+	};
+
+	public ref class PageDigest
+	{
+	public:
+		property Int64 Offset { Int64 get() { return _offset; } }
+		property String^ Digest { String^ get() { return _digest; } }
+
+		PageDigest(Int64 offset, String^ digest)
+			: _offset(offset), _digest(digest) { }
+
+	private:
+		Int64 _offset;
+		String^ _digest;
+	};
+
+	public ref class ImageDigest
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property String^ Sha1 { String^ get() { return _sha1; } }
+		property String^ Sha256 { String^ get() { return _sha256; } }
+		property UInt32 CheckSum { UInt32 get() { return _checksum; } }
+		property UInt32 ComputedCheckSum { UInt32 get() { return _computed_checksum; } }
+		property bool CheckSumValid { bool get() { return _checksum == _computed_checksum; } }
+		property UInt32 CertificateTableOffset { UInt32 get() { return _cert_offset; } }
+		property UInt32 CertificateTableSize { UInt32 get() { return _cert_size; } }
+		property PageHashAlgorithm PageAlgorithm { PageHashAlgorithm get() { return _page_algorithm; } }
+		property List<PageDigest^>^ Pages { List<PageDigest^>^ get() { return _pages; } }
+
+		ImageDigest(String^ path, Core::PLS_IMAGE_DIGEST digest)
+			: _path(path), _checksum(digest->HeaderCheckSum), _computed_checksum(digest->ComputedCheckSum),
+				_cert_offset(digest->CertificateTableOffset), _cert_size(digest->CertificateTableSize),
+				_page_algorithm(static_cast<PageHashAlgorithm>(digest->PageAlgorithm))
+		{
+			_sha1 = ToHexString(digest->Sha1, LS_SHA1_SIZE);
+			_sha256 = ToHexString(digest->Sha256, LS_SHA256_SIZE);
+			_pages = gcnew List<PageDigest^>(static_cast<Int32>(digest->PageDigests.size()));
+			ULONG page_digest_size = digest->PageAlgorithm == Core::PageHashSha1 ? LS_SHA1_SIZE : LS_SHA256_SIZE;
+			for (const Core::LS_PAGE_DIGEST& page : digest->PageDigests)
+				_pages->Add(gcnew PageDigest(page.Offset, ToHexString(page.Digest, page_digest_size)));
+		}
+
+	private:
+		String^ _path;
+		String^ _sha1;
+		String^ _sha256;
+		UInt32 _checksum;
+		UInt32 _computed_checksum;
+		UInt32 _cert_offset;
+		UInt32 _cert_size;
+		PageHashAlgorithm _page_algorithm;
+		List<PageDigest^>^ _pages;
+
+		static String^ ToHexString(const BYTE* data, ULONG size)
+		{
+			array<Byte>^ bytes = gcnew array<Byte>(size);
+			Marshal::Copy(IntPtr(const_cast<BYTE*>(data)), bytes, 0, size);
+
+			return BitConverter::ToString(bytes)->Replace("-", String::Empty);
+		}
+	};
+
+	public ref class SignerInfo
+	{
+	public:
+		property String^ Subject { String^ get() { return _subject; } }
+		property String^ Issuer { String^ get() { return _issuer; } }
+		property String^ SerialNumber { String^ get() { return _serial_number; } }
+		property String^ DigestAlgorithm { String^ get() { return _digest_algorithm; } }
+		property String^ ImageDigestAlgorithm { String^ get() { return _image_digest_algorithm; } }
+		property String^ ImageDigest { String^ get() { return _image_digest; } }
+		property Nullable<DateTime> SigningTime { Nullable<DateTime> get() { return _signing_time; } }
+		property bool IsNested { bool get() { return _is_nested; } }
+
+		SignerInfo(const Core::LS_SIGNER_INFO& signer)
+			: _subject(gcnew String(signer.Subject.GetBuffer())), _issuer(gcnew String(signer.Issuer.GetBuffer())),
+				_serial_number(gcnew String(signer.SerialNumber.GetBuffer())), _digest_algorithm(gcnew String(signer.DigestAlgorithm.GetBuffer())),
+				_image_digest_algorithm(gcnew String(signer.ImageDigestAlgorithm.GetBuffer())), _image_digest(gcnew String(signer.ImageDigest.GetBuffer())),
+				_is_nested(signer.IsNested)
+		{
+			if (signer.SigningTime != 0)
+				_signing_time = DateTime::FromFileTimeUtc(static_cast<Int64>(signer.SigningTime));
+		}
+
+	private:
+		String^ _subject;
+		String^ _issuer;
+		String^ _serial_number;
+		String^ _digest_algorithm;
+		String^ _image_digest_algorithm;
+		String^ _image_digest;
+		Nullable<DateTime> _signing_time;
+		bool _is_nested;
+	};
+
+	public ref class ImageSignature
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property bool IsSigned { bool get() { return _signers->Count > 0; } }
+		property Int32 CertificateCount { Int32 get() { return _certificate_count; } }
+		property List<String^>^ DigestAlgorithms { List<String^>^ get() { return _digest_algorithms; } }
+		property List<SignerInfo^>^ Signers { List<SignerInfo^>^ get() { return _signers; } }
+
+		ImageSignature(String^ path, const Core::LS_SIGNATURE_INFO& signature)
+			: _path(path), _certificate_count(static_cast<Int32>(signature.Certificates.size()))
+		{
+			_digest_algorithms = gcnew List<String^>(static_cast<Int32>(signature.DigestAlgorithms.size()));
+			for (const WuString& algorithm : signature.DigestAlgorithms)
+				_digest_algorithms->Add(gcnew String(algorithm.GetBuffer()));
+
+			_signers = gcnew List<SignerInfo^>(static_cast<Int32>(signature.Signers.size()));
+			for (const Core::LS_SIGNER_INFO& signer : signature.Signers)
+				_signers->Add(gcnew SignerInfo(signer));
+		}
+
+	private:
+		String^ _path;
+		Int32 _certificate_count;
+		List<String^>^ _digest_algorithms;
+		List<SignerInfo^>^ _signers;
+	};
+
+	public ref class CodeViewInfo
+	{
+	public:
+		property String^ Format { String^ get() { return _format; } }
+		property Guid PdbGuid { Guid get() { return _guid; } }
+		property UInt32 Signature { UInt32 get() { return _signature; } }
+		property UInt32 Age { UInt32 get() { return _age; } }
+		property String^ PdbPath { String^ get() { return _pdb_path; } }
+		property String^ SymbolKey { String^ get() { return _symbol_key; } }
+
+		CodeViewInfo(const Core::LS_CODEVIEW_INFO& codeview)
+			: _format(codeview.Format == LS_CODEVIEW_RSDS ? "RSDS" : "NB10"), _signature(codeview.Signature), _age(codeview.Age),
+				_pdb_path(gcnew String(codeview.PdbPath.GetBuffer())), _symbol_key(gcnew String(Core::DebugDirectoryReader::GetSymbolKey(codeview).GetBuffer()))
+		{
+			const GUID& guid = codeview.Guid;
+			_guid = Guid(static_cast<Int32>(guid.Data1), static_cast<Int16>(guid.Data2), static_cast<Int16>(guid.Data3), guid.Data4[0], guid.Data4[1], guid.Data4[2],
+				guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+		}
+
+	private:
+		String^ _format;
+		Guid _guid;
+		UInt32 _signature;
+		UInt32 _age;
+		String^ _pdb_path;
+		String^ _symbol_key;
+	};
+
+	public ref class DebugEntry
+	{
+	public:
+		property UInt32 Type { UInt32 get() { return _type; } }
+		property DateTime TimeDateStamp { DateTime get() { return _time_date_stamp; } }
+		property String^ Version { String^ get() { return _version; } }
+		property UInt32 SizeOfData { UInt32 get() { return _size_of_data; } }
+		property UInt32 AddressOfRawData { UInt32 get() { return _address_of_raw_data; } }
+		property UInt32 PointerToRawData { UInt32 get() { return _pointer_to_raw_data; } }
+
+		DebugEntry(const Core::LS_DEBUG_ENTRY& entry);
+
+	private:
+		UInt32 _type;
+		DateTime _time_date_stamp;
+		String^ _version;
+		UInt32 _size_of_data;
+		UInt32 _address_of_raw_data;
+		UInt32 _pointer_to_raw_data;
+	};
+
+	public ref class PogoEntry
+	{
+	public:
+		property UInt32 Rva { UInt32 get() { return _rva; } }
+		property UInt32 Size { UInt32 get() { return _size; } }
+		property String^ Name { String^ get() { return _name; } }
+
+		PogoEntry(const Core::LS_POGO_ENTRY& entry)
+			: _rva(entry.Rva), _size(entry.Size), _name(gcnew String(entry.Name.GetBuffer())) { }
+
+	private:
+		UInt32 _rva;
+		UInt32 _size;
+		String^ _name;
+	};
+
+	public ref class ImageDebugInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property List<DebugEntry^>^ Entries { List<DebugEntry^>^ get() { return _entries; } }
+		property List<CodeViewInfo^>^ CodeView { List<CodeViewInfo^>^ get() { return _codeview; } }
+		property List<PogoEntry^>^ Pogo { List<PogoEntry^>^ get() { return _pogo; } }
+		property bool IsDeterministic { bool get() { return _is_deterministic; } }
+		property String^ ReproHash { String^ get() { return _repro_hash; } }
+		property bool HasEmbeddedPdb { bool get() { return _has_embedded_pdb; } }
+		property UInt32 EmbeddedPdbSize { UInt32 get() { return _embedded_pdb_size; } }
+		property UInt32 EmbeddedPdbUncompressedSize { UInt32 get() { return _embedded_pdb_uncompressed_size; } }
+
+		ImageDebugInfo(String^ path, const Core::LS_DEBUG_INFO& debug_info);
+
+	private:
+		String^ _path;
+		List<DebugEntry^>^ _entries;
+		List<CodeViewInfo^>^ _codeview;
+		List<PogoEntry^>^ _pogo;
+		bool _is_deterministic;
+		String^ _repro_hash;
+		bool _has_embedded_pdb;
+		UInt32 _embedded_pdb_size;
+		UInt32 _embedded_pdb_uncompressed_size;
+	};
+
+	public ref class SymbolKeyInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property String^ SymbolKey { String^ get() { return _symbol_key; } }
+		property CodeViewInfo^ CodeView { CodeViewInfo^ get() { return _codeview; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		SymbolKeyInfo(String^ path, String^ symbol_key, CodeViewInfo^ codeview, Exception^ error)
+			: _path(path), _symbol_key(symbol_key), _codeview(codeview), _error(error) { }
+
+	private:
+		String^ _path;
+		String^ _symbol_key;
+		CodeViewInfo^ _codeview;
+		Exception^ _error;
+	};
+
+	public ref class RichEntry
+	{
+	public:
+		property UInt16 ProductId { UInt16 get() { return _product_id; } }
+		property UInt16 Build { UInt16 get() { return _build; } }
+		property UInt32 Count { UInt32 get() { return _count; } }
+		property String^ CompId { String^ get() { return String::Format("{0:X4}{1:X4}", _product_id, _build); } }
+
+		RichEntry(const Core::LS_RICH_ENTRY& entry)
+			: _product_id(entry.ProductId), _build(entry.Build), _count(entry.Count) { }
+
+	private:
+		UInt16 _product_id;
+		UInt16 _build;
+		UInt32 _count;
+	};
+
+	public ref class RichHeaderInfo
 	{
 	public:
-		ModuleBase^ GetDependencyList(String^ file_name, DependencySource source);
+		property String^ Path { String^ get() { return _path; } }
+		property bool IsPresent { bool get() { return _is_present; } }
+		property UInt32 Key { UInt32 get() { return _key; } }
+		property bool ChecksumValid { bool get() { return _checksum_valid; } }
+		property UInt32 Offset { UInt32 get() { return _offset; } }
+		property UInt32 Size { UInt32 get() { return _size; } }
+		property List<RichEntry^>^ Entries { List<RichEntry^>^ get() { return _entries; } }
+
+		RichHeaderInfo(String^ path, const Core::LS_RICH_HEADER& rich_header)
+			: _path(path), _is_present(rich_header.Present), _key(rich_header.Key), _checksum_valid(rich_header.ChecksumValid),
+				_offset(rich_header.Offset), _size(rich_header.Size)
+		{
+			_entries = gcnew List<RichEntry^>(static_cast<Int32>(rich_header.Entries.size()));
+			for (const Core::LS_RICH_ENTRY& entry : rich_header.Entries)
+				_entries->Add(gcnew RichEntry(entry));
+		}
+
+	private:
+		String^ _path;
+		bool _is_present;
+		UInt32 _key;
+		bool _checksum_valid;
+		UInt32 _offset;
+		UInt32 _size;
+		List<RichEntry^>^ _entries;
+	};
+
+	public ref class ToolchainCount
+	{
+	public:
+		property UInt16 ProductId { UInt16 get() { return _product_id; } }
+		property UInt16 Build { UInt16 get() { return _build; } }
+		property UInt32 FileCount { UInt32 get() { return _file_count; } }
+		property UInt64 ObjectCount { UInt64 get() { return _object_count; } }
+		property String^ CompId { String^ get() { return String::Format("{0:X4}{1:X4}", _product_id, _build); } }
+
+		ToolchainCount(const Core::LS_TOOLCHAIN_COUNT& count)
+			: _product_id(count.ProductId), _build(count.Build), _file_count(count.FileCount), _object_count(count.ObjectCount) { }
+
+	private:
+		UInt16 _product_id;
+		UInt16 _build;
+		UInt32 _file_count;
+		UInt64 _object_count;
+	};
+
+	public ref class ToolchainFailure
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		ToolchainFailure(String^ path, Exception^ error)
+			: _path(path), _error(error) { }
+
+	private:
+		String^ _path;
+		Exception^ _error;
+	};
+
+	public ref class ToolchainReport
+	{
+	public:
+		property List<ToolchainCount^>^ Counts { List<ToolchainCount^>^ get() { return _counts; } }
+		property List<ToolchainFailure^>^ Failures { List<ToolchainFailure^>^ get() { return _failures; } }
+
+		ToolchainReport(List<ToolchainCount^>^ counts, List<ToolchainFailure^>^ failures)
+			: _counts(counts), _failures(failures) { }
+
+	private:
+		List<ToolchainCount^>^ _counts;
+		List<ToolchainFailure^>^ _failures;
+	};
+
+	public ref class ModuleLoadCost
+	{
+	public:
+		property String^ Name { String^ get() { return _name; } }
+		property String^ Path { String^ get() { return _path; } }
+		property UInt32 SizeOfImage { UInt32 get() { return _size_of_image; } }
+		property bool DynamicBase { bool get() { return _dynamic_base; } }
+		property UInt64 FixupCount { UInt64 get() { return _fixup_count; } }
+		property UInt32 RelocationBlockCount { UInt32 get() { return _relocation_block_count; } }
+		property bool HasTls { bool get() { return _has_tls; } }
+		property UInt32 TlsCallbackCount { UInt32 get() { return _tls_callback_count; } }
+		property UInt64 TlsTemplateSize { UInt64 get() { return _tls_template_size; } }
+		property UInt32 LoadConfigSize { UInt32 get() { return _load_config_size; } }
+		property UInt32 GuardFlags { UInt32 get() { return _guard_flags; } }
+		property UInt64 GuardCFFunctionCount { UInt64 get() { return _guard_cf_function_count; } }
+		property UInt64 GuardTableSize { UInt64 get() { return _guard_table_size; } }
+		property bool HasDynamicRelocations { bool get() { return _has_dynamic_relocations; } }
+
+		ModuleLoadCost(String^ name, String^ path, const Core::LS_LOAD_COST& load_cost)
+			: _name(name), _path(path), _size_of_image(load_cost.SizeOfImage), _dynamic_base(load_cost.DynamicBase),
+				_fixup_count(load_cost.Relocations.FixupCount), _relocation_block_count(load_cost.Relocations.BlockCount),
+				_has_tls(load_cost.HasTls), _tls_callback_count(load_cost.Tls.CallbackCount), _tls_template_size(load_cost.Tls.TemplateSize + load_cost.Tls.ZeroFillSize),
+				_load_config_size(load_cost.LoadConfig.Size), _guard_flags(load_cost.LoadConfig.GuardFlags), _guard_cf_function_count(load_cost.LoadConfig.GuardCFFunctionCount),
+				_guard_table_size(load_cost.LoadConfig.GuardTableSize), _has_dynamic_relocations(load_cost.LoadConfig.HasDynamicRelocations) { }
+
+	private:
+		String^ _name;
+		String^ _path;
+		UInt32 _size_of_image;
+		bool _dynamic_base;
+		UInt64 _fixup_count;
+		UInt32 _relocation_block_count;
+		bool _has_tls;
+		UInt32 _tls_callback_count;
+		UInt64 _tls_template_size;
+		UInt32 _load_config_size;
+		UInt32 _guard_flags;
+		UInt64 _guard_cf_function_count;
+		UInt64 _guard_table_size;
+		bool _has_dynamic_relocations;
+	};
+
+	public ref class ChainLoadCost
+	{
+	public:
+		property String^ Root { String^ get() { return _root; } }
+		property UInt32 ModuleCount { UInt32 get() { return _module_count; } }
+		property UInt64 CommittedImageSize { UInt64 get() { return _committed_image_size; } }
+		property UInt64 FixupCount { UInt64 get() { return _fixup_count; } }
+		property UInt32 RelocationBlockCount { UInt32 get() { return _relocation_block_count; } }
+		property UInt32 TlsModuleCount { UInt32 get() { return _tls_module_count; } }
+		property UInt32 TlsCallbackCount { UInt32 get() { return _tls_callback_count; } }
+		property UInt64 TlsTemplateSize { UInt64 get() { return _tls_template_size; } }
+		property UInt64 GuardCFFunctionCount { UInt64 get() { return _guard_cf_function_count; } }
+		property UInt64 GuardTableSize { UInt64 get() { return _guard_table_size; } }
+		property List<ModuleLoadCost^>^ Modules { List<ModuleLoadCost^>^ get() { return _modules; } }
+
+		ChainLoadCost(String^ root, const Core::LS_CHAIN_LOAD_COST& chain_cost, List<ModuleLoadCost^>^ modules)
+			: _root(root), _module_count(chain_cost.ModuleCount), _committed_image_size(chain_cost.CommittedImageSize),
+				_fixup_count(chain_cost.FixupCount), _relocation_block_count(chain_cost.RelocationBlockCount), _tls_module_count(chain_cost.TlsModuleCount),
+				_tls_callback_count(chain_cost.TlsCallbackCount), _tls_template_size(chain_cost.TlsTemplateSize),
+				_guard_cf_function_count(chain_cost.GuardCFFunctionCount), _guard_table_size(chain_cost.GuardTableSize), _modules(modules) { }
+
+	private:
+		String^ _root;
+		UInt32 _module_count;
+		UInt64 _committed_image_size;
+		UInt64 _fixup_count;
+		UInt32 _relocation_block_count;
+		UInt32 _tls_module_count;
+		UInt32 _tls_callback_count;
+		UInt64 _tls_template_size;
+		UInt64 _guard_cf_function_count;
+		UInt64 _guard_table_size;
+		List<ModuleLoadCost^>^ _modules;
+	};
+
+	public ref class UnwindCode
+	{
+	public:
+		property Byte CodeOffset { Byte get() { return _code_offset; } }
+		property Byte Operation { Byte get() { return _operation; } }
+		property Byte OperationInfo { Byte get() { return _operation_info; } }
+		property UInt32 Operand { UInt32 get() { return _operand; } }
+
+		UnwindCode(const Core::LS_UNWIND_CODE& code)
+			: _code_offset(code.CodeOffset), _operation(code.Operation), _operation_info(code.OperationInfo), _operand(code.Operand) { }
+
+	private:
+		Byte _code_offset;
+		Byte _operation;
+		Byte _operation_info;
+		UInt32 _operand;
+	};
+
+	public ref class UnwindInfo
+	{
+	public:
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property Byte Version { Byte get() { return _version; } }
+		property Byte Flags { Byte get() { return _flags; } }
+		property Byte PrologSize { Byte get() { return _prolog_size; } }
+		property Byte FrameRegister { Byte get() { return _frame_register; } }
+		property Byte FrameOffset { Byte get() { return _frame_offset; } }
+		property bool HasExceptionHandler { bool get() { return _has_exception_handler; } }
+		property UInt32 ExceptionHandlerRva { UInt32 get() { return _exception_handler_rva; } }
+		property bool IsChained { bool get() { return _is_chained; } }
+		property UInt32 ChainedFunctionRva { UInt32 get() { return _chained_function_rva; } }
+		property bool IsPacked { bool get() { return _is_packed; } }
+		property UInt32 FunctionLength { UInt32 get() { return _function_length; } }
+		property UInt32 FrameSize { UInt32 get() { return _frame_size; } }
+		property UInt32 EpilogCount { UInt32 get() { return _epilog_count; } }
+		property List<UnwindCode^>^ Codes { List<UnwindCode^>^ get() { return _codes; } }
+		property array<Byte>^ CodeBytes { array<Byte>^ get() { return _code_bytes; } }
+
+		UnwindInfo(const Core::LS_UNWIND_INFO& unwind_info)
+			: _machine(unwind_info.Machine), _version(unwind_info.Version), _flags(unwind_info.Flags), _prolog_size(unwind_info.PrologSize),
+				_frame_register(unwind_info.FrameRegister), _frame_offset(unwind_info.FrameOffset), _has_exception_handler(unwind_info.HasExceptionHandler),
+				_exception_handler_rva(unwind_info.ExceptionHandlerRva), _is_chained(unwind_info.IsChained), _chained_function_rva(unwind_info.ChainedFunctionRva),
+				_is_packed(unwind_info.IsPacked), _function_length(unwind_info.FunctionLength), _frame_size(unwind_info.FrameSize), _epilog_count(unwind_info.EpilogCount)
+		{
+			_codes = gcnew List<UnwindCode^>(static_cast<Int32>(unwind_info.Codes.size()));
+			for (const Core::LS_UNWIND_CODE& code : unwind_info.Codes)
+				_codes->Add(gcnew UnwindCode(code));
+
+			_code_bytes = gcnew array<Byte>(static_cast<Int32>(unwind_info.CodeBytes.size()));
+			for (Int32 i = 0; i < _code_bytes->Length; i++)
+				_code_bytes[i] = unwind_info.CodeBytes[i];
+		}
 
 	private:
-		PeHelper* pe_helper;
+		UInt16 _machine;
+		Byte _version;
+		Byte _flags;
+		Byte _prolog_size;
+		Byte _frame_register;
+		Byte _frame_offset;
+		bool _has_exception_handler;
+		UInt32 _exception_handler_rva;
+		bool _is_chained;
+		UInt32 _chained_function_rva;
+		bool _is_packed;
+		UInt32 _function_length;
+		UInt32 _frame_size;
+		UInt32 _epilog_count;
+		List<UnwindCode^>^ _codes;
+		array<Byte>^ _code_bytes;
+	};
+
+	public ref class FunctionMatch
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property UInt32 Rva { UInt32 get() { return _rva; } }
+		property bool Found { bool get() { return _found; } }
+		property UInt32 FunctionIndex { UInt32 get() { return _function_index; } }
+		property UInt32 BeginAddress { UInt32 get() { return _begin_address; } }
+		property UInt32 EndAddress { UInt32 get() { return _end_address; } }
+		property UInt32 Offset { UInt32 get() { return _found ? _rva - _begin_address : 0; } }
+		property UnwindInfo^ Unwind { UnwindInfo^ get() { return _unwind; } }
+
+		FunctionMatch(String^ path, const Core::LS_FUNCTION_MATCH& match, UnwindInfo^ unwind)
+			: _path(path), _rva(match.Rva), _found(match.Found), _function_index(match.Function.Index),
+				_begin_address(match.Function.BeginAddress), _end_address(match.Function.EndAddress), _unwind(unwind) { }
+
+	private:
+		String^ _path;
+		UInt32 _rva;
+		bool _found;
+		UInt32 _function_index;
+		UInt32 _begin_address;
+		UInt32 _end_address;
+		UnwindInfo^ _unwind;
+	};
+
+	public ref class CoffRelocation
+	{
+	public:
+		property UInt32 VirtualAddress { UInt32 get() { return _virtual_address; } }
+		property UInt32 SymbolIndex { UInt32 get() { return _symbol_index; } }
+		property UInt16 Type { UInt16 get() { return _type; } }
+
+		CoffRelocation(const IMAGE_RELOCATION& relocation)
+			: _virtual_address(relocation.VirtualAddress), _symbol_index(relocation.SymbolTableIndex), _type(relocation.Type) { }
+
+	private:
+		UInt32 _virtual_address;
+		UInt32 _symbol_index;
+		UInt16 _type;
+	};
+
+	public ref class CoffSection
+	{
+	public:
+		property String^ Name { String^ get() { return _name; } }
+		property UInt32 SizeOfRawData { UInt32 get() { return _size_of_raw_data; } }
+		property UInt32 PointerToRawData { UInt32 get() { return _pointer_to_raw_data; } }
+		property UInt32 Characteristics { UInt32 get() { return _characteristics; } }
+		property List<CoffRelocation^>^ Relocations { List<CoffRelocation^>^ get() { return _relocations; } }
+
+		CoffSection(String^ name, const IMAGE_SECTION_HEADER& header, List<CoffRelocation^>^ relocations)
+			: _name(name), _size_of_raw_data(header.SizeOfRawData), _pointer_to_raw_data(header.PointerToRawData),
+				_characteristics(header.Characteristics), _relocations(relocations) { }
+
+	private:
+		String^ _name;
+		UInt32 _size_of_raw_data;
+		UInt32 _pointer_to_raw_data;
+		UInt32 _characteristics;
+		List<CoffRelocation^>^ _relocations;
+	};
+
+	public ref class CoffSymbol
+	{
+	public:
+		property UInt32 Index { UInt32 get() { return _index; } }
+		property String^ Name { String^ get() { return _name; } }
+		property UInt32 Value { UInt32 get() { return _value; } }
+		property Int32 SectionNumber { Int32 get() { return _section_number; } }
+		property UInt16 Type { UInt16 get() { return _type; } }
+		property Byte StorageClass { Byte get() { return _storage_class; } }
+		property array<Byte>^ AuxData { array<Byte>^ get() { return _aux_data; } }
+
+		CoffSymbol(String^ name, const Core::LS_COFF_SYMBOL& symbol, array<Byte>^ aux_data)
+			: _index(symbol.Index), _name(name), _value(symbol.Value), _section_number(symbol.SectionNumber),
+				_type(symbol.Type), _storage_class(symbol.StorageClass), _aux_data(aux_data) { }
+
+	private:
+		UInt32 _index;
+		String^ _name;
+		UInt32 _value;
+		Int32 _section_number;
+		UInt16 _type;
+		Byte _storage_class;
+		array<Byte>^ _aux_data;
+	};
+
+	public ref class CoffObjectInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property bool IsKnownMachine { bool get() { return Core::CoffObject::IsKnownMachine(_machine); } }
+		property bool IsBigObj { bool get() { return _is_big_obj; } }
+		property DateTime TimeDateStamp { DateTime get() { return _time_date_stamp; } }
+		property List<CoffSection^>^ Sections { List<CoffSection^>^ get() { return _sections; } }
+		property List<CoffSymbol^>^ Symbols { List<CoffSymbol^>^ get() { return _symbols; } }
+
+		CoffObjectInfo(String^ path, UInt16 machine, bool is_big_obj, DateTime time_date_stamp, List<CoffSection^>^ sections, List<CoffSymbol^>^ symbols)
+			: _path(path), _machine(machine), _is_big_obj(is_big_obj), _time_date_stamp(time_date_stamp), _sections(sections), _symbols(symbols) { }
+
+	private:
+		String^ _path;
+		UInt16 _machine;
+		bool _is_big_obj;
+		DateTime _time_date_stamp;
+		List<CoffSection^>^ _sections;
+		List<CoffSymbol^>^ _symbols;
+	};
+
+	public ref class CoffObjectSummary
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property bool IsKnownMachine { bool get() { return Core::CoffObject::IsKnownMachine(_machine); } }
+		property bool IsBigObj { bool get() { return _is_big_obj; } }
+		property UInt32 SectionCount { UInt32 get() { return _section_count; } }
+		property UInt32 SymbolCount { UInt32 get() { return _symbol_count; } }
+		property UInt32 DefinedCount { UInt32 get() { return _defined_count; } }
+		property UInt32 UndefinedCount { UInt32 get() { return _undefined_count; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		CoffObjectSummary(const Core::LS_COFF_SCAN_RESULT& result, Exception^ error)
+			: _path(gcnew String(result.Path.GetBuffer())), _machine(result.Machine), _is_big_obj(result.IsBigObj), _section_count(result.SectionCount),
+				_symbol_count(result.SymbolCount), _defined_count(result.DefinedCount), _undefined_count(result.UndefinedCount), _error(error) { }
+
+	private:
+		String^ _path;
+		UInt16 _machine;
+		bool _is_big_obj;
+		UInt32 _section_count;
+		UInt32 _symbol_count;
+		UInt32 _defined_count;
+		UInt32 _undefined_count;
+		Exception^ _error;
+	};
+
+	public ref class CoffSymbolUsage
+	{
+	public:
+		property String^ Name { String^ get() { return _name; } }
+		property UInt32 ReferenceCount { UInt32 get() { return _reference_count; } }
+		property UInt32 DefinitionCount { UInt32 get() { return _definition_count; } }
+		property bool IsUnresolved { bool get() { return _definition_count == 0; } }
+
+		CoffSymbolUsage(const Core::LS_COFF_SYMBOL_USAGE& usage)
+			: _name(gcnew String(usage.Name.GetBuffer())), _reference_count(usage.ReferenceCount), _definition_count(usage.DefinitionCount) { }
+
+	private:
+		String^ _name;
+		UInt32 _reference_count;
+		UInt32 _definition_count;
+	};
+
+	public ref class CoffScanReport
+	{
+	public:
+		property List<CoffObjectSummary^>^ Objects { List<CoffObjectSummary^>^ get() { return _objects; } }
+		property List<CoffSymbolUsage^>^ Symbols { List<CoffSymbolUsage^>^ get() { return _symbols; } }
+
+		CoffScanReport(List<CoffObjectSummary^>^ objects, List<CoffSymbolUsage^>^ symbols)
+			: _objects(objects), _symbols(symbols) { }
+
+	private:
+		List<CoffObjectSummary^>^ _objects;
+		List<CoffSymbolUsage^>^ _symbols;
+	};
+
+	public enum class LibraryMemberKind
+	{
+		Linker,
+		LongNames,
+		Object,
+		Import,
+		Other
+	};
+
+	public ref class LibraryMember
+	{
+	public:
+		property String^ Name { String^ get() { return _name; } }
+		property UInt32 Offset { UInt32 get() { return _offset; } }
+		property UInt32 Size { UInt32 get() { return _size; } }
+		property LibraryMemberKind Kind { LibraryMemberKind get() { return _kind; } }
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property UInt32 SymbolCount { UInt32 get() { return _symbol_count; } }
+		property String^ ImportModule { String^ get() { return _import_module; } }
+		property String^ ImportName { String^ get() { return _import_name; } }
+		property UInt16 OrdinalOrHint { UInt16 get() { return _ordinal_or_hint; } }
+
+		LibraryMember(String^ name, const Core::LS_ARCHIVE_MEMBER& member, UInt16 machine, UInt32 symbol_count, String^ import_module, String^ import_name, UInt16 ordinal_or_hint)
+			: _name(name), _offset(member.HeaderOffset), _size(member.Size), _kind(static_cast<LibraryMemberKind>(member.Kind)), _machine(machine),
+				_symbol_count(symbol_count), _import_module(import_module), _import_name(import_name), _ordinal_or_hint(ordinal_or_hint) { }
+
+	private:
+		String^ _name;
+		UInt32 _offset;
+		UInt32 _size;
+		LibraryMemberKind _kind;
+		UInt16 _machine;
+		UInt32 _symbol_count;
+		String^ _import_module;
+		String^ _import_name;
+		UInt16 _ordinal_or_hint;
+	};
+
+	public ref class LibrarySymbol
+	{
+	public:
+		property String^ Library { String^ get() { return _library; } }
+		property String^ Name { String^ get() { return _name; } }
+		property String^ Member { String^ get() { return _member; } }
+		property bool IsImport { bool get() { return _is_import; } }
+		property String^ Module { String^ get() { return _module; } }
+		property String^ ImportName { String^ get() { return _import_name; } }
+		property UInt16 OrdinalOrHint { UInt16 get() { return _ordinal_or_hint; } }
+
+		LibrarySymbol(String^ library, const Core::LS_LIBRARY_SYMBOL& symbol)
+			: _library(library), _name(gcnew String(symbol.Name.GetBuffer())), _member(gcnew String(symbol.Member.GetBuffer())), _is_import(symbol.IsImport),
+				_module(symbol.IsImport ? gcnew String(symbol.Module.GetBuffer()) : nullptr),
+				_import_name(symbol.IsImport && symbol.ImportName.Length() > 0 ? gcnew String(symbol.ImportName.GetBuffer()) : nullptr),
+				_ordinal_or_hint(symbol.OrdinalOrHint) { }
+
+	private:
+		String^ _library;
+		String^ _name;
+		String^ _member;
+		bool _is_import;
+		String^ _module;
+		String^ _import_name;
+		UInt16 _ordinal_or_hint;
+	};
+
+	public ref class LibraryInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property List<LibraryMember^>^ Members { List<LibraryMember^>^ get() { return _members; } }
+		property UInt32 SymbolCount { UInt32 get() { return _symbol_count; } }
+
+		LibraryInfo(String^ path, List<LibraryMember^>^ members, UInt32 symbol_count)
+			: _path(path), _members(members), _symbol_count(symbol_count) { }
+
+	private:
+		String^ _path;
+		List<LibraryMember^>^ _members;
+		UInt32 _symbol_count;
+	};
+
+	public ref class LibraryIndex
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property UInt32 MemberCount { UInt32 get() { return _member_count; } }
+		property UInt32 ObjectCount { UInt32 get() { return _object_count; } }
+		property UInt32 ImportCount { UInt32 get() { return _import_count; } }
+		property List<LibrarySymbol^>^ Symbols { List<LibrarySymbol^>^ get() { return _symbols; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		LibraryIndex(const Core::LS_LIBRARY_INDEX& index, Exception^ error)
+			: _path(gcnew String(index.Path.GetBuffer())), _member_count(index.MemberCount), _object_count(index.ObjectCount),
+				_import_count(index.ImportCount), _error(error)
+		{
+			_symbols = gcnew List<LibrarySymbol^>(static_cast<Int32>(index.Symbols.size()));
+			for (const Core::LS_LIBRARY_SYMBOL& symbol : index.Symbols)
+				_symbols->Add(gcnew LibrarySymbol(_path, symbol));
+		}
+
+	private:
+		String^ _path;
+		UInt32 _member_count;
+		UInt32 _object_count;
+		UInt32 _import_count;
+		List<LibrarySymbol^>^ _symbols;
+		Exception^ _error;
+	};
+
+	public enum class SymbolHashKind
+	{
+		Import,
+		Export
+	};
+
+	public ref class ImageSymbolHash
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+
+		// Lowercase hex, like other imphash tools print it. Null if there are no imports.
+		property String^ ImportHash { String^ get() { return _import_hash; } }
+		property String^ ExportHash { String^ get() { return _export_hash; } }
+		property UInt32 ImportCount { UInt32 get() { return _import_count; } }
+		property UInt32 ExportCount { UInt32 get() { return _export_count; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		// Set when a limit stopped the walk. Hashes over a truncated list are null.
+		property WorkStopReason StopReason { WorkStopReason get() { return _stop_reason; } }
+		property bool IsPartial { bool get() { return _stop_reason != WorkStopReason::None; } }
+
+		ImageSymbolHash(const Core::LS_SYMBOL_HASH_RESULT& result, Exception^ error)
+			: _path(gcnew String(result.Path.GetBuffer())), _import_count(result.ImportCount), _export_count(result.ExportCount),
+				_stop_reason(static_cast<WorkStopReason>(result.StopReason)), _error(error)
+		{
+			if (result.HasImportHash)
+				_import_hash = ToImportHashString(result.ImportHash);
+
+			if (result.ExportCount > 0 && result.StopReason == Core::WorkStopNone)
+				_export_hash = UInt64(result.ExportHash).ToString("x16");
+		}
+
+	internal:
+		static String^ ToImportHashString(const Core::LS_IMPORT_HASH& hash)
+		{
+			array<Byte>^ bytes = gcnew array<Byte>(LS_IMPORT_HASH_SIZE);
+			Marshal::Copy(IntPtr(const_cast<BYTE*>(hash.Bytes)), bytes, 0, LS_IMPORT_HASH_SIZE);
+
+			return BitConverter::ToString(bytes)->Replace("-", String::Empty)->ToLowerInvariant();
+		}
+
+	private:
+		String^ _path;
+		String^ _import_hash;
+		String^ _export_hash;
+		UInt32 _import_count;
+		UInt32 _export_count;
+		WorkStopReason _stop_reason;
+		Exception^ _error;
+	};
+
+	public ref class SymbolHashGroup
+	{
+	public:
+		property SymbolHashKind Kind { SymbolHashKind get() { return _kind; } }
+		property String^ Hash { String^ get() { return _hash; } }
+		property Int32 Count { Int32 get() { return _paths->Count; } }
+		property List<String^>^ Paths { List<String^>^ get() { return _paths; } }
+
+		SymbolHashGroup(SymbolHashKind kind, String^ hash, List<String^>^ paths)
+			: _kind(kind), _hash(hash), _paths(paths) { }
+
+	private:
+		SymbolHashKind _kind;
+		String^ _hash;
+		List<String^>^ _paths;
+	};
+
+	public ref class DuplicateSet
+	{
+	public:
+		property UInt64 FileSize { UInt64 get() { return _file_size; } }
+		property String^ Sha256 { String^ get() { return _sha256; } }
+		property Int32 Count { Int32 get() { return _paths->Count; } }
+
+		// The first path is the one that was parsed.
+		property List<String^>^ Paths { List<String^>^ get() { return _paths; } }
+
+		DuplicateSet(const Core::LS_DUPLICATE_SET& set, List<String^>^ paths)
+			: _file_size(set.FileSize), _paths(paths)
+		{
+			array<Byte>^ bytes = gcnew array<Byte>(LS_DEDUP_HASH_SIZE);
+			Marshal::Copy(IntPtr(const_cast<BYTE*>(set.Hash)), bytes, 0, LS_DEDUP_HASH_SIZE);
+			_sha256 = BitConverter::ToString(bytes)->Replace("-", String::Empty);
+		}
+
+	private:
+		UInt64 _file_size;
+		String^ _sha256;
+		List<String^>^ _paths;
+	};
+
+	public ref class SymbolHashReport
+	{
+	public:
+		property List<ImageSymbolHash^>^ Images { List<ImageSymbolHash^>^ get() { return _images; } }
+		property List<SymbolHashGroup^>^ Groups { List<SymbolHashGroup^>^ get() { return _groups; } }
+
+		// Empty unless duplicates were looked for.
+		property List<DuplicateSet^>^ Duplicates { List<DuplicateSet^>^ get() { return _duplicates; } }
+
+		SymbolHashReport(List<ImageSymbolHash^>^ images, List<SymbolHashGroup^>^ groups, List<DuplicateSet^>^ duplicates)
+			: _images(images), _groups(groups), _duplicates(duplicates) { }
+
+	private:
+		List<ImageSymbolHash^>^ _images;
+		List<SymbolHashGroup^>^ _groups;
+		List<DuplicateSet^>^ _duplicates;
+	};
+
+	public enum class BundleFileType
+	{
+		Unknown,
+		Assembly,
+		NativeBinary,
+		DepsJson,
+		RuntimeConfigJson,
+		Symbols
+	};
+
+	public ref class BundleEntry
+	{
+	public:
+		property String^ RelativePath { String^ get() { return _relative_path; } }
+		property BundleFileType Type { BundleFileType get() { return _type; } }
+		property UInt64 Offset { UInt64 get() { return _offset; } }
+		property UInt64 Size { UInt64 get() { return _size; } }
+		property UInt64 CompressedSize { UInt64 get() { return _compressed_size; } }
+		property bool IsCompressed { bool get() { return _compressed_size != 0; } }
+
+		// Assemblies, and native binaries only. Read in place, from the bundle.
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property bool IsClr { bool get() { return _is_clr; } }
+		property String^ AssemblyFullName { String^ get() { return _assembly_full_name; } }
+		property List<String^>^ Imports { List<String^>^ get() { return _imports; } }
+		property List<String^>^ References { List<String^>^ get() { return _references; } }
+		property List<String^>^ PInvokeModules { List<String^>^ get() { return _pinvoke_modules; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		BundleEntry(String^ relative_path, const Core::LS_BUNDLE_ENTRY& entry)
+			: _relative_path(relative_path), _type(static_cast<BundleFileType>(entry.Type)), _offset(entry.Offset), _size(entry.Size),
+				_compressed_size(entry.CompressedSize), _machine(0), _is_clr(false), _imports(gcnew List<String^>()),
+				_references(gcnew List<String^>()), _pinvoke_modules(gcnew List<String^>()) { }
+
+	internal:
+		void SetImage(UInt16 machine, bool is_clr, String^ assembly_full_name) {
+			_machine = machine;
+			_is_clr = is_clr;
+			_assembly_full_name = assembly_full_name;
+		}
+
+		void SetError(Exception^ error) { _error = error; }
+
+	private:
+		String^ _relative_path;
+		BundleFileType _type;
+		UInt64 _offset;
+		UInt64 _size;
+		UInt64 _compressed_size;
+		UInt16 _machine;
+		bool _is_clr;
+		String^ _assembly_full_name;
+		List<String^>^ _imports;
+		List<String^>^ _references;
+		List<String^>^ _pinvoke_modules;
+		Exception^ _error;
+	};
+
+	public ref class BundleInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property UInt32 MajorVersion { UInt32 get() { return _major_version; } }
+		property UInt32 MinorVersion { UInt32 get() { return _minor_version; } }
+		property String^ BundleId { String^ get() { return _bundle_id; } }
+		property UInt64 HeaderOffset { UInt64 get() { return _header_offset; } }
+		property UInt64 Flags { UInt64 get() { return _flags; } }
+		property List<BundleEntry^>^ Entries { List<BundleEntry^>^ get() { return _entries; } }
+
+		BundleInfo(String^ path, const Core::BundleReader& reader, String^ bundle_id, List<BundleEntry^>^ entries)
+			: _path(path), _major_version(reader.MajorVersion()), _minor_version(reader.MinorVersion()), _bundle_id(bundle_id),
+				_header_offset(reader.HeaderOffset()), _flags(reader.Flags()), _entries(entries) { }
+
+	private:
+		String^ _path;
+		UInt32 _major_version;
+		UInt32 _minor_version;
+		String^ _bundle_id;
+		UInt64 _header_offset;
+		UInt64 _flags;
+		List<BundleEntry^>^ _entries;
+	};
+
+	public enum class ReadyToRunSectionType
+	{
+		CompilerIdentifier = 100,
+		ImportSections = 101,
+		RuntimeFunctions = 102,
+		MethodDefEntryPoints = 103,
+		ExceptionInfo = 104,
+		DebugInfo = 105,
+		DelayLoadMethodCallThunks = 106,
+		AvailableTypes = 108,
+		InstanceMethodEntryPoints = 109,
+		InliningInfo = 110,
+		ProfileDataInfo = 111,
+		ManifestMetadata = 112,
+		AttributePresence = 113,
+		InliningInfo2 = 114,
+		ComponentAssemblies = 115,
+		OwnerCompositeExecutable = 116,
+		PgoInstrumentationData = 117,
+		ManifestAssemblyMvids = 118,
+		CrossModuleInlineInfo = 119,
+		HotColdMap = 120,
+		MethodIsGenericMap = 121,
+		EnclosingTypeMap = 122,
+		TypeGenericInfoMap = 123
+	};
+
+	public ref class ReadyToRunSection
+	{
+	public:
+		property ReadyToRunSectionType Type { ReadyToRunSectionType get() { return _type; } }
+		property UInt32 Rva { UInt32 get() { return _rva; } }
+		property UInt32 Size { UInt32 get() { return _size; } }
+
+		ReadyToRunSection(const Core::LS_READYTORUN_SECTION& section)
+			: _type(static_cast<ReadyToRunSectionType>(section.Type)), _rva(section.Rva), _size(section.Size) { }
+
+	private:
+		ReadyToRunSectionType _type;
+		UInt32 _rva;
+		UInt32 _size;
+	};
+
+	public ref class ReadyToRunInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property bool IsReadyToRun { bool get() { return _is_ready_to_run; } }
+		property bool IsNgenImage { bool get() { return _is_ngen_image; } }
+		property UInt16 MajorVersion { UInt16 get() { return _major_version; } }
+		property UInt16 MinorVersion { UInt16 get() { return _minor_version; } }
+		property UInt32 Flags { UInt32 get() { return _flags; } }
+		property bool IsComposite { bool get() { return _is_composite; } }
+		property bool IsComponent { bool get() { return _is_component; } }
+		property String^ OwnerComposite { String^ get() { return _owner_composite; } }
+		property String^ CompilerIdentifier { String^ get() { return _compiler_identifier; } }
+		property List<ReadyToRunSection^>^ Sections { List<ReadyToRunSection^>^ get() { return _sections; } }
+		property List<String^>^ ComponentAssemblies { List<String^>^ get() { return _component_assemblies; } }
+
+		// Assemblies the ReadyToRun code depends on, that the IL metadata doesn't reference.
+		property List<String^>^ ManifestReferences { List<String^>^ get() { return _manifest_references; } }
+
+		ReadyToRunInfo(String^ path, const Core::LS_READYTORUN_INFO& info)
+			: _path(path), _is_ready_to_run(info.IsReadyToRun), _is_ngen_image(info.IsNgenImage), _major_version(info.MajorVersion),
+				_minor_version(info.MinorVersion), _flags(info.Flags), _is_composite(info.IsComposite), _is_component(info.IsComponent)
+		{
+			_owner_composite = info.OwnerComposite.Length() > 0 ? gcnew String(info.OwnerComposite.GetBuffer()) : nullptr;
+			_compiler_identifier = info.CompilerIdentifier.Length() > 0 ? gcnew String(info.CompilerIdentifier.GetBuffer()) : nullptr;
+
+			_sections = gcnew List<ReadyToRunSection^>(static_cast<Int32>(info.Sections.size()));
+			for (const Core::LS_READYTORUN_SECTION& section : info.Sections)
+				_sections->Add(gcnew ReadyToRunSection(section));
+
+			_component_assemblies = gcnew List<String^>(static_cast<Int32>(info.ComponentAssemblies.size()));
+			for (const WuString& name : info.ComponentAssemblies)
+				_component_assemblies->Add(gcnew String(name.GetBuffer()));
+
+			_manifest_references = gcnew List<String^>(static_cast<Int32>(info.ManifestReferences.size()));
+			for (const WuString& name : info.ManifestReferences)
+				_manifest_references->Add(gcnew String(name.GetBuffer()));
+		}
+
+	private:
+		String^ _path;
+		bool _is_ready_to_run;
+		bool _is_ngen_image;
+		UInt16 _major_version;
+		UInt16 _minor_version;
+		UInt32 _flags;
+		bool _is_composite;
+		bool _is_component;
+		String^ _owner_composite;
+		String^ _compiler_identifier;
+		List<ReadyToRunSection^>^ _sections;
+		List<String^>^ _component_assemblies;
+		List<String^>^ _manifest_references;
+	};
+
+	public ref class PackageEntry
+	{
+	public:
+		property String^ Name { String^ get() { return _name; } }
+		property UInt16 Method { UInt16 get() { return _method; } }
+		property UInt64 CompressedSize { UInt64 get() { return _compressed_size; } }
+		property UInt64 Size { UInt64 get() { return _size; } }
+		property UInt32 Crc32 { UInt32 get() { return _crc32; } }
+		property bool IsCompressed { bool get() { return _method != LS_ZIP_METHOD_STORED; } }
+
+		// Images only, by extension. Stored ones are read in place, deflated ones inflated as far
+		// as the tables go. 'BytesInflated' is how far, zero for stored images.
+		property bool IsImage { bool get() { return _is_image; } }
+		property UInt64 BytesInflated { UInt64 get() { return _bytes_inflated; } }
+		property UInt16 Machine { UInt16 get() { return _machine; } }
+		property bool IsClr { bool get() { return _is_clr; } }
+		property String^ AssemblyFullName { String^ get() { return _assembly_full_name; } }
+		property List<String^>^ Imports { List<String^>^ get() { return _imports; } }
+		property List<String^>^ References { List<String^>^ get() { return _references; } }
+		property List<String^>^ PInvokeModules { List<String^>^ get() { return _pinvoke_modules; } }
+		property Exception^ Error { Exception^ get() { return _error; } }
+
+		PackageEntry(String^ name, const Core::LS_ZIP_ENTRY& entry)
+			: _name(name), _method(entry.Method), _compressed_size(entry.CompressedSize), _size(entry.UncompressedSize), _crc32(entry.Crc32),
+				_is_image(false), _bytes_inflated(0), _machine(0), _is_clr(false), _imports(gcnew List<String^>()),
+				_references(gcnew List<String^>()), _pinvoke_modules(gcnew List<String^>()) { }
+
+	internal:
+		void SetImage(UInt16 machine, bool is_clr, String^ assembly_full_name, UInt64 bytes_inflated) {
+			_is_image = true;
+			_machine = machine;
+			_is_clr = is_clr;
+			_assembly_full_name = assembly_full_name;
+			_bytes_inflated = bytes_inflated;
+		}
+
+		void SetError(Exception^ error) {
+			_is_image = true;
+			_error = error;
+		}
+
+	private:
+		String^ _name;
+		UInt16 _method;
+		UInt64 _compressed_size;
+		UInt64 _size;
+		UInt32 _crc32;
+		bool _is_image;
+		UInt64 _bytes_inflated;
+		UInt16 _machine;
+		bool _is_clr;
+		String^ _assembly_full_name;
+		List<String^>^ _imports;
+		List<String^>^ _references;
+		List<String^>^ _pinvoke_modules;
+		Exception^ _error;
+	};
+
+	public ref class PackageInfo
+	{
+	public:
+		property String^ Path { String^ get() { return _path; } }
+		property List<PackageEntry^>^ Entries { List<PackageEntry^>^ get() { return _entries; } }
+
+		PackageInfo(String^ path, List<PackageEntry^>^ entries)
+			: _path(path), _entries(entries) { }
+
+	private:
+		String^ _path;
+		List<PackageEntry^>^ _entries;
+	};
+
+	[Serializable()]
+	public ref class NativeException : public Exception
+	{
+	public:
+		property Int32 ErrorCode { Int32 get() { return _error_code; } }
+		property String^ CompactTrace { String^ get() { return _compact_trace; } }
+
+		NativeException(Int32 error_code)
+			: Exception((gcnew String(Core::LSRESULT::GetErrorMessage(error_code).GetBuffer()))->Trim()),
+			  _error_code(error_code) { }
+
+		NativeException(Int32 error_code, String^ message)
+			: Exception(message), _error_code(error_code) { }
+
+		NativeException(Int32 error_code, String^ message, Exception^ inner_exception)
+			: Exception(message, inner_exception), _error_code(error_code) { }
+
+		NativeException(Core::LSRESULT& ls_error)
+			: Exception(gcnew String(ls_error.Message.GetBuffer())),
+			  _error_code(ls_error.Result),
+			  _compact_trace(gcnew String(ls_error.CompactTrace.GetBuffer())) { }
+
+	protected:
+		NativeException()
+			: Exception() { }
+
+		NativeException(SerializationInfo^ info, StreamingContext context)
+			: Exception(info, context) { }
+
+	private:
+		Int32 _error_code;
+		String^ _compact_trace;
+	};
+}
+
+namespace LibSnitcher::Core {
+	public ref class Wrapper
+	{
+	public:
+		Wrapper();
+		~Wrapper();
+
+		// 'importing_name' is the name of the module that imports 'file_name', if any. Its activation
+		// context, then the one of the root, are searched before the standard search order.
+		ModuleBase^ GetDependencyList(String^ file_name, DependencySource source, Int32 depth, String^ importing_name);
+
+		// Resolves the native chain of 'file_name' in one call, with the 'ScanStrings', 'Limits', and trace
+		// of this instance. A 'depth' of zero means no limit. Meant to follow the root 'GetDependencyList'
+		// call: it runs under the timeout that started, and doesn't start one.
+		ResolvedChain^ ResolveChain(String^ file_name, Int32 depth);
+
+		// Tracing is off by default. Once started, every module resolved and parsed
+		// through this instance is recorded, until 'StopTrace' writes the events to 'file_path'.
+		void StartTrace();
+		void StopTrace(String^ file_path);
+
+		// Off by default. When on, module names found in the read-only data of every
+		// image are listed as 'Heuristic' dependencies, after the ones from the PE tables.
+		property bool ScanStrings {
+			bool get() { return _scan_strings; }
+			void set(bool value) { _scan_strings = value; }
+		}
+
+		// Null means the default per-file limits, without a timeout. The timeout starts at depth zero.
+		property ScanLimits^ Limits {
+			ScanLimits^ get() { return _limits; }
+			void set(ScanLimits^ value) { _limits = value; }
+		}
+
+		// The Windows directory side-by-side assemblies are looked up in. Null means the one of this system.
+		property String^ Sysroot {
+			String^ get() { return _sysroot; }
+			void set(String^ value) {
+				_sysroot = value;
+				if (_sxs != NULL) {
+					delete _sxs;
+					_sxs = NULL;
+				}
+			}
+		}
+
+	protected:
+		!Wrapper();
+
+	private:
+		TraceRecorder* _tracer;
+
+		// The WinSxS store index is built the first time a manifest asks for it.
+		// Activation contexts are per module, by lowercase name, the root's applies to the whole
+		// chain. Both are the ones of the chain being listed, reset at depth zero.
+		SxsStoreIndex* _sxs;
+		String^ _sysroot;
+		wuvector<LS_ASSEMBLY_IDENTITY>* _root_context;
+		wumap<WWuString, wuvector<LS_ASSEMBLY_IDENTITY>>* _module_contexts;
+		bool _scan_strings;
+		ScanLimits^ _limits;
+
+		// The bundle the chain started from, if the root is one. Reset at depth zero.
+		BundleReader* _bundle;
+		String^ _bundle_path;
+		Dictionary<String^, UInt32>^ _bundle_entries;
+
+		// Compressed bundle entries are inflated here, one at a time. Only grown.
+		wuvector<BYTE>* _inflate_buffer;
+
+		ModuleBase^ GetDependencyListCore(String^ file_name, DependencySource source, Int32 depth, String^ importing_name);
+		LSRESULT GetBasicInformation(HMODULE hmodule, String^ name, Int32 depth, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info);
+		WorkBudget CreateBudget();
+		void ReadResources(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, ModuleBase^ module, Int32 depth);
+		void ScanModuleNames(HMODULE hmodule, PeHelper::PLS_IMAGE_BASIC_INFORMATION basic_info, ModuleBase^ module);
+		bool FindSxsModule(const WWuString& module_name, String^ importing_name, WWuString& module_path);
+		SxsStoreIndex* GetSxsIndex();
+		void AddBundledFiles(String^ path, ModuleBase^ module);
+		ModuleBase^ GetBundledModule(String^ relative_path, Int32 depth);
+		void ReadReadyToRun(HMODULE hmodule, String^ path, ModuleBase^ module);
+		void AddReadyToRunDependencies(const ImageView& view, String^ path, ModuleBase^ module);
+	};
+
+	// Hosts the native resolver daemon in this process.
+	public ref class DaemonHost
+	{
+	public:
+		// A null 'sysroot' means the Windows directory of this system.
+		DaemonHost(String^ sysroot);
+		~DaemonHost();
+
+		void Start(String^ socket_path);
+		void Stop();
+
+	protected:
+		!DaemonHost();
+
+	private:
+		ResolverDaemon* _daemon;
+	};
+
+	// Binary snapshots of natively resolved chains. The format is documented in 'ClrCore\Snapshot.h'.
+	public ref class DependencySnapshot abstract sealed
+	{
+	public:
+		// Resolves 'file_name', and writes the chain to 'file_path'. Returns the number of modules written.
+		// Side-by-side assemblies are looked up under 'sysroot', null means the Windows directory of this system.
+		static Int32 Export(String^ file_name, Int32 depth, String^ file_path, String^ sysroot);
+
+		// Compares two snapshots by module name. Entries are ordered by module name.
+		static List<SnapshotDiffEntry^>^ Compare(String^ reference_path, String^ difference_path);
+	};
+
+	public ref class AuthenticodeHasher abstract sealed
+	{
+	public:
+		// Computes the Authenticode digests, and the PE checksum in one pass over the file.
+		static ImageDigest^ Hash(String^ file_path, PageHashAlgorithm page_algorithm);
+	};
+
+	public ref class AuthenticodeSignature abstract sealed
+	{
+	public:
+		// Reads the signer identities from the certificate table, without verifying anything.
+		// Parsed signatures are cached by content hash, for the lifetime of the process.
+		static ImageSignature^ Get(String^ file_path);
+	};
+
+	public ref class DebugDirectory abstract sealed
+	{
+	public:
+		// Reads the debug directory, and the CodeView, POGO, repro, and embedded PDB entries.
+		static ImageDebugInfo^ Get(String^ file_path);
+
+		// Reads only the headers, the debug directory, and the CodeView records of each file, issuing
+		// the reads asynchronously, and parsing on 'thread_count' threads. Zero means one per processor.
+		// Failures are returned per file.
+		static List<SymbolKeyInfo^>^ GetSymbolKeys(IEnumerable<String^>^ file_paths, Int32 thread_count);
+	};
+
+	public ref class RichHeader abstract sealed
+	{
+	public:
+		// Reads the bytes before the NT headers, and decodes the Rich header, if any.
+		static RichHeaderInfo^ Get(String^ file_path);
+
+		// Counts, for each comp.id, the files it's in. Files are read in parallel, keeping the
+		// device queue full. Counts are sorted by file count. Files that can't be read, or are
+		// not images, are not counted, and are returned as failures, in input order.
+		static ToolchainReport^ Aggregate(IEnumerable<String^>^ file_paths);
+	};
+
+	public ref class LoadCost abstract sealed
+	{
+	public:
+		// Resolves 'file_name' natively, and sums the image sizes, fixups, TLS callbacks,
+		// and guard tables of every module in the chain. A 'depth' of zero means no limit.
+		// Side-by-side assemblies are looked up under 'sysroot', null means the Windows directory of this system.
+		static ChainLoadCost^ Measure(String^ file_name, Int32 depth, String^ sysroot);
+	};
+
+	public ref class FunctionTable abstract sealed
+	{
+	public:
+		// Maps the image once, and finds the function containing each RVA in the exception directory.
+		// Matches are in the order of 'rvas'. Unwind data is decoded only if 'include_unwind' is set.
+		static List<FunctionMatch^>^ Lookup(String^ file_path, IEnumerable<UInt32>^ rvas, bool include_unwind);
+	};
+
+	public ref class CoffFile abstract sealed
+	{
+	public:
+		// Reads the sections, with long names, the symbol table, and optionally the relocations of an object file.
+		static CoffObjectInfo^ Get(String^ file_path, bool include_relocations);
+
+		// Maps every object on 'thread_count' threads, and counts the references, and definitions
+		// of each external symbol. Zero means one per processor. Failures are returned per file.
+		static CoffScanReport^ Scan(IEnumerable<String^>^ file_paths, Int32 thread_count, bool unresolved_only);
+	};
+
+	public ref class StaticLibrary abstract sealed
+	{
+	public:
+		// Lists the members of a static, or import library. Objects are read in place, import entries decoded.
+		static LibraryInfo^ Get(String^ file_path);
+
+		// Indexes the symbols of every library, from the linker members, on 'thread_count' threads.
+		// Zero means one per processor. Failures are returned per file.
+		static List<LibraryIndex^>^ GetSymbols(IEnumerable<String^>^ file_paths, Int32 thread_count);
+	};
+
+	public ref class SymbolHash abstract sealed
+	{
+	public:
+		// Computes the imphash, and the export hash of every image on 'thread_count' threads,
+		// and groups the files by each. Zero means one per processor. Failures are returned per file.
+		// With 'deduplicate', files with the same content are mapped once.
+		static SymbolHashReport^ Compute(IEnumerable<String^>^ file_paths, Int32 thread_count, bool deduplicate);
+
+		// The same, within 'limits'. Once cancelled, or past the timeout, the files not started
+		// yet fail with 'ERROR_CANCELLED', or 'ERROR_TIMEOUT'.
+		static SymbolHashReport^ Compute(IEnumerable<String^>^ file_paths, Int32 thread_count, bool deduplicate, ScanLimits^ limits);
+	};
+
+	public ref class ContentDedup abstract sealed
+	{
+	public:
+		// Finds files with the same content, by size, then a hash of sampled pages, then SHA-256.
+		// Zero threads means one per processor. Files that can't be read are left out.
+		static List<DuplicateSet^>^ Find(IEnumerable<String^>^ file_paths, Int32 thread_count);
+	};
+
+	public ref class SingleFileBundle abstract sealed
+	{
+	public:
+		// Reads the manifest of a single-file bundle, and the headers, imports, and CLR metadata
+		// of each embedded assembly, and native binary, in place. Nothing is extracted.
+		static BundleInfo^ Get(String^ file_path);
+	};
+
+	public ref class PackageArchive abstract sealed
+	{
+	public:
+		// Reads the central directory of a zip archive, or NuGet package, and parses the images in
+		// it without extracting them. One buffer is used to inflate every compressed image.
+		static PackageInfo^ Get(String^ file_path);
+	};
+
+	public ref class ReadyToRunImage abstract sealed
+	{
+	public:
+		// Reads the ReadyToRun header, and section table, the component assemblies, and the manifest
+		// metadata references. The file is mapped as data, and only the pages read are touched.
+		static ReadyToRunInfo^ Get(String^ file_path);
 	};
 
 	static WuString GetNarrowFromManagedString(String^ str);
+	static String^ GetStringFromUtf8(const char* value, size_t length);
 	static bool TryLoadAssembly(String^ name, String^ path, Assembly^& assembly, Exception^& loader_exception);
 	
 	static DateTime GetDateTimeFromTimeT(DWORD seconds) {
@@ -0,0 +1,251 @@
+#include "pch.h"
+
+#include "Zip.h"
+
+#include <algorithm>
+
+namespace LibSnitcher::Core
+{
+	#define LS_ZIP_LOCAL_HEADER_SIGNATURE 0x04034B50
+	#define LS_ZIP_CENTRAL_HEADER_SIGNATURE 0x02014B50
+	#define LS_ZIP_END_SIGNATURE 0x06054B50
+	#define LS_ZIP64_END_SIGNATURE 0x06064B50
+	#define LS_ZIP64_LOCATOR_SIGNATURE 0x07064B50
+	#define LS_ZIP64_EXTRA_ID 0x0001
+
+	#define LS_ZIP_LOCAL_HEADER_SIZE 30
+	#define LS_ZIP_CENTRAL_HEADER_SIZE 46
+	#define LS_ZIP_END_SIZE 22
+	#define LS_ZIP64_END_SIZE 56
+	#define LS_ZIP64_LOCATOR_SIZE 20
+	#define LS_ZIP_MAX_COMMENT 0xFFFF
+
+	ZipReader::ZipReader()
+		: _h_file(INVALID_HANDLE_VALUE), _h_map(NULL), _view(NULL), _data(NULL), _size(0) { }
+
+	ZipReader::~ZipReader()
+	{
+		Close();
+	}
+
+	const LSRESULT ZipReader::Open(const WWuString& file_path)
+	{
+		Close();
+
+		_h_file = CreateFile(file_path.GetBuffer(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (_h_file == INVALID_HANDLE_VALUE)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(_h_file, &file_size))
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		// Empty files can't be mapped.
+		if (file_size.QuadPart < LS_ZIP_END_SIZE)
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a zip archive.", __FILEW__, __LINE__);
+
+		_h_map = CreateFileMapping(_h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_h_map == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		_view = static_cast<const BYTE*>(MapViewOfFile(_h_map, FILE_MAP_READ, 0, 0, 0));
+		if (_view == NULL)
+			return LSRESULT(GetLastError(), __FILEW__, __LINE__);
+
+		return Attach(_view, static_cast<size_t>(file_size.QuadPart));
+	}
+
+	const LSRESULT ZipReader::Attach(const BYTE* data, size_t size)
+	{
+		// 'Open' attaches its own view.
+		if (data != _view)
+			Close();
+
+		_entries.clear();
+		_data = data;
+		_size = size;
+
+		size_t end_offset;
+		if (data == NULL || !FindEndRecord(end_offset))
+			return LSRESULT(ERROR_BAD_FORMAT, L"File is not a zip archive.", __FILEW__, __LINE__);
+
+		// Total entry count, directory size, and offset. All ones mean the ZIP64 record has them.
+		ULONGLONG entry_count = *reinterpret_cast<const WORD*>(data + end_offset + 10);
+		ULONGLONG directory_size = *reinterpret_cast<const DWORD*>(data + end_offset + 12);
+		ULONGLONG directory_offset = *reinterpret_cast<const DWORD*>(data + end_offset + 16);
+		if (entry_count == MAXWORD || directory_size == MAXDWORD || directory_offset == MAXDWORD) {
+			if (!ReadZip64EndRecord(end_offset, entry_count, directory_offset, directory_size))
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid ZIP64 end of central directory.", __FILEW__, __LINE__);
+		}
+
+		if (directory_offset > size || directory_size > size - directory_offset)
+			return LSRESULT(ERROR_BAD_FORMAT, L"Central directory out of bounds.", __FILEW__, __LINE__);
+
+		// The count can't be trusted more than the directory size.
+		_entries.reserve(static_cast<size_t>(min(entry_count, directory_size / LS_ZIP_CENTRAL_HEADER_SIZE)));
+
+		size_t offset = static_cast<size_t>(directory_offset);
+		size_t end = static_cast<size_t>(directory_offset + directory_size);
+		for (ULONGLONG i = 0; i < entry_count; i++) {
+			if (end - offset < LS_ZIP_CENTRAL_HEADER_SIZE || *reinterpret_cast<const DWORD*>(data + offset) != LS_ZIP_CENTRAL_HEADER_SIGNATURE)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Invalid central directory entry.", __FILEW__, __LINE__);
+
+			const BYTE* header = data + offset;
+			WORD name_length = *reinterpret_cast<const WORD*>(header + 28);
+			WORD extra_length = *reinterpret_cast<const WORD*>(header + 30);
+			WORD comment_length = *reinterpret_cast<const WORD*>(header + 32);
+			size_t header_size = static_cast<size_t>(LS_ZIP_CENTRAL_HEADER_SIZE) + name_length + extra_length + comment_length;
+			if (end - offset < header_size)
+				return LSRESULT(ERROR_BAD_FORMAT, L"Central directory out of bounds.", __FILEW__, __LINE__);
+
+			LS_ZIP_ENTRY entry{ };
+			entry.Flags = *reinterpret_cast<const WORD*>(header + 8);
+			entry.Method = *reinterpret_cast<const WORD*>(header + 10);
+			entry.Crc32 = *reinterpret_cast<const DWORD*>(header + 16);
+			entry.CompressedSize = *reinterpret_cast<const DWORD*>(header + 20);
+			entry.UncompressedSize = *reinterpret_cast<const DWORD*>(header + 24);
+			entry.LocalHeaderOffset = *reinterpret_cast<const DWORD*>(header + 42);
+			entry.Name = reinterpret_cast<const char*>(header + LS_ZIP_CENTRAL_HEADER_SIZE);
+			entry.NameLength = name_length;
+			ReadZip64Extra(header + LS_ZIP_CENTRAL_HEADER_SIZE + name_length, extra_length, entry);
+
+			_entries.push_back(entry);
+			offset += header_size;
+		}
+
+		return LSRESULT();
+	}
+
+	void ZipReader::Close() noexcept
+	{
+		if (_view != NULL) {
+			UnmapViewOfFile(_view);
+			_view = NULL;
+		}
+
+		if (_h_map != NULL) {
+			CloseHandle(_h_map);
+			_h_map = NULL;
+		}
+
+		if (_h_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(_h_file);
+			_h_file = INVALID_HANDLE_VALUE;
+		}
+
+		_data = NULL;
+		_size = 0;
+		_entries.clear();
+	}
+
+	bool ZipReader::IsDirectory(DWORD index) const noexcept
+	{
+		const LS_ZIP_ENTRY& entry = _entries[index];
+
+		return entry.NameLength > 0 && (entry.Name[entry.NameLength - 1] == '/' || entry.Name[entry.NameLength - 1] == '\\');
+	}
+
+	bool ZipReader::GetEntryData(DWORD index, const BYTE*& data, size_t& size) const noexcept
+	{
+		if (index >= _entries.size())
+			return false;
+
+		// The local header has its own name, and extra field lengths, not always the central directory ones.
+		const LS_ZIP_ENTRY& entry = _entries[index];
+		if (entry.LocalHeaderOffset > _size || _size - entry.LocalHeaderOffset < LS_ZIP_LOCAL_HEADER_SIZE)
+			return false;
+
+		const BYTE* header = _data + entry.LocalHeaderOffset;
+		if (*reinterpret_cast<const DWORD*>(header) != LS_ZIP_LOCAL_HEADER_SIGNATURE)
+			return false;
+
+		ULONGLONG data_offset = entry.LocalHeaderOffset + LS_ZIP_LOCAL_HEADER_SIZE + *reinterpret_cast<const WORD*>(header + 26) + *reinterpret_cast<const WORD*>(header + 28);
+		if (data_offset > _size || entry.CompressedSize > _size - data_offset)
+			return false;
+
+		data = _data + data_offset;
+		size = static_cast<size_t>(entry.CompressedSize);
+
+		return true;
+	}
+
+	bool ZipReader::FindEndRecord(size_t& offset) const noexcept
+	{
+		if (_size < LS_ZIP_END_SIZE)
+			return false;
+
+		// Usually there's no comment, and the record is the last 22 bytes.
+		size_t lowest = _size - LS_ZIP_END_SIZE > LS_ZIP_MAX_COMMENT ? _size - LS_ZIP_END_SIZE - LS_ZIP_MAX_COMMENT : 0;
+		for (size_t current = _size - LS_ZIP_END_SIZE + 1; current-- > lowest;) {
+			if (*reinterpret_cast<const DWORD*>(_data + current) != LS_ZIP_END_SIGNATURE)
+				continue;
+
+			// The comment must end where the file does, or the signature is part of something else.
+			WORD comment_length = *reinterpret_cast<const WORD*>(_data + current + 20);
+			if (current + LS_ZIP_END_SIZE + comment_length == _size) {
+				offset = current;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool ZipReader::ReadZip64EndRecord(size_t end_offset, ULONGLONG& entry_count, ULONGLONG& directory_offset, ULONGLONG& directory_size) const noexcept
+	{
+		// The locator is right before the end record, and has the offset of the ZIP64 one.
+		if (end_offset < LS_ZIP64_LOCATOR_SIZE)
+			return false;
+
+		const BYTE* locator = _data + end_offset - LS_ZIP64_LOCATOR_SIZE;
+		if (*reinterpret_cast<const DWORD*>(locator) != LS_ZIP64_LOCATOR_SIGNATURE)
+			return false;
+
+		ULONGLONG record_offset = *reinterpret_cast<const ULONGLONG*>(locator + 8);
+		if (record_offset > _size || _size - record_offset < LS_ZIP64_END_SIZE)
+			return false;
+
+		const BYTE* record = _data + record_offset;
+		if (*reinterpret_cast<const DWORD*>(record) != LS_ZIP64_END_SIGNATURE)
+			return false;
+
+		entry_count = *reinterpret_cast<const ULONGLONG*>(record + 32);
+		directory_size = *reinterpret_cast<const ULONGLONG*>(record + 40);
+		directory_offset = *reinterpret_cast<const ULONGLONG*>(record + 48);
+
+		return true;
+	}
+
+	void ZipReader::ReadZip64Extra(const BYTE* extra, WORD extra_size, LS_ZIP_ENTRY& entry) noexcept
+	{
+		// Tag, and size, then only the fields that are all ones in the header, in this order.
+		size_t offset = 0;
+		while (extra_size - offset >= 4) {
+			WORD id = *reinterpret_cast<const WORD*>(extra + offset);
+			WORD size = *reinterpret_cast<const WORD*>(extra + offset + 2);
+			offset += 4;
+			if (size > extra_size - offset)
+				return;
+
+			if (id == LS_ZIP64_EXTRA_ID) {
+				const BYTE* field = extra + offset;
+				const BYTE* end = field + size;
+				ULONGLONG* values[3] = { &entry.UncompressedSize, &entry.CompressedSize, &entry.LocalHeaderOffset };
+				for (ULONGLONG* value : values) {
+					if (*value != MAXDWORD)
+						continue;
+
+					if (end - field < 8)
+						return;
+
+					*value = *reinterpret_cast<const ULONGLONG*>(field);
+					field += 8;
+				}
+
+				return;
+			}
+
+			offset += size;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#pragma unmanaged
+
+#include "Common.h"
+#include "Expressions.h"
+
+namespace LibSnitcher::Core
+{
+	#define LS_ZIP_METHOD_STORED 0
+	#define LS_ZIP_METHOD_DEFLATE 8
+
+	// General purpose flag bit 0.
+	#define LS_ZIP_FLAG_ENCRYPTED 0x0001
+
+	// A central directory entry. 'Name' points into the file, is UTF-8, or CP437 for old archivers,
+	// and is not null terminated. Sizes, and the offset, are the ZIP64 ones when the entry has them.
+	typedef struct _LS_ZIP_ENTRY
+	{
+		const char* Name;
+		DWORD NameLength;
+		WORD Method;
+		WORD Flags;
+		DWORD Crc32;
+		ULONGLONG CompressedSize;
+		ULONGLONG UncompressedSize;
+		ULONGLONG LocalHeaderOffset;
+
+	} LS_ZIP_ENTRY, *PLS_ZIP_ENTRY;
+
+	// Reader for zip archives, NuGet packages included. Only the central directory is read up front.
+	// Entry data is found through the local header when asked for, and is a range of the mapping.
+	// Stored entries are the file itself, deflated ones go through 'Inflater'. Nothing is extracted.
+	class ZipReader
+	{
+	public:
+		ZipReader();
+		~ZipReader();
+
+		// Fails with 'ERROR_BAD_FORMAT' for files without an end of central directory record.
+		const LSRESULT Open(const WWuString& file_path);
+
+		// 'data' is not copied, and must outlive the reader.
+		const LSRESULT Attach(const BYTE* data, size_t size);
+		void Close() noexcept;
+
+		_NODISCARD DWORD EntryCount() const noexcept { return static_cast<DWORD>(_entries.size()); }
+		_NODISCARD const LS_ZIP_ENTRY& GetEntry(DWORD index) const noexcept { return _entries[index]; }
+
+		// Directories end with a slash.
+		_NODISCARD bool IsDirectory(DWORD index) const noexcept;
+
+		// The entry data as it is in the file, compressed or not. False if the local header, or the
+		// data, are out of bounds.
+		bool GetEntryData(DWORD index, const BYTE*& data, size_t& size) const noexcept;
+
+	private:
+		HANDLE _h_file;
+		HANDLE _h_map;
+		const BYTE* _view;
+		const BYTE* _data;
+		size_t _size;
+		wuvector<LS_ZIP_ENTRY> _entries;
+
+		// The end of central directory record, searched backwards over the comment.
+		bool FindEndRecord(size_t& offset) const noexcept;
+		bool ReadZip64EndRecord(size_t end_offset, ULONGLONG& entry_count, ULONGLONG& directory_offset, ULONGLONG& directory_size) const noexcept;
+		static void ReadZip64Extra(const BYTE* extra, WORD extra_size, LS_ZIP_ENTRY& entry) noexcept;
+	};
+}
\ No newline at end of file
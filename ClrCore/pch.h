@@ -21,12 +21,16 @@
 #pragma comment(lib, "Imagehlp.lib")
 #pragma comment(lib, "Shlwapi.lib")
 #pragma comment(lib, "Pathcch.lib")
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Bcrypt.lib")
 
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include <memory>
 #include <xstring>
 #include <Windows.h>
+#include <bcrypt.h>
 #include <Pathcch.h>
 #include <Shlwapi.h>
 #include <ImageHlp.h>
@@ -1,7 +1,10 @@
-﻿using System.IO;
+﻿using System;
+using System.IO;
 using System.Linq;
+using System.Threading;
 using System.Collections.Generic;
 using System.Management.Automation;
+using LibSnitcher.Core;
 
 namespace LibSnitcher.Commands
 {
@@ -23,11 +26,25 @@ namespace LibSnitcher.Commands
     ///     <para>Returning the dependency chain for 'mscorlib.dll', using an assembly qualified name. Unique values only.</para>
     ///     <para></para>
     /// </example>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-PeDependencyChain -Path 'C:\Windows\explorer.exe' -TracePath 'C:\Temp\explorer.trace.json'</code>
+    ///     <para>Returning the dependency chain from 'explorer.exe', and writing a Trace Event file that can be opened in Perfetto.</para>
+    ///     <para></para>
+    /// </example>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-PeDependencyChain -Path 'C:\Windows\explorer.exe' -IncludeHeuristic</code>
+    ///     <para>Returning the dependency chain from 'explorer.exe', including modules named in its read-only data.</para>
+    ///     <para></para>
+    /// </example>
     /// </summary>
     [Cmdlet(VerbsCommon.Get, "PeDependencyChain")]
     [Alias("getdepchain")]
     public class GetModuleDependencyChainCommand : PSCmdlet
     {
+        private ScanLimits _limits;
+
         /// <summary>
         /// <para type="description">The path, name for a portable executable, or .NET assembly fully qualified name.</para>
         /// <para type="description">The Cmdlet will resolve by attempting to load the module.</para>
@@ -53,10 +70,54 @@ namespace LibSnitcher.Commands
         [ValidateRange(0, int.MaxValue)]
         public int Depth { get; set; } = 0;
 
+        /// <summary>
+        /// <para type="description">A file path to write a Trace Event JSON of the resolution run.</para>
+        /// <para type="description">The trace contains one span per module resolve and parse, and can be opened in Perfetto, or 'chrome://tracing'.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateNotNullOrEmpty]
+        public string TracePath { get; set; }
+
+        /// <summary>
+        /// <para type="description">Also lists modules whose names are in the read-only data of the image, like the ones loaded with 'LoadLibrary'.</para>
+        /// <para type="description">These are a guess, the module might never be loaded. They are marked as 'Heuristic'.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter IncludeHeuristic { get; set; }
+
+        /// <summary>
+        /// <para type="description">The maximum time in seconds to resolve the chain. Zero, the default, means no timeout.</para>
+        /// <para type="description">When the time runs out, or the command is stopped, the modules resolved until then are returned, and a warning says the chain is partial.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, int.MaxValue)]
+        public int TimeoutSec { get; set; }
+
+        /// <summary>
+        /// <para type="description">The Windows directory side-by-side assemblies are looked up in, like the one of a mounted image.</para>
+        /// <para type="description">Defaults to the Windows directory of this system.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateNotNullOrEmpty]
+        public string Sysroot { get; set; }
+
         protected override void ProcessRecord()
         {
+            string trace_path = null;
+            if (!string.IsNullOrEmpty(TracePath))
+                trace_path = GetUnresolvedProviderPathFromPSPath(TracePath);
+
+            string sysroot = string.IsNullOrEmpty(Sysroot) ? null : GetUnresolvedProviderPathFromPSPath(Sysroot);
+
+            _limits = new() { Timeout = TimeSpan.FromSeconds(TimeoutSec) };
+
             Helper helper = new(this);
-            helper.PrintModuleDependencyChain(Path, Unique, Depth);
+            helper.PrintModuleDependencyChain(Path, Unique, Depth, IncludeHeuristic, trace_path, _limits, sysroot);
+        }
+
+        protected override void StopProcessing()
+        {
+            _limits?.Cancel();
         }
     }
 
@@ -153,4 +214,1037 @@ namespace LibSnitcher.Commands
             WriteObject(new PortableExecutable(Path));
         }
     }
+
+    /// <summary>
+    /// <para type="synopsis">Runs the resolver daemon.</para>
+    /// <para type="description">This Cmdlet starts the native resolver in daemon mode, and blocks until stopped with Ctrl+C.</para>
+    /// <para type="description">The daemon keeps parsed images, and directory listings in memory, and answers chain, headers and reverse dependency queries over a Unix domain socket.</para>
+    /// <para type="description">Cached images are validated against the file size, and last write time, so changed files are parsed again.</para>
+    /// <para type="description">The binary protocol is documented in 'ClrCore\Daemon.h'.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Start-PeResolverDaemon -SocketPath 'C:\Temp\libsnitcher.sock'</code>
+    ///     <para>Starting the daemon, listening on 'C:\Temp\libsnitcher.sock'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsLifecycle.Start, "PeResolverDaemon")]
+    public class StartPeResolverDaemonCommand : PSCmdlet
+    {
+        private readonly ManualResetEventSlim _stop_event = new(false);
+
+        /// <summary>
+        /// <para type="description">The path for the Unix domain socket.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0)]
+        [ValidateNotNullOrEmpty]
+        public string SocketPath { get; set; }
+
+        /// <summary>
+        /// <para type="description">The Windows directory side-by-side assemblies are looked up in, like the one of a mounted image.</para>
+        /// <para type="description">Defaults to the Windows directory of this system.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateNotNullOrEmpty]
+        public string Sysroot { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            string socket_path = GetUnresolvedProviderPathFromPSPath(SocketPath);
+            string sysroot = string.IsNullOrEmpty(Sysroot) ? null : GetUnresolvedProviderPathFromPSPath(Sysroot);
+            using DaemonHost host = new(sysroot);
+
+            host.Start(socket_path);
+            WriteVerbose($"Listening on '{socket_path}'. Press Ctrl+C to stop.");
+
+            _stop_event.Wait();
+            host.Stop();
+        }
+
+        protected override void StopProcessing()
+        {
+            _stop_event.Set();
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Writes a binary snapshot of a module's dependency chain.</para>
+    /// <para type="description">This Cmdlet resolves the dependency chain natively, and writes it to a compact binary snapshot file.</para>
+    /// <para type="description">The snapshot holds the modules, edges, header summaries, and error codes, and can be read from a mapped view without parsing.</para>
+    /// <para type="description">Only the PE import and delay load tables are resolved. The format is documented in 'ClrCore\Snapshot.h'.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Export-PeDependencySnapshot -Path 'C:\Windows\explorer.exe' -Destination 'C:\Temp\explorer.lssn'</code>
+    ///     <para>Writing the dependency chain from 'explorer.exe' to 'C:\Temp\explorer.lssn'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsData.Export, "PeDependencySnapshot")]
+    [OutputType(typeof(FileInfo))]
+    public class ExportPeDependencySnapshotCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The path, or name for a portable executable.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0)]
+        [Alias("Name")]
+        public string Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The snapshot file path. Existing files are overwritten.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 1)]
+        [ValidateNotNullOrEmpty]
+        public string Destination { get; set; }
+
+        /// <summary>
+        /// <para type="description">The maximum recursion depth.</para>
+        /// <para type="description">Depth 1 returns only the dependencies for the main module.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, int.MaxValue)]
+        public int Depth { get; set; } = 0;
+
+        /// <summary>
+        /// <para type="description">The Windows directory side-by-side assemblies are looked up in, like the one of a mounted image.</para>
+        /// <para type="description">Defaults to the Windows directory of this system.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateNotNullOrEmpty]
+        public string Sysroot { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            string destination = GetUnresolvedProviderPathFromPSPath(Destination);
+            string sysroot = string.IsNullOrEmpty(Sysroot) ? null : GetUnresolvedProviderPathFromPSPath(Sysroot);
+            int node_count = DependencySnapshot.Export(Path, Depth, destination, sysroot);
+
+            WriteVerbose($"Wrote {node_count} modules to '{destination}'.");
+            WriteObject(new FileInfo(destination));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Compares two dependency snapshots.</para>
+    /// <para type="description">This Cmdlet compares two snapshots written by 'Export-PeDependencySnapshot', matching modules by name.</para>
+    /// <para type="description">It returns the modules, and edges added or removed, the imported and exported functions added or removed, and the header fields that changed.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Compare-PeDependencySnapshot -ReferencePath 'C:\Builds\100\app.lssn' -DifferencePath 'C:\Builds\101\app.lssn'</code>
+    ///     <para>Listing what changed in the dependency chain between build 100, and 101.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsData.Compare, "PeDependencySnapshot")]
+    [OutputType(typeof(SnapshotDiffEntry))]
+    public class ComparePeDependencySnapshotCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The snapshot used as reference, usually the older one.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0)]
+        [ValidateNotNullOrEmpty]
+        public string ReferencePath { get; set; }
+
+        /// <summary>
+        /// <para type="description">The snapshot compared against the reference.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 1)]
+        [ValidateNotNullOrEmpty]
+        public string DifferencePath { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            string reference_path = GetUnresolvedProviderPathFromPSPath(ReferencePath);
+            string difference_path = GetUnresolvedProviderPathFromPSPath(DifferencePath);
+
+            WriteObject(DependencySnapshot.Compare(reference_path, difference_path), true);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Computes the Authenticode digest, and the PE checksum of an image.</para>
+    /// <para type="description">This Cmdlet reads the file once, computing the SHA-1 and SHA-256 Authenticode digests, and the PE checksum in the same pass.</para>
+    /// <para type="description">The digest skips the checksum field, the certificate table entry, and the certificate table, so it matches the digest signed in the file.</para>
+    /// <para type="description">Optionally, it also computes the page hashes, used by signatures with page hashing.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-PeAuthenticodeHash -Path 'C:\Windows\System32\kernel32.dll'</code>
+    ///     <para>Getting the Authenticode digests, and checksum for 'kernel32.dll'.</para>
+    ///     <para></para>
+    /// </example>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Windows\System32\*.dll' | Get-PeAuthenticodeHash | Where-Object { -not $_.CheckSumValid }</code>
+    ///     <para>Listing the system DLLs with an invalid checksum.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeAuthenticodeHash")]
+    [OutputType(typeof(ImageDigest))]
+    public class GetPeAuthenticodeHashCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The algorithm used for the page hashes. 'None' skips them.</para>
+        /// </summary>
+        [Parameter()]
+        public PageHashAlgorithm PageHashAlgorithm { get; set; } = PageHashAlgorithm.None;
+
+        protected override void ProcessRecord()
+        {
+            string file_path = GetUnresolvedProviderPathFromPSPath(Path);
+            WriteObject(AuthenticodeHasher.Hash(file_path, PageHashAlgorithm));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Gets the Authenticode signers of an image.</para>
+    /// <para type="description">This Cmdlet reads the image's attribute certificate table, and walks the PKCS #7 signatures in it, including nested ones.</para>
+    /// <para type="description">It returns the signer subject, issuer, serial number, signing time, and digest algorithms, without calling the platform trust APIs.</para>
+    /// <para type="description">The signatures are not verified. Use 'Get-AuthenticodeSignature' for that.</para>
+    /// <para type="description">Parsed signatures are cached by content hash, so scanning the same binaries again costs one read of the certificate table.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Windows\System32\*.dll' | Get-PeSignature | Where-Object { -not $_.IsSigned }</code>
+    ///     <para>Listing the system DLLs without an embedded signature.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeSignature")]
+    [OutputType(typeof(ImageSignature))]
+    public class GetPeSignatureCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            WriteObject(AuthenticodeSignature.Get(GetUnresolvedProviderPathFromPSPath(Path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Gets the debug directory of an image.</para>
+    /// <para type="description">This Cmdlet reads the image's debug directory, and decodes the CodeView (RSDS and NB10), POGO, repro, and embedded portable PDB entries.</para>
+    /// <para type="description">Each CodeView record comes with its symbol server key.</para>
+    /// <para type="description">Only the headers, the directory, and the entry data are read. The image is not mapped.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-PeDebugInfo -Path 'C:\Windows\System32\kernel32.dll').CodeView</code>
+    ///     <para>Getting the PDB GUID, age, and path for 'kernel32.dll'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeDebugInfo")]
+    [OutputType(typeof(ImageDebugInfo))]
+    public class GetPeDebugInfoCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            WriteObject(DebugDirectory.Get(GetUnresolvedProviderPathFromPSPath(Path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Gets the symbol server keys of a set of images.</para>
+    /// <para type="description">This Cmdlet collects the paths from the pipeline, and reads only the headers, the debug directory, and the CodeView records of each file, on multiple threads.</para>
+    /// <para type="description">The key is in the symbol server layout, 'name.pdb/GUIDAGE/name.pdb'.</para>
+    /// <para type="description">Files that can't be read, or have no CodeView record, are returned with the error.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Windows\System32\*.dll' | Get-PeSymbolKey | Where-Object { $_.SymbolKey }</code>
+    ///     <para>Computing the symbol server keys for the system DLLs.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeSymbolKey")]
+    [OutputType(typeof(SymbolKeyInfo))]
+    public class GetPeSymbolKeyCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            foreach (SymbolKeyInfo key in DebugDirectory.GetSymbolKeys(_paths, ThrottleLimit))
+                WriteObject(key);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Gets the Rich header of an image.</para>
+    /// <para type="description">This Cmdlet decodes the Rich header the Microsoft linker writes between the DOS stub, and the NT headers.</para>
+    /// <para type="description">Each entry is a comp.id, the tool product ID and build, and the number of objects it produced.</para>
+    /// <para type="description">Only the bytes before the NT headers are read.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-PeRichHeader -Path 'C:\Windows\System32\kernel32.dll').Entries</code>
+    ///     <para>Listing the tools that built 'kernel32.dll'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeRichHeader")]
+    [OutputType(typeof(RichHeaderInfo))]
+    public class GetPeRichHeaderCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            WriteObject(RichHeader.Get(GetUnresolvedProviderPathFromPSPath(Path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Counts the toolchains that built a set of images.</para>
+    /// <para type="description">This Cmdlet collects the paths from the pipeline, decodes the Rich header of each file with a single read, and counts the files, and objects for each comp.id.</para>
+    /// <para type="description">Results are sorted by file count. Files that can't be read, or are not images, are not counted, and are written as non-terminating errors.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files\MyApp' -Recurse -Include *.dll, *.exe | Measure-PeToolchain</code>
+    ///     <para>Listing the MSVC tool builds used across an application.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsDiagnostic.Measure, "PeToolchain")]
+    [OutputType(typeof(ToolchainCount))]
+    public class MeasurePeToolchainCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+
+        /// <summary>
+        /// <para type="description">The image file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            ToolchainReport report = RichHeader.Aggregate(_paths);
+            foreach (ToolchainFailure failure in report.Failures)
+                WriteError(new ErrorRecord(failure.Error, "ImageReadError", ErrorCategory.ReadError, failure.Path));
+
+            foreach (ToolchainCount count in report.Counts)
+                WriteObject(count);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Estimates the cost of loading a module's dependency chain.</para>
+    /// <para type="description">This Cmdlet resolves the dependency chain natively, and parses the base relocation, TLS, and load config directories of every module.</para>
+    /// <para type="description">It returns the total committed image size, the fixups applied if ASLR moves the images, the TLS callbacks, and the control flow guard table sizes, with a per module breakdown.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Measure-PeLoadCost -Path 'C:\Windows\explorer.exe').Modules | Sort-Object FixupCount -Descending | Select-Object -First 10</code>
+    ///     <para>Listing the modules in the 'explorer.exe' chain with the most fixups.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsDiagnostic.Measure, "PeLoadCost")]
+    [OutputType(typeof(ChainLoadCost))]
+    public class MeasurePeLoadCostCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The path, or name for a portable executable.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0)]
+        [Alias("Name")]
+        public string Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The maximum recursion depth.</para>
+        /// <para type="description">Depth 1 returns only the dependencies for the main module.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, int.MaxValue)]
+        public int Depth { get; set; } = 0;
+
+        /// <summary>
+        /// <para type="description">The Windows directory side-by-side assemblies are looked up in, like the one of a mounted image.</para>
+        /// <para type="description">Defaults to the Windows directory of this system.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateNotNullOrEmpty]
+        public string Sysroot { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            string sysroot = string.IsNullOrEmpty(Sysroot) ? null : GetUnresolvedProviderPathFromPSPath(Sysroot);
+            WriteObject(LoadCost.Measure(Path, Depth, sysroot));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Finds the functions containing a set of relative virtual addresses.</para>
+    /// <para type="description">This Cmdlet maps the image, and searches the exception directory (.pdata) of x64, and ARM64 images in place.</para>
+    /// <para type="description">The addresses are sorted, and matched against the table in a single pass. Optionally, the unwind data of each function is decoded.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Find-PeFunction -Path 'C:\Windows\System32\ntdll.dll' -Rva 0x1000, 0x2F4A0 -IncludeUnwindInfo</code>
+    ///     <para>Finding the functions, and unwind data for two addresses in 'ntdll.dll'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Find, "PeFunction")]
+    [OutputType(typeof(FunctionMatch))]
+    public class FindPeFunctionCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The path for a portable executable.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0)]
+        [ValidateNotNullOrEmpty]
+        public string Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The relative virtual addresses to look up.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 1,
+            ValueFromPipeline = true)]
+        public uint[] Rva { get; set; }
+
+        /// <summary>
+        /// <para type="description">Decodes the unwind data of each function found.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter IncludeUnwindInfo { get; set; }
+
+        private readonly List<uint> _rvas = new();
+
+        protected override void ProcessRecord()
+        {
+            _rvas.AddRange(Rva);
+        }
+
+        protected override void EndProcessing()
+        {
+            foreach (FunctionMatch match in FunctionTable.Lookup(GetUnresolvedProviderPathFromPSPath(Path), _rvas, IncludeUnwindInfo))
+                WriteObject(match);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Reads a COFF object file.</para>
+    /// <para type="description">This Cmdlet maps an object file, regular or /bigobj, and lists its sections, with long names decoded from the string table, and its symbol table, with auxiliary records.</para>
+    /// <para type="description">Use 'IncludeRelocations' to read the relocations of each section.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-CoffObject -Path '.\x64\Release\Wrapper.obj').Symbols | Where-Object { $_.SectionNumber -eq 0 }</code>
+    ///     <para>Listing the undefined symbols in an object file.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "CoffObject")]
+    [OutputType(typeof(CoffObjectInfo))]
+    public class GetCoffObjectCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The object file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">Reads the relocations of each section.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter IncludeRelocations { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+            {
+                CoffObjectInfo info = CoffFile.Get(GetUnresolvedProviderPathFromPSPath(path), IncludeRelocations);
+                if (!info.IsKnownMachine)
+                    WriteWarning($"'{info.Path}' is for an unknown machine, 0x{info.Machine:X4}.");
+
+                WriteObject(info);
+            }
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Counts the references, and definitions of external symbols across object files.</para>
+    /// <para type="description">This Cmdlet maps each object file on multiple threads, and walks its symbol table in place.</para>
+    /// <para type="description">It returns, for each external symbol, how many symbol records reference, and define it. Files that can't be read are written as errors.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem '.\x64\Release\*.obj' | Get-CoffSymbolUsage -Unresolved</code>
+    ///     <para>Listing the symbols referenced, and defined by no object in a build.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "CoffSymbolUsage")]
+    [OutputType(typeof(CoffSymbolUsage))]
+    public class GetCoffSymbolUsageCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+
+        /// <summary>
+        /// <para type="description">The object file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">Returns only the symbols no object defines.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter Unresolved { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            CoffScanReport report = CoffFile.Scan(_paths, ThrottleLimit, Unresolved);
+            foreach (CoffObjectSummary summary in report.Objects)
+            {
+                if (summary.Error is not null)
+                    WriteError(new ErrorRecord(summary.Error, "CoffObjectReadError", ErrorCategory.ReadError, summary.Path));
+                else if (!summary.IsKnownMachine)
+                    WriteWarning($"'{summary.Path}' is for an unknown machine, 0x{summary.Machine:X4}.");
+            }
+
+            foreach (CoffSymbolUsage usage in report.Symbols)
+                WriteObject(usage);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Lists the members of a static, or import library.</para>
+    /// <para type="description">This Cmdlet maps an archive, and reads the member headers, linker members, and long names in place.</para>
+    /// <para type="description">Object members are read where they are, without extracting them, and short import entries are decoded to the module, and name imported.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-LibraryArchive -Path 'C:\Program Files (x86)\Windows Kits\10\Lib\10.0.22621.0\um\x64\kernel32.lib').Members | Where-Object Kind -EQ Import</code>
+    ///     <para>Listing the import entries in 'kernel32.lib'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "LibraryArchive")]
+    [OutputType(typeof(LibraryInfo))]
+    public class GetLibraryArchiveCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The library file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                WriteObject(StaticLibrary.Get(GetUnresolvedProviderPathFromPSPath(path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Indexes the symbols of static, and import libraries.</para>
+    /// <para type="description">This Cmdlet reads the symbol index in the linker members of each library, on multiple threads, and maps each symbol to its member.</para>
+    /// <para type="description">Symbols from import entries come with the module, and the name, or ordinal imported. Libraries that can't be read are written as errors.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files (x86)\Windows Kits\10\Lib\10.0.22621.0\um\x64\*.lib' | Get-LibrarySymbol | Where-Object Name -EQ 'CreateFileW'</code>
+    ///     <para>Finding the libraries, and modules 'CreateFileW' links to.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "LibrarySymbol")]
+    [OutputType(typeof(LibrarySymbol))]
+    public class GetLibrarySymbolCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+
+        /// <summary>
+        /// <para type="description">The library file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            foreach (LibraryIndex index in StaticLibrary.GetSymbols(_paths, ThrottleLimit))
+            {
+                if (index.Error is not null)
+                {
+                    WriteError(new ErrorRecord(index.Error, "LibraryReadError", ErrorCategory.ReadError, index.Path));
+                    continue;
+                }
+
+                foreach (LibrarySymbol symbol in index.Symbols)
+                    WriteObject(symbol);
+            }
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Computes the import hash (imphash), and the export hash of portable executables.</para>
+    /// <para type="description">This Cmdlet maps each image on multiple threads, and computes both hashes while it walks the import, and export tables.</para>
+    /// <para type="description">The import hash is the imphash, the MD5 of the lowercase 'module.function' list from the import table. The export hash doesn't depend on the export order.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Windows\System32\*.dll' | Get-PeImportHash</code>
+    ///     <para>Computing the hashes for every DLL in 'System32'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeImportHash")]
+    [OutputType(typeof(ImageSymbolHash))]
+    public class GetPeImportHashCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+        private readonly ScanLimits _limits = new();
+
+        /// <summary>
+        /// <para type="description">The portable executable file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">Finds files with the same content first, and parses each of them once. Useful when the same DLL is copied in many directories.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter Deduplicate { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        /// <summary>
+        /// <para type="description">The maximum time in seconds for the whole batch. Zero, the default, means no timeout.</para>
+        /// <para type="description">When the time runs out, or the command is stopped, the files not started yet fail with a timeout, or cancelled error.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, int.MaxValue)]
+        public int TimeoutSec { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            _limits.Timeout = TimeSpan.FromSeconds(TimeoutSec);
+            foreach (ImageSymbolHash image in SymbolHash.Compute(_paths, ThrottleLimit, Deduplicate, _limits).Images)
+            {
+                if (image.Error is not null)
+                {
+                    WriteError(new ErrorRecord(image.Error, "ImageReadError", ErrorCategory.ReadError, image.Path));
+                    continue;
+                }
+
+                if (image.IsPartial)
+                    WriteWarning($"The tables of '{image.Path}' were not read to the end. Limit reached: {image.StopReason}.");
+
+                WriteObject(image);
+            }
+        }
+
+        protected override void StopProcessing()
+        {
+            _limits.Cancel();
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Groups portable executables by import hash (imphash), or export hash.</para>
+    /// <para type="description">This Cmdlet hashes each image on multiple threads, and groups the files sharing a hash as they finish.</para>
+    /// <para type="description">Groups are returned largest first. By default only groups with more than one file are returned.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files' -Filter '*.dll' -Recurse | Group-PeImportHash</code>
+    ///     <para>Finding DLLs in 'Program Files' with the same import profile.</para>
+    ///     <para></para>
+    /// </example>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files' -Filter '*.dll' -Recurse | Group-PeImportHash -Kind Export -MinimumCount 10</code>
+    ///     <para>Finding export sets shared by ten or more DLLs, like vendored copies of the same library.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsData.Group, "PeImportHash")]
+    [OutputType(typeof(SymbolHashGroup))]
+    public class GroupPeImportHashCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+        private readonly ScanLimits _limits = new();
+
+        /// <summary>
+        /// <para type="description">The portable executable file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The hash to group by. 'Import' is the imphash.</para>
+        /// </summary>
+        [Parameter()]
+        public SymbolHashKind Kind { get; set; } = SymbolHashKind.Import;
+
+        /// <summary>
+        /// <para type="description">The minimum number of files in a group.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(1, int.MaxValue)]
+        public int MinimumCount { get; set; } = 2;
+
+        /// <summary>
+        /// <para type="description">Finds files with the same content first, and parses each of them once. Useful when the same DLL is copied in many directories.</para>
+        /// </summary>
+        [Parameter()]
+        public SwitchParameter Deduplicate { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        /// <summary>
+        /// <para type="description">The maximum time in seconds for the whole batch. Zero, the default, means no timeout.</para>
+        /// <para type="description">When the time runs out, or the command is stopped, the files not started yet fail with a timeout, or cancelled error.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, int.MaxValue)]
+        public int TimeoutSec { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            _limits.Timeout = TimeSpan.FromSeconds(TimeoutSec);
+            SymbolHashReport report = SymbolHash.Compute(_paths, ThrottleLimit, Deduplicate, _limits);
+            foreach (ImageSymbolHash image in report.Images)
+            {
+                if (image.Error is not null)
+                    WriteError(new ErrorRecord(image.Error, "ImageReadError", ErrorCategory.ReadError, image.Path));
+                else if (image.IsPartial)
+                    WriteWarning($"The tables of '{image.Path}' were not read to the end, and it's not grouped by the hashes it couldn't finish. Limit reached: {image.StopReason}.");
+            }
+
+            foreach (SymbolHashGroup group in report.Groups)
+            {
+                if (group.Kind == Kind && group.Count >= MinimumCount)
+                    WriteObject(group);
+            }
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Finds files with the same content.</para>
+    /// <para type="description">This Cmdlet groups files by size, then by a hash of the headers and pages sampled over the file, then by SHA-256, each pass on multiple threads and only over the files the previous pass couldn't tell apart.</para>
+    /// <para type="description">Each set lists the paths with the same content. Files with a size of their own are never opened.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files' -Filter '*.dll' -Recurse | Find-PeDuplicate</code>
+    ///     <para>Finding DLLs copied in more than one directory in 'Program Files'.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Find, "PeDuplicate")]
+    [OutputType(typeof(DuplicateSet))]
+    public class FindPeDuplicateCommand : PSCmdlet
+    {
+        private readonly List<string> _paths = new();
+
+        /// <summary>
+        /// <para type="description">The file path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        /// <summary>
+        /// <para type="description">The number of reader threads. Zero, the default, means one per processor.</para>
+        /// </summary>
+        [Parameter()]
+        [ValidateRange(0, 64)]
+        public int ThrottleLimit { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                _paths.Add(GetUnresolvedProviderPathFromPSPath(path));
+        }
+
+        protected override void EndProcessing()
+        {
+            foreach (DuplicateSet set in ContentDedup.Find(_paths, ThrottleLimit))
+                WriteObject(set);
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Lists the files embedded in a .NET single-file bundle.</para>
+    /// <para type="description">This Cmdlet finds the bundle header in the apphost, reads the manifest, and lists each embedded file with its offset, size, and type.</para>
+    /// <para type="description">Assemblies, and native binaries are parsed where they are in the bundle, without being extracted. Their imports, assembly references, and P/Invoke modules come from the headers, and the CLR metadata. Compressed files are inflated in memory, only as far as the tables the parser reads.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-PeBundle -Path 'C:\Tools\MyTool.exe').Entries | Where-Object Type -EQ 'Assembly' | Select-Object RelativePath, AssemblyFullName</code>
+    ///     <para>Listing the assemblies bundled in a single-file application.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeBundle")]
+    [OutputType(typeof(BundleInfo))]
+    public class GetPeBundleCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The single-file application path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                WriteObject(SingleFileBundle.Get(GetUnresolvedProviderPathFromPSPath(path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Reads the ReadyToRun header of a .NET image.</para>
+    /// <para type="description">This Cmdlet finds the READYTORUN_HEADER through the COR header, or the 'RTR_HEADER' export of composite images, and lists its sections.</para>
+    /// <para type="description">Composite membership, the owner composite image, the component assemblies, and the assemblies in the manifest metadata are reported. The file is mapped as data, and only the header, and the sections read are touched. NGen images are recognized, but their native header is not read.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>Get-ChildItem 'C:\Program Files\dotnet\shared\Microsoft.NETCore.App\8.0.0\*.dll' | Get-PeReadyToRun | Where-Object IsReadyToRun</code>
+    ///     <para>Listing the ReadyToRun images of a shared framework.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PeReadyToRun")]
+    [OutputType(typeof(ReadyToRunInfo))]
+    public class GetPeReadyToRunCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The image path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                WriteObject(ReadyToRunImage.Get(GetUnresolvedProviderPathFromPSPath(path)));
+        }
+    }
+
+    /// <summary>
+    /// <para type="synopsis">Lists the files in a zip archive, or NuGet package, and parses the images in it.</para>
+    /// <para type="description">This Cmdlet reads the central directory, and lists each entry with its compression method, and sizes.</para>
+    /// <para type="description">Images, by extension, are parsed without being extracted. Stored ones are read where they are in the archive, deflated ones are inflated in memory only as far as the headers, and the sections holding the import, export, and CLR tables. Their imports, assembly references, and P/Invoke modules are returned for each entry.</para>
+    /// <example>
+    ///     <para></para>
+    ///     <code>(Get-PePackage -Path 'C:\Packages\newtonsoft.json.13.0.3.nupkg').Entries | Where-Object IsImage | Select-Object Name, AssemblyFullName, References</code>
+    ///     <para>Listing the assemblies in a NuGet package, and what they reference.</para>
+    ///     <para></para>
+    /// </example>
+    /// </summary>
+    [Cmdlet(VerbsCommon.Get, "PePackage")]
+    [OutputType(typeof(PackageInfo))]
+    public class GetPePackageCommand : PSCmdlet
+    {
+        /// <summary>
+        /// <para type="description">The zip archive, or NuGet package path.</para>
+        /// </summary>
+        [Parameter(
+            Mandatory = true,
+            Position = 0,
+            ValueFromPipeline = true,
+            ValueFromPipelineByPropertyName = true)]
+        [Alias("FullName")]
+        [ValidateNotNullOrEmpty]
+        public string[] Path { get; set; }
+
+        protected override void ProcessRecord()
+        {
+            foreach (string path in Path)
+                WriteObject(PackageArchive.Get(GetUnresolvedProviderPathFromPSPath(path)));
+        }
+    }
 }
\ No newline at end of file
@@ -18,23 +18,64 @@ namespace LibSnitcher
             _printed = new();
         }
 
-        public List<Module> GetDependencyChainList(string lib_name, bool unique, int max_depth)
+        public List<Module> GetDependencyChainList(string lib_name, bool unique, int max_depth, ScanLimits limits = null)
         {
-            DependencyChain factory = DependencyChain.GetChain(unique, max_depth);
+            DependencyChain factory = DependencyChain.GetChain(unique, max_depth, false, limits);
             List<Module> chain = factory.ResolveDependencyChain(lib_name);
 
             factory.Dispose();
+            WarnPartial(lib_name, chain, limits);
 
             return chain;
         }
 
-        public void PrintModuleDependencyChain(string lib_name, bool unique, int max_depth)
+        public void PrintModuleDependencyChain(string lib_name, bool unique, int max_depth, bool heuristic, string trace_path, ScanLimits limits = null, string sysroot = null)
         {
-            DependencyChain factory = DependencyChain.GetChain(unique, max_depth);
-            List<Module> chain = factory.ResolveDependencyChain(lib_name);
-            GetTextListFromModuleList(chain.First(m => m.Depth == 0));
+            DependencyChain factory = DependencyChain.GetChain(unique, max_depth, heuristic, limits, sysroot);
+            List<Module> chain;
+            try
+            {
+                if (!string.IsNullOrEmpty(trace_path))
+                    factory.StartTrace();
 
-            factory.Dispose();
+                try
+                {
+                    chain = factory.ResolveDependencyChain(lib_name);
+                }
+                finally
+                {
+                    // Also when the resolution throws, or the pipeline is stopped, with what was recorded until then.
+                    // A trace that can't be written is not worth losing the resolution error over.
+                    if (!string.IsNullOrEmpty(trace_path))
+                    {
+                        try
+                        {
+                            factory.StopTrace(trace_path);
+                        }
+                        catch (Exception ex)
+                        {
+                            _context.WriteWarning($"The trace could not be written to '{trace_path}'. {ex.Message}");
+                        }
+                    }
+                }
+
+                GetTextListFromModuleList(chain.First(m => m.Depth == 0));
+            }
+            finally
+            {
+                factory.Dispose();
+            }
+
+            WarnPartial(lib_name, chain, limits);
+        }
+
+        private void WarnPartial(string lib_name, List<Module> chain, ScanLimits limits)
+        {
+            if (limits is not null && limits.StopReason != WorkStopReason.None)
+                _context.WriteWarning($"The dependency chain for '{lib_name}' is partial. Stopped by: {limits.StopReason}.");
+
+            foreach (Module module in chain.Where(m => m.IsPartial))
+                _context.WriteWarning($"The import tables of '{module.Name}' were not read to the end. Limit reached: {module.StopReason}.");
         }
 
         private void GetTextListFromModuleList(Module root)
@@ -53,7 +94,17 @@ namespace LibSnitcher
         {
             StringBuilder buffer = new();
             buffer.Append(' ', module.Depth * 2);
-            buffer.Append($"{module.AbsoluteName} (Loaded: {module.Loaded}): {module.PostfixText}");
+            if (module.Source == DependencySource.Heuristic)
+                buffer.Append($"{module.AbsoluteName} (Loaded: {module.Loaded}; Heuristic): {module.PostfixText}");
+            else if (module.Source == DependencySource.Bundle)
+                buffer.Append($"{module.AbsoluteName} (Loaded: {module.Loaded}; Bundle): {module.PostfixText}");
+            else if (module.Source == DependencySource.ReadyToRun)
+                buffer.Append($"{module.AbsoluteName} (Loaded: {module.Loaded}; ReadyToRun): {module.PostfixText}");
+            else
+                buffer.Append($"{module.AbsoluteName} (Loaded: {module.Loaded}): {module.PostfixText}");
+
+            if (module.IsPartial)
+                buffer.Append($" (Partial: {module.StopReason})");
 
             // buffer.Append($"{module.AbsoluteName} <{module.Depth}> (Loaded: {module.Loaded}; Parent: {module.Parent}): {module.Path}");
             // buffer.Append($"{module.AbsoluteName} (Id: {module.Id};Loaded: {module.Loaded}; Parent Id: {module.ParentId};Parent: {module.Parent}): {module.Path}");
@@ -64,13 +115,21 @@ namespace LibSnitcher
 
     internal class DependencyChain : IDisposable
     {
+        private const int ERROR_MOD_NOT_FOUND = 126;
+
         private bool _unique;
         private int _max_depth;
         private readonly Wrapper _unwrapper;
-        private static DependencyChain _instance;
         private readonly Dictionary<string, Module> _result;
+        private ResolvedChain _native;
+
+        internal bool Unique { get { return _unique; } }
 
-        internal bool Unique { get { return _instance._unique; } }
+        // The native modules of the chain, resolved in one call after the root.
+        internal ResolvedChain Native { get { return _native; } }
+
+        // Cancelled, or past the timeout. Modules not resolved yet are left out.
+        internal bool IsStopped { get { return _unwrapper.Limits is not null && _unwrapper.Limits.Check() != WorkStopReason.None; } }
 
         private DependencyChain(int max_depth)
         {
@@ -81,40 +140,88 @@ namespace LibSnitcher
 
         public void Dispose()
         {
-            // Being static, the instance only gets collected when its app domain dies.
-            // If we call the Cmdlet again with different parameters, we will be using the
-            // previous instance. Setting it to null makes it available to the GC.
-            _instance = null;
-            GC.Collect();
+            _native?.Dispose();
+            _unwrapper.Dispose();
         }
 
-        internal static DependencyChain GetChain(bool unique, int max_depth)
+        internal void StartTrace() => _unwrapper.StartTrace();
+
+        internal void StopTrace(string file_path) => _unwrapper.StopTrace(file_path);
+
+        // A new chain per call. Nothing is shared, so commands in different runspaces can resolve at the same time.
+        internal static DependencyChain GetChain(bool unique, int max_depth, bool heuristic, ScanLimits limits = null, string sysroot = null)
         {
-            _instance ??= new(max_depth);
-            _instance._unique = unique;
-            return _instance;
+            DependencyChain chain = new(max_depth);
+            chain._unique = unique;
+            chain._unwrapper.ScanStrings = heuristic;
+            chain._unwrapper.Limits = limits;
+            chain._unwrapper.Sysroot = sysroot;
+            return chain;
         }
 
         internal List<Module> ResolveDependencyChain(string module_name)
         {
             Module root = GetModule(Guid.Empty, module_name, string.Empty, DependencySource.None, 0, out _);
+
+            // The root goes through the wrapper, it might be an assembly, or a bundle. The native modules
+            // under it are resolved at once, instead of one wrapper call, and one 'ModuleBase' each.
+            if (root.Loaded && !IsStopped)
+                _native = _unwrapper.ResolveChain(root.Path ?? module_name, Math.Max(_max_depth, 0));
+
             root.ResolveDependencies();
-            return _instance._result.Values.ToList();
+            return _result.Values.ToList();
         }
 
         internal Module GetModule(Guid parent_id, string name, string parent, DependencySource source, int new_depth, out bool is_trivial)
         {
-            Module new_module;
-            ModuleBase base_module;
+            if (_result.TryGetValue(name, out Module module))
+            {
+                is_trivial = true;
+                return module.TrivialCopy(new_depth, parent, parent_id);
+            }
+
+            // Bundle entries, and assemblies are not in the native chain, even when the name matches.
+            int node = -1;
+            if (_native is not null && (source == DependencySource.PeTables || source == DependencySource.Heuristic))
+                node = _native.FindNode(name);
+
+            return AddModule(parent_id, name, node, parent, source, new_depth, out is_trivial);
+        }
 
-            if (_instance._result.TryGetValue(name, out Module module))
+        // For the dependencies of a module from the native chain, they are nodes already.
+        internal Module GetModule(Guid parent_id, int node, string parent, DependencySource source, int new_depth, out bool is_trivial)
+        {
+            string name = _native.GetName(node);
+            if (_result.TryGetValue(name, out Module module))
             {
                 is_trivial = true;
                 return module.TrivialCopy(new_depth, parent, parent_id);
             }
 
-            base_module = _unwrapper.GetDependencyList(name, source);
-            new_module = new(parent_id, parent, source, new_depth, base_module, ref _instance);
+            return AddModule(parent_id, name, node, parent, source, new_depth, out is_trivial);
+        }
+
+        private Module AddModule(Guid parent_id, string name, int node, string parent, DependencySource source, int new_depth, out bool is_trivial)
+        {
+            Module new_module;
+
+            // The native chain has no assembly references, and the wrapper has more to say about what failed to load.
+            // A module reached here by a longer path than in the native walk can need dependencies the native walk
+            // didn't go down to. Nodes are only used when they were expanded, or the module won't be.
+            bool expands = _max_depth <= 0 || new_depth < _max_depth;
+            if (node >= 0 && _native.IsLoaded(node) && !_native.IsClr(node) && (!expands || _native.IsExpanded(node)))
+                new_module = new(parent_id, parent, source, new_depth, _native, node, this);
+            else
+                new_module = new(parent_id, parent, source, new_depth, _unwrapper.GetDependencyList(name, source, new_depth, parent), this);
+
+            // The same rule as the native chain. Heuristic names that are not there are mostly strings that only
+            // look like file names, so they are left out, and not remembered, an import of the name still resolves.
+            if (source == DependencySource.Heuristic && !new_module.Loaded && new_module.LoaderException is NativeException { ErrorCode: ERROR_MOD_NOT_FOUND })
+            {
+                is_trivial = true;
+                return null;
+            }
+
             _result.Add(name, new_module);
 
             if (_max_depth > 0)
@@ -142,6 +249,9 @@ namespace LibSnitcher
         private readonly DependencyChain _chain;
         private readonly List<DependencyEntry> _native_dependencies;
 
+        // The node in the chain native modules come from, or -1 for the ones from the wrapper.
+        private readonly int _node;
+
         internal Guid Id { get; private set; }
         internal Guid ParentId { get; private set; }
 
@@ -154,6 +264,15 @@ namespace LibSnitcher
         public bool IsClr { get; }
         public bool Loaded { get; }
         public Exception LoaderException { get; }
+        public string FileVersion { get; }
+        public string ProductVersion { get; }
+        public string CompanyName { get; }
+        public string FileDescription { get; }
+        public bool IsReadyToRun { get; }
+        public bool IsCompositeImage { get; }
+        public string OwnerComposite { get; }
+        public bool IsPartial { get; }
+        public WorkStopReason StopReason { get; }
 
         public List<Module> Dependencies { get; private set; }
 
@@ -183,7 +302,7 @@ namespace LibSnitcher
             }
         }
 
-        internal Module(Guid parent_id, string parent, DependencySource source, int depth, ModuleBase base_module, ref DependencyChain chain)
+        internal Module(Guid parent_id, string parent, DependencySource source, int depth, ModuleBase base_module, DependencyChain chain)
         {
             Id = Guid.NewGuid();
             ParentId = parent_id;
@@ -197,6 +316,15 @@ namespace LibSnitcher
             AssemblyFullName = base_module.AssemblyFullName;
             Loaded = base_module.Loaded;
             LoaderException = base_module.LoaderException;
+            FileVersion = base_module.FileVersion;
+            ProductVersion = base_module.ProductVersion;
+            CompanyName = base_module.CompanyName;
+            FileDescription = base_module.FileDescription;
+            IsReadyToRun = base_module.IsReadyToRun;
+            IsCompositeImage = base_module.IsCompositeImage;
+            OwnerComposite = base_module.OwnerComposite;
+            IsPartial = base_module.IsPartial;
+            StopReason = base_module.StopReason;
 
             Dependencies = new();
             if (base_module.Dependencies is not null)
@@ -204,6 +332,31 @@ namespace LibSnitcher
             else
                 _native_dependencies = new();
 
+            _node = -1;
+            _chain = chain;
+        }
+
+        internal Module(Guid parent_id, string parent, DependencySource source, int depth, ResolvedChain native, int node, DependencyChain chain)
+        {
+            Id = Guid.NewGuid();
+            ParentId = parent_id;
+            Parent = parent;
+            Source = source;
+            Depth = depth;
+
+            Name = native.GetName(node);
+            Path = native.GetPath(node);
+            AssemblyFullName = string.Empty;
+            Loaded = true;
+            FileVersion = native.GetFileVersion(node);
+            ProductVersion = native.GetProductVersion(node);
+            CompanyName = native.GetCompanyName(node);
+            FileDescription = native.GetFileDescription(node);
+            StopReason = native.GetStopReason(node);
+            IsPartial = StopReason != WorkStopReason.None;
+
+            Dependencies = new();
+            _node = node;
             _chain = chain;
         }
 
@@ -227,9 +380,24 @@ namespace LibSnitcher
         {
             // DependencyChain.PrintLocation("Module.ResolveDependencies");
             List<Module> new_dependencies = new();
-            foreach (DependencyEntry entry in _native_dependencies)
+            ResolvedChain native = _chain.Native;
+            int count = _node >= 0 ? native.GetDependencyCount(_node) : _native_dependencies.Count;
+            for (int i = 0; i < count; i++)
             {
-                Module dependency = _chain.GetModule(Id, entry.Name, Name, entry.Source, Depth + 1, out bool is_trivial);
+                if (_chain.IsStopped)
+                    return;
+
+                Module dependency;
+                bool is_trivial;
+                if (_node >= 0)
+                    dependency = _chain.GetModule(Id, native.GetDependency(_node, i), Name, native.GetDependencySource(_node, i), Depth + 1, out is_trivial);
+                else
+                    dependency = _chain.GetModule(Id, _native_dependencies[i].Name, Name, _native_dependencies[i].Source, Depth + 1, out is_trivial);
+
+                // A heuristic name that was not found.
+                if (dependency is null)
+                    continue;
+
                 if (is_trivial)
                 {
                     Dependencies.Add(dependency);
@@ -241,7 +409,12 @@ namespace LibSnitcher
             }
 
             foreach (Module dependency in new_dependencies)
+            {
+                if (_chain.IsStopped)
+                    return;
+
                 dependency.ResolveDependencies();
+            }
         }
     }
 }
\ No newline at end of file